@@ -2,6 +2,7 @@ QT       += core gui sql widgets svg
 QT       += widgets
 QT       += opengl
 QT       += printsupport
+QT       += concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -12,11 +13,55 @@ CONFIG += c++11
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    attributetablemodel.cpp \
+    coordinatetransformer.cpp \
+    featureloader.cpp \
+    featurerenderer.cpp \
+    featureselection.cpp \
+    featurestore.cpp \
+    geometrychecker.cpp \
+    geoprocessing.cpp \
+    geosutils.cpp \
+    heatmap.cpp \
+    labelengine.cpp \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    mapcanvas.cpp \
+    mapexporter.cpp \
+    memoryfile.cpp \
+    pointclusterindex.cpp \
+    pointgenerator.cpp \
+    printlayout.cpp \
+    renderdiagnostics.cpp \
+    spatialindex.cpp \
+    spatialjoin.cpp \
+    vectorlayeritem.cpp \
+    vectorwriter.cpp
 
 HEADERS += \
-    mainwindow.h
+    attributetablemodel.h \
+    coordinatetransformer.h \
+    featureloader.h \
+    featurerenderer.h \
+    featureselection.h \
+    featurestore.h \
+    geometrychecker.h \
+    geoprocessing.h \
+    geosutils.h \
+    heatmap.h \
+    labelengine.h \
+    mainwindow.h \
+    mapcanvas.h \
+    mapexporter.h \
+    memoryfile.h \
+    pointclusterindex.h \
+    pointgenerator.h \
+    printlayout.h \
+    renderdiagnostics.h \
+    spatialindex.h \
+    spatialjoin.h \
+    vectorlayeritem.h \
+    vectorwriter.h
 
 FORMS += \
     mainwindow.ui
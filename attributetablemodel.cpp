@@ -0,0 +1,54 @@
+#include "attributetablemodel.h"
+
+AttributeTableModel::AttributeTableModel(const FeatureStorePtr &store, QObject *parent)
+    : QAbstractTableModel(parent)
+    , store(store)
+{
+}
+
+int AttributeTableModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() || !store) return 0;
+    return int(store->featureCount());
+}
+
+int AttributeTableModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() || !store) return 0;
+    // First column is the feature id
+    return store->fieldCount() + 1;
+}
+
+QVariant AttributeTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || !store) return QVariant();
+
+    qint64 feature = index.row();
+    int column = index.column();
+
+    if (role == Qt::DisplayRole) {
+        if (column == 0) {
+            return store->featureId(feature);
+        }
+        QVariant value = store->attribute(column - 1, feature);
+        return value.isNull() ? QVariant(QStringLiteral("NULL")) : value;
+    }
+
+    if (role == Qt::TextAlignmentRole && column > 0 &&
+            store->field(column - 1).type != FeatureStore::StringField) {
+        return int(Qt::AlignRight | Qt::AlignVCenter);
+    }
+
+    return QVariant();
+}
+
+QVariant AttributeTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole || !store) return QVariant();
+
+    if (orientation == Qt::Horizontal) {
+        if (section == 0) return QStringLiteral("FID");
+        return store->field(section - 1).name;
+    }
+    return section + 1;
+}
@@ -0,0 +1,29 @@
+#ifndef ATTRIBUTETABLEMODEL_H
+#define ATTRIBUTETABLEMODEL_H
+
+#include <QAbstractTableModel>
+
+#include "featurestore.h"
+
+// Read-only table model over the attribute columns of a FeatureStore.
+// Rows are produced on demand, so large layers open instantly.
+class AttributeTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit AttributeTableModel(const FeatureStorePtr &store, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+
+    FeatureStorePtr featureStore() const { return store; }
+
+private:
+    FeatureStorePtr store;
+};
+
+#endif // ATTRIBUTETABLEMODEL_H
@@ -0,0 +1,261 @@
+#include "coordinatetransformer.h"
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "gdal.h"
+#include "ogr_spatialref.h"
+
+namespace {
+// Below this many points the thread pool costs more than it saves
+const qint64 kMinimumChunkSize = 16384;
+
+struct Chunk {
+    double *xs;
+    double *ys;
+    qint64 count;
+    qint64 failed;
+    bool ok;
+};
+
+typedef QPair<QString, QString> CacheKey;
+}
+
+struct CoordinateTransformer::Entry {
+    OGRSpatialReference *source = nullptr;
+    OGRSpatialReference *destination = nullptr;
+    QList<OGRCoordinateTransformation*> idle;
+};
+
+namespace {
+QMutex cacheMutex;
+QHash<CacheKey, CoordinateTransformer::Entry*> cache;
+}
+
+// Borrows one transformation object of a cache entry for the current thread
+class CoordinateTransformer::Lease
+{
+public:
+    explicit Lease(Entry *entry)
+        : entry(entry)
+        , transformation(nullptr)
+    {
+        QMutexLocker locker(&cacheMutex);
+        if (!entry->idle.isEmpty()) {
+            transformation = entry->idle.takeLast();
+        } else {
+            transformation = OGRCreateCoordinateTransformation(entry->source, entry->destination);
+        }
+    }
+
+    ~Lease()
+    {
+        if (!transformation) return;
+        QMutexLocker locker(&cacheMutex);
+        entry->idle.append(transformation);
+    }
+
+    OGRCoordinateTransformation *get() const { return transformation; }
+
+private:
+    Entry *entry;
+    OGRCoordinateTransformation *transformation;
+
+    Q_DISABLE_COPY(Lease)
+};
+
+OGRSpatialReference *CoordinateTransformer::createSpatialReference(const QString &crs)
+{
+    if (crs.trimmed().isEmpty()) return nullptr;
+
+    OGRSpatialReference *srs = new OGRSpatialReference();
+    if (srs->SetFromUserInput(crs.toUtf8().constData()) != OGRERR_NONE) {
+        delete srs;
+        return nullptr;
+    }
+#if GDAL_VERSION_MAJOR >= 3
+    // GDAL 3 follows the authority axis order (lat, lon for EPSG:4326)
+    srs->SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+#endif
+    return srs;
+}
+
+bool CoordinateTransformer::isSameCrs(const QString &first, const QString &second)
+{
+    if (first == second) return true;
+
+    OGRSpatialReference *a = createSpatialReference(first);
+    OGRSpatialReference *b = createSpatialReference(second);
+    bool same = a && b && a->IsSame(b);
+    delete a;
+    delete b;
+    return same;
+}
+
+bool CoordinateTransformer::isGeographic(const QString &crs)
+{
+    OGRSpatialReference *srs = createSpatialReference(crs);
+    bool geographic = srs && srs->IsGeographic();
+    delete srs;
+    return geographic;
+}
+
+CoordinateTransformer::Entry *CoordinateTransformer::cacheEntry(const QString &sourceCrs,
+                                                                const QString &destinationCrs,
+                                                                QString *errorMessage)
+{
+    CacheKey key(sourceCrs, destinationCrs);
+    {
+        QMutexLocker locker(&cacheMutex);
+        Entry *entry = cache.value(key, nullptr);
+        if (entry) return entry;
+    }
+
+    Entry *entry = new Entry();
+    entry->source = createSpatialReference(sourceCrs);
+    entry->destination = createSpatialReference(destinationCrs);
+
+    OGRCoordinateTransformation *first = nullptr;
+    if (entry->source && entry->destination) {
+        first = OGRCreateCoordinateTransformation(entry->source, entry->destination);
+    }
+
+    if (!first) {
+        if (errorMessage) {
+            *errorMessage = QString("Cannot transform from %1 to %2: %3")
+                    .arg(sourceCrs.left(60), destinationCrs.left(60))
+                    .arg(CPLGetLastErrorMsg());
+        }
+        delete entry->source;
+        delete entry->destination;
+        delete entry;
+        return nullptr;
+    }
+    entry->idle.append(first);
+
+    QMutexLocker locker(&cacheMutex);
+    Entry *existing = cache.value(key, nullptr);
+    if (existing) {
+        // Another thread got there first
+        OGRCoordinateTransformation::DestroyCT(first);
+        delete entry->source;
+        delete entry->destination;
+        delete entry;
+        return existing;
+    }
+    cache.insert(key, entry);
+    return entry;
+}
+
+void CoordinateTransformer::clearCache()
+{
+    QMutexLocker locker(&cacheMutex);
+    for (Entry *entry : cache) {
+        for (OGRCoordinateTransformation *transformation : entry->idle) {
+            OGRCoordinateTransformation::DestroyCT(transformation);
+        }
+        delete entry->source;
+        delete entry->destination;
+        delete entry;
+    }
+    cache.clear();
+}
+
+bool CoordinateTransformer::transformChunk(Entry *entry, double *xs, double *ys, qint64 count,
+                                           qint64 *failedCount)
+{
+    Lease lease(entry);
+    if (!lease.get()) return false;
+
+    std::vector<int> success(size_t(count), 0);
+    lease.get()->Transform(int(count), xs, ys, nullptr, success.data());
+
+    // Failed points become NaN so extents and drawing skip them
+    qint64 failed = 0;
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    for (qint64 i = 0; i < count; ++i) {
+        if (!success[size_t(i)] || !std::isfinite(xs[i]) || !std::isfinite(ys[i])) {
+            xs[i] = nan;
+            ys[i] = nan;
+            ++failed;
+        }
+    }
+    if (failedCount) *failedCount = failed;
+    return true;
+}
+
+bool CoordinateTransformer::transform(const QString &sourceCrs, const QString &destinationCrs,
+                                      double *xs, double *ys, qint64 count,
+                                      qint64 *failedCount, QString *errorMessage)
+{
+    if (failedCount) *failedCount = 0;
+    if (count <= 0 || sourceCrs == destinationCrs) return true;
+
+    Entry *entry = cacheEntry(sourceCrs, destinationCrs, errorMessage);
+    if (!entry) return false;
+
+    // Split into one chunk per pool thread, but never into tiny chunks
+    int threads = qMax(1, QThread::idealThreadCount());
+    qint64 chunkSize = qMax(kMinimumChunkSize, (count + threads - 1) / threads);
+    chunkSize = qMin<qint64>(chunkSize, std::numeric_limits<int>::max());
+
+    QVector<Chunk> chunks;
+    for (qint64 begin = 0; begin < count; begin += chunkSize) {
+        Chunk chunk;
+        chunk.xs = xs + begin;
+        chunk.ys = ys + begin;
+        chunk.count = qMin(chunkSize, count - begin);
+        chunk.failed = 0;
+        chunk.ok = false;
+        chunks.append(chunk);
+    }
+
+    if (chunks.size() == 1) {
+        chunks[0].ok = transformChunk(entry, xs, ys, count, &chunks[0].failed);
+    } else {
+        QtConcurrent::blockingMap(chunks, [entry](Chunk &chunk) {
+            chunk.ok = transformChunk(entry, chunk.xs, chunk.ys, chunk.count, &chunk.failed);
+        });
+    }
+
+    bool ok = true;
+    qint64 failed = 0;
+    for (const Chunk &chunk : chunks) {
+        ok = ok && chunk.ok;
+        failed += chunk.failed;
+    }
+    if (failedCount) *failedCount = failed;
+    if (!ok && errorMessage) {
+        *errorMessage = QString("Coordinate transformation failed: %1").arg(CPLGetLastErrorMsg());
+    }
+    return ok;
+}
+
+FeatureStorePtr CoordinateTransformer::reprojectStore(const FeatureStorePtr &source,
+                                                      const QString &sourceCrs, const QString &destinationCrs,
+                                                      qint64 *failedCount, QString *errorMessage)
+{
+    if (failedCount) *failedCount = 0;
+
+    // Layout and attributes stay shared with the source; only the copied
+    // vertices move
+    FeatureStorePtr store = FeatureStore::coordinateCopy(source);
+    if (!store) return FeatureStorePtr();
+
+    if (!isSameCrs(sourceCrs, destinationCrs) &&
+            !transform(sourceCrs, destinationCrs, store->mutableXData(), store->mutableYData(),
+                       store->vertexCount(), failedCount, errorMessage)) {
+        return FeatureStorePtr();
+    }
+    store->updateExtents();
+    return store;
+}
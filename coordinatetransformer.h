@@ -0,0 +1,58 @@
+#ifndef COORDINATETRANSFORMER_H
+#define COORDINATETRANSFORMER_H
+
+#include <QString>
+
+#include "featurestore.h"
+
+class OGRCoordinateTransformation;
+class OGRSpatialReference;
+
+// Reprojects coordinate arrays between two CRS.
+//
+// CRS are given as anything OGRSpatialReference::SetFromUserInput()
+// understands ("EPSG:32633", WKT, PROJ strings). Transformations are
+// cached per (source, destination) pair; since one OGR transformation
+// object must not be used from two threads at once, each pair keeps a
+// small pool of clones that worker threads borrow for their chunk.
+//
+// Large arrays are split into chunks and transformed on the global
+// thread pool, each chunk in one Transform() call.
+class CoordinateTransformer
+{
+public:
+    // Transforms count points in place. Points that cannot be transformed
+    // are set to NaN and counted in failedCount.
+    static bool transform(const QString &sourceCrs, const QString &destinationCrs,
+                          double *xs, double *ys, qint64 count,
+                          qint64 *failedCount = nullptr, QString *errorMessage = nullptr);
+
+    // Copy of a finished store with every vertex transformed. Only the
+    // coordinates are copied, the rest is shared with the source, which is
+    // left untouched, so renders still reading it are unaffected; null on
+    // failure.
+    static FeatureStorePtr reprojectStore(const FeatureStorePtr &source,
+                                          const QString &sourceCrs, const QString &destinationCrs,
+                                          qint64 *failedCount = nullptr, QString *errorMessage = nullptr);
+
+    static bool isSameCrs(const QString &first, const QString &second);
+    static bool isGeographic(const QString &crs);
+
+    // Creates a spatial reference with x = easting / longitude axis order
+    static OGRSpatialReference *createSpatialReference(const QString &crs);
+
+    static void clearCache();
+
+    // Cached transformations of one (source, destination) pair
+    struct Entry;
+
+private:
+    class Lease;
+
+    static Entry *cacheEntry(const QString &sourceCrs, const QString &destinationCrs,
+                             QString *errorMessage);
+    static bool transformChunk(Entry *entry, double *xs, double *ys, qint64 count,
+                               qint64 *failedCount);
+};
+
+#endif // COORDINATETRANSFORMER_H
@@ -0,0 +1,338 @@
+#include "featureloader.h"
+
+#include <QDate>
+#include <QDateTime>
+#include <QDebug>
+#include <QStringList>
+#include <QVector>
+#include <cstring>
+
+#if GDAL_VERSION_NUM >= GDAL_COMPUTE_VERSION(3, 6, 0)
+#include "ogr_recordbatch.h"
+#define HAVE_OGR_ARROW_STREAM 1
+#endif
+
+FeatureStorePtr FeatureLoader::load(GDALDataset *dataset, OGRLayer *layer,
+                                    Method method, Method *usedMethod)
+{
+    if (!layer) return FeatureStorePtr();
+
+    FeatureStorePtr store;
+    bool tryArrow = (method == ArrowStreamMethod) ||
+            (method == AutomaticMethod && hasFastArrowStream(dataset, layer));
+
+    if (tryArrow) {
+        store = loadWithArrowStream(layer);
+        if (store) {
+            if (usedMethod) *usedMethod = ArrowStreamMethod;
+            return store;
+        }
+        qDebug() << "Arrow stream failed for" << layer->GetName() << "- using feature iterator";
+    }
+
+    store = loadWithFeatureIterator(layer);
+    if (usedMethod) *usedMethod = FeatureIteratorMethod;
+    return store;
+}
+
+bool FeatureLoader::hasFastArrowStream(GDALDataset *dataset, OGRLayer *layer)
+{
+#ifdef HAVE_OGR_ARROW_STREAM
+#ifdef OLCFastGetArrowStream
+    Q_UNUSED(dataset);
+    return layer->TestCapability(OLCFastGetArrowStream);
+#else
+    // GDAL 3.6/3.7 only have native batch readers in these drivers
+    Q_UNUSED(layer);
+    if (!dataset || !dataset->GetDriver()) return false;
+    QString driver = QString::fromUtf8(dataset->GetDriver()->GetDescription());
+    return QStringList({"GPKG", "Parquet", "Arrow"}).contains(driver);
+#endif
+#else
+    Q_UNUSED(dataset);
+    Q_UNUSED(layer);
+    return false;
+#endif
+}
+
+QString FeatureLoader::methodName(Method method)
+{
+    switch (method) {
+    case ArrowStreamMethod:
+        return "Arrow stream";
+    case FeatureIteratorMethod:
+        return "Feature iterator";
+    default:
+        return "Automatic";
+    }
+}
+
+FeatureStorePtr FeatureLoader::loadWithFeatureIterator(OGRLayer *layer)
+{
+    FeatureStorePtr store(new FeatureStore());
+    store->addFieldsFromDefinition(layer->GetLayerDefn());
+
+    layer->ResetReading();
+    OGRFeature *feature;
+    while ((feature = layer->GetNextFeature()) != nullptr) {
+        store->beginFeature(feature->GetFID());
+        store->addGeometry(feature->GetGeometryRef());
+        store->setAttributesFromFeature(feature);
+        store->endFeature();
+        OGRFeature::DestroyFeature(feature);
+    }
+
+    // Move the columns into the layer arena
+    store->finish();
+    return store;
+}
+
+#ifdef HAVE_OGR_ARROW_STREAM
+
+namespace {
+
+enum ColumnRole {
+    IgnoredColumn,
+    FidColumn,
+    GeometryColumn,
+    AttributeColumn
+};
+
+struct ArrowColumn {
+    ColumnRole role = IgnoredColumn;
+    int field = -1;
+    QByteArray format;
+};
+
+// Value of the ARROW:extension:name metadata key, if any
+QByteArray arrowExtensionName(const struct ArrowSchema *schema)
+{
+    const char *metadata = schema->metadata;
+    if (!metadata) return QByteArray();
+
+    qint32 pairs;
+    memcpy(&pairs, metadata, sizeof(qint32));
+    metadata += sizeof(qint32);
+
+    for (qint32 i = 0; i < pairs; ++i) {
+        qint32 keyLength;
+        memcpy(&keyLength, metadata, sizeof(qint32));
+        metadata += sizeof(qint32);
+        QByteArray key(metadata, keyLength);
+        metadata += keyLength;
+
+        qint32 valueLength;
+        memcpy(&valueLength, metadata, sizeof(qint32));
+        metadata += sizeof(qint32);
+        QByteArray value(metadata, valueLength);
+        metadata += valueLength;
+
+        if (key == "ARROW:extension:name") return value;
+    }
+    return QByteArray();
+}
+
+inline bool arrowIsValid(const struct ArrowArray *array, qint64 index)
+{
+    if (array->null_count == 0 || !array->buffers[0]) return true;
+    const quint8 *validity = static_cast<const quint8*>(array->buffers[0]);
+    return (validity[index >> 3] >> (index & 7)) & 1;
+}
+
+template <typename T>
+inline T arrowValue(const struct ArrowArray *array, qint64 index)
+{
+    return static_cast<const T*>(array->buffers[1])[index];
+}
+
+// Pointer and length of a binary / utf8 element (32 or 64 bit offsets)
+inline const char *arrowBytes(const struct ArrowArray *array, bool largeOffsets,
+                              qint64 index, qint64 &length)
+{
+    qint64 begin;
+    qint64 end;
+    if (largeOffsets) {
+        begin = arrowValue<qint64>(array, index);
+        end = arrowValue<qint64>(array, index + 1);
+    } else {
+        begin = arrowValue<qint32>(array, index);
+        end = arrowValue<qint32>(array, index + 1);
+    }
+    length = end - begin;
+    return static_cast<const char*>(array->buffers[2]) + begin;
+}
+
+void setArrowAttribute(FeatureStore &store, const ArrowColumn &column,
+                       const struct ArrowArray *array, qint64 index)
+{
+    const QByteArray &format = column.format;
+    int field = column.field;
+    qint64 length = 0;
+
+    if (format == "l") {
+        store.setInteger(field, arrowValue<qint64>(array, index));
+    } else if (format == "i") {
+        store.setInteger(field, arrowValue<qint32>(array, index));
+    } else if (format == "s") {
+        store.setInteger(field, arrowValue<qint16>(array, index));
+    } else if (format == "c") {
+        store.setInteger(field, arrowValue<qint8>(array, index));
+    } else if (format == "L") {
+        store.setInteger(field, qint64(arrowValue<quint64>(array, index)));
+    } else if (format == "I") {
+        store.setInteger(field, arrowValue<quint32>(array, index));
+    } else if (format == "S") {
+        store.setInteger(field, arrowValue<quint16>(array, index));
+    } else if (format == "C") {
+        store.setInteger(field, arrowValue<quint8>(array, index));
+    } else if (format == "b") {
+        const quint8 *bits = static_cast<const quint8*>(array->buffers[1]);
+        store.setInteger(field, (bits[index >> 3] >> (index & 7)) & 1);
+    } else if (format == "g") {
+        store.setReal(field, arrowValue<double>(array, index));
+    } else if (format == "f") {
+        store.setReal(field, arrowValue<float>(array, index));
+    } else if (format == "u" || format == "U") {
+        const char *text = arrowBytes(array, format == "U", index, length);
+        store.setString(field, text, int(length));
+    } else if (format == "tdD") {
+        QDate date = QDate(1970, 1, 1).addDays(arrowValue<qint32>(array, index));
+        store.setString(field, date.toString(Qt::ISODate));
+    } else if (format.startsWith("ts")) {
+        // Timestamps: "tss:", "tsm:", "tsu:" or "tsn:" plus an optional zone
+        qint64 value = arrowValue<qint64>(array, index);
+        qint64 msecs = value;
+        switch (format.at(2)) {
+        case 's': msecs = value * 1000; break;
+        case 'u': msecs = value / 1000; break;
+        case 'n': msecs = value / 1000000; break;
+        default: break;
+        }
+        store.setString(field, QDateTime::fromMSecsSinceEpoch(msecs, Qt::UTC).toString(Qt::ISODate));
+    }
+    // Other Arrow types stay null
+}
+
+}
+
+FeatureStorePtr FeatureLoader::loadWithArrowStream(OGRLayer *layer)
+{
+    struct ArrowArrayStream stream;
+    memset(&stream, 0, sizeof(stream));
+
+    char **options = nullptr;
+    options = CSLSetNameValue(options, "INCLUDE_FID", "YES");
+    options = CSLSetNameValue(options, "MAX_FEATURES_IN_BATCH", "65536");
+    options = CSLSetNameValue(options, "GEOMETRY_ENCODING", "WKB");
+
+    layer->ResetReading();
+    bool opened = layer->GetArrowStream(&stream, options);
+    CSLDestroy(options);
+    if (!opened) return FeatureStorePtr();
+
+    struct ArrowSchema schema;
+    if (stream.get_schema(&stream, &schema) != 0) {
+        stream.release(&stream);
+        return FeatureStorePtr();
+    }
+
+    FeatureStorePtr store(new FeatureStore());
+    OGRFeatureDefn *definition = layer->GetLayerDefn();
+    store->addFieldsFromDefinition(definition);
+
+    // Work out what each top-level column holds
+    QByteArray fidName = layer->GetFIDColumn();
+    if (fidName.isEmpty()) fidName = "OGC_FID";
+    QByteArray geometryName = layer->GetGeometryColumn();
+
+    QVector<ArrowColumn> arrowColumns(int(schema.n_children));
+    bool haveGeometry = false;
+    for (int c = 0; c < int(schema.n_children); ++c) {
+        const struct ArrowSchema *child = schema.children[c];
+        ArrowColumn &column = arrowColumns[c];
+        column.format = child->format;
+        QByteArray name = child->name;
+
+        if (name == fidName && (column.format == "l" || column.format == "i")) {
+            column.role = FidColumn;
+        } else if (!haveGeometry &&
+                   (column.format == "z" || column.format == "Z") &&
+                   (arrowExtensionName(child) == "ogc.wkb" || name == geometryName ||
+                    (geometryName.isEmpty() && name == "wkb_geometry"))) {
+            column.role = GeometryColumn;
+            haveGeometry = true;
+        } else {
+            column.field = definition->GetFieldIndex(child->name);
+            if (column.field >= 0) column.role = AttributeColumn;
+        }
+    }
+
+    bool failed = false;
+    qint64 rowBase = 0;
+
+    while (true) {
+        struct ArrowArray batch;
+        if (stream.get_next(&stream, &batch) != 0) {
+            qDebug() << "Arrow stream error:" << stream.get_last_error(&stream);
+            failed = true;
+            break;
+        }
+        if (!batch.release) break; // End of stream
+
+        for (qint64 row = 0; row < batch.length; ++row) {
+            qint64 fid = rowBase + row;
+
+            // FID first, so the feature can be opened
+            for (int c = 0; c < arrowColumns.size(); ++c) {
+                if (arrowColumns[c].role != FidColumn) continue;
+                const struct ArrowArray *child = batch.children[c];
+                qint64 index = batch.offset + child->offset + row;
+                fid = arrowColumns[c].format == "l" ? arrowValue<qint64>(child, index)
+                                                    : arrowValue<qint32>(child, index);
+            }
+
+            store->beginFeature(fid);
+
+            for (int c = 0; c < arrowColumns.size(); ++c) {
+                const ArrowColumn &column = arrowColumns[c];
+                if (column.role != GeometryColumn && column.role != AttributeColumn) continue;
+
+                const struct ArrowArray *child = batch.children[c];
+                qint64 index = batch.offset + child->offset + row;
+                if (!arrowIsValid(child, index)) continue;
+
+                if (column.role == GeometryColumn) {
+                    qint64 length = 0;
+                    const char *wkb = arrowBytes(child, column.format == "Z", index, length);
+                    store->addWkb(reinterpret_cast<const unsigned char*>(wkb), size_t(length));
+                } else {
+                    setArrowAttribute(*store, column, child, index);
+                }
+            }
+
+            store->endFeature();
+        }
+
+        rowBase += batch.length;
+        batch.release(&batch);
+    }
+
+    schema.release(&schema);
+    stream.release(&stream);
+
+    if (failed) return FeatureStorePtr();
+
+    store->finish();
+    return store;
+}
+
+#else
+
+FeatureStorePtr FeatureLoader::loadWithArrowStream(OGRLayer *layer)
+{
+    // GDAL older than 3.6 has no Arrow stream interface
+    Q_UNUSED(layer);
+    return FeatureStorePtr();
+}
+
+#endif
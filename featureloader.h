@@ -0,0 +1,37 @@
+#ifndef FEATURELOADER_H
+#define FEATURELOADER_H
+
+#include <QString>
+
+#include "gdal_priv.h"
+#include "ogrsf_frmts.h"
+
+#include "featurestore.h"
+
+// Reads an OGR layer into a FeatureStore.
+//
+// When the driver has a fast Arrow stream (GDAL >= 3.6), features arrive
+// in record batches: geometry as WKB blobs parsed straight into the
+// vertex buffers and attributes as typed column buffers, without creating
+// an OGRFeature per row. Otherwise the classic GetNextFeature() loop is used.
+class FeatureLoader
+{
+public:
+    enum Method {
+        AutomaticMethod,
+        ArrowStreamMethod,
+        FeatureIteratorMethod
+    };
+
+    static FeatureStorePtr load(GDALDataset *dataset, OGRLayer *layer,
+                                Method method = AutomaticMethod,
+                                Method *usedMethod = nullptr);
+
+    static bool hasFastArrowStream(GDALDataset *dataset, OGRLayer *layer);
+    static QString methodName(Method method);
+
+    static FeatureStorePtr loadWithFeatureIterator(OGRLayer *layer);
+    static FeatureStorePtr loadWithArrowStream(OGRLayer *layer);
+};
+
+#endif // FEATURELOADER_H
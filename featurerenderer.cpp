@@ -0,0 +1,165 @@
+#include "featurerenderer.h"
+
+#include <QHash>
+#include <QRandomGenerator>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+FeatureRenderer::FeatureRenderer()
+    : rendererType(SingleSymbol)
+    , classField(-1)
+{
+}
+
+bool FeatureRenderer::classifyCategorized(const FeatureStore &store, int field, int maxCategories)
+{
+    if (field < 0 || field >= store.fieldCount()) return false;
+
+    qint64 count = store.featureCount();
+    maxCategories = qMin(maxCategories, int(NoSymbol));
+
+    rendererType = CategorizedSymbol;
+    classField = field;
+    symbolTable.clear();
+    symbols.assign(size_t(count), NoSymbol);
+
+    QHash<QString, quint16> lookup;
+    for (qint64 f = 0; f < count; ++f) {
+        if (store.isNull(field, f)) continue;
+
+        QString value = store.stringValue(field, f);
+        QHash<QString, quint16>::const_iterator it = lookup.constFind(value);
+        quint16 symbol;
+        if (it != lookup.constEnd()) {
+            symbol = it.value();
+        } else {
+            // Values past the limit fall into the "other" symbol
+            if (symbolTable.size() >= maxCategories) continue;
+            symbol = quint16(symbolTable.size());
+            lookup.insert(value, symbol);
+
+            Category category;
+            category.value = value;
+            category.label = value;
+            symbolTable.append(category);
+        }
+        symbols[size_t(f)] = symbol;
+        symbolTable[symbol].count++;
+    }
+
+    // Sort the table by value and remap the indices once
+    QVector<int> order(symbolTable.size());
+    for (int i = 0; i < order.size(); ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        return symbolTable[a].value.localeAwareCompare(symbolTable[b].value) < 0;
+    });
+
+    QVector<Category> sorted(symbolTable.size());
+    std::vector<quint16> remap(size_t(symbolTable.size()));
+    for (int i = 0; i < order.size(); ++i) {
+        sorted[i] = symbolTable[order[i]];
+        remap[size_t(order[i])] = quint16(i);
+    }
+    symbolTable = sorted;
+    for (quint16 &symbol : symbols) {
+        if (symbol != NoSymbol) symbol = remap[symbol];
+    }
+
+    applyRandomColors();
+    return true;
+}
+
+bool FeatureRenderer::classifyGraduated(const FeatureStore &store, int field, int classes,
+                                        ClassificationMode mode)
+{
+    if (field < 0 || field >= store.fieldCount() || classes < 1) return false;
+    if (store.field(field).type == FeatureStore::StringField) return false;
+
+    qint64 count = store.featureCount();
+    std::vector<double> values;
+    values.reserve(size_t(count));
+    for (qint64 f = 0; f < count; ++f) {
+        if (!store.isNull(field, f)) values.push_back(store.realValue(field, f));
+    }
+    if (values.empty()) return false;
+
+    double minimum = *std::min_element(values.begin(), values.end());
+    double maximum = *std::max_element(values.begin(), values.end());
+
+    // Upper bound of every class; the last one is the maximum
+    QVector<double> breaks;
+    if (mode == Quantile) {
+        std::vector<double> sorted = values;
+        std::sort(sorted.begin(), sorted.end());
+        for (int c = 1; c < classes; ++c) {
+            size_t position = size_t(double(c) / classes * (sorted.size() - 1));
+            double value = sorted[position];
+            if (breaks.isEmpty() || value > breaks.last()) breaks.append(value);
+        }
+    } else {
+        double width = (maximum - minimum) / classes;
+        for (int c = 1; c < classes && width > 0.0; ++c) {
+            breaks.append(minimum + width * c);
+        }
+    }
+    if (breaks.isEmpty() || breaks.last() < maximum) breaks.append(maximum);
+
+    rendererType = GraduatedSymbol;
+    classField = field;
+    symbolTable.clear();
+
+    double lower = minimum;
+    for (double upper : breaks) {
+        Category category;
+        category.lower = lower;
+        category.upper = upper;
+        category.label = QString("%1 - %2").arg(lower, 0, 'g', 6).arg(upper, 0, 'g', 6);
+        symbolTable.append(category);
+        lower = upper;
+    }
+
+    // Binary search of each value in the class bounds
+    symbols.assign(size_t(count), NoSymbol);
+    for (qint64 f = 0; f < count; ++f) {
+        if (store.isNull(field, f)) continue;
+        double value = store.realValue(field, f);
+        QVector<double>::const_iterator it = std::lower_bound(breaks.constBegin(), breaks.constEnd(), value);
+        if (it == breaks.constEnd()) --it;
+        quint16 symbol = quint16(it - breaks.constBegin());
+        symbols[size_t(f)] = symbol;
+        symbolTable[symbol].count++;
+    }
+
+    applyColorRamp(QColor(255, 245, 240), QColor(165, 15, 21));
+    return true;
+}
+
+void FeatureRenderer::setCategoryColor(int category, const QColor &color)
+{
+    if (category < 0 || category >= symbolTable.size()) return;
+    symbolTable[category].color = color;
+}
+
+void FeatureRenderer::applyColorRamp(const QColor &start, const QColor &end)
+{
+    int classes = symbolTable.size();
+    for (int i = 0; i < classes; ++i) {
+        double t = classes > 1 ? double(i) / (classes - 1) : 0.0;
+        symbolTable[i].color = QColor::fromRgbF(start.redF() + t * (end.redF() - start.redF()),
+                                                start.greenF() + t * (end.greenF() - start.greenF()),
+                                                start.blueF() + t * (end.blueF() - start.blueF()));
+    }
+}
+
+void FeatureRenderer::applyRandomColors()
+{
+    // Evenly spread hues with a fixed seed so colours are stable between runs
+    QRandomGenerator generator(symbolTable.size());
+    double hue = generator.generateDouble();
+    for (Category &category : symbolTable) {
+        category.color = QColor::fromHsvF(hue, 0.55 + 0.3 * generator.generateDouble(),
+                                          0.75 + 0.2 * generator.generateDouble());
+        hue = std::fmod(hue + 0.618033988749895, 1.0);
+    }
+}
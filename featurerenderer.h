@@ -0,0 +1,82 @@
+#ifndef FEATURERENDERER_H
+#define FEATURERENDERER_H
+
+#include <QColor>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+#include <vector>
+
+#include "featurestore.h"
+
+// Decides the colour of every feature of a layer.
+//
+// Classification runs once over the store and leaves a compact
+// per-feature symbol index (two bytes per feature). Drawing only looks
+// up that index in the symbol table, so restyling (new colours, a
+// different ramp) rebuilds the small table and never touches the
+// features again.
+class FeatureRenderer
+{
+public:
+    enum Type {
+        SingleSymbol,
+        CategorizedSymbol,
+        GraduatedSymbol
+    };
+
+    enum ClassificationMode {
+        EqualInterval,
+        Quantile
+    };
+
+    struct Category {
+        QString label;
+        QString value;        // Categorized: the unique value
+        double lower = 0.0;   // Graduated: class bounds
+        double upper = 0.0;
+        qint64 count = 0;
+        QColor color;
+    };
+
+    // Features without a class (nulls, values past the category limit)
+    static const quint16 NoSymbol = 0xFFFF;
+
+    FeatureRenderer();
+
+    Type type() const { return rendererType; }
+    int field() const { return classField; }
+    const QVector<Category> &categories() const { return symbolTable; }
+
+    // Unique value classification, at most maxCategories classes
+    bool classifyCategorized(const FeatureStore &store, int field, int maxCategories = 1024);
+    // Numeric classes by equal interval or quantile breaks
+    bool classifyGraduated(const FeatureStore &store, int field, int classes,
+                           ClassificationMode mode);
+
+    // Symbol table changes; the per-feature indices stay as they are.
+    // Classification replaces the indices, so it is only done on a
+    // renderer no layer draws with yet.
+    void setCategoryColor(int category, const QColor &color);
+    void applyColorRamp(const QColor &start, const QColor &end);
+    void applyRandomColors();
+
+    quint16 symbolIndex(qint64 feature) const {
+        return symbols.empty() ? NoSymbol : symbols[size_t(feature)];
+    }
+    QColor symbolColor(quint16 symbol, const QColor &fallback) const {
+        return symbol < symbolTable.size() ? symbolTable[symbol].color : fallback;
+    }
+
+    size_t memoryUsage() const { return symbols.capacity() * sizeof(quint16); }
+
+private:
+    Type rendererType;
+    int classField;
+    QVector<Category> symbolTable;
+    std::vector<quint16> symbols;
+};
+
+typedef QSharedPointer<FeatureRenderer> FeatureRendererPtr;
+
+#endif // FEATURERENDERER_H
@@ -0,0 +1,79 @@
+#include "featureselection.h"
+
+#include <QtAlgorithms>
+#include <algorithm>
+
+FeatureSelection::FeatureSelection(qint64 featureCount)
+    : numFeatures(0)
+    , numSelected(0)
+    , changes(0)
+{
+    resize(featureCount);
+}
+
+void FeatureSelection::resize(qint64 featureCount)
+{
+    numFeatures = qMax<qint64>(0, featureCount);
+    words.assign(size_t((numFeatures + 63) / 64), 0);
+    numSelected = 0;
+    ++changes;
+}
+
+void FeatureSelection::select(qint64 feature)
+{
+    if (feature < 0 || feature >= numFeatures) return;
+    quint64 &w = words[size_t(feature >> 6)];
+    quint64 bit = quint64(1) << (feature & 63);
+    if (!(w & bit)) {
+        w |= bit;
+        ++numSelected;
+        ++changes;
+    }
+}
+
+void FeatureSelection::deselect(qint64 feature)
+{
+    if (feature < 0 || feature >= numFeatures) return;
+    quint64 &w = words[size_t(feature >> 6)];
+    quint64 bit = quint64(1) << (feature & 63);
+    if (w & bit) {
+        w &= ~bit;
+        --numSelected;
+        ++changes;
+    }
+}
+
+void FeatureSelection::clear()
+{
+    std::fill(words.begin(), words.end(), quint64(0));
+    numSelected = 0;
+    ++changes;
+}
+
+void FeatureSelection::apply(const QVector<qint64> &features, Mode mode)
+{
+    if (mode == ReplaceSelection) {
+        clear();
+    }
+
+    if (mode == RemoveFromSelection) {
+        for (qint64 feature : features) deselect(feature);
+    } else {
+        for (qint64 feature : features) select(feature);
+    }
+}
+
+QVector<qint64> FeatureSelection::selectedFeatures() const
+{
+    QVector<qint64> features;
+    features.reserve(int(numSelected));
+
+    for (size_t w = 0; w < words.size(); ++w) {
+        quint64 bits = words[w];
+        while (bits) {
+            features.append(qint64(w) * 64 + qCountTrailingZeroBits(bits));
+            bits &= bits - 1;
+        }
+    }
+    return features;
+}
@@ -0,0 +1,57 @@
+#ifndef FEATURESELECTION_H
+#define FEATURESELECTION_H
+
+#include <QSharedPointer>
+#include <QVector>
+#include <vector>
+
+// Selected features of one layer as a bitset, one bit per feature.
+// A million features take 125 KB; whole 64-feature words that are
+// empty are skipped when iterating.
+class FeatureSelection
+{
+public:
+    enum Mode {
+        ReplaceSelection,
+        AddToSelection,
+        RemoveFromSelection
+    };
+
+    explicit FeatureSelection(qint64 featureCount = 0);
+
+    void resize(qint64 featureCount);
+    qint64 size() const { return numFeatures; }
+
+    bool isSelected(qint64 feature) const {
+        return (words[size_t(feature >> 6)] >> (feature & 63)) & 1;
+    }
+    void select(qint64 feature);
+    void deselect(qint64 feature);
+    void clear();
+
+    // Applies a list of features according to mode
+    void apply(const QVector<qint64> &features, Mode mode);
+
+    qint64 selectedCount() const { return numSelected; }
+    bool isEmpty() const { return numSelected == 0; }
+    QVector<qint64> selectedFeatures() const;
+
+    // Changes with every modification, so drawings of it can be cached
+    quint64 revision() const { return changes; }
+
+    // Word access for fast scans: bit i of word w is feature w * 64 + i
+    int wordCount() const { return int(words.size()); }
+    quint64 word(int index) const { return words[size_t(index)]; }
+
+    size_t memoryUsage() const { return words.capacity() * sizeof(quint64); }
+
+private:
+    std::vector<quint64> words;
+    qint64 numFeatures;
+    qint64 numSelected;
+    quint64 changes;
+};
+
+typedef QSharedPointer<FeatureSelection> FeatureSelectionPtr;
+
+#endif // FEATURESELECTION_H
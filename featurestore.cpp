@@ -0,0 +1,985 @@
+#include "featurestore.h"
+
+#include <QtGlobal>
+#include <QtEndian>
+#include <QDate>
+#include <QDateTime>
+#include <QTime>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "ogrsf_frmts.h"
+
+// =========== LAYER ARENA ===========
+
+LayerArena::LayerArena(size_t blockSize)
+    : defaultBlockSize(blockSize)
+    , usedBytes(0)
+    , reservedBytes(0)
+{
+}
+
+LayerArena::~LayerArena()
+{
+    clear();
+}
+
+void *LayerArena::allocate(size_t bytes, size_t alignment)
+{
+    if (bytes == 0) return nullptr;
+
+    // Try the current block first
+    if (!blocks.empty()) {
+        Block &block = blocks.back();
+        size_t offset = (block.used + alignment - 1) & ~(alignment - 1);
+        if (offset + bytes <= block.size) {
+            block.used = offset + bytes;
+            usedBytes += bytes;
+            return block.data + offset;
+        }
+    }
+
+    // Large columns get a block of their own so the current block keeps
+    // serving the small ones
+    bool dedicated = bytes > defaultBlockSize / 2;
+
+    Block block;
+    block.size = dedicated ? bytes : defaultBlockSize;
+    block.data = static_cast<char*>(::operator new(block.size));
+    block.used = bytes;
+
+    if (dedicated && !blocks.empty()) {
+        blocks.insert(blocks.end() - 1, block);
+    } else {
+        blocks.push_back(block);
+    }
+
+    usedBytes += bytes;
+    reservedBytes += block.size;
+    return block.data;
+}
+
+void LayerArena::clear()
+{
+    for (const Block &block : blocks) {
+        ::operator delete(block.data);
+    }
+    blocks.clear();
+    usedBytes = 0;
+    reservedBytes = 0;
+}
+
+// =========== FEATURE STORE ===========
+
+namespace {
+
+template <typename T>
+T *freezeColumn(LayerArena &arena, std::vector<T> &buffer)
+{
+    T *column = arena.allocateArray<T>(buffer.size());
+    if (column) {
+        memcpy(column, buffer.data(), sizeof(T) * buffer.size());
+    }
+    std::vector<T>().swap(buffer);
+    return column;
+}
+
+double segmentDistance(double px, double py,
+                       double ax, double ay, double bx, double by)
+{
+    double dx = bx - ax;
+    double dy = by - ay;
+    double lengthSquared = dx * dx + dy * dy;
+    double t = 0.0;
+    if (lengthSquared > 0.0) {
+        t = ((px - ax) * dx + (py - ay) * dy) / lengthSquared;
+        t = qBound(0.0, t, 1.0);
+    }
+    double cx = ax + t * dx - px;
+    double cy = ay + t * dy - py;
+    return std::sqrt(cx * cx + cy * cy);
+}
+
+}
+
+FeatureStore::Extent FeatureStore::Extent::null()
+{
+    Extent extent;
+    extent.minX = std::numeric_limits<double>::max();
+    extent.minY = std::numeric_limits<double>::max();
+    extent.maxX = -std::numeric_limits<double>::max();
+    extent.maxY = -std::numeric_limits<double>::max();
+    return extent;
+}
+
+FeatureStore::Extent FeatureStore::Extent::fromRectF(const QRectF &rect)
+{
+    QRectF normalized = rect.normalized();
+    Extent extent;
+    extent.minX = normalized.left();
+    extent.minY = normalized.top();
+    extent.maxX = normalized.right();
+    extent.maxY = normalized.bottom();
+    return extent;
+}
+
+FeatureStore::FeatureStore()
+    : finished(false)
+    , numFeatures(0)
+    , numParts(0)
+    , numRings(0)
+    , numVertices(0)
+    , layerKind(NoGeometry)
+    , layerExtent(Extent::null())
+    , multipart(false)
+    , currentKind(NoGeometry)
+    , fids(nullptr)
+    , kinds(nullptr)
+    , extents(nullptr)
+    , featureParts(nullptr)
+    , partRings(nullptr)
+    , ringVertices(nullptr)
+    , xs(nullptr)
+    , ys(nullptr)
+    , geometryMemory(0)
+    , attributeMemory(0)
+{
+}
+
+FeatureStore::~FeatureStore()
+{
+}
+
+int FeatureStore::addField(const QString &name, FieldType type)
+{
+    Q_ASSERT(!finished && numFeatures == 0);
+
+    Column column;
+    column.field.name = name;
+    column.field.type = type;
+    columns.push_back(column);
+    return int(columns.size()) - 1;
+}
+
+void FeatureStore::addFieldsFromDefinition(OGRFeatureDefn *definition)
+{
+    if (!definition) return;
+
+    for (int i = 0; i < definition->GetFieldCount(); ++i) {
+        OGRFieldDefn *fieldDefn = definition->GetFieldDefn(i);
+        FieldType type;
+        switch (fieldDefn->GetType()) {
+        case OFTInteger:
+        case OFTInteger64:
+            type = IntegerField;
+            break;
+        case OFTReal:
+            type = RealField;
+            break;
+        default:
+            // Dates, lists and binary values are kept as their string form
+            type = StringField;
+            break;
+        }
+        addField(QString::fromUtf8(fieldDefn->GetNameRef()), type);
+    }
+}
+
+qint64 FeatureStore::beginFeature(qint64 fid)
+{
+    Q_ASSERT(!finished);
+
+    fidBuffer.push_back(fid);
+    kindBuffer.push_back(NoGeometry);
+    featurePartBuffer.push_back(quint32(numParts));
+    currentKind = NoGeometry;
+
+    // Every attribute starts out null
+    for (Column &column : columns) {
+        switch (column.field.type) {
+        case IntegerField:
+            column.intBuffer.push_back(0);
+            break;
+        case RealField:
+            column.realBuffer.push_back(0.0);
+            break;
+        case StringField:
+            column.offsetBuffer.push_back(quint32(column.charBuffer.size()));
+            break;
+        }
+        column.nullBuffer.push_back(1);
+    }
+
+    return numFeatures++;
+}
+
+void FeatureStore::beginPart(GeometryKind kind)
+{
+    if (currentKind == NoGeometry) {
+        currentKind = kind;
+        kindBuffer.back() = kind;
+    }
+    partRingBuffer.push_back(quint32(numRings));
+    numParts++;
+}
+
+void FeatureStore::beginRing()
+{
+    ringVertexBuffer.push_back(quint32(numVertices));
+    numRings++;
+}
+
+void FeatureStore::addVertex(double x, double y)
+{
+    xBuffer.push_back(x);
+    yBuffer.push_back(y);
+    numVertices++;
+}
+
+void FeatureStore::addGeometry(const OGRGeometry *geometry)
+{
+    if (!geometry || geometry->IsEmpty()) return;
+    addGeometryRecursive(geometry);
+}
+
+void FeatureStore::copyGeometry(const FeatureStore &from, qint64 feature)
+{
+    // Same part / ring / vertex layout, no OGR or WKB round trip
+    GeometryKind kind = from.geometryKind(feature);
+    const double *fromXs = from.xData();
+    const double *fromYs = from.yData();
+    for (quint32 part = from.partBegin(feature); part < from.partEnd(feature); ++part) {
+        beginPart(kind);
+        for (quint32 ring = from.ringBegin(part); ring < from.ringEnd(part); ++ring) {
+            beginRing();
+            for (quint32 v = from.vertexBegin(ring); v < from.vertexEnd(ring); ++v) {
+                addVertex(fromXs[v], fromYs[v]);
+            }
+        }
+    }
+}
+
+void FeatureStore::addLineString(const OGRGeometry *geometry)
+{
+    const OGRSimpleCurve *curve = static_cast<const OGRSimpleCurve*>(geometry);
+    int pointCount = curve->getNumPoints();
+
+    beginRing();
+    if (pointCount <= 0) return;
+
+    // Copy the whole coordinate run at once instead of getPoint() per vertex
+    size_t first = xBuffer.size();
+    xBuffer.resize(first + pointCount);
+    yBuffer.resize(first + pointCount);
+    curve->getPoints(&xBuffer[first], sizeof(double),
+                     &yBuffer[first], sizeof(double));
+    numVertices += pointCount;
+}
+
+void FeatureStore::addGeometryRecursive(const OGRGeometry *geometry)
+{
+    OGRwkbGeometryType type = wkbFlatten(geometry->getGeometryType());
+
+    // Curved geometries are stored as their linear approximation
+    if (OGR_GT_IsNonLinear(type)) {
+        OGRGeometry *linear = geometry->getLinearGeometry();
+        if (linear) {
+            addGeometryRecursive(linear);
+            delete linear;
+        }
+        return;
+    }
+
+    switch (type) {
+    case wkbPoint: {
+        if (currentKind != NoGeometry && currentKind != PointGeometry) return;
+        const OGRPoint *point = static_cast<const OGRPoint*>(geometry);
+        beginPart(PointGeometry);
+        beginRing();
+        addVertex(point->getX(), point->getY());
+        break;
+    }
+    case wkbLineString:
+    case wkbLinearRing:
+        if (currentKind != NoGeometry && currentKind != LineGeometry) return;
+        beginPart(LineGeometry);
+        addLineString(geometry);
+        break;
+    case wkbPolygon: {
+        if (currentKind != NoGeometry && currentKind != PolygonGeometry) return;
+        const OGRPolygon *polygon = static_cast<const OGRPolygon*>(geometry);
+        const OGRLinearRing *exterior = polygon->getExteriorRing();
+        if (!exterior) return;
+
+        beginPart(PolygonGeometry);
+        addLineString(exterior);
+        for (int r = 0; r < polygon->getNumInteriorRings(); r++) {
+            addLineString(polygon->getInteriorRing(r));
+        }
+        break;
+    }
+    case wkbMultiPoint:
+    case wkbMultiLineString:
+    case wkbMultiPolygon:
+    case wkbGeometryCollection: {
+        const OGRGeometryCollection *collection =
+                static_cast<const OGRGeometryCollection*>(geometry);
+        for (int i = 0; i < collection->getNumGeometries(); i++) {
+            addGeometryRecursive(collection->getGeometryRef(i));
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+// Minimal WKB cursor; handles both byte orders
+struct FeatureStore::WkbReader
+{
+    const unsigned char *data;
+    size_t size;
+    size_t pos;
+    bool bigEndian;
+
+    bool readByte(quint8 &value)
+    {
+        if (pos + 1 > size) return false;
+        value = data[pos++];
+        return true;
+    }
+
+    bool readUInt32(quint32 &value)
+    {
+        if (pos + 4 > size) return false;
+        value = bigEndian ? qFromBigEndian<quint32>(data + pos)
+                          : qFromLittleEndian<quint32>(data + pos);
+        pos += 4;
+        return true;
+    }
+
+    double doubleAt(size_t offset) const
+    {
+        quint64 bits = bigEndian ? qFromBigEndian<quint64>(data + offset)
+                                 : qFromLittleEndian<quint64>(data + offset);
+        double value;
+        memcpy(&value, &bits, sizeof(double));
+        return value;
+    }
+};
+
+void FeatureStore::addWkb(const unsigned char *wkb, size_t size)
+{
+    if (!wkb || size == 0) return;
+
+    WkbReader reader;
+    reader.data = wkb;
+    reader.size = size;
+    reader.pos = 0;
+    reader.bigEndian = false;
+
+    BuildMark mark = buildMark();
+    if (parseWkbGeometry(reader)) return;
+
+    // Curves and malformed blobs go through OGR instead
+    rollback(mark);
+    OGRGeometry *geometry = nullptr;
+    if (OGRGeometryFactory::createFromWkb(wkb, nullptr, &geometry, size) == OGRERR_NONE) {
+        addGeometry(geometry);
+    }
+    delete geometry;
+}
+
+bool FeatureStore::parseWkbGeometry(WkbReader &reader)
+{
+    quint8 byteOrder;
+    if (!reader.readByte(byteOrder) || byteOrder > 1) return false;
+    reader.bigEndian = (byteOrder == 0);
+
+    quint32 rawType;
+    if (!reader.readUInt32(rawType)) return false;
+
+    // Accept ISO (1000/2000/3000 offsets) and EWKB flag variants
+    bool hasZ = (rawType & 0x80000000u) != 0;
+    bool hasM = (rawType & 0x40000000u) != 0;
+    if (rawType & 0x20000000u) {
+        quint32 srid;
+        if (!reader.readUInt32(srid)) return false;
+    }
+    quint32 baseType = rawType & 0x0FFFFFFFu;
+    quint32 isoDimension = baseType / 1000;
+    baseType %= 1000;
+    if (isoDimension == 1 || isoDimension == 3) hasZ = true;
+    if (isoDimension == 2 || isoDimension == 3) hasM = true;
+
+    size_t stride = sizeof(double) * (2 + (hasZ ? 1 : 0) + (hasM ? 1 : 0));
+
+    GeometryKind kind = NoGeometry;
+    switch (baseType) {
+    case 1: kind = PointGeometry; break;
+    case 2: kind = LineGeometry; break;
+    case 3: kind = PolygonGeometry; break;
+    case 4:
+    case 5:
+    case 6:
+    case 7: {
+        quint32 count;
+        if (!reader.readUInt32(count)) return false;
+        for (quint32 i = 0; i < count; ++i) {
+            if (!parseWkbGeometry(reader)) return false;
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+
+    // Parts of another kind than the feature's first part are skipped
+    bool keep = (currentKind == NoGeometry || currentKind == kind);
+
+    if (kind == PointGeometry) {
+        if (reader.pos + stride > reader.size) return false;
+        double x = reader.doubleAt(reader.pos);
+        double y = reader.doubleAt(reader.pos + sizeof(double));
+        reader.pos += stride;
+        // POINT EMPTY is encoded as NaN coordinates
+        if (keep && !qIsNaN(x) && !qIsNaN(y)) {
+            beginPart(PointGeometry);
+            beginRing();
+            addVertex(x, y);
+        }
+        return true;
+    }
+
+    quint32 ringTotal = 1;
+    if (kind == PolygonGeometry && !reader.readUInt32(ringTotal)) return false;
+    if (keep && ringTotal > 0) beginPart(kind);
+
+    for (quint32 r = 0; r < ringTotal; ++r) {
+        quint32 pointCount;
+        if (!reader.readUInt32(pointCount)) return false;
+        if (reader.pos + size_t(pointCount) * stride > reader.size) return false;
+
+        if (keep) {
+            beginRing();
+            size_t first = xBuffer.size();
+            xBuffer.resize(first + pointCount);
+            yBuffer.resize(first + pointCount);
+            for (quint32 i = 0; i < pointCount; ++i) {
+                size_t offset = reader.pos + i * stride;
+                xBuffer[first + i] = reader.doubleAt(offset);
+                yBuffer[first + i] = reader.doubleAt(offset + sizeof(double));
+            }
+            numVertices += pointCount;
+        }
+        reader.pos += size_t(pointCount) * stride;
+    }
+    return true;
+}
+
+FeatureStore::BuildMark FeatureStore::buildMark() const
+{
+    BuildMark mark;
+    mark.parts = numParts;
+    mark.rings = numRings;
+    mark.vertices = numVertices;
+    mark.kind = currentKind;
+    return mark;
+}
+
+void FeatureStore::rollback(const BuildMark &mark)
+{
+    numParts = mark.parts;
+    numRings = mark.rings;
+    numVertices = mark.vertices;
+    partRingBuffer.resize(size_t(mark.parts));
+    ringVertexBuffer.resize(size_t(mark.rings));
+    xBuffer.resize(size_t(mark.vertices));
+    yBuffer.resize(size_t(mark.vertices));
+    currentKind = mark.kind;
+    if (!kindBuffer.empty()) kindBuffer.back() = mark.kind;
+}
+
+void FeatureStore::setInteger(int field, qint64 value)
+{
+    Column &column = columns[field];
+    if (column.field.type == RealField) {
+        column.realBuffer.back() = double(value);
+    } else if (column.field.type == IntegerField) {
+        column.intBuffer.back() = value;
+    } else {
+        setString(field, QString::number(value));
+        return;
+    }
+    column.nullBuffer.back() = 0;
+}
+
+void FeatureStore::setReal(int field, double value)
+{
+    Column &column = columns[field];
+    if (column.field.type == RealField) {
+        column.realBuffer.back() = value;
+    } else if (column.field.type == IntegerField) {
+        column.intBuffer.back() = qint64(value);
+    } else {
+        setString(field, QString::number(value, 'g', 15));
+        return;
+    }
+    column.nullBuffer.back() = 0;
+}
+
+void FeatureStore::setString(int field, const QString &value)
+{
+    QByteArray utf8 = value.toUtf8();
+    setString(field, utf8.constData(), utf8.size());
+}
+
+void FeatureStore::setString(int field, const char *utf8, int length)
+{
+    Column &column = columns[field];
+    if (column.field.type != StringField) {
+        // Numeric columns parse the text
+        QString text = QString::fromUtf8(utf8, length);
+        if (column.field.type == IntegerField) {
+            column.intBuffer.back() = text.toLongLong();
+        } else {
+            column.realBuffer.back() = text.toDouble();
+        }
+        column.nullBuffer.back() = 0;
+        return;
+    }
+
+    // Strings are written once per feature, in feature order
+    if (length < 0) length = int(strlen(utf8));
+    column.charBuffer.insert(column.charBuffer.end(), utf8, utf8 + length);
+    column.nullBuffer.back() = 0;
+}
+
+namespace {
+// OGR dates in the ISO 8601 form the Arrow loader writes: the date alone,
+// or date and time in UTC
+QString isoDateTime(OGRFeature *feature, int field, bool dateOnly)
+{
+    int year = 0, month = 0, day = 0, hour = 0, minute = 0, zone = 0;
+    float second = 0.0f;
+    if (!feature->GetFieldAsDateTime(field, &year, &month, &day, &hour, &minute, &second, &zone)) {
+        return QString::fromUtf8(feature->GetFieldAsString(field));
+    }
+    QDate date(year, month, day);
+    if (dateOnly) return date.toString(Qt::ISODate);
+
+    // Zone 100 is UTC and every step from it 15 minutes; unknown (0) and
+    // local (1) times are taken as UTC, like zoneless Arrow timestamps
+    int offsetSeconds = zone >= 2 ? (zone - 100) * 15 * 60 : 0;
+    QDateTime dateTime(date, QTime(hour, minute, int(second)), Qt::OffsetFromUTC, offsetSeconds);
+    return dateTime.toUTC().toString(Qt::ISODate);
+}
+}
+
+void FeatureStore::setAttributesFromFeature(OGRFeature *feature)
+{
+    if (!feature) return;
+
+    int count = qMin(feature->GetFieldCount(), int(columns.size()));
+    for (int i = 0; i < count; ++i) {
+        if (!feature->IsFieldSetAndNotNull(i)) continue;
+
+        switch (columns[i].field.type) {
+        case IntegerField:
+            setInteger(i, feature->GetFieldAsInteger64(i));
+            break;
+        case RealField:
+            setReal(i, feature->GetFieldAsDouble(i));
+            break;
+        case StringField: {
+            OGRFieldType type = feature->GetFieldDefnRef(i)->GetType();
+            if (type == OFTDate || type == OFTDateTime) {
+                setString(i, isoDateTime(feature, i, type == OFTDate));
+            } else {
+                setString(i, feature->GetFieldAsString(i));
+            }
+            break;
+        }
+        }
+    }
+}
+
+void FeatureStore::endFeature()
+{
+    if (numParts - featurePartBuffer.back() > 1) multipart = true;
+    currentKind = NoGeometry;
+}
+
+void FeatureStore::finish()
+{
+    if (finished) return;
+
+    // Offset arrays get their closing sentinel
+    featurePartBuffer.push_back(quint32(numParts));
+    partRingBuffer.push_back(quint32(numRings));
+    ringVertexBuffer.push_back(quint32(numVertices));
+
+    size_t before = arena.bytesUsed();
+
+    fids = freezeColumn(arena, fidBuffer);
+    kinds = freezeColumn(arena, kindBuffer);
+    featureParts = freezeColumn(arena, featurePartBuffer);
+    partRings = freezeColumn(arena, partRingBuffer);
+    ringVertices = freezeColumn(arena, ringVertexBuffer);
+    xs = freezeColumn(arena, xBuffer);
+    ys = freezeColumn(arena, yBuffer);
+    extents = arena.allocateArray<Extent>(size_t(numFeatures));
+
+    geometryMemory = arena.bytesUsed() - before;
+    before = arena.bytesUsed();
+
+    for (Column &column : columns) {
+        switch (column.field.type) {
+        case IntegerField:
+            column.ints = freezeColumn(arena, column.intBuffer);
+            break;
+        case RealField:
+            column.reals = freezeColumn(arena, column.realBuffer);
+            break;
+        case StringField:
+            column.offsetBuffer.push_back(quint32(column.charBuffer.size()));
+            column.offsets = freezeColumn(arena, column.offsetBuffer);
+            column.chars = freezeColumn(arena, column.charBuffer);
+            break;
+        }
+
+        // Pack the null flags into a validity bitmap
+        size_t words = size_t((numFeatures + 63) / 64);
+        quint64 *validity = arena.allocateArray<quint64>(words);
+        if (validity) {
+            memset(validity, 0, words * sizeof(quint64));
+            for (qint64 i = 0; i < numFeatures; ++i) {
+                if (!column.nullBuffer[size_t(i)]) {
+                    validity[i >> 6] |= quint64(1) << (i & 63);
+                }
+            }
+        }
+        column.validity = validity;
+        std::vector<quint8>().swap(column.nullBuffer);
+    }
+
+    attributeMemory = arena.bytesUsed() - before;
+    finished = true;
+
+    updateExtents();
+}
+
+FeatureStorePtr FeatureStore::coordinateCopy(const FeatureStorePtr &source)
+{
+    if (!source || !source->isFinished()) return FeatureStorePtr();
+
+    FeatureStorePtr store(new FeatureStore());
+    store->sharedSource = source;
+    store->numFeatures = source->numFeatures;
+    store->numParts = source->numParts;
+    store->numRings = source->numRings;
+    store->numVertices = source->numVertices;
+    store->multipart = source->multipart;
+    store->fids = source->fids;
+    store->kinds = source->kinds;
+    store->featureParts = source->featureParts;
+    store->partRings = source->partRings;
+    store->ringVertices = source->ringVertices;
+    store->columns = source->columns;
+
+    size_t vertices = size_t(source->numVertices);
+    store->xs = store->arena.allocateArray<double>(vertices);
+    store->ys = store->arena.allocateArray<double>(vertices);
+    if (vertices > 0) {
+        memcpy(store->xs, source->xs, sizeof(double) * vertices);
+        memcpy(store->ys, source->ys, sizeof(double) * vertices);
+    }
+    store->extents = store->arena.allocateArray<Extent>(size_t(source->numFeatures));
+
+    store->geometryMemory = source->geometryMemory + store->arena.bytesUsed();
+    store->attributeMemory = source->attributeMemory;
+    store->finished = true;
+    return store;
+}
+
+void FeatureStore::updateExtents()
+{
+    layerExtent = Extent::null();
+    int kindCounts[4] = {0, 0, 0, 0};
+
+    for (qint64 f = 0; f < numFeatures; ++f) {
+        Extent extent = Extent::null();
+        quint32 firstVertex = ringVertices[partRings[featureParts[f]]];
+        quint32 lastVertex = ringVertices[partRings[featureParts[f + 1]]];
+
+        for (quint32 v = firstVertex; v < lastVertex; ++v) {
+            // Vertices that failed to reproject are NaN
+            if (!std::isfinite(xs[v]) || !std::isfinite(ys[v])) continue;
+            extent.minX = qMin(extent.minX, xs[v]);
+            extent.maxX = qMax(extent.maxX, xs[v]);
+            extent.minY = qMin(extent.minY, ys[v]);
+            extent.maxY = qMax(extent.maxY, ys[v]);
+        }
+        extents[f] = extent;
+
+        if (!extent.isNull()) {
+            layerExtent.minX = qMin(layerExtent.minX, extent.minX);
+            layerExtent.maxX = qMax(layerExtent.maxX, extent.maxX);
+            layerExtent.minY = qMin(layerExtent.minY, extent.minY);
+            layerExtent.maxY = qMax(layerExtent.maxY, extent.maxY);
+        }
+        kindCounts[kinds[f]]++;
+    }
+
+    // The most common kind decides how the layer is drawn and listed
+    layerKind = NoGeometry;
+    for (int k = PointGeometry; k <= PolygonGeometry; ++k) {
+        if (kindCounts[k] > kindCounts[layerKind]) {
+            layerKind = GeometryKind(k);
+        }
+    }
+
+    // Extents changed, so the spatial index is rebuilt from scratch
+    index.clear();
+    index.reserve(numFeatures);
+    for (qint64 f = 0; f < numFeatures; ++f) {
+        const Extent &extent = extents[f];
+        if (extent.isNull()) continue;
+        index.add(f, extent.minX, extent.minY, extent.maxX, extent.maxY);
+    }
+    index.finish();
+}
+
+OGRGeometry *FeatureStore::createGeometry(qint64 feature) const
+{
+    quint32 firstPart = partBegin(feature);
+    quint32 lastPart = partEnd(feature);
+    int parts = int(lastPart - firstPart);
+    if (parts == 0) return nullptr;
+
+    OGRGeometryCollection *multi = nullptr;
+    switch (geometryKind(feature)) {
+    case PointGeometry:
+        if (parts > 1) multi = new OGRMultiPoint();
+        break;
+    case LineGeometry:
+        if (parts > 1) multi = new OGRMultiLineString();
+        break;
+    case PolygonGeometry:
+        if (parts > 1) multi = new OGRMultiPolygon();
+        break;
+    default:
+        return nullptr;
+    }
+
+    OGRGeometry *single = nullptr;
+    for (quint32 part = firstPart; part < lastPart; ++part) {
+        OGRGeometry *partGeometry = nullptr;
+        quint32 ring = ringBegin(part);
+        quint32 first = vertexBegin(ring);
+        int count = int(vertexEnd(ring) - first);
+
+        switch (geometryKind(feature)) {
+        case PointGeometry:
+            partGeometry = new OGRPoint(xs[first], ys[first]);
+            break;
+        case LineGeometry: {
+            OGRLineString *line = new OGRLineString();
+            line->setPoints(count, xs + first, ys + first);
+            partGeometry = line;
+            break;
+        }
+        case PolygonGeometry: {
+            OGRPolygon *polygon = new OGRPolygon();
+            for (; ring < ringEnd(part); ++ring) {
+                first = vertexBegin(ring);
+                count = int(vertexEnd(ring) - first);
+                OGRLinearRing *linearRing = new OGRLinearRing();
+                linearRing->setPoints(count, xs + first, ys + first);
+                polygon->addRingDirectly(linearRing);
+            }
+            partGeometry = polygon;
+            break;
+        }
+        default:
+            break;
+        }
+
+        if (multi) {
+            multi->addGeometryDirectly(partGeometry);
+        } else {
+            single = partGeometry;
+        }
+    }
+
+    return multi ? multi : single;
+}
+
+bool FeatureStore::ringContains(quint32 ring, double x, double y) const
+{
+    quint32 first = vertexBegin(ring);
+    quint32 last = vertexEnd(ring);
+    if (last - first < 3) return false;
+
+    // Even-odd crossing test
+    bool inside = false;
+    for (quint32 i = first, j = last - 1; i < last; j = i++) {
+        if ((ys[i] > y) != (ys[j] > y) &&
+                x < (xs[j] - xs[i]) * (y - ys[i]) / (ys[j] - ys[i]) + xs[i]) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+double FeatureStore::ringDistance(quint32 ring, double x, double y, bool closed) const
+{
+    quint32 first = vertexBegin(ring);
+    quint32 last = vertexEnd(ring);
+    if (first == last) return std::numeric_limits<double>::max();
+
+    double distance = std::numeric_limits<double>::max();
+    if (last - first == 1) {
+        return std::hypot(xs[first] - x, ys[first] - y);
+    }
+    for (quint32 i = first + 1; i < last; ++i) {
+        distance = qMin(distance, segmentDistance(x, y, xs[i - 1], ys[i - 1], xs[i], ys[i]));
+    }
+    if (closed) {
+        distance = qMin(distance, segmentDistance(x, y, xs[last - 1], ys[last - 1], xs[first], ys[first]));
+    }
+    return distance;
+}
+
+bool FeatureStore::hitTest(qint64 feature, double x, double y, double tolerance) const
+{
+    const Extent &bounds = extents[feature];
+    if (x < bounds.minX - tolerance || x > bounds.maxX + tolerance ||
+            y < bounds.minY - tolerance || y > bounds.maxY + tolerance) {
+        return false;
+    }
+
+    GeometryKind kind = geometryKind(feature);
+    for (quint32 part = partBegin(feature); part < partEnd(feature); ++part) {
+        if (kind == PolygonGeometry) {
+            bool inside = false;
+            for (quint32 ring = ringBegin(part); ring < ringEnd(part); ++ring) {
+                if (ringContains(ring, x, y)) inside = !inside;
+                if (ringDistance(ring, x, y, true) <= tolerance) return true;
+            }
+            if (inside) return true;
+        } else {
+            for (quint32 ring = ringBegin(part); ring < ringEnd(part); ++ring) {
+                if (ringDistance(ring, x, y, false) <= tolerance) return true;
+            }
+        }
+    }
+    return false;
+}
+
+QVector<qint64> FeatureStore::featuresAt(double x, double y, double tolerance) const
+{
+    Extent area;
+    area.minX = x - tolerance;
+    area.minY = y - tolerance;
+    area.maxX = x + tolerance;
+    area.maxY = y + tolerance;
+
+    QVector<qint64> hits;
+    for (qint64 f : featuresIn(area)) {
+        if (hitTest(f, x, y, tolerance)) {
+            hits.append(f);
+        }
+    }
+    return hits;
+}
+
+QVector<qint64> FeatureStore::featuresIn(const Extent &extent) const
+{
+    QVector<qint64> candidates;
+    if (extent.isNull()) return candidates;
+
+    index.search(extent.minX, extent.minY, extent.maxX, extent.maxY, candidates);
+    std::sort(candidates.begin(), candidates.end());
+    return candidates;
+}
+
+int FeatureStore::fieldIndex(const QString &name) const
+{
+    for (size_t i = 0; i < columns.size(); ++i) {
+        if (columns[i].field.name.compare(name, Qt::CaseInsensitive) == 0) {
+            return int(i);
+        }
+    }
+    return -1;
+}
+
+bool FeatureStore::isNull(int field, qint64 feature) const
+{
+    const Column &column = columns[field];
+    if (!column.validity) return true;
+    return !(column.validity[feature >> 6] & (quint64(1) << (feature & 63)));
+}
+
+qint64 FeatureStore::integerValue(int field, qint64 feature) const
+{
+    const Column &column = columns[field];
+    switch (column.field.type) {
+    case IntegerField:
+        return column.ints[feature];
+    case RealField:
+        return qint64(column.reals[feature]);
+    case StringField:
+        return stringValue(field, feature).toLongLong();
+    }
+    return 0;
+}
+
+double FeatureStore::realValue(int field, qint64 feature) const
+{
+    const Column &column = columns[field];
+    switch (column.field.type) {
+    case IntegerField:
+        return double(column.ints[feature]);
+    case RealField:
+        return column.reals[feature];
+    case StringField:
+        return stringValue(field, feature).toDouble();
+    }
+    return 0.0;
+}
+
+QString FeatureStore::stringValue(int field, qint64 feature) const
+{
+    const Column &column = columns[field];
+    switch (column.field.type) {
+    case IntegerField:
+        return QString::number(column.ints[feature]);
+    case RealField:
+        return QString::number(column.reals[feature], 'g', 15);
+    case StringField: {
+        quint32 begin = column.offsets[feature];
+        quint32 end = column.offsets[feature + 1];
+        return QString::fromUtf8(column.chars + begin, int(end - begin));
+    }
+    }
+    return QString();
+}
+
+QVariant FeatureStore::attribute(int field, qint64 feature) const
+{
+    if (isNull(field, feature)) return QVariant();
+
+    const Column &column = columns[field];
+    switch (column.field.type) {
+    case IntegerField:
+        return QVariant(column.ints[feature]);
+    case RealField:
+        return QVariant(column.reals[feature]);
+    case StringField:
+        return QVariant(stringValue(field, feature));
+    }
+    return QVariant();
+}
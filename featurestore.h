@@ -0,0 +1,281 @@
+#ifndef FEATURESTORE_H
+#define FEATURESTORE_H
+
+#include <QString>
+#include <QVariant>
+#include <QRectF>
+#include <QVector>
+#include <QSharedPointer>
+#include <vector>
+#include <cstddef>
+
+#include "spatialindex.h"
+
+class OGRGeometry;
+class OGRFeature;
+class OGRFeatureDefn;
+
+// Bump allocator owning every column of one layer. Nothing is freed
+// individually; all blocks go away together with the layer.
+class LayerArena
+{
+public:
+    explicit LayerArena(size_t blockSize = 1024 * 1024);
+    ~LayerArena();
+
+    void *allocate(size_t bytes, size_t alignment);
+
+    template <typename T>
+    T *allocateArray(size_t count)
+    {
+        if (count == 0) return nullptr;
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    void clear();
+
+    size_t bytesUsed() const { return usedBytes; }
+    size_t bytesReserved() const { return reservedBytes; }
+
+private:
+    struct Block {
+        char *data;
+        size_t size;
+        size_t used;
+    };
+
+    std::vector<Block> blocks;
+    size_t defaultBlockSize;
+    size_t usedBytes;
+    size_t reservedBytes;
+
+    Q_DISABLE_COPY(LayerArena)
+};
+
+// Columnar in-memory copy of a vector layer.
+//
+// Geometry is kept as structure-of-arrays vertex buffers (xs / ys) with
+// offset arrays describing features -> parts -> rings -> vertices. A point
+// part is one ring holding a single vertex, a line part is one ring, and a
+// polygon part is its exterior ring followed by its holes.
+//
+// The store is filled once through the builder methods (beginFeature ...
+// endFeature) and then frozen with finish(), which moves all columns into
+// the layer arena. After finish() the store is read-only; reprojection
+// writes the coordinates of a new copy before anything else sees it.
+class FeatureStore;
+typedef QSharedPointer<FeatureStore> FeatureStorePtr;
+
+class FeatureStore
+{
+public:
+    enum GeometryKind : quint8 {
+        NoGeometry = 0,
+        PointGeometry,
+        LineGeometry,
+        PolygonGeometry
+    };
+
+    enum FieldType : quint8 {
+        IntegerField,
+        RealField,
+        StringField
+    };
+
+    struct Field {
+        QString name;
+        FieldType type;
+    };
+
+    struct Extent {
+        double minX;
+        double minY;
+        double maxX;
+        double maxY;
+
+        bool isNull() const { return minX > maxX || minY > maxY; }
+        bool intersects(const Extent &other) const {
+            return minX <= other.maxX && maxX >= other.minX &&
+                    minY <= other.maxY && maxY >= other.minY;
+        }
+        bool contains(double x, double y) const {
+            return x >= minX && x <= maxX && y >= minY && y <= maxY;
+        }
+        QRectF toRectF() const {
+            return isNull() ? QRectF() : QRectF(minX, minY, maxX - minX, maxY - minY);
+        }
+        static Extent null();
+        static Extent fromRectF(const QRectF &rect);
+    };
+
+    FeatureStore();
+    ~FeatureStore();
+
+    // ---- Building ----
+    int addField(const QString &name, FieldType type);
+    void addFieldsFromDefinition(OGRFeatureDefn *definition);
+
+    qint64 beginFeature(qint64 fid);
+    void beginPart(GeometryKind kind);
+    void beginRing();
+    void addVertex(double x, double y);
+    void addGeometry(const OGRGeometry *geometry);
+    void copyGeometry(const FeatureStore &from, qint64 feature);
+    void addWkb(const unsigned char *wkb, size_t size);
+    void setInteger(int field, qint64 value);
+    void setReal(int field, double value);
+    void setString(int field, const QString &value);
+    void setString(int field, const char *utf8, int length = -1);
+    void setAttributesFromFeature(OGRFeature *feature);
+    void endFeature();
+
+    void finish();
+    bool isFinished() const { return finished; }
+
+    // Finished store with its own copy of the vertex coordinates, sharing
+    // the offsets, ids and attribute columns of source (kept alive by the
+    // copy). Extents and the index are left to updateExtents(), which the
+    // caller runs once the new coordinates are written.
+    static FeatureStorePtr coordinateCopy(const FeatureStorePtr &source);
+
+    // ---- Geometry access ----
+    qint64 featureCount() const { return numFeatures; }
+    qint64 partCount() const { return numParts; }
+    qint64 ringCount() const { return numRings; }
+    qint64 vertexCount() const { return numVertices; }
+
+    qint64 featureId(qint64 feature) const { return fids[feature]; }
+    GeometryKind geometryKind(qint64 feature) const { return GeometryKind(kinds[feature]); }
+    const Extent &featureExtent(qint64 feature) const { return extents[feature]; }
+    const Extent &extent() const { return layerExtent; }
+    GeometryKind dominantKind() const { return layerKind; }
+    // True if some feature has more than one part
+    bool hasMultipartFeatures() const { return multipart; }
+
+    quint32 partBegin(qint64 feature) const { return featureParts[feature]; }
+    quint32 partEnd(qint64 feature) const { return featureParts[feature + 1]; }
+    quint32 ringBegin(quint32 part) const { return partRings[part]; }
+    quint32 ringEnd(quint32 part) const { return partRings[part + 1]; }
+    quint32 vertexBegin(quint32 ring) const { return ringVertices[ring]; }
+    quint32 vertexEnd(quint32 ring) const { return ringVertices[ring + 1]; }
+
+    const double *xData() const { return xs; }
+    const double *yData() const { return ys; }
+    double *mutableXData() { return xs; }
+    double *mutableYData() { return ys; }
+    void updateExtents();
+
+    OGRGeometry *createGeometry(qint64 feature) const;
+
+    // Identify support: true if (x, y) hits the feature within tolerance
+    bool hitTest(qint64 feature, double x, double y, double tolerance) const;
+    QVector<qint64> featuresAt(double x, double y, double tolerance) const;
+
+    // Features whose extent intersects the given extent, in feature order.
+    // Answered from the packed R-tree rebuilt by updateExtents().
+    QVector<qint64> featuresIn(const Extent &extent) const;
+    const SpatialIndex &spatialIndex() const { return index; }
+
+    // ---- Attribute access ----
+    int fieldCount() const { return int(columns.size()); }
+    const Field &field(int index) const { return columns[index].field; }
+    int fieldIndex(const QString &name) const;
+
+    bool isNull(int field, qint64 feature) const;
+    qint64 integerValue(int field, qint64 feature) const;
+    double realValue(int field, qint64 feature) const;
+    QString stringValue(int field, qint64 feature) const;
+    QVariant attribute(int field, qint64 feature) const;
+
+    // ---- Memory accounting ----
+    // A coordinate copy counts the shared source it keeps alive
+    size_t geometryBytes() const { return geometryMemory; }
+    size_t attributeBytes() const { return attributeMemory; }
+    size_t memoryUsage() const {
+        return arena.bytesUsed() + (sharedSource ? sharedSource->memoryUsage() : 0);
+    }
+    size_t memoryReserved() const {
+        return arena.bytesReserved() + (sharedSource ? sharedSource->memoryReserved() : 0);
+    }
+    size_t indexBytes() const { return index.memoryUsage(); }
+
+private:
+    struct Column {
+        Field field;
+
+        // Builder buffers, released by finish()
+        std::vector<qint64> intBuffer;
+        std::vector<double> realBuffer;
+        std::vector<quint32> offsetBuffer;
+        std::vector<char> charBuffer;
+        std::vector<quint8> nullBuffer;
+
+        // Frozen arena columns
+        const qint64 *ints = nullptr;
+        const double *reals = nullptr;
+        const quint32 *offsets = nullptr;
+        const char *chars = nullptr;
+        const quint64 *validity = nullptr;
+    };
+
+    struct BuildMark {
+        qint64 parts;
+        qint64 rings;
+        qint64 vertices;
+        GeometryKind kind;
+    };
+
+    struct WkbReader;
+
+    void addGeometryRecursive(const OGRGeometry *geometry);
+    bool parseWkbGeometry(WkbReader &reader);
+    BuildMark buildMark() const;
+    void rollback(const BuildMark &mark);
+    void addLineString(const OGRGeometry *line);
+    bool ringContains(quint32 ring, double x, double y) const;
+    double ringDistance(quint32 ring, double x, double y, bool closed) const;
+
+    LayerArena arena;
+    bool finished;
+
+    qint64 numFeatures;
+    qint64 numParts;
+    qint64 numRings;
+    qint64 numVertices;
+
+    GeometryKind layerKind;
+    Extent layerExtent;
+    bool multipart;
+
+    // Builder buffers, released by finish()
+    std::vector<qint64> fidBuffer;
+    std::vector<quint8> kindBuffer;
+    std::vector<quint32> featurePartBuffer;
+    std::vector<quint32> partRingBuffer;
+    std::vector<quint32> ringVertexBuffer;
+    std::vector<double> xBuffer;
+    std::vector<double> yBuffer;
+    GeometryKind currentKind;
+
+    // Frozen arena columns; all but extents, xs and ys may belong to the
+    // shared source of a coordinate copy
+    const qint64 *fids;
+    const quint8 *kinds;
+    Extent *extents;
+    const quint32 *featureParts;
+    const quint32 *partRings;
+    const quint32 *ringVertices;
+    double *xs;
+    double *ys;
+    FeatureStorePtr sharedSource;
+
+    std::vector<Column> columns;
+    SpatialIndex index;
+
+    size_t geometryMemory;
+    size_t attributeMemory;
+
+    Q_DISABLE_COPY(FeatureStore)
+};
+
+#endif // FEATURESTORE_H
@@ -0,0 +1,256 @@
+#include "geometrychecker.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
+#include <vector>
+
+#include "geosutils.h"
+
+namespace {
+// Same chunking as Geoprocessing: most features are valid and cheap to
+// check, the repairs are the expensive part
+const qint64 kMinimumChunkSize = 32;
+const qint64 kMaximumChunkSize = 2048;
+const int kChunksPerThread = 4;
+
+int kindDimension(FeatureStore::GeometryKind kind)
+{
+    switch (kind) {
+    case FeatureStore::PointGeometry: return 0;
+    case FeatureStore::LineGeometry: return 1;
+    case FeatureStore::PolygonGeometry: return 2;
+    default: return -1;
+    }
+}
+
+// WKB of the non-empty components of the given dimension; a repaired
+// polygon can come back as a collection with collapsed lines and points
+void appendComponents(GEOSContextHandle_t context, GEOSWKBWriter *writer,
+                      const GEOSGeometry *geometry, int dimension,
+                      std::vector<QByteArray> &parts)
+{
+    if (!geometry || GEOSisEmpty_r(context, geometry) != 0) return;
+
+    if (GEOSGeomTypeId_r(context, geometry) == GEOS_GEOMETRYCOLLECTION) {
+        int count = GEOSGetNumGeometries_r(context, geometry);
+        for (int i = 0; i < count; ++i) {
+            appendComponents(context, writer, GEOSGetGeometryN_r(context, geometry, i),
+                             dimension, parts);
+        }
+        return;
+    }
+    if (GEOSGeom_getDimensions_r(context, geometry) != dimension) return;
+
+    size_t size = 0;
+    unsigned char *wkb = GEOSWKBWriter_write_r(context, writer, geometry, &size);
+    if (!wkb) return;
+    parts.push_back(QByteArray(reinterpret_cast<const char*>(wkb), int(size)));
+    GEOSFree_r(context, wkb);
+}
+
+GEOSGeometry *makeValid(GEOSContextHandle_t context, const GEOSGeometry *geometry)
+{
+#if GEOS_VERSION_MAJOR > 3 || (GEOS_VERSION_MAJOR == 3 && GEOS_VERSION_MINOR >= 10)
+    // Structure keeps the polygon shells and holes instead of re-noding
+    // every line, and drops the parts that collapse
+    GEOSMakeValidParams *params = GEOSMakeValidParams_create_r(context);
+    GEOSMakeValidParams_setMethod_r(context, params, GEOS_MAKE_VALID_STRUCTURE);
+    GEOSMakeValidParams_setKeepCollapsed_r(context, params, 0);
+    GEOSGeometry *valid = GEOSMakeValidWithParams_r(context, geometry, params);
+    GEOSMakeValidParams_destroy_r(context, params);
+    return valid;
+#else
+    return GEOSMakeValid_r(context, geometry);
+#endif
+}
+}
+
+struct GeometryChecker::Issue {
+    qint64 feature = -1;
+    Status status = Failed;
+    QString reason;
+    double x = 0.0;                 // Error location
+    double y = 0.0;
+    std::vector<QByteArray> parts;  // WKB of the repaired geometry
+};
+
+struct GeometryChecker::Chunk {
+    qint64 begin = 0;
+    qint64 end = 0;
+    std::vector<Issue> issues;      // Invalid features only, in feature order
+};
+
+QString GeometryChecker::statusName(Status status)
+{
+    switch (status) {
+    case Valid: return "valid";
+    case Repaired: return "repaired";
+    case TypeChanged: return "collapsed";
+    case Failed: return "failed";
+    }
+    return QString();
+}
+
+bool GeometryChecker::check(const FeatureStore &input, const Options &options, Result &result,
+                            Geoprocessing::Feedback *feedback, Statistics *statistics, QString *error)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    FeatureStorePtr repaired(new FeatureStore());
+    for (int field = 0; field < input.fieldCount(); ++field) {
+        repaired->addField(input.field(field).name, input.field(field).type);
+    }
+    FeatureStorePtr errors(new FeatureStore());
+    int fidField = errors->addField("FID", FeatureStore::IntegerField);
+    int reasonField = errors->addField("REASON", FeatureStore::StringField);
+    int statusField = errors->addField("STATUS", FeatureStore::StringField);
+
+    qint64 count = input.featureCount();
+    int threads = qMax(1, QThread::idealThreadCount());
+    qint64 chunkSize = qBound(kMinimumChunkSize, count / (qint64(threads) * kChunksPerThread),
+                              kMaximumChunkSize);
+    qint64 batchSize = chunkSize * threads * kChunksPerThread;
+
+    Statistics stats;
+    stats.checked = count;
+    stats.threads = int(qMin<qint64>(threads, (count + chunkSize - 1) / chunkSize));
+    if (feedback) feedback->setTotal(count);
+
+    for (qint64 batchBegin = 0; batchBegin < count; batchBegin += batchSize) {
+        if (feedback && feedback->isCanceled()) break;
+        qint64 batchEnd = qMin(count, batchBegin + batchSize);
+
+        QVector<Chunk> chunks;
+        for (qint64 begin = batchBegin; begin < batchEnd; begin += chunkSize) {
+            Chunk chunk;
+            chunk.begin = begin;
+            chunk.end = qMin(batchEnd, begin + chunkSize);
+            chunks.append(chunk);
+        }
+
+        if (chunks.size() == 1) {
+            checkChunk(input, feedback, chunks[0]);
+        } else {
+            QtConcurrent::blockingMap(chunks, [&input, feedback](Chunk &chunk) {
+                checkChunk(input, feedback, chunk);
+            });
+        }
+
+        // Append in feature order: valid features straight from the input,
+        // invalid ones from their repair, then drop the batch
+        for (Chunk &chunk : chunks) {
+            std::vector<Issue>::const_iterator issue = chunk.issues.begin();
+            for (qint64 f = chunk.begin; f < chunk.end; ++f) {
+                bool invalid = issue != chunk.issues.end() && issue->feature == f;
+                if (!invalid && options.invalidOnly) continue;
+
+                repaired->beginFeature(input.featureId(f));
+                if (invalid) {
+                    for (const QByteArray &part : issue->parts) {
+                        repaired->addWkb(reinterpret_cast<const unsigned char*>(part.constData()),
+                                         size_t(part.size()));
+                    }
+                } else {
+                    repaired->copyGeometry(input, f);
+                }
+                Geoprocessing::copyAttributes(input, f, *repaired, 0);
+                repaired->endFeature();
+
+                if (!invalid) continue;
+                errors->beginFeature(errors->featureCount());
+                errors->beginPart(FeatureStore::PointGeometry);
+                errors->beginRing();
+                errors->addVertex(issue->x, issue->y);
+                errors->setInteger(fidField, input.featureId(f));
+                errors->setString(reasonField, issue->reason);
+                errors->setString(statusField, statusName(issue->status));
+                errors->endFeature();
+
+                ++stats.invalid;
+                if (issue->status == Repaired) ++stats.repaired;
+                else ++stats.failed;
+                ++issue;
+            }
+            std::vector<Issue>().swap(chunk.issues);
+        }
+    }
+
+    if (feedback && feedback->isCanceled()) {
+        if (error) *error = "Canceled";
+        return false;
+    }
+
+    repaired->finish();
+    errors->finish();
+    result.repaired = repaired;
+    result.errors = errors;
+
+    stats.elapsedMs = timer.elapsed();
+    if (statistics) *statistics = stats;
+    return true;
+}
+
+void GeometryChecker::checkChunk(const FeatureStore &input, Geoprocessing::Feedback *feedback,
+                                 Chunk &chunk)
+{
+    GeosContext geos;
+    GEOSContextHandle_t context = geos.handle();
+    GEOSWKBWriter *writer = GEOSWKBWriter_create_r(context);
+
+    qint64 f = chunk.begin;
+    for (; f < chunk.end; ++f) {
+        if (feedback && feedback->isCanceled()) break;
+        // Features without geometry are left alone
+        if (input.partBegin(f) == input.partEnd(f)) continue;
+
+        const FeatureStore::Extent &extent = input.featureExtent(f);
+        Issue issue;
+        issue.feature = f;
+        issue.x = (extent.minX + extent.maxX) / 2.0;
+        issue.y = (extent.minY + extent.maxY) / 2.0;
+
+        // GEOS refuses to build rings and lines with too few vertices
+        GEOSGeometry *geometry = GeosUtils::fromFeature(context, input, f);
+        if (!geometry) {
+            issue.reason = "Too few points in geometry component";
+            chunk.issues.push_back(issue);
+            continue;
+        }
+
+        char *reason = nullptr;
+        GEOSGeometry *location = nullptr;
+        char valid = GEOSisValidDetail_r(context, geometry, 0, &reason, &location);
+        if (valid == 1) {
+            GEOSGeom_destroy_r(context, geometry);
+            continue;
+        }
+
+        issue.reason = reason ? QString::fromUtf8(reason) : QString("Validity check failed");
+        if (location) {
+            double x = 0.0;
+            double y = 0.0;
+            if (GEOSGeomGetX_r(context, location, &x) == 1 && GEOSGeomGetY_r(context, location, &y) == 1) {
+                issue.x = x;
+                issue.y = y;
+            }
+            GEOSGeom_destroy_r(context, location);
+        }
+        if (reason) GEOSFree_r(context, reason);
+
+        GEOSGeometry *fixed = valid == 0 ? makeValid(context, geometry) : nullptr;
+        if (fixed) {
+            appendComponents(context, writer, fixed, kindDimension(input.geometryKind(f)), issue.parts);
+            issue.status = issue.parts.empty() ? TypeChanged : Repaired;
+            GEOSGeom_destroy_r(context, fixed);
+        }
+        GEOSGeom_destroy_r(context, geometry);
+        chunk.issues.push_back(issue);
+    }
+    if (feedback) feedback->addProgress(f - chunk.begin);
+
+    GEOSWKBWriter_destroy_r(context, writer);
+}
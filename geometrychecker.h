@@ -0,0 +1,64 @@
+#ifndef GEOMETRYCHECKER_H
+#define GEOMETRYCHECKER_H
+
+#include <QString>
+
+#include "featurestore.h"
+#include "geoprocessing.h"
+
+// Validity check and repair of a layer on GEOS.
+//
+// The layer is cut into chunks that run on the thread pool, each in its own
+// GEOS context. Every feature is checked with GEOSisValidDetail; only the
+// invalid ones are repaired with GEOSMakeValid and kept as WKB, keeping the
+// components of the input's dimension. Valid features never leave the
+// store: they are copied vertex for vertex while the batch is appended.
+// Results are appended in feature order a batch at a time, like the
+// Geoprocessing tools, so besides the outputs only one batch of repairs is
+// held.
+//
+// Two layers come out: the repaired layer, with the input attributes and
+// fids, and an error report with one point per invalid feature at the
+// location GEOS reports, the reason and what the repair did.
+class GeometryChecker
+{
+public:
+    enum Status {
+        Valid,
+        Repaired,
+        TypeChanged,    // Repair left nothing of the input's dimension
+        Failed          // No geometry could be built or repaired
+    };
+
+    struct Options {
+        bool invalidOnly = false;   // Repaired layer holds only the fixed features
+    };
+
+    struct Result {
+        FeatureStorePtr repaired;
+        FeatureStorePtr errors;
+    };
+
+    struct Statistics {
+        qint64 checked = 0;
+        qint64 invalid = 0;
+        qint64 repaired = 0;
+        qint64 failed = 0;     // Failed and type changed
+        int threads = 0;
+        qint64 elapsedMs = 0;
+    };
+
+    static bool check(const FeatureStore &input, const Options &options, Result &result,
+                      Geoprocessing::Feedback *feedback = nullptr,
+                      Statistics *statistics = nullptr, QString *error = nullptr);
+
+    static QString statusName(Status status);
+
+private:
+    struct Issue;
+    struct Chunk;
+
+    static void checkChunk(const FeatureStore &input, Geoprocessing::Feedback *feedback, Chunk &chunk);
+};
+
+#endif // GEOMETRYCHECKER_H
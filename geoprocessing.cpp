@@ -0,0 +1,696 @@
+#include "geoprocessing.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
+#include <algorithm>
+#include <vector>
+
+#include "geosutils.h"
+
+namespace {
+// Features per task; small enough to balance, large enough to amortise
+// the per-chunk GEOS context and prepared overlay geometries
+const qint64 kMinimumChunkSize = 32;
+const qint64 kMaximumChunkSize = 2048;
+// Chunks per thread held in memory before they are appended to the output
+const int kChunksPerThread = 4;
+
+int kindDimension(FeatureStore::GeometryKind kind)
+{
+    switch (kind) {
+    case FeatureStore::PointGeometry: return 0;
+    case FeatureStore::LineGeometry: return 1;
+    case FeatureStore::PolygonGeometry: return 2;
+    default: return -1;
+    }
+}
+
+struct OverlayGeometry {
+    GEOSGeometry *geometry;
+    const GEOSPreparedGeometry *prepared;
+};
+}
+
+struct Geoprocessing::Job {
+    Operation operation;
+    const FeatureStore *input;
+    const FeatureStore *overlay;
+    double distance;
+    int segments;
+    Feedback *feedback;
+};
+
+struct Geoprocessing::Chunk {
+    struct Output {
+        Output(qint64 source, qint64 overlay)
+            : source(source), overlay(overlay), length(0.0), lines(0) {}
+
+        qint64 source;
+        qint64 overlay;               // -1 unless the operation pairs features
+        std::vector<QByteArray> parts; // WKB of the kept components
+        double length;                // Sum Line Lengths
+        qint64 lines;
+    };
+
+    qint64 begin;
+    qint64 end;
+    qint64 candidates;
+    std::vector<Output> results;
+};
+
+namespace {
+// Writes the non-empty components of the given dimension as WKB. Overlay
+// results can be collections mixing dimensions (a polygon touching another
+// one in a line); only the dimension of the inputs is kept. With explode,
+// multi geometries are split into one blob per part as well.
+void appendComponents(GEOSContextHandle_t context, GEOSWKBWriter *writer,
+                      const GEOSGeometry *geometry, int dimension, bool explode,
+                      std::vector<QByteArray> &parts)
+{
+    if (!geometry || GEOSisEmpty_r(context, geometry) != 0) return;
+
+    int type = GEOSGeomTypeId_r(context, geometry);
+    if (type == GEOS_GEOMETRYCOLLECTION ||
+            (explode && (type == GEOS_MULTIPOINT || type == GEOS_MULTILINESTRING ||
+                         type == GEOS_MULTIPOLYGON))) {
+        int count = GEOSGetNumGeometries_r(context, geometry);
+        for (int i = 0; i < count; ++i) {
+            appendComponents(context, writer, GEOSGetGeometryN_r(context, geometry, i),
+                             dimension, explode, parts);
+        }
+        return;
+    }
+    if (GEOSGeom_getDimensions_r(context, geometry) != dimension) return;
+
+    size_t size = 0;
+    unsigned char *wkb = GEOSWKBWriter_write_r(context, writer, geometry, &size);
+    if (!wkb) return;
+    parts.push_back(QByteArray(reinterpret_cast<const char*>(wkb), int(size)));
+    GEOSFree_r(context, wkb);
+}
+}
+
+FeatureStorePtr Geoprocessing::buffer(const FeatureStore &input, double distance, int segments,
+                                      Feedback *feedback, Statistics *statistics, QString *error)
+{
+    if (segments < 1) {
+        if (error) *error = "Buffer needs at least one segment per quarter circle";
+        return FeatureStorePtr();
+    }
+
+    Job job;
+    job.operation = BufferOperation;
+    job.input = &input;
+    job.overlay = nullptr;
+    job.distance = distance;
+    job.segments = segments;
+    job.feedback = feedback;
+    return run(job, statistics, error);
+}
+
+FeatureStorePtr Geoprocessing::clip(const FeatureStore &input, const FeatureStore &overlay,
+                                    Feedback *feedback, Statistics *statistics, QString *error)
+{
+    if (overlay.dominantKind() != FeatureStore::PolygonGeometry) {
+        if (error) *error = "The clip layer must be a polygon layer";
+        return FeatureStorePtr();
+    }
+
+    Job job;
+    job.operation = ClipOperation;
+    job.input = &input;
+    job.overlay = &overlay;
+    job.distance = 0.0;
+    job.segments = 0;
+    job.feedback = feedback;
+    return run(job, statistics, error);
+}
+
+FeatureStorePtr Geoprocessing::intersection(const FeatureStore &input, const FeatureStore &overlay,
+                                            Feedback *feedback, Statistics *statistics, QString *error)
+{
+    Job job;
+    job.operation = IntersectionOperation;
+    job.input = &input;
+    job.overlay = &overlay;
+    job.distance = 0.0;
+    job.segments = 0;
+    job.feedback = feedback;
+    return run(job, statistics, error);
+}
+
+FeatureStorePtr Geoprocessing::lineIntersections(const FeatureStore &input, const FeatureStore &overlay,
+                                                 Feedback *feedback, Statistics *statistics, QString *error)
+{
+    if (input.dominantKind() != FeatureStore::LineGeometry ||
+            overlay.dominantKind() != FeatureStore::LineGeometry) {
+        if (error) *error = "Both layers must be line layers";
+        return FeatureStorePtr();
+    }
+
+    Job job;
+    job.operation = LineIntersectionOperation;
+    job.input = &input;
+    job.overlay = &overlay;
+    job.distance = 0.0;
+    job.segments = 0;
+    job.feedback = feedback;
+    return run(job, statistics, error);
+}
+
+FeatureStorePtr Geoprocessing::sumLineLengths(const FeatureStore &polygons, const FeatureStore &lines,
+                                              Feedback *feedback, Statistics *statistics, QString *error)
+{
+    if (polygons.dominantKind() != FeatureStore::PolygonGeometry ||
+            lines.dominantKind() != FeatureStore::LineGeometry) {
+        if (error) *error = "Sum Line Lengths needs a polygon layer and a line layer";
+        return FeatureStorePtr();
+    }
+
+    Job job;
+    job.operation = SumLineLengthOperation;
+    job.input = &polygons;
+    job.overlay = &lines;
+    job.distance = 0.0;
+    job.segments = 0;
+    job.feedback = feedback;
+    return run(job, statistics, error);
+}
+
+void Geoprocessing::copyAttributes(const FeatureStore &from, qint64 feature,
+                                   FeatureStore &to, int firstField)
+{
+    for (int field = 0; field < from.fieldCount(); ++field) {
+        if (from.isNull(field, feature)) continue;
+
+        switch (from.field(field).type) {
+        case FeatureStore::IntegerField:
+            to.setInteger(firstField + field, from.integerValue(field, feature));
+            break;
+        case FeatureStore::RealField:
+            to.setReal(firstField + field, from.realValue(field, feature));
+            break;
+        case FeatureStore::StringField:
+            to.setString(firstField + field, from.stringValue(field, feature));
+            break;
+        }
+    }
+}
+
+FeatureStorePtr Geoprocessing::run(const Job &job, Statistics *statistics, QString *error)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    const FeatureStore &input = *job.input;
+    FeatureStorePtr output(new FeatureStore());
+
+    // Input fields first, then the overlay fields for paired results
+    for (int field = 0; field < input.fieldCount(); ++field) {
+        output->addField(input.field(field).name, input.field(field).type);
+    }
+    int extraFirstField = output->fieldCount();
+    if (job.operation == IntersectionOperation || job.operation == LineIntersectionOperation) {
+        for (int field = 0; field < job.overlay->fieldCount(); ++field) {
+            QString name = job.overlay->field(field).name;
+            while (output->fieldIndex(name) >= 0) name += "_2";
+            output->addField(name, job.overlay->field(field).type);
+        }
+    } else if (job.operation == SumLineLengthOperation) {
+        QString lengthName = "LENGTH";
+        QString countName = "COUNT";
+        while (output->fieldIndex(lengthName) >= 0) lengthName += "_2";
+        while (output->fieldIndex(countName) >= 0) countName += "_2";
+        output->addField(lengthName, FeatureStore::RealField);
+        output->addField(countName, FeatureStore::IntegerField);
+    }
+
+    qint64 count = input.featureCount();
+    int threads = qMax(1, QThread::idealThreadCount());
+    qint64 chunkSize = qBound(kMinimumChunkSize, count / (qint64(threads) * kChunksPerThread),
+                              kMaximumChunkSize);
+    qint64 batchSize = chunkSize * threads * kChunksPerThread;
+
+    Statistics stats;
+    stats.inputFeatures = count;
+    stats.threads = int(qMin<qint64>(threads, (count + chunkSize - 1) / chunkSize));
+    if (job.feedback) job.feedback->setTotal(count);
+
+    for (qint64 batchBegin = 0; batchBegin < count; batchBegin += batchSize) {
+        if (job.feedback && job.feedback->isCanceled()) {
+            if (error) *error = "Canceled";
+            return FeatureStorePtr();
+        }
+        qint64 batchEnd = qMin(count, batchBegin + batchSize);
+
+        QVector<Chunk> chunks;
+        for (qint64 begin = batchBegin; begin < batchEnd; begin += chunkSize) {
+            Chunk chunk;
+            chunk.begin = begin;
+            chunk.end = qMin(batchEnd, begin + chunkSize);
+            chunk.candidates = 0;
+            chunks.append(chunk);
+        }
+
+        if (chunks.size() == 1) {
+            processChunk(job, chunks[0]);
+        } else {
+            QtConcurrent::blockingMap(chunks, [&job](Chunk &chunk) {
+                processChunk(job, chunk);
+            });
+        }
+
+        // Append in feature order and drop the batch
+        for (Chunk &chunk : chunks) {
+            stats.candidates += chunk.candidates;
+            for (const Chunk::Output &result : chunk.results) {
+                output->beginFeature(output->featureCount());
+                for (const QByteArray &part : result.parts) {
+                    output->addWkb(reinterpret_cast<const unsigned char*>(part.constData()),
+                                   size_t(part.size()));
+                }
+                copyAttributes(input, result.source, *output, 0);
+                if (result.overlay >= 0) {
+                    copyAttributes(*job.overlay, result.overlay, *output, extraFirstField);
+                }
+                if (job.operation == SumLineLengthOperation) {
+                    output->setReal(extraFirstField, result.length);
+                    output->setInteger(extraFirstField + 1, result.lines);
+                }
+                output->endFeature();
+            }
+            std::vector<Chunk::Output>().swap(chunk.results);
+        }
+    }
+
+    if (job.feedback && job.feedback->isCanceled()) {
+        if (error) *error = "Canceled";
+        return FeatureStorePtr();
+    }
+
+    output->finish();
+
+    stats.outputFeatures = output->featureCount();
+    stats.elapsedMs = timer.elapsed();
+    if (statistics) *statistics = stats;
+    return output;
+}
+
+void Geoprocessing::processChunk(const Job &job, Chunk &chunk)
+{
+    GeosContext geos;
+    GEOSContextHandle_t context = geos.handle();
+    GEOSWKBWriter *writer = GEOSWKBWriter_create_r(context);
+
+    const FeatureStore &input = *job.input;
+    const FeatureStore *overlay = job.overlay;
+    bool selfJoin = job.operation == LineIntersectionOperation && overlay == job.input;
+    // Sum Line Lengths prepares the polygon instead of the lines
+    bool prepareOverlay = job.operation != SumLineLengthOperation;
+
+    // Overlay features are built (and prepared) once per chunk, on first use
+    QHash<qint64, OverlayGeometry> overlayGeometries;
+    std::vector<GEOSGeometry*> pieces;
+
+    qint64 f = chunk.begin;
+    for (; f < chunk.end; ++f) {
+        if (job.feedback && job.feedback->isCanceled()) break;
+
+        GEOSGeometry *geometry = GeosUtils::fromFeature(context, input, f);
+        if (!geometry) continue;
+
+        int dimension = kindDimension(input.geometryKind(f));
+
+        if (job.operation == BufferOperation) {
+            GEOSGeometry *buffered = GEOSBuffer_r(context, geometry, job.distance, job.segments);
+            if (buffered) {
+                Chunk::Output result(f, -1);
+                appendComponents(context, writer, buffered, 2, false, result.parts);
+                if (!result.parts.empty()) chunk.results.push_back(result);
+                GEOSGeom_destroy_r(context, buffered);
+            }
+            GEOSGeom_destroy_r(context, geometry);
+            continue;
+        }
+
+        QVector<qint64> candidates = overlay->featuresIn(input.featureExtent(f));
+        chunk.candidates += candidates.size();
+
+        const GEOSPreparedGeometry *preparedInput = nullptr;
+        Chunk::Output sum(f, -1);
+        if (job.operation == SumLineLengthOperation) {
+            preparedInput = GEOSPrepare_r(context, geometry);
+        }
+
+        for (qint64 candidate : candidates) {
+            // Within one layer every pair is visited from its lower feature only
+            if (selfJoin && candidate <= f) continue;
+
+            QHash<qint64, OverlayGeometry>::iterator it = overlayGeometries.find(candidate);
+            if (it == overlayGeometries.end()) {
+                OverlayGeometry entry;
+                entry.geometry = GeosUtils::fromFeature(context, *overlay, candidate);
+                entry.prepared = entry.geometry && prepareOverlay ? GEOSPrepare_r(context, entry.geometry) : nullptr;
+                it = overlayGeometries.insert(candidate, entry);
+            }
+            const OverlayGeometry &entry = it.value();
+            if (!entry.geometry) continue;
+
+            if (job.operation == SumLineLengthOperation) {
+                if (!preparedInput || GEOSPreparedIntersects_r(context, preparedInput, entry.geometry) != 1) continue;
+
+                // Lines fully inside count with their whole length
+                double length = 0.0;
+                if (GEOSPreparedContains_r(context, preparedInput, entry.geometry) == 1) {
+                    GEOSLength_r(context, entry.geometry, &length);
+                } else {
+                    GEOSGeometry *inside = GEOSIntersection_r(context, entry.geometry, geometry);
+                    if (inside) {
+                        GEOSLength_r(context, inside, &length);
+                        GEOSGeom_destroy_r(context, inside);
+                    }
+                }
+                if (length > 0.0) {
+                    sum.length += length;
+                    sum.lines++;
+                }
+                continue;
+            }
+
+            if (!entry.prepared || GEOSPreparedIntersects_r(context, entry.prepared, geometry) != 1) continue;
+
+            if (job.operation == LineIntersectionOperation) {
+                GEOSGeometry *crossing = GEOSIntersection_r(context, geometry, entry.geometry);
+                if (!crossing) continue;
+
+                // One point feature per crossing; shared stretches are not crossings
+                std::vector<QByteArray> points;
+                appendComponents(context, writer, crossing, 0, true, points);
+                for (const QByteArray &point : points) {
+                    Chunk::Output result(f, candidate);
+                    result.parts.push_back(point);
+                    chunk.results.push_back(result);
+                }
+                GEOSGeom_destroy_r(context, crossing);
+                continue;
+            }
+
+            // Features fully inside the overlay are kept as they are
+            GEOSGeometry *piece = GEOSPreparedContains_r(context, entry.prepared, geometry) == 1
+                    ? GEOSGeom_clone_r(context, geometry)
+                    : GEOSIntersection_r(context, geometry, entry.geometry);
+            if (!piece) continue;
+
+            if (job.operation == IntersectionOperation) {
+                Chunk::Output result(f, candidate);
+                int overlayDimension = kindDimension(overlay->geometryKind(candidate));
+                appendComponents(context, writer, piece, qMin(dimension, overlayDimension), false, result.parts);
+                if (!result.parts.empty()) chunk.results.push_back(result);
+                GEOSGeom_destroy_r(context, piece);
+            } else {
+                pieces.push_back(piece);
+            }
+        }
+
+        if (job.operation == SumLineLengthOperation) {
+            // Every polygon is kept, with zero when no line crosses it
+            appendComponents(context, writer, geometry, 2, false, sum.parts);
+            if (!sum.parts.empty()) chunk.results.push_back(sum);
+            if (preparedInput) GEOSPreparedGeom_destroy_r(context, preparedInput);
+        }
+
+        if (!pieces.empty()) {
+            // Clip: the pieces cut by several overlay polygons become one feature
+            GEOSGeometry *clipped = pieces[0];
+            if (pieces.size() > 1) {
+                GEOSGeometry *collection = GEOSGeom_createCollection_r(
+                            context, GEOS_GEOMETRYCOLLECTION, pieces.data(), (unsigned int)pieces.size());
+                GEOSGeometry *merged = GEOSUnaryUnion_r(context, collection);
+                if (merged) {
+                    GEOSGeom_destroy_r(context, collection);
+                    clipped = merged;
+                } else {
+                    clipped = collection;
+                }
+            }
+
+            Chunk::Output result(f, -1);
+            appendComponents(context, writer, clipped, dimension, false, result.parts);
+            if (!result.parts.empty()) chunk.results.push_back(result);
+            GEOSGeom_destroy_r(context, clipped);
+            pieces.clear();
+        }
+
+        GEOSGeom_destroy_r(context, geometry);
+    }
+
+    if (job.feedback) job.feedback->addProgress(f - chunk.begin);
+
+    for (const OverlayGeometry &entry : overlayGeometries) {
+        if (entry.prepared) GEOSPreparedGeom_destroy_r(context, entry.prepared);
+        if (entry.geometry) GEOSGeom_destroy_r(context, entry.geometry);
+    }
+    GEOSWKBWriter_destroy_r(context, writer);
+}
+
+namespace {
+// Features per cascaded union task inside one dissolve group
+const qint64 kDissolveBatchSize = 2048;
+
+// Z-order key of a point inside the extent, 16 bits per axis
+quint32 mortonKey(double x, double y, const FeatureStore::Extent &extent)
+{
+    double width = extent.maxX - extent.minX;
+    double height = extent.maxY - extent.minY;
+    quint32 ix = width > 0.0 ? quint32(qBound(0.0, (x - extent.minX) / width, 1.0) * 65535.0) : 0;
+    quint32 iy = height > 0.0 ? quint32(qBound(0.0, (y - extent.minY) / height, 1.0) * 65535.0) : 0;
+
+    quint32 key = 0;
+    for (int bit = 0; bit < 16; ++bit) {
+        key |= ((ix >> bit) & 1u) << (2 * bit);
+        key |= ((iy >> bit) & 1u) << (2 * bit + 1);
+    }
+    return key;
+}
+
+// Cascaded union of the geometries (consumed) as WKB
+QByteArray unionToWkb(GEOSContextHandle_t context, std::vector<GEOSGeometry*> &geometries)
+{
+    if (geometries.empty()) return QByteArray();
+
+    GEOSGeometry *collection = GEOSGeom_createCollection_r(
+                context, GEOS_GEOMETRYCOLLECTION, geometries.data(), (unsigned int)geometries.size());
+    geometries.clear();
+    if (!collection) return QByteArray();
+
+    GEOSGeometry *merged = GEOSUnaryUnion_r(context, collection);
+    GEOSGeom_destroy_r(context, collection);
+    if (!merged) return QByteArray();
+
+    GEOSWKBWriter *writer = GEOSWKBWriter_create_r(context);
+    size_t size = 0;
+    unsigned char *wkb = GEOSWKBWriter_write_r(context, writer, merged, &size);
+    QByteArray result;
+    if (wkb) {
+        result = QByteArray(reinterpret_cast<const char*>(wkb), int(size));
+        GEOSFree_r(context, wkb);
+    }
+    GEOSWKBWriter_destroy_r(context, writer);
+    GEOSGeom_destroy_r(context, merged);
+    return result;
+}
+
+struct DissolveGroup {
+    QString key;
+    std::vector<qint64> features;
+    std::vector<QByteArray> parts;   // Final geometry, WKB per kept component
+    qint64 elapsedMs = 0;
+};
+
+struct DissolveTask {
+    int group;
+    size_t begin;
+    size_t end;
+    QByteArray wkb;
+    qint64 elapsedMs = 0;
+};
+}
+
+FeatureStorePtr Geoprocessing::dissolve(const FeatureStore &input, int field,
+                                        Feedback *feedback, Statistics *statistics,
+                                        QVector<GroupTiming> *timings, QString *error)
+{
+    if (field >= input.fieldCount()) {
+        if (error) *error = "Unknown dissolve field";
+        return FeatureStorePtr();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Group by key, in order of first appearance
+    std::vector<DissolveGroup> groups;
+    QHash<QString, int> groupIndex;
+    qint64 count = input.featureCount();
+    for (qint64 f = 0; f < count; ++f) {
+        if (input.geometryKind(f) == FeatureStore::NoGeometry) continue;
+
+        QString key = field < 0 ? QString("All")
+                                : (input.isNull(field, f) ? QString("NULL") : input.attribute(field, f).toString());
+        QHash<QString, int>::const_iterator it = groupIndex.constFind(key);
+        int group;
+        if (it == groupIndex.constEnd()) {
+            group = int(groups.size());
+            groupIndex.insert(key, group);
+            groups.push_back(DissolveGroup());
+            groups.back().key = key;
+        } else {
+            group = it.value();
+        }
+        groups[size_t(group)].features.push_back(f);
+    }
+
+    // Large groups are cut into batches of nearby features, so every
+    // union task merges neighbours and the batches keep all threads busy
+    std::vector<DissolveTask> tasks;
+    std::vector<quint32> keys;
+    for (size_t g = 0; g < groups.size(); ++g) {
+        std::vector<qint64> &features = groups[g].features;
+        if (qint64(features.size()) > kDissolveBatchSize) {
+            if (keys.empty()) {
+                keys.resize(size_t(count));
+                for (qint64 f = 0; f < count; ++f) {
+                    const FeatureStore::Extent &extent = input.featureExtent(f);
+                    keys[size_t(f)] = mortonKey((extent.minX + extent.maxX) / 2,
+                                                (extent.minY + extent.maxY) / 2, input.extent());
+                }
+            }
+            std::sort(features.begin(), features.end(), [&keys](qint64 a, qint64 b) {
+                return keys[size_t(a)] < keys[size_t(b)];
+            });
+        }
+        for (size_t begin = 0; begin < features.size(); begin += size_t(kDissolveBatchSize)) {
+            DissolveTask task;
+            task.group = int(g);
+            task.begin = begin;
+            task.end = qMin(features.size(), begin + size_t(kDissolveBatchSize));
+            tasks.push_back(task);
+        }
+    }
+
+    if (feedback) feedback->setTotal(count);
+
+    QtConcurrent::blockingMap(tasks, [&input, &groups, feedback](DissolveTask &task) {
+        if (feedback && feedback->isCanceled()) return;
+
+        QElapsedTimer taskTimer;
+        taskTimer.start();
+        GeosContext geos;
+        const std::vector<qint64> &features = groups[size_t(task.group)].features;
+
+        std::vector<GEOSGeometry*> geometries;
+        geometries.reserve(task.end - task.begin);
+        for (size_t i = task.begin; i < task.end; ++i) {
+            GEOSGeometry *geometry = GeosUtils::fromFeature(geos.handle(), input, features[i]);
+            if (geometry) geometries.push_back(geometry);
+        }
+        task.wkb = unionToWkb(geos.handle(), geometries);
+        task.elapsedMs = taskTimer.elapsed();
+        if (feedback) feedback->addProgress(qint64(task.end - task.begin));
+    });
+
+    if (feedback && feedback->isCanceled()) {
+        if (error) *error = "Canceled";
+        return FeatureStorePtr();
+    }
+
+    // Merge the partial unions of every group
+    std::vector<std::vector<QByteArray> > partials(groups.size());
+    for (const DissolveTask &task : tasks) {
+        groups[size_t(task.group)].elapsedMs += task.elapsedMs;
+        if (!task.wkb.isEmpty()) partials[size_t(task.group)].push_back(task.wkb);
+    }
+
+    int dimension = kindDimension(input.dominantKind());
+    QVector<int> groupNumbers;
+    for (int g = 0; g < int(groups.size()); ++g) groupNumbers.append(g);
+
+    QtConcurrent::blockingMap(groupNumbers, [&groups, &partials, dimension, feedback](int g) {
+        if (feedback && feedback->isCanceled()) return;
+
+        QElapsedTimer mergeTimer;
+        mergeTimer.start();
+        GeosContext geos;
+        GEOSContextHandle_t context = geos.handle();
+
+        GEOSWKBReader *reader = GEOSWKBReader_create_r(context);
+        std::vector<GEOSGeometry*> geometries;
+        for (const QByteArray &wkb : partials[size_t(g)]) {
+            GEOSGeometry *geometry = GEOSWKBReader_read_r(
+                        context, reader, reinterpret_cast<const unsigned char*>(wkb.constData()), size_t(wkb.size()));
+            if (geometry) geometries.push_back(geometry);
+        }
+        GEOSWKBReader_destroy_r(context, reader);
+
+        GEOSGeometry *merged = nullptr;
+        if (geometries.size() == 1) {
+            merged = geometries[0];
+        } else if (geometries.size() > 1) {
+            GEOSGeometry *collection = GEOSGeom_createCollection_r(
+                        context, GEOS_GEOMETRYCOLLECTION, geometries.data(), (unsigned int)geometries.size());
+            merged = collection ? GEOSUnaryUnion_r(context, collection) : nullptr;
+            if (collection) GEOSGeom_destroy_r(context, collection);
+        }
+
+        if (merged) {
+            GEOSWKBWriter *writer = GEOSWKBWriter_create_r(context);
+            appendComponents(context, writer, merged, dimension, false, groups[size_t(g)].parts);
+            GEOSWKBWriter_destroy_r(context, writer);
+            GEOSGeom_destroy_r(context, merged);
+        }
+        groups[size_t(g)].elapsedMs += mergeTimer.elapsed();
+    });
+
+    if (feedback && feedback->isCanceled()) {
+        if (error) *error = "Canceled";
+        return FeatureStorePtr();
+    }
+
+    FeatureStorePtr output(new FeatureStore());
+    for (int f = 0; f < input.fieldCount(); ++f) {
+        output->addField(input.field(f).name, input.field(f).type);
+    }
+
+    if (timings) timings->clear();
+    for (const DissolveGroup &group : groups) {
+        if (timings) {
+            GroupTiming timing;
+            timing.key = group.key;
+            timing.features = qint64(group.features.size());
+            timing.elapsedMs = group.elapsedMs;
+            timings->append(timing);
+        }
+        if (group.parts.empty()) continue;
+
+        output->beginFeature(output->featureCount());
+        for (const QByteArray &part : group.parts) {
+            output->addWkb(reinterpret_cast<const unsigned char*>(part.constData()), size_t(part.size()));
+        }
+        // Attributes of the first feature in file order
+        copyAttributes(input, *std::min_element(group.features.begin(), group.features.end()), *output, 0);
+        output->endFeature();
+    }
+    output->finish();
+
+    Statistics stats;
+    stats.inputFeatures = count;
+    stats.outputFeatures = output->featureCount();
+    stats.threads = int(qMin<size_t>(size_t(qMax(1, QThread::idealThreadCount())), tasks.size()));
+    stats.elapsedMs = timer.elapsed();
+    if (statistics) *statistics = stats;
+    return output;
+}
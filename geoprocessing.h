@@ -0,0 +1,125 @@
+#ifndef GEOPROCESSING_H
+#define GEOPROCESSING_H
+
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QString>
+#include <QVector>
+
+#include "featurestore.h"
+
+// Vector geoprocessing on GEOS.
+//
+// The input layer is cut into chunks of features that run on the thread
+// pool; every chunk works in its own GEOS context (the reentrant _r API),
+// so no GEOS state is shared between threads. Overlay features are first
+// filtered through the overlay's spatial index and then tested against
+// prepared geometries before the expensive overlay operation runs.
+//
+// Chunk results are kept as WKB and appended to the output store in
+// feature order a batch at a time, so only one batch of results is ever
+// held besides the output layer itself. Both layers must be in the same CRS.
+// Long runs report progress and stop early through a Feedback object.
+class Geoprocessing
+{
+public:
+    struct Statistics {
+        qint64 inputFeatures = 0;
+        qint64 candidates = 0;       // Overlay features passed by the index
+        qint64 outputFeatures = 0;
+        int threads = 0;
+        qint64 elapsedMs = 0;
+    };
+
+    // Progress and cancellation, shared between the worker threads and a
+    // caller polling from another thread
+    class Feedback
+    {
+    public:
+        Feedback() : processed(0), total(0), canceled(0) {}
+
+        void cancel() { canceled.fetchAndStoreOrdered(1); }
+        bool isCanceled() const { return canceled.loadAcquire() != 0; }
+
+        // Set by the algorithm: units of work in total and done so far
+        void setTotal(qint64 count) {
+            processed.fetchAndStoreOrdered(0);
+            total.fetchAndStoreOrdered(count);
+        }
+        void addProgress(qint64 done) { processed.fetchAndAddRelaxed(done); }
+
+        // Fraction of the work done, 0 to 1
+        double progress() const {
+            qint64 count = total.loadAcquire();
+            return count > 0 ? double(processed.loadAcquire()) / count : 0.0;
+        }
+
+    private:
+        QAtomicInteger<qint64> processed;
+        QAtomicInteger<qint64> total;
+        QAtomicInt canceled;
+    };
+
+    // Buffers every feature by distance (map units); output is polygons
+    static FeatureStorePtr buffer(const FeatureStore &input, double distance, int segments,
+                                  Feedback *feedback = nullptr, Statistics *statistics = nullptr,
+                                  QString *error = nullptr);
+    // Parts of the input features inside the overlay polygons, one output
+    // feature per input feature with the input attributes
+    static FeatureStorePtr clip(const FeatureStore &input, const FeatureStore &overlay,
+                                Feedback *feedback = nullptr, Statistics *statistics = nullptr,
+                                QString *error = nullptr);
+    // One output feature per intersecting input/overlay pair, with the
+    // attributes of both
+    static FeatureStorePtr intersection(const FeatureStore &input, const FeatureStore &overlay,
+                                        Feedback *feedback = nullptr, Statistics *statistics = nullptr,
+                                        QString *error = nullptr);
+    // One point per crossing of an input line with an overlay line, with the
+    // attributes of both. Passing the same layer twice finds the crossings
+    // within one network, each pair reported once.
+    static FeatureStorePtr lineIntersections(const FeatureStore &input, const FeatureStore &overlay,
+                                             Feedback *feedback = nullptr, Statistics *statistics = nullptr,
+                                             QString *error = nullptr);
+    // The input polygons with the total length (map units) and the number
+    // of the overlay lines inside each of them
+    static FeatureStorePtr sumLineLengths(const FeatureStore &polygons, const FeatureStore &lines,
+                                          Feedback *feedback = nullptr, Statistics *statistics = nullptr,
+                                          QString *error = nullptr);
+
+    // Time spent on one dissolve group, summed over its union tasks
+    struct GroupTiming {
+        QString key;
+        qint64 features = 0;
+        qint64 elapsedMs = 0;
+    };
+
+    // Merges the features sharing the value of field (all features when
+    // field is -1) into one feature per value, with the attributes of the
+    // group's first feature. Large groups are split into spatially
+    // coherent batches whose cascaded unions run in parallel with the
+    // other groups, and the partial results are then unioned once more.
+    static FeatureStorePtr dissolve(const FeatureStore &input, int field,
+                                    Feedback *feedback = nullptr, Statistics *statistics = nullptr,
+                                    QVector<GroupTiming> *timings = nullptr, QString *error = nullptr);
+
+    // Copies the attributes of one feature into fields starting at firstField
+    static void copyAttributes(const FeatureStore &from, qint64 feature,
+                               FeatureStore &to, int firstField);
+
+private:
+    enum Operation {
+        BufferOperation,
+        ClipOperation,
+        IntersectionOperation,
+        LineIntersectionOperation,
+        SumLineLengthOperation
+    };
+
+    struct Job;
+    struct Chunk;
+
+    static FeatureStorePtr run(const Job &job, Statistics *statistics, QString *error);
+    static void processChunk(const Job &job, Chunk &chunk);
+};
+
+#endif // GEOPROCESSING_H
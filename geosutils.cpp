@@ -0,0 +1,131 @@
+#include "geosutils.h"
+
+#include <QDebug>
+#include <vector>
+
+namespace {
+void geosMessage(const char *message, void *userData)
+{
+    Q_UNUSED(userData);
+    qDebug() << "GEOS:" << message;
+}
+}
+
+GeosContext::GeosContext()
+    : context(GEOS_init_r())
+{
+    GEOSContext_setNoticeMessageHandler_r(context, geosMessage, nullptr);
+    GEOSContext_setErrorMessageHandler_r(context, geosMessage, nullptr);
+}
+
+GeosContext::~GeosContext()
+{
+    GEOS_finish_r(context);
+}
+
+GEOSCoordSequence *GeosUtils::coordinates(GEOSContextHandle_t context,
+                                          const double *xs, const double *ys,
+                                          quint32 first, quint32 last, bool close)
+{
+    unsigned int count = last - first;
+    bool addClosing = close && count > 0 &&
+            (xs[first] != xs[last - 1] || ys[first] != ys[last - 1]);
+
+    GEOSCoordSequence *sequence = GEOSCoordSeq_create_r(context, count + (addClosing ? 1 : 0), 2);
+    if (!sequence) return nullptr;
+
+    for (unsigned int i = 0; i < count; ++i) {
+        GEOSCoordSeq_setX_r(context, sequence, i, xs[first + i]);
+        GEOSCoordSeq_setY_r(context, sequence, i, ys[first + i]);
+    }
+    if (addClosing) {
+        GEOSCoordSeq_setX_r(context, sequence, count, xs[first]);
+        GEOSCoordSeq_setY_r(context, sequence, count, ys[first]);
+    }
+    return sequence;
+}
+
+GEOSGeometry *GeosUtils::fromFeature(GEOSContextHandle_t context,
+                                     const FeatureStore &store, qint64 feature)
+{
+    const double *xs = store.xData();
+    const double *ys = store.yData();
+    FeatureStore::GeometryKind kind = store.geometryKind(feature);
+
+    std::vector<GEOSGeometry*> parts;
+    for (quint32 part = store.partBegin(feature); part < store.partEnd(feature); ++part) {
+        quint32 firstRing = store.ringBegin(part);
+        quint32 lastRing = store.ringEnd(part);
+        if (firstRing == lastRing) continue;
+
+        GEOSGeometry *geometry = nullptr;
+        quint32 first = store.vertexBegin(firstRing);
+        quint32 last = store.vertexEnd(firstRing);
+
+        switch (kind) {
+        case FeatureStore::PointGeometry:
+            if (last > first) {
+                geometry = GEOSGeom_createPoint_r(context, coordinates(context, xs, ys, first, first + 1, false));
+            }
+            break;
+        case FeatureStore::LineGeometry:
+            if (last - first >= 2) {
+                geometry = GEOSGeom_createLineString_r(context, coordinates(context, xs, ys, first, last, false));
+            }
+            break;
+        case FeatureStore::PolygonGeometry: {
+            // Rings need at least three distinct vertices
+            if (last - first < 3) break;
+            GEOSGeometry *shell = GEOSGeom_createLinearRing_r(context, coordinates(context, xs, ys, first, last, true));
+            if (!shell) break;
+
+            std::vector<GEOSGeometry*> holes;
+            for (quint32 ring = firstRing + 1; ring < lastRing; ++ring) {
+                quint32 holeFirst = store.vertexBegin(ring);
+                quint32 holeLast = store.vertexEnd(ring);
+                if (holeLast - holeFirst < 3) continue;
+                GEOSGeometry *hole = GEOSGeom_createLinearRing_r(
+                            context, coordinates(context, xs, ys, holeFirst, holeLast, true));
+                if (hole) holes.push_back(hole);
+            }
+            geometry = GEOSGeom_createPolygon_r(context, shell,
+                                                holes.empty() ? nullptr : holes.data(),
+                                                unsigned(holes.size()));
+            break;
+        }
+        default:
+            break;
+        }
+
+        if (geometry) parts.push_back(geometry);
+    }
+
+    if (parts.empty()) return nullptr;
+    if (parts.size() == 1) return parts[0];
+
+    int collectionType = GEOS_GEOMETRYCOLLECTION;
+    switch (kind) {
+    case FeatureStore::PointGeometry: collectionType = GEOS_MULTIPOINT; break;
+    case FeatureStore::LineGeometry: collectionType = GEOS_MULTILINESTRING; break;
+    case FeatureStore::PolygonGeometry: collectionType = GEOS_MULTIPOLYGON; break;
+    default: break;
+    }
+    return GEOSGeom_createCollection_r(context, collectionType, parts.data(), unsigned(parts.size()));
+}
+
+GEOSGeometry *GeosUtils::fromPolygon(GEOSContextHandle_t context, const QPolygonF &polygon)
+{
+    if (polygon.size() < 3) return nullptr;
+
+    std::vector<double> xs(size_t(polygon.size()));
+    std::vector<double> ys(size_t(polygon.size()));
+    for (int i = 0; i < polygon.size(); ++i) {
+        xs[size_t(i)] = polygon[i].x();
+        ys[size_t(i)] = polygon[i].y();
+    }
+
+    GEOSGeometry *shell = GEOSGeom_createLinearRing_r(
+                context, coordinates(context, xs.data(), ys.data(), 0, quint32(xs.size()), true));
+    if (!shell) return nullptr;
+    return GEOSGeom_createPolygon_r(context, shell, nullptr, 0);
+}
@@ -0,0 +1,42 @@
+#ifndef GEOSUTILS_H
+#define GEOSUTILS_H
+
+#include <QPolygonF>
+
+#define GEOS_USE_ONLY_R_API
+#include <geos_c.h>
+
+#include "featurestore.h"
+
+// Owns one GEOS context handle. GEOS handles are not thread-safe, so
+// every thread working with GEOS creates its own GeosContext.
+class GeosContext
+{
+public:
+    GeosContext();
+    ~GeosContext();
+
+    GEOSContextHandle_t handle() const { return context; }
+
+private:
+    GEOSContextHandle_t context;
+
+    Q_DISABLE_COPY(GeosContext)
+};
+
+// Conversions between FeatureStore / Qt geometry and GEOS geometry.
+// Returned geometries are owned by the caller (GEOSGeom_destroy_r).
+class GeosUtils
+{
+public:
+    static GEOSGeometry *fromFeature(GEOSContextHandle_t context,
+                                     const FeatureStore &store, qint64 feature);
+    static GEOSGeometry *fromPolygon(GEOSContextHandle_t context, const QPolygonF &polygon);
+
+private:
+    static GEOSCoordSequence *coordinates(GEOSContextHandle_t context,
+                                          const double *xs, const double *ys,
+                                          quint32 first, quint32 last, bool close);
+};
+
+#endif // GEOSUTILS_H
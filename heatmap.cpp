@@ -0,0 +1,402 @@
+#include "heatmap.h"
+
+#include <QElapsedTimer>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
+#include <cmath>
+
+namespace {
+const qint64 kMinimumChunkSize = 4096;
+const qint64 kMaximumChunkSize = 262144;
+const int kChunksPerThread = 4;
+// Row bands per pool thread, for load balancing around dense clusters
+const int kTilesPerThread = 8;
+const int kMinimumBandRows = 16;
+// Largest raster: 400 MB of floats, and what a pixmap can still hold per side
+const qint64 kMaximumCells = 100000000;
+const qint64 kMaximumSide = 32767;
+// Cancellation is checked every this many rows
+const int kCancelStep = 64;
+
+// Radial kernel profiles over the distance as a fraction of the radius
+double radialWeight(Heatmap::Kernel kernel, double distance)
+{
+    if (distance > 1.0) return 0.0;
+    switch (kernel) {
+    case Heatmap::Quartic: {
+        double u = 1.0 - distance * distance;
+        return u * u;
+    }
+    case Heatmap::Triangular:
+        return 1.0 - distance;
+    case Heatmap::Uniform:
+        return 1.0;
+    case Heatmap::Gaussian:
+        break;
+    }
+    return 0.0;
+}
+}
+
+struct Heatmap::Bin {
+    qint32 row;
+    qint32 column;
+    float weight;
+};
+
+struct Heatmap::Chunk {
+    qint64 begin = 0;
+    qint64 end = 0;
+    qint64 points = 0;
+    std::vector<Bin> bins;
+    std::vector<qint64> bandCursor;   // Bins per band, then where they go in the sorted array
+};
+
+struct Heatmap::Tile {
+    int firstRow = 0;
+    int lastRow = 0;                  // One past the last output row
+    qint64 bins = 0;
+    float maximum = 0.0f;
+};
+
+struct Heatmap::Context {
+    Kernel kernel = Quartic;
+    int radiusCells = 0;
+    int bandRows = 0;
+    std::vector<float> weights;       // Gaussian: 2R+1 taps; radial: (2R+1)² mask
+    std::vector<Bin> bins;            // Sorted by band
+    std::vector<qint64> bandBegin;    // Offsets into bins, plus one past the end
+    Raster *raster = nullptr;
+    Geoprocessing::Feedback *feedback = nullptr;
+};
+
+void Heatmap::spreadTile(const Context &context, Tile &tile)
+{
+    Geoprocessing::Feedback *feedback = context.feedback;
+    if (feedback && feedback->isCanceled()) return;
+
+    Raster &raster = *context.raster;
+    int radius = context.radiusCells;
+    int columns = raster.columns;
+    int outputRows = tile.lastRow - tile.firstRow;
+    int localFirst = tile.firstRow - radius;
+    int localRows = outputRows + 2 * radius;
+
+    // Bin the points of every row within the radius of the tile
+    std::vector<float> grid(size_t(localRows) * columns, 0.0f);
+    std::vector<char> rowUsed(size_t(localRows), 0);
+    int firstBand = qMax(0, localFirst) / context.bandRows;
+    int lastBand = qMin(raster.rows - 1, tile.lastRow - 1 + radius) / context.bandRows;
+    for (qint64 b = context.bandBegin[firstBand]; b < context.bandBegin[lastBand + 1]; ++b) {
+        const Bin &bin = context.bins[b];
+        int row = bin.row - localFirst;
+        if (row < 0 || row >= localRows) continue;
+        grid[size_t(row) * columns + bin.column] += bin.weight;
+        rowUsed[row] = 1;
+    }
+    for (int row = radius; row < radius + outputRows; ++row) {
+        if (!rowUsed[row]) continue;
+        const float *values = &grid[size_t(row) * columns];
+        for (int c = 0; c < columns; ++c) {
+            if (values[c] != 0.0f) ++tile.bins;
+        }
+    }
+
+    float *output = raster.values.data() + size_t(tile.firstRow) * columns;
+
+    if (context.kernel == Gaussian) {
+        const float *taps = context.weights.data() + radius;
+
+        // Horizontal pass, from the non-empty bins only
+        std::vector<float> smoothed(grid.size(), 0.0f);
+        for (int row = 0; row < localRows; ++row) {
+            if (!rowUsed[row]) continue;
+            const float *in = &grid[size_t(row) * columns];
+            float *out = &smoothed[size_t(row) * columns];
+            for (int c = 0; c < columns; ++c) {
+                float weight = in[c];
+                if (weight == 0.0f) continue;
+                int from = qMax(-radius, -c);
+                int to = qMin(radius, columns - 1 - c);
+                for (int k = from; k <= to; ++k) out[c + k] += weight * taps[k];
+            }
+        }
+
+        // Vertical pass into the tile's rows
+        for (int r = 0; r < outputRows; ++r) {
+            if (feedback && r % kCancelStep == 0 && feedback->isCanceled()) return;
+            float *out = output + size_t(r) * columns;
+            for (int k = -radius; k <= radius; ++k) {
+                int row = r + radius + k;
+                if (!rowUsed[row]) continue;
+                const float *in = &smoothed[size_t(row) * columns];
+                float tap = taps[k];
+                for (int c = 0; c < columns; ++c) out[c] += tap * in[c];
+            }
+        }
+    } else {
+        // Stamp the mask of every non-empty bin, clipped to the tile
+        int side = 2 * radius + 1;
+        for (int row = 0; row < localRows; ++row) {
+            if (feedback && row % kCancelStep == 0 && feedback->isCanceled()) return;
+            if (!rowUsed[row]) continue;
+            int fromY = qMax(-radius, radius - row);
+            int toY = qMin(radius, outputRows - 1 + radius - row);
+            const float *in = &grid[size_t(row) * columns];
+            for (int c = 0; c < columns; ++c) {
+                float weight = in[c];
+                if (weight == 0.0f) continue;
+                int fromX = qMax(-radius, -c);
+                int toX = qMin(radius, columns - 1 - c);
+                for (int dy = fromY; dy <= toY; ++dy) {
+                    float *out = output + size_t(row - radius + dy) * columns + c;
+                    const float *mask = context.weights.data() + size_t(dy + radius) * side + radius;
+                    for (int dx = fromX; dx <= toX; ++dx) out[dx] += weight * mask[dx];
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < size_t(outputRows) * columns; ++i) {
+        tile.maximum = qMax(tile.maximum, output[i]);
+    }
+    if (feedback) feedback->addProgress(outputRows);
+}
+
+bool Heatmap::estimate(const FeatureStore &points, const Options &options, Raster &raster,
+                       Geoprocessing::Feedback *feedback, Statistics *statistics, QString *error)
+{
+    if (!(options.cellSize > 0.0) || !(options.radius > 0.0)) {
+        if (error) *error = "The cell size and radius must be positive";
+        return false;
+    }
+    if (points.dominantKind() != FeatureStore::PointGeometry || points.extent().isNull()) {
+        if (error) *error = "The layer has no points";
+        return false;
+    }
+    int weightField = options.weightField;
+    if (weightField >= 0 && (weightField >= points.fieldCount() ||
+                             points.field(weightField).type == FeatureStore::StringField)) {
+        if (error) *error = "The weight field must be numeric";
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Grid over the extent grown by the radius, so no kernel is cut off
+    const FeatureStore::Extent &extent = points.extent();
+    double cellSize = options.cellSize;
+    double radius = options.radius;
+    qint64 columns = qMax<qint64>(1, qint64(std::ceil((extent.maxX - extent.minX + 2.0 * radius) / cellSize)));
+    qint64 rows = qMax<qint64>(1, qint64(std::ceil((extent.maxY - extent.minY + 2.0 * radius) / cellSize)));
+    if (columns > kMaximumSide || rows > kMaximumSide || columns * rows > kMaximumCells) {
+        if (error) *error = QString("A %1 x %2 cell raster is too large; use a larger cell size")
+                .arg(columns).arg(rows);
+        return false;
+    }
+
+    raster = Raster();
+    raster.columns = int(columns);
+    raster.rows = int(rows);
+    raster.originX = extent.minX - radius;
+    raster.originY = extent.maxY + radius;
+    raster.cellSize = cellSize;
+    raster.values.assign(size_t(columns * rows), 0.0f);
+
+    Context context;
+    context.kernel = options.kernel;
+    context.radiusCells = int(std::floor(radius / cellSize));
+    context.raster = &raster;
+    context.feedback = feedback;
+    int r = context.radiusCells;
+
+    // Discrete kernel between cell centres, normalised to sum to one
+    double sum = 0.0;
+    if (options.kernel == Gaussian) {
+        double sigma = radius / 3.0;
+        context.weights.resize(size_t(2 * r + 1));
+        for (int k = -r; k <= r; ++k) {
+            double d = k * cellSize / sigma;
+            context.weights[k + r] = float(std::exp(-0.5 * d * d));
+            sum += context.weights[k + r];
+        }
+    } else {
+        int side = 2 * r + 1;
+        context.weights.resize(size_t(side) * side);
+        for (int dy = -r; dy <= r; ++dy) {
+            for (int dx = -r; dx <= r; ++dx) {
+                double d = std::sqrt(double(dx * dx + dy * dy)) * cellSize / radius;
+                float weight = float(radialWeight(options.kernel, d));
+                context.weights[size_t(dy + r) * side + dx + r] = weight;
+                sum += weight;
+            }
+        }
+    }
+    // A radius under one cell leaves only the centre, which may weigh zero
+    if (sum <= 0.0) {
+        context.weights.assign(context.weights.size(), 0.0f);
+        context.weights[context.weights.size() / 2] = 1.0f;
+        sum = 1.0;
+    }
+    for (float &weight : context.weights) weight = float(weight / sum);
+
+    int threads = qMax(1, QThread::idealThreadCount());
+    context.bandRows = qMax(qMax(kMinimumBandRows, r),
+                            int((rows + threads * kTilesPerThread - 1) / (threads * kTilesPerThread)));
+    int bands = int((rows + context.bandRows - 1) / context.bandRows);
+
+    qint64 count = points.featureCount();
+    qint64 chunkSize = qBound(kMinimumChunkSize, count / (qint64(threads) * kChunksPerThread),
+                              kMaximumChunkSize);
+    QVector<Chunk> chunks;
+    for (qint64 begin = 0; begin < count; begin += chunkSize) {
+        Chunk chunk;
+        chunk.begin = begin;
+        chunk.end = qMin(count, begin + chunkSize);
+        chunks.append(chunk);
+    }
+
+    if (feedback) feedback->setTotal(count + rows);
+
+    // Bin every point vertex and count the bins per band
+    int bandRows = context.bandRows;
+    QtConcurrent::blockingMap(chunks, [&points, &raster, weightField, bands, bandRows, feedback](Chunk &chunk) {
+        chunk.bandCursor.assign(size_t(bands), 0);
+        if (feedback && feedback->isCanceled()) return;
+
+        for (qint64 f = chunk.begin; f < chunk.end; ++f) {
+            if (points.geometryKind(f) != FeatureStore::PointGeometry) continue;
+            double weight = 1.0;
+            if (weightField >= 0) {
+                if (points.isNull(weightField, f)) continue;
+                weight = points.realValue(weightField, f);
+            }
+
+            const double *xs = points.xData();
+            const double *ys = points.yData();
+            for (quint32 part = points.partBegin(f); part < points.partEnd(f); ++part) {
+                for (quint32 ring = points.ringBegin(part); ring < points.ringEnd(part); ++ring) {
+                    for (quint32 v = points.vertexBegin(ring); v < points.vertexEnd(ring); ++v) {
+                        Bin bin;
+                        bin.column = qBound(0, int((xs[v] - raster.originX) / raster.cellSize), raster.columns - 1);
+                        bin.row = qBound(0, int((raster.originY - ys[v]) / raster.cellSize), raster.rows - 1);
+                        bin.weight = float(weight);
+                        chunk.bins.push_back(bin);
+                        chunk.bandCursor[bin.row / bandRows]++;
+                        chunk.points++;
+                    }
+                }
+            }
+        }
+        if (feedback) feedback->addProgress(chunk.end - chunk.begin);
+    });
+
+    if (feedback && feedback->isCanceled()) {
+        if (error) *error = "Canceled";
+        raster = Raster();
+        return false;
+    }
+
+    // Counting sort by band; chunks keep their order inside a band, so
+    // the sums and the raster do not depend on scheduling
+    Statistics stats;
+    context.bandBegin.assign(size_t(bands) + 1, 0);
+    qint64 offset = 0;
+    for (int band = 0; band < bands; ++band) {
+        context.bandBegin[band] = offset;
+        for (Chunk &chunk : chunks) {
+            qint64 binCount = chunk.bandCursor[band];
+            chunk.bandCursor[band] = offset;
+            offset += binCount;
+        }
+    }
+    context.bandBegin[bands] = offset;
+    context.bins.resize(size_t(offset));
+    for (const Chunk &chunk : chunks) stats.points += chunk.points;
+
+    QtConcurrent::blockingMap(chunks, [&context, bandRows](Chunk &chunk) {
+        for (const Bin &bin : chunk.bins) {
+            context.bins[chunk.bandCursor[bin.row / bandRows]++] = bin;
+        }
+        std::vector<Bin>().swap(chunk.bins);
+    });
+
+    QVector<Tile> tiles;
+    for (int band = 0; band < bands; ++band) {
+        Tile tile;
+        tile.firstRow = band * bandRows;
+        tile.lastRow = int(qMin<qint64>(rows, qint64(tile.firstRow) + bandRows));
+        tiles.append(tile);
+    }
+    QtConcurrent::blockingMap(tiles, [&context](Tile &tile) {
+        spreadTile(context, tile);
+    });
+
+    if (feedback && feedback->isCanceled()) {
+        if (error) *error = "Canceled";
+        raster = Raster();
+        return false;
+    }
+
+    for (const Tile &tile : tiles) {
+        raster.maximum = qMax(raster.maximum, tile.maximum);
+        stats.bins += tile.bins;
+    }
+    stats.tiles = tiles.size();
+    stats.threads = qMin(threads, tiles.size());
+    stats.elapsedMs = timer.elapsed();
+    if (statistics) *statistics = stats;
+    return true;
+}
+
+QImage Heatmap::render(const Raster &raster)
+{
+    if (raster.isNull()) return QImage();
+
+    // Blue, cyan, green, yellow, red; the low end fades out
+    static const int stops[5][3] = {
+        {0, 0, 255}, {0, 255, 255}, {0, 255, 0}, {255, 255, 0}, {255, 0, 0}
+    };
+    QRgb ramp[256];
+    ramp[0] = qRgba(0, 0, 0, 0);
+    for (int i = 1; i < 256; ++i) {
+        double t = i / 255.0;
+        int segment = qMin(3, int(t * 4.0));
+        double f = t * 4.0 - segment;
+        int channels[3];
+        for (int c = 0; c < 3; ++c) {
+            channels[c] = int(std::lround(stops[segment][c] + f * (stops[segment + 1][c] - stops[segment][c])));
+        }
+        int alpha = qMin(220, int(60 + t * 640));
+        ramp[i] = qRgba(channels[0], channels[1], channels[2], alpha);
+    }
+
+    QImage image(raster.columns, raster.rows, QImage::Format_ARGB32);
+    float scale = raster.maximum > 0.0f ? 255.0f / raster.maximum : 0.0f;
+    for (int row = 0; row < raster.rows; ++row) {
+        QRgb *line = reinterpret_cast<QRgb*>(image.scanLine(row));
+        const float *values = raster.values.data() + size_t(row) * raster.columns;
+        for (int c = 0; c < raster.columns; ++c) {
+            int index = values[c] > 0.0f ? qBound(1, int(std::ceil(values[c] * scale)), 255) : 0;
+            line[c] = ramp[index];
+        }
+    }
+    return image;
+}
+
+QString Heatmap::kernelName(Kernel kernel)
+{
+    switch (kernel) {
+    case Quartic:
+        return "Quartic";
+    case Triangular:
+        return "Triangular";
+    case Uniform:
+        return "Uniform";
+    case Gaussian:
+        return "Gaussian";
+    }
+    return QString();
+}
@@ -0,0 +1,79 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <QImage>
+#include <QString>
+#include <vector>
+
+#include "featurestore.h"
+#include "geoprocessing.h"
+
+// Kernel density estimate of a point layer as a float raster.
+//
+// Points are binned into the raster cells and counting-sorted into row
+// bands. Every band is a tile that runs in parallel: it gathers the bins
+// within the kernel radius of its rows and spreads them into its own rows
+// of the output, so no two tiles write the same cell. The Gaussian kernel
+// is separable and runs as a horizontal and a vertical 1-D pass; the
+// radial kernels stamp a precomputed (2R+1)² mask per non-empty bin.
+// Kernels are normalised to sum to one, so a cell holds the expected
+// point weight in that cell and the raster sums to the total weight.
+class Heatmap
+{
+public:
+    enum Kernel {
+        Quartic,
+        Triangular,
+        Uniform,
+        Gaussian     // Truncated at the radius, which is three sigma
+    };
+
+    struct Options {
+        double cellSize = 0.0;
+        double radius = 0.0;
+        Kernel kernel = Quartic;
+        int weightField = -1;   // Numeric field to weight points by
+    };
+
+    // Row-major and north up: row 0 has its top edge at originY
+    struct Raster {
+        int columns = 0;
+        int rows = 0;
+        double originX = 0.0;
+        double originY = 0.0;
+        double cellSize = 0.0;
+        float maximum = 0.0f;
+        std::vector<float> values;
+
+        bool isNull() const { return values.empty(); }
+        float value(int column, int row) const { return values[size_t(row) * columns + column]; }
+    };
+
+    struct Statistics {
+        qint64 points = 0;
+        qint64 bins = 0;        // Non-empty cells after binning
+        int tiles = 0;
+        int threads = 0;
+        qint64 elapsedMs = 0;
+    };
+
+    // The raster covers the layer extent grown by the radius
+    static bool estimate(const FeatureStore &points, const Options &options, Raster &raster,
+                         Geoprocessing::Feedback *feedback = nullptr,
+                         Statistics *statistics = nullptr, QString *error = nullptr);
+
+    // Pseudocolor ramp: transparent at zero, blue through green and yellow to red at the maximum
+    static QImage render(const Raster &raster);
+
+    static QString kernelName(Kernel kernel);
+
+private:
+    struct Bin;
+    struct Chunk;
+    struct Tile;
+    struct Context;
+
+    static void spreadTile(const Context &context, Tile &tile);
+};
+
+#endif // HEATMAP_H
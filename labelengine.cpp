@@ -0,0 +1,390 @@
+#include "labelengine.h"
+
+#include <QElapsedTimer>
+#include <QFontMetricsF>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+// Screen size of one collision grid cell
+const double kCellSize = 64.0;
+// Gap between a point and its label, and around every label box
+const double kPointOffset = 5.0;
+const double kLabelPadding = 2.0;
+// Zoom levels kept in the cache
+const int kMaxCachedLevels = 8;
+
+inline qint64 cellKey(int column, int row)
+{
+    return (qint64(column) << 32) ^ quint32(row);
+}
+
+// Sparse uniform grid of placed label boxes
+class CollisionGrid
+{
+public:
+    bool collides(const QRectF &rect) const
+    {
+        int firstColumn, lastColumn, firstRow, lastRow;
+        cellRange(rect, firstColumn, lastColumn, firstRow, lastRow);
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            for (int row = firstRow; row <= lastRow; ++row) {
+                QHash<qint64, QVector<int> >::const_iterator cell = cells.constFind(cellKey(column, row));
+                if (cell == cells.constEnd()) continue;
+                for (int index : cell.value()) {
+                    if (boxes[index].intersects(rect)) return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void insert(const QRectF &rect)
+    {
+        int index = boxes.size();
+        boxes.append(rect);
+        int firstColumn, lastColumn, firstRow, lastRow;
+        cellRange(rect, firstColumn, lastColumn, firstRow, lastRow);
+        for (int column = firstColumn; column <= lastColumn; ++column) {
+            for (int row = firstRow; row <= lastRow; ++row) {
+                cells[cellKey(column, row)].append(index);
+            }
+        }
+    }
+
+private:
+    static void cellRange(const QRectF &rect, int &firstColumn, int &lastColumn,
+                          int &firstRow, int &lastRow)
+    {
+        firstColumn = int(std::floor(rect.left() / kCellSize));
+        lastColumn = int(std::floor(rect.right() / kCellSize));
+        firstRow = int(std::floor(rect.top() / kCellSize));
+        lastRow = int(std::floor(rect.bottom() / kCellSize));
+    }
+
+    QVector<QRectF> boxes;
+    QHash<qint64, QVector<int> > cells;
+};
+
+// Point halfway along a vertex run
+QPointF lineMidpoint(const double *xs, const double *ys, quint32 first, quint32 last, double &length)
+{
+    length = 0.0;
+    for (quint32 v = first + 1; v < last; ++v) {
+        length += std::hypot(xs[v] - xs[v - 1], ys[v] - ys[v - 1]);
+    }
+
+    double half = length / 2.0;
+    double walked = 0.0;
+    for (quint32 v = first + 1; v < last; ++v) {
+        double segment = std::hypot(xs[v] - xs[v - 1], ys[v] - ys[v - 1]);
+        if (walked + segment >= half && segment > 0.0) {
+            double t = (half - walked) / segment;
+            return QPointF(xs[v - 1] + t * (xs[v] - xs[v - 1]), ys[v - 1] + t * (ys[v] - ys[v - 1]));
+        }
+        walked += segment;
+    }
+    return QPointF(xs[first], ys[first]);
+}
+
+// Area centroid of a ring; falls back to the vertex average for degenerate rings
+QPointF ringCentroid(const double *xs, const double *ys, quint32 first, quint32 last, double &area)
+{
+    double cx = 0.0;
+    double cy = 0.0;
+    double doubleArea = 0.0;
+    // Relative to the first vertex to keep precision with large coordinates
+    double ox = xs[first];
+    double oy = ys[first];
+
+    for (quint32 v = first; v + 1 < last; ++v) {
+        double x0 = xs[v] - ox, y0 = ys[v] - oy;
+        double x1 = xs[v + 1] - ox, y1 = ys[v + 1] - oy;
+        double cross = x0 * y1 - x1 * y0;
+        doubleArea += cross;
+        cx += (x0 + x1) * cross;
+        cy += (y0 + y1) * cross;
+    }
+
+    area = std::fabs(doubleArea / 2.0);
+    if (std::fabs(doubleArea) < 1e-12) {
+        double sx = 0.0, sy = 0.0;
+        for (quint32 v = first; v < last; ++v) {
+            sx += xs[v];
+            sy += ys[v];
+        }
+        return QPointF(sx / (last - first), sy / (last - first));
+    }
+    return QPointF(ox + cx / (3.0 * doubleArea), oy + cy / (3.0 * doubleArea));
+}
+}
+
+LabelEngine::LabelEngine(const FeatureStorePtr &store, QObject *parent)
+    : QObject(parent)
+    , store(store)
+    , generation(0)
+    , runningGeneration(-1)
+    , runningKey(0)
+    , hasQueued(false)
+    , queuedKey(0)
+{
+    connect(&watcher, &QFutureWatcher<Result>::finished, this, &LabelEngine::onPlacementFinished);
+}
+
+LabelEngine::~LabelEngine()
+{
+    // A running job keeps its own references to the store; just wait for it
+    watcher.waitForFinished();
+}
+
+void LabelEngine::setSettings(const LabelSettings &settings)
+{
+    labelSettings = settings;
+    invalidate();
+}
+
+void LabelEngine::setStore(const FeatureStorePtr &featureStore)
+{
+    store = featureStore;
+    invalidate();
+}
+
+void LabelEngine::invalidate()
+{
+    ++generation;
+    anchors.clear();
+    cache.clear();
+    cacheOrder.clear();
+    lastPlacement.clear();
+    hasQueued = false;
+}
+
+QTransform LabelEngine::linearPart(const QTransform &mapToDevice)
+{
+    // Only the linear part matters; translation is just panning
+    return QTransform(mapToDevice.m11(), mapToDevice.m12(),
+                      mapToDevice.m21(), mapToDevice.m22(), 0.0, 0.0);
+}
+
+qint64 LabelEngine::zoomKey(const QTransform &mapToDevice)
+{
+    // Scale in 1/16 octave steps plus rotation in whole degrees
+    double scale = std::sqrt(std::fabs(mapToDevice.determinant()));
+    qint64 scaleStep = scale > 0.0 ? qRound64(std::log2(scale) * 16.0) : 0;
+    qint64 rotation = qRound64(std::atan2(mapToDevice.m12(), mapToDevice.m11()) * 180.0 / M_PI);
+    bool mirrored = mapToDevice.determinant() < 0.0;
+    return scaleStep * 4096 + (rotation + 360) * 2 + (mirrored ? 1 : 0);
+}
+
+LabelPlacementPtr LabelEngine::placement(const QTransform &mapToDevice)
+{
+    if (!labelSettings.enabled || labelSettings.field < 0 || !store) return LabelPlacementPtr();
+
+    QTransform mapToPixel = linearPart(mapToDevice);
+    qint64 key = zoomKey(mapToPixel);
+
+    LabelPlacementPtr cached = cache.value(key);
+    if (cached) {
+        lastPlacement = cached;
+        return cached;
+    }
+
+    if (watcher.isRunning()) {
+        if (runningKey != key || runningGeneration != generation) {
+            hasQueued = true;
+            queuedKey = key;
+            queuedTransform = mapToPixel;
+        }
+    } else {
+        startPlacement(key, mapToPixel);
+    }
+    return lastPlacement;
+}
+
+LabelEngine::Request LabelEngine::request() const
+{
+    Request result;
+    if (!labelSettings.enabled || labelSettings.field < 0 || !store) return result;
+
+    result.store = store;
+    result.settings = labelSettings;
+    result.anchors = anchors;
+    return result;
+}
+
+LabelPlacementPtr LabelEngine::placeRequest(const Request &request, const QTransform &mapToDevice)
+{
+    if (!request.store) return LabelPlacementPtr();
+    return place(request.store, request.settings, request.anchors, linearPart(mapToDevice)).placement;
+}
+
+void LabelEngine::startPlacement(qint64 key, const QTransform &mapToPixel)
+{
+    runningKey = key;
+    runningGeneration = generation;
+    hasQueued = false;
+    watcher.setFuture(QtConcurrent::run(&LabelEngine::place, store, labelSettings, anchors, mapToPixel));
+}
+
+void LabelEngine::onPlacementFinished()
+{
+    Result result = watcher.result();
+
+    // Results computed before an invalidate() are dropped
+    if (runningGeneration == generation && result.placement) {
+        anchors = result.anchors;
+        cache.insert(runningKey, result.placement);
+        cacheOrder.append(runningKey);
+        while (cacheOrder.size() > kMaxCachedLevels) {
+            cache.remove(cacheOrder.takeFirst());
+        }
+        lastPlacement = result.placement;
+    }
+
+    if (hasQueued) {
+        if (cache.contains(queuedKey)) {
+            hasQueued = false;
+        } else {
+            startPlacement(queuedKey, queuedTransform);
+        }
+    }
+    emit placementReady();
+}
+
+LabelEngine::AnchorsPtr LabelEngine::computeAnchors(const FeatureStorePtr &store,
+                                                    const LabelSettings &settings)
+{
+    QSharedPointer<Anchors> result(new Anchors());
+    qint64 count = store->featureCount();
+    const double *xs = store->xData();
+    const double *ys = store->yData();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    result->points.resize(int(count));
+    QVector<double> sizes(int(count), 0.0);
+
+    for (qint64 f = 0; f < count; ++f) {
+        QPointF anchor(nan, nan);
+        double bestSize = -1.0;
+
+        if (!store->isNull(settings.field, f)) {
+            for (quint32 part = store->partBegin(f); part < store->partEnd(f); ++part) {
+                quint32 ring = store->ringBegin(part);
+                if (ring == store->ringEnd(part)) continue;
+                quint32 first = store->vertexBegin(ring);
+                quint32 last = store->vertexEnd(ring);
+                if (last == first) continue;
+
+                double size = 0.0;
+                QPointF candidate;
+                switch (store->geometryKind(f)) {
+                case FeatureStore::LineGeometry:
+                    candidate = lineMidpoint(xs, ys, first, last, size);
+                    break;
+                case FeatureStore::PolygonGeometry:
+                    candidate = ringCentroid(xs, ys, first, last, size);
+                    break;
+                default:
+                    candidate = QPointF(xs[first], ys[first]);
+                    break;
+                }
+
+                // Longest line part, largest polygon part, first point
+                if (size > bestSize && std::isfinite(candidate.x()) && std::isfinite(candidate.y())) {
+                    bestSize = size;
+                    anchor = candidate;
+                }
+            }
+        }
+
+        result->points[int(f)] = anchor;
+        sizes[int(f)] = bestSize;
+        if (bestSize >= 0.0) result->order.append(f);
+    }
+
+    // Priority field first, then bigger features, then feature order
+    QVector<double> priorities;
+    if (settings.priorityField >= 0) {
+        priorities.resize(int(count));
+        for (qint64 f = 0; f < count; ++f) {
+            priorities[int(f)] = store->isNull(settings.priorityField, f)
+                    ? -std::numeric_limits<double>::max()
+                    : store->attribute(settings.priorityField, f).toDouble();
+        }
+    }
+
+    std::stable_sort(result->order.begin(), result->order.end(),
+                     [&sizes, &priorities](qint64 a, qint64 b) {
+        if (!priorities.isEmpty() && priorities[int(a)] != priorities[int(b)]) {
+            return priorities[int(a)] > priorities[int(b)];
+        }
+        return sizes[int(a)] > sizes[int(b)];
+    });
+
+    return result;
+}
+
+LabelEngine::Result LabelEngine::place(FeatureStorePtr store, LabelSettings settings,
+                                       AnchorsPtr anchors, QTransform mapToPixel)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    Result result;
+    result.anchors = anchors ? anchors : computeAnchors(store, settings);
+
+    QSharedPointer<LabelPlacement> placement(new LabelPlacement());
+    QFontMetricsF metrics(settings.font);
+    placement->ascent = metrics.ascent();
+    double height = metrics.height();
+
+    CollisionGrid grid;
+
+    for (qint64 f : result.anchors->order) {
+        QPointF anchor = result.anchors->points[int(f)];
+        QString text = store->attribute(settings.field, f).toString().trimmed();
+        if (text.isEmpty()) continue;
+
+        double width = metrics.boundingRect(text).width();
+        QPointF pixel = mapToPixel.map(anchor);
+
+        // Candidate boxes relative to the anchor, most preferred first
+        QVector<QRectF> candidates;
+        if (store->geometryKind(f) == FeatureStore::PointGeometry) {
+            double d = kPointOffset;
+            candidates << QRectF(d, -d - height, width, height)               // top right
+                       << QRectF(-d - width, -d - height, width, height)      // top left
+                       << QRectF(d, d, width, height)                         // bottom right
+                       << QRectF(-d - width, d, width, height)                // bottom left
+                       << QRectF(d, -height / 2, width, height)               // right
+                       << QRectF(-d - width, -height / 2, width, height)      // left
+                       << QRectF(-width / 2, -d - height, width, height)      // above
+                       << QRectF(-width / 2, d, width, height);               // below
+        } else {
+            candidates << QRectF(-width / 2, -height / 2, width, height)
+                       << QRectF(-width / 2, -height * 1.5, width, height)
+                       << QRectF(-width / 2, height / 2, width, height);
+        }
+
+        for (const QRectF &candidate : candidates) {
+            placement->candidates++;
+            QRectF box = candidate.translated(pixel)
+                    .adjusted(-kLabelPadding, -kLabelPadding, kLabelPadding, kLabelPadding);
+            if (grid.collides(box)) continue;
+
+            grid.insert(box);
+            PlacedLabel label;
+            label.anchor = anchor;
+            label.rect = candidate;
+            label.text = text;
+            placement->labels.append(label);
+            break;
+        }
+    }
+
+    placement->elapsedMs = timer.elapsed();
+    result.placement = placement;
+    return result;
+}
@@ -0,0 +1,137 @@
+#ifndef LABELENGINE_H
+#define LABELENGINE_H
+
+#include <QObject>
+#include <QColor>
+#include <QFont>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QList>
+#include <QPointF>
+#include <QRectF>
+#include <QSharedPointer>
+#include <QTransform>
+#include <QVector>
+
+#include "featurestore.h"
+
+struct LabelSettings {
+    bool enabled = false;
+    int field = -1;          // Attribute holding the label text
+    int priorityField = -1;  // Optional numeric field, higher values placed first
+    QFont font;
+    QColor color = Qt::black;
+    bool buffer = true;      // Halo around the text
+    QColor bufferColor = Qt::white;
+};
+
+struct PlacedLabel {
+    QPointF anchor;   // Map units
+    QRectF rect;      // Text box in pixels, relative to the anchor
+    QString text;
+};
+
+struct LabelPlacement {
+    QVector<PlacedLabel> labels;
+    double ascent = 0.0;
+    qint64 candidates = 0;
+    qint64 elapsedMs = 0;
+};
+
+typedef QSharedPointer<const LabelPlacement> LabelPlacementPtr;
+
+// Places the labels of one layer.
+//
+// Each feature gets an anchor (the point, the middle of its longest line
+// part, the centroid of its largest polygon part) and a list of candidate
+// boxes around it. Features are visited in priority order and the first
+// candidate that does not overlap an already placed label wins. Overlaps
+// are found through a sparse uniform grid of screen cells, so every test
+// only looks at labels in the few cells the box covers.
+//
+// Placement depends on scale and rotation only, not on the visible area,
+// so it is done for the whole layer on the thread pool and cached per
+// zoom level: panning reuses the cached result.
+class LabelEngine : public QObject
+{
+    Q_OBJECT
+
+    struct Anchors;
+    typedef QSharedPointer<const Anchors> AnchorsPtr;
+
+public:
+    // Everything a placement reads besides the transform
+    struct Request {
+        FeatureStorePtr store;
+        LabelSettings settings;
+        AnchorsPtr anchors;        // Computed by the placement when null
+    };
+
+    explicit LabelEngine(const FeatureStorePtr &store, QObject *parent = nullptr);
+    ~LabelEngine();
+
+    const LabelSettings &settings() const { return labelSettings; }
+    void setSettings(const LabelSettings &settings);
+
+    // Places the labels of another store from now on, e.g. a reprojected
+    // copy; a running placement keeps the old one and its result is dropped
+    void setStore(const FeatureStorePtr &featureStore);
+
+    // Drops all cached placements
+    void invalidate();
+
+    // Placement for the linear part of a map-to-device transform. Returns the
+    // cached result, or the last available one while the new level is
+    // computed in the background (placementReady() fires when done).
+    LabelPlacementPtr placement(const QTransform &mapToDevice);
+
+    // Inputs of a placement, taken on the GUI thread; placeRequest() then
+    // places the labels for exactly one transform on any thread. Exports
+    // use these so their labels never depend on what the views happened
+    // to have placed, and they start no background work that would
+    // repaint the layer. Null store when there is nothing to label.
+    Request request() const;
+    static LabelPlacementPtr placeRequest(const Request &request, const QTransform &mapToDevice);
+
+signals:
+    void placementReady();
+
+private slots:
+    void onPlacementFinished();
+
+private:
+    struct Anchors {
+        QVector<QPointF> points;   // Per feature, NaN when it has no label position
+        QVector<qint64> order;     // Features in placement order
+    };
+
+    struct Result {
+        LabelPlacementPtr placement;
+        AnchorsPtr anchors;
+    };
+
+    static qint64 zoomKey(const QTransform &mapToDevice);
+    static QTransform linearPart(const QTransform &mapToDevice);
+    static AnchorsPtr computeAnchors(const FeatureStorePtr &store, const LabelSettings &settings);
+    static Result place(FeatureStorePtr store, LabelSettings settings, AnchorsPtr anchors,
+                        QTransform mapToPixel);
+    void startPlacement(qint64 key, const QTransform &mapToPixel);
+
+    FeatureStorePtr store;
+    LabelSettings labelSettings;
+    AnchorsPtr anchors;
+
+    QHash<qint64, LabelPlacementPtr> cache;
+    QList<qint64> cacheOrder;
+    LabelPlacementPtr lastPlacement;
+
+    QFutureWatcher<Result> watcher;
+    int generation;
+    int runningGeneration;
+    qint64 runningKey;
+    bool hasQueued;
+    qint64 queuedKey;
+    QTransform queuedTransform;
+};
+
+#endif // LABELENGINE_H
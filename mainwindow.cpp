@@ -45,6 +45,37 @@
 #include <QTextStream>
 #include <QCloseEvent>
 #include <QFileDialog>
+#include <QElapsedTimer>
+#include <QTableView>
+#include <QSortFilterProxyModel>
+#include <QLocale>
+#include <QToolTip>
+#include <QFontComboBox>
+#include <QColorDialog>
+#include <QDoubleSpinBox>
+#include <QEventLoop>
+#include <QFutureWatcher>
+#include <QProgressDialog>
+#include <QSet>
+#include <QtConcurrent/QtConcurrentRun>
+#include <algorithm>
+
+#include "attributetablemodel.h"
+#include "coordinatetransformer.h"
+#include "featureloader.h"
+#include "geometrychecker.h"
+#include "geoprocessing.h"
+#include "geosutils.h"
+#include "heatmap.h"
+#include "mapcanvas.h"
+#include "mapexporter.h"
+#include "memoryfile.h"
+#include "pointgenerator.h"
+#include "printlayout.h"
+#include "renderdiagnostics.h"
+#include "spatialjoin.h"
+#include "vectorlayeritem.h"
+#include "vectorwriter.h"
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -220,6 +251,9 @@ MainWindow::MainWindow(QWidget *parent)
 }
 MainWindow::~MainWindow()
 {
+    delete layoutFrameCache;
+    layoutFrameCache = nullptr;
+
     // Clean up GDAL dataset
     if (gdalDataset) {
         GDALClose(gdalDataset);
@@ -362,6 +396,10 @@ void MainWindow::setupUI()
     if (processingToolboxDock) addDockWidget(Qt::RightDockWidgetArea, processingToolboxDock);
     if (layerStylingDock) addDockWidget(Qt::RightDockWidgetArea, layerStylingDock);
     if (imagePropertiesDock) addDockWidget(Qt::RightDockWidgetArea, imagePropertiesDock);
+    if (diagnosticsDock) {
+        addDockWidget(Qt::RightDockWidgetArea, diagnosticsDock);
+        diagnosticsDock->hide();
+    }
 
     // Tabify dock widgets
     if (browserDock && layersDock) {
@@ -403,7 +441,7 @@ void MainWindow::setupMenuBar()
 
     QMenu *importExportMenu = projectMenu->addMenu(QIcon(":/icons/load_image.png"), "Import/Export");
     importExportMenu->addAction(QIcon(":/icons/load_image.png"), "Import Image...", this, &MainWindow::onLoadImage, QKeySequence("Ctrl+I"));
-    importExportMenu->addAction(QIcon(":/icons/export.png"), "Export Map...", this, [](){ /* Export map */ });
+    importExportMenu->addAction(QIcon(":/icons/export.png"), "Export Map...", this, &MainWindow::onExportMap);
 
     saveAllLayersAction = projectMenu->addAction(QIcon(":/icons/save_edit.png"), "Save All Layers...", this, &MainWindow::onSaveAllLayers, QKeySequence("Ctrl+Shift+S"));
 
@@ -443,10 +481,29 @@ void MainWindow::setupMenuBar()
     QAction *findAction = editMenu->addAction(QIcon(":/icons/find.png"),"Find");
     findAction->setShortcut(QKeySequence::Find);
 
+    editMenu->addSeparator();
+
+    // Selection tools: Shift adds to the selection, Ctrl removes from it
+    QMenu *selectMenu = editMenu->addMenu("&Select");
+    selectRectangleAction = selectMenu->addAction("Select Features by Rectangle");
+    selectRectangleAction->setCheckable(true);
+    selectPolygonAction = selectMenu->addAction("Select Features by Polygon");
+    selectPolygonAction->setCheckable(true);
+    selectRadiusAction = selectMenu->addAction("Select Features by Radius");
+    selectRadiusAction->setCheckable(true);
+    selectMenu->addSeparator();
+    deselectAllAction = selectMenu->addAction("Deselect Features from All Layers", this, &MainWindow::onDeselectAll);
+    deselectAllAction->setShortcut(QKeySequence("Ctrl+Shift+A"));
+
+    connect(selectRectangleAction, &QAction::toggled, this, &MainWindow::onSelectionToolToggled);
+    connect(selectPolygonAction, &QAction::toggled, this, &MainWindow::onSelectionToolToggled);
+    connect(selectRadiusAction, &QAction::toggled, this, &MainWindow::onSelectionToolToggled);
+
     // View Menu
     QMenu *viewMenu = menuBar->addMenu("&View");
     newMapViewAction = viewMenu->addAction(QIcon(":/icons/new_map_view.png"), "New &Map View");
     newMapViewAction->setShortcut(QKeySequence("Ctrl+M"));
+    connect(newMapViewAction, &QAction::triggered, this, &MainWindow::onNewMapView);
 
     viewMenu->addAction(QIcon(":/icons/3d-map.png"), "3D Map Views");
     viewMenu->addSeparator();
@@ -474,6 +531,13 @@ void MainWindow::setupMenuBar()
 
     identifyAction = viewMenu->addAction(QIcon(":/icons/identity.png"), "Identify Features");
     identifyAction->setShortcut(QKeySequence("Ctrl+Shift+I"));
+    identifyAction->setCheckable(true);
+    connect(identifyAction, &QAction::toggled, this, [this](bool checked) {
+        if (!checked) return;
+        selectRectangleAction->setChecked(false);
+        selectPolygonAction->setChecked(false);
+        selectRadiusAction->setChecked(false);
+    });
 
     measureAction = viewMenu->addAction(QIcon(":/icons/Measure.png"), "Measure");
 
@@ -490,7 +554,7 @@ void MainWindow::setupMenuBar()
     QAction *zoomFullAction = viewMenu->addAction(QIcon(":/icons/zoom_full.png"), "Zoom Full");
     zoomFullAction->setShortcut(QKeySequence("Ctrl+Shift+F"));
 
-    QAction *zoomToSelectionAction = viewMenu->addAction(QIcon(":/icons/zoom_to_selection.png"), "Zoom to Selection");
+    QAction *zoomToSelectionAction = viewMenu->addAction(QIcon(":/icons/zoom_to_selection.png"), "Zoom to Selection", this, &MainWindow::onZoomToSelection);
     zoomToSelectionAction->setShortcut(QKeySequence("Ctrl+I"));
 
     QAction *zoomToLayerAction = viewMenu->addAction(QIcon(":/icons/zoom_to_layer.png"), "Zoom to Layer(s)");
@@ -498,6 +562,9 @@ void MainWindow::setupMenuBar()
 
     QAction *refreshAction = viewMenu->addAction(QIcon(":/icons/refresh.png"), "Refresh");
     refreshAction->setShortcut(QKeySequence("F5"));
+    viewMenu->addAction("Render Statistics...", this, &MainWindow::onShowRenderStatistics);
+    renderDiagnosticsAction = viewMenu->addAction("Render Diagnostics");
+    renderDiagnosticsAction->setCheckable(true);
 
     // Layer Menu
     QMenu *layerMenu = menuBar->addMenu("Layer");
@@ -529,10 +596,11 @@ void MainWindow::setupMenuBar()
 
     saveLayerAction = layerMenu->addAction(QIcon(":/icons/save.png"), "&Save Layer", this, &MainWindow::onSaveLayer, QKeySequence::Save);
     saveLayerAsAction = layerMenu->addAction(QIcon(":/icons/saveAs.png"), "Save Layer &As...", this, &MainWindow::onSaveLayerAs, QKeySequence::SaveAs);
+    layerMenu->addAction(QIcon(":/icons/export.png"), "Export Vector As...", this, &MainWindow::onExportVectorAs);
 
     layerMenu->addSeparator();
 
-    openAttributeTableAction = layerMenu->addAction("Open Attribute Table");
+    openAttributeTableAction = layerMenu->addAction("Open Attribute Table", this, &MainWindow::onOpenAttributeTable);
     openAttributeTableAction->setShortcut(QKeySequence("F6"));
 
     layerMenu->addAction("Filter Attribute Table");
@@ -541,7 +609,7 @@ void MainWindow::setupMenuBar()
     layerPropertiesAction = layerMenu->addAction(QIcon(":/icons/properties.png"), "Layer Properties...", this, &MainWindow::onShowLayerProperties);
     layerMenu->addAction("Filter...");
     layerStylingAction = layerMenu->addAction(QIcon(":/icons/layer_styling.png"), "Styling");
-    labelAction = layerMenu->addAction(QIcon(":/icons/label_settings.png"), "Labeling");
+    labelAction = layerMenu->addAction(QIcon(":/icons/label_settings.png"), "Labeling", this, &MainWindow::onLayerLabeling);
 
     layerMenu->addSeparator();
 
@@ -606,6 +674,7 @@ void MainWindow::setupMenuBar()
 
     processingMenu->addAction(QIcon(":/icons/processing.png"), "Graphical Modeler...");
     processingMenu->addAction(QIcon(":/icons/recent.png"), "History...");
+    processingMenu->addAction(QIcon(":/icons/vector.png"), "Benchmark Vector Loading...", this, &MainWindow::onBenchmarkVectorLoading);
     processingMenu->addAction(QIcon(":/icons/identity.png"), "Results Viewer...");
 
     // Help Menu
@@ -717,11 +786,15 @@ void MainWindow::setupToolBars()
 
     QAction *zoomFullActionTB = mapNavToolBar->addAction(QIcon(":/icons/zoom_full.png"), "Zoom Full");
     QAction *zoomToLayerActionTB = mapNavToolBar->addAction(QIcon(":/icons/zoom_to_layer.png"), "Zoom to Layer");
-    QAction *zoomToSelectionActionTB = mapNavToolBar->addAction(QIcon(":/icons/zoom_to_selection.png"), "Zoom to Selection");
+    QAction *zoomToSelectionActionTB = mapNavToolBar->addAction(QIcon(":/icons/zoom_to_selection.png"), "Zoom to Selection", this, &MainWindow::onZoomToSelection);
 
     mapNavToolBar->addSeparator();
 
-    QAction *identifyActionTB = mapNavToolBar->addAction(QIcon(":/icons/identity.png"), "Identify");
+    mapNavToolBar->addAction(identifyAction);
+    mapNavToolBar->addAction(selectRectangleAction);
+    mapNavToolBar->addAction(selectPolygonAction);
+    mapNavToolBar->addAction(selectRadiusAction);
+    mapNavToolBar->addAction(deselectAllAction);
     QAction *measureActionTB = mapNavToolBar->addAction(QIcon(":/icons/Measure.png"), "Measure");
     QAction *bookmarkActionTB = mapNavToolBar->addAction(QIcon(":/icons/bookmark.png"), "Bookmark", this, &MainWindow::onShowBookmarks);
 
@@ -770,13 +843,13 @@ void MainWindow::setupToolBars()
 
     attributesToolBar->addSeparator();
 
-    QAction *openAttrTableAction = attributesToolBar->addAction(QIcon(":/icons/attribute.png"),"Attribute Table");
+    QAction *openAttrTableAction = attributesToolBar->addAction(QIcon(":/icons/attribute.png"),"Attribute Table", this, &MainWindow::onOpenAttributeTable);
 
     // Label Toolbar
     labelToolBar = new QToolBar("Label", this);
     labelToolBar->setIconSize(QSize(24, 24));
 
-    QAction *labelSettingsAction = labelToolBar->addAction(QIcon(":/icons/Label_settings.png"), "Label Settings");
+    QAction *labelSettingsAction = labelToolBar->addAction(QIcon(":/icons/Label_settings.png"), "Label Settings", this, &MainWindow::onLayerLabeling);
 
     QComboBox *labelFontCombo = new QComboBox();
     labelFontCombo->addItems({"Arial", "Times New Roman", "Verdana", "Courier New"});
@@ -1015,11 +1088,15 @@ void MainWindow::setupDockWidgets()
     new QTreeWidgetItem(geoProcessing, QStringList() << "Buffer");
     new QTreeWidgetItem(geoProcessing, QStringList() << "Clip");
     new QTreeWidgetItem(geoProcessing, QStringList() << "Intersection");
+    new QTreeWidgetItem(geoProcessing, QStringList() << "Dissolve");
+    new QTreeWidgetItem(geoProcessing, QStringList() << "Check & Fix Geometries");
 
     QTreeWidgetItem *analysis = new QTreeWidgetItem(processingTree, QStringList() << "Analysis");
     analysis->setIcon(0, QIcon(":/icons/processing.png"));
     new QTreeWidgetItem(analysis, QStringList() << "Line Intersections");
     new QTreeWidgetItem(analysis, QStringList() << "Sum Line Lengths");
+    new QTreeWidgetItem(analysis, QStringList() << "Spatial Join");
+    new QTreeWidgetItem(analysis, QStringList() << "Heatmap (Kernel Density)");
 
     QTreeWidgetItem *research = new QTreeWidgetItem(processingTree, QStringList() << "Research");
     research->setIcon(0, QIcon(":/icons/processing.png"));
@@ -1028,6 +1105,7 @@ void MainWindow::setupDockWidgets()
 
     processingTree->expandAll();
     processingLayout->addWidget(processingTree);
+    connect(processingTree, &QTreeWidget::itemDoubleClicked, this, &MainWindow::onProcessingAlgorithm);
 
     processingToolboxDock->setWidget(processingWidget);
 
@@ -1040,13 +1118,9 @@ void MainWindow::setupDockWidgets()
     QVBoxLayout *stylingLayout = new QVBoxLayout(stylingWidget);
     stylingLayout->setContentsMargins(5, 5, 5, 5);
 
-    QComboBox *layerCombo = new QComboBox();
-    layerCombo->addItems({"Roads", "Buildings", "Parcels", "DEM"});
-    layerCombo->setItemIcon(0, QIcon(":/icons/arrow.png"));
-    layerCombo->setItemIcon(1, QIcon(":/icons/add_feature.png"));
-    layerCombo->setItemIcon(2, QIcon(":/icons/move_feature.png"));
-    layerCombo->setItemIcon(3, QIcon(":/icons/raster_layer.png"));
-    stylingLayout->addWidget(layerCombo);
+    // Vector layers that can be styled, refreshed as layers come and go
+    stylingLayerCombo = new QComboBox();
+    stylingLayout->addWidget(stylingLayerCombo);
 
     QTabWidget *stylingTabs = new QTabWidget();
     stylingTabs->setIconSize(QSize(16, 16));
@@ -1055,6 +1129,55 @@ void MainWindow::setupDockWidgets()
     QWidget *labelsTab = new QWidget();
     QWidget *masksTab = new QWidget();
 
+    // Symbology: renderer type, classification field and the class list
+    QFormLayout *symbologyLayout = new QFormLayout(symbologyTab);
+    rendererTypeCombo = new QComboBox();
+    rendererTypeCombo->addItem("Single Symbol", FeatureRenderer::SingleSymbol);
+    rendererTypeCombo->addItem("Categorized", FeatureRenderer::CategorizedSymbol);
+    rendererTypeCombo->addItem("Graduated", FeatureRenderer::GraduatedSymbol);
+    rendererFieldCombo = new QComboBox();
+    rendererModeCombo = new QComboBox();
+    rendererModeCombo->addItem("Equal Interval", FeatureRenderer::EqualInterval);
+    rendererModeCombo->addItem("Quantile (Equal Count)", FeatureRenderer::Quantile);
+    rendererClassesSpin = new QSpinBox();
+    rendererClassesSpin->setRange(2, 32);
+    rendererClassesSpin->setValue(5);
+    QPushButton *classifyButton = new QPushButton("Classify");
+    rendererClassesTree = new QTreeWidget();
+    rendererClassesTree->setHeaderLabels(QStringList() << "Symbol" << "Value" << "Count");
+    rendererClassesTree->setRootIsDecorated(false);
+    rendererClassesTree->setToolTip("Double-click a class to change its colour");
+    clusterPointsCheck = new QCheckBox("Cluster points when zoomed out");
+    clusterPointsCheck->setToolTip("Draw dense point layers as clusters with counts");
+
+    symbologyLayout->addRow("Renderer:", rendererTypeCombo);
+    symbologyLayout->addRow("Field:", rendererFieldCombo);
+    symbologyLayout->addRow("Mode:", rendererModeCombo);
+    symbologyLayout->addRow("Classes:", rendererClassesSpin);
+    symbologyLayout->addRow(classifyButton);
+    symbologyLayout->addRow(rendererClassesTree);
+    symbologyLayout->addRow(clusterPointsCheck);
+
+    connect(stylingLayerCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::onStylingLayerChanged);
+    connect(rendererTypeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this]() {
+        bool graduated = rendererTypeCombo->currentData().toInt() == FeatureRenderer::GraduatedSymbol;
+        rendererModeCombo->setEnabled(graduated);
+        rendererClassesSpin->setEnabled(graduated);
+        rendererFieldCombo->setEnabled(rendererTypeCombo->currentIndex() != 0);
+    });
+    connect(classifyButton, &QPushButton::clicked, this, &MainWindow::onApplyRenderer);
+    connect(clusterPointsCheck, &QCheckBox::toggled, this, [this](bool checked) {
+        LayerInfo *layer = stylingLayer();
+        if (!layer) return;
+        qgraphicsitem_cast<VectorLayerItem*>(layer->graphicsItem)->setClustering(checked);
+    });
+    connect(rendererClassesTree, &QTreeWidget::itemDoubleClicked,
+            this, &MainWindow::onRendererClassDoubleClicked);
+    rendererModeCombo->setEnabled(false);
+    rendererClassesSpin->setEnabled(false);
+    rendererFieldCombo->setEnabled(false);
+
     stylingTabs->addTab(symbologyTab, QIcon(":/icons/layer_styling.png"), "Symbology");
     stylingTabs->addTab(labelsTab, QIcon(":/icons/label_settings.png"), "Labels");
     stylingTabs->addTab(masksTab, QIcon(":/icons/layer_styling.png"), "Masks");
@@ -1138,6 +1261,171 @@ void MainWindow::setupDockWidgets()
     imagePropsLayout->addStretch();
 
     imagePropertiesDock->setWidget(imagePropsWidget);
+
+    setupDiagnosticsDock();
+}
+
+void MainWindow::setupDiagnosticsDock()
+{
+    renderDiagnostics = new RenderDiagnostics(this);
+    VectorLayerItem::setDiagnostics(renderDiagnostics);
+
+    diagnosticsDock = new QDockWidget("Render Diagnostics", this);
+    diagnosticsDock->setObjectName("RenderDiagnostics");
+    diagnosticsDock->setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea |
+                                     Qt::BottomDockWidgetArea);
+
+    QWidget *diagnosticsWidget = new QWidget();
+    QVBoxLayout *diagnosticsLayout = new QVBoxLayout(diagnosticsWidget);
+    diagnosticsLayout->setContentsMargins(5, 5, 5, 5);
+
+    diagnosticsOverlayCheck = new QCheckBox("Show overlay on the map");
+    diagnosticsLayout->addWidget(diagnosticsOverlayCheck);
+
+    diagnosticsSummaryLabel = new QLabel("No frames recorded");
+    diagnosticsSummaryLabel->setWordWrap(true);
+    diagnosticsSummaryLabel->setStyleSheet("padding: 6px; background-color: #f0f0f0; border-radius: 5px;");
+    diagnosticsLayout->addWidget(diagnosticsSummaryLabel);
+
+    // Layers of the last frame
+    diagnosticsLayerTable = new QTableWidget(0, 6);
+    diagnosticsLayerTable->setHorizontalHeaderLabels(QStringList() << "Layer" << "Paint (ms)" << "Render (ms)"
+                                                     << "Drawn" << "Culled" << "Cache");
+    diagnosticsLayerTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    diagnosticsLayerTable->verticalHeader()->setVisible(false);
+    diagnosticsLayerTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    diagnosticsLayout->addWidget(diagnosticsLayerTable);
+
+    QHBoxLayout *buttonsLayout = new QHBoxLayout();
+    QPushButton *clearButton = new QPushButton("Clear");
+    QPushButton *exportButton = new QPushButton("Export CSV...");
+    buttonsLayout->addWidget(clearButton);
+    buttonsLayout->addWidget(exportButton);
+    buttonsLayout->addStretch();
+    diagnosticsLayout->addLayout(buttonsLayout);
+
+    diagnosticsDock->setWidget(diagnosticsWidget);
+
+    // The dock refreshes a few times per second, not once per frame
+    diagnosticsRefreshTimer = new QTimer(this);
+    diagnosticsRefreshTimer->setSingleShot(true);
+    diagnosticsRefreshTimer->setInterval(250);
+    connect(diagnosticsRefreshTimer, &QTimer::timeout, this, &MainWindow::refreshDiagnostics);
+    connect(renderDiagnostics, &RenderDiagnostics::frameRecorded, this, [this]() {
+        if (!diagnosticsRefreshTimer->isActive()) diagnosticsRefreshTimer->start();
+    });
+
+    connect(clearButton, &QPushButton::clicked, this, [this]() {
+        renderDiagnostics->clear();
+        refreshDiagnostics();
+    });
+    connect(exportButton, &QPushButton::clicked, this, &MainWindow::onExportDiagnosticsCsv);
+    connect(diagnosticsOverlayCheck, &QCheckBox::toggled, this, [this](bool checked) {
+        MapCanvas *canvas = qobject_cast<MapCanvas*>(mapView);
+        if (canvas) canvas->setOverlayVisible(checked);
+        updateDiagnosticsRecording();
+    });
+
+    if (renderDiagnosticsAction) {
+        connect(renderDiagnosticsAction, &QAction::toggled, diagnosticsDock, &QDockWidget::setVisible);
+        connect(diagnosticsDock->toggleViewAction(), &QAction::toggled,
+                renderDiagnosticsAction, &QAction::setChecked);
+    }
+    connect(diagnosticsDock->toggleViewAction(), &QAction::toggled, this, [this]() {
+        updateDiagnosticsRecording();
+    });
+}
+
+void MainWindow::updateDiagnosticsRecording()
+{
+    // Frames are only timed while someone looks at them
+    bool record = (diagnosticsDock && diagnosticsDock->isVisible()) ||
+            (diagnosticsOverlayCheck && diagnosticsOverlayCheck->isChecked());
+    if (record == renderDiagnostics->isEnabled()) return;
+
+    renderDiagnostics->setEnabled(record);
+    if (record && mapView) mapView->viewport()->update();
+}
+
+void MainWindow::refreshDiagnostics()
+{
+    if (!renderDiagnostics || !diagnosticsSummaryLabel) return;
+
+    const QVector<RenderDiagnostics::Frame> &frames = renderDiagnostics->history();
+    if (frames.isEmpty()) {
+        diagnosticsSummaryLabel->setText("No frames recorded");
+        diagnosticsLayerTable->setRowCount(0);
+        return;
+    }
+
+    // Mean and 95th percentile over the history
+    QVector<double> times;
+    times.reserve(frames.size());
+    double sum = 0.0;
+    for (const RenderDiagnostics::Frame &frame : frames) {
+        times.append(frame.totalMs);
+        sum += frame.totalMs;
+    }
+    std::sort(times.begin(), times.end());
+    double p95 = times[qMin(times.size() - 1, int(times.size() * 0.95))];
+
+    const RenderDiagnostics::Frame &last = frames.last();
+    VectorLayerItem::RenderCounters counters = VectorLayerItem::renderCounters();
+    diagnosticsSummaryLabel->setText(
+                QString("Last frame %1: %2 ms\n"
+                        "Cache: %3 hit, %4 miss\n"
+                        "Features: %5 drawn, %6 culled\n"
+                        "Coordinates: %7 ms (transform %8 ms)\n"
+                        "History (%9 frames): mean %10 ms, 95%: %11 ms\n"
+                        "Renders: %12 completed, %13 canceled")
+                .arg(last.number)
+                .arg(last.totalMs, 0, 'f', 2)
+                .arg(last.cacheHits)
+                .arg(last.cacheMisses)
+                .arg(last.drawn)
+                .arg(last.culled)
+                .arg(last.coordinateUpdateMs, 0, 'f', 2)
+                .arg(last.geographicTransformMs, 0, 'f', 2)
+                .arg(frames.size())
+                .arg(sum / frames.size(), 0, 'f', 2)
+                .arg(p95, 0, 'f', 2)
+                .arg(counters.completed)
+                .arg(counters.canceled));
+
+    diagnosticsLayerTable->setRowCount(last.layers.size());
+    for (int row = 0; row < last.layers.size(); ++row) {
+        const RenderDiagnostics::LayerSample &sample = last.layers[row];
+        diagnosticsLayerTable->setItem(row, 0, new QTableWidgetItem(sample.layer));
+        diagnosticsLayerTable->setItem(row, 1, new QTableWidgetItem(QString::number(sample.paintMs, 'f', 2)));
+        diagnosticsLayerTable->setItem(row, 2, new QTableWidgetItem(QString::number(sample.renderMs, 'f', 2)));
+        diagnosticsLayerTable->setItem(row, 3, new QTableWidgetItem(QString::number(sample.drawn)));
+        diagnosticsLayerTable->setItem(row, 4, new QTableWidgetItem(QString::number(sample.culled)));
+        diagnosticsLayerTable->setItem(row, 5, new QTableWidgetItem(sample.cacheHit ? "hit" : "miss"));
+    }
+}
+
+void MainWindow::onExportDiagnosticsCsv()
+{
+    if (!renderDiagnostics || renderDiagnostics->history().isEmpty()) {
+        QMessageBox::information(this, "Render Diagnostics", "No frames recorded yet.");
+        return;
+    }
+
+    QString filePath = QFileDialog::getSaveFileName(this, "Export Render Diagnostics",
+                                                    QDir::homePath() + "/render_diagnostics.csv",
+                                                    "CSV Files (*.csv)");
+    if (filePath.isEmpty()) return;
+
+    QString error;
+    if (!renderDiagnostics->exportCsv(filePath, &error)) {
+        QMessageBox::warning(this, "Render Diagnostics", error);
+        return;
+    }
+    if (messageLabel) {
+        messageLabel->setText(QString("Exported %1 frames to %2")
+                              .arg(renderDiagnostics->history().size())
+                              .arg(filePath));
+    }
 }
 
 void MainWindow::setupCentralWidget()
@@ -1155,13 +1443,7 @@ void MainWindow::setupCentralWidget()
 
     // Create main map view
     mapScene = new QGraphicsScene(this);
-    mapView = new QGraphicsView(mapScene);
-    mapView->setRenderHint(QPainter::Antialiasing, true);
-    mapView->setDragMode(QGraphicsView::ScrollHandDrag);
-    mapView->setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
-    mapView->setBackgroundBrush(QBrush(QColor(240, 240, 240)));
-    mapView->setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
-    mapView->setResizeAnchor(QGraphicsView::AnchorUnderMouse);
+    mapView = createMapCanvas();
     mapView->setContextMenuPolicy(Qt::CustomContextMenu);
 
     mapViewsTabWidget->addTab(mapView, "Map");
@@ -1170,6 +1452,99 @@ void MainWindow::setupCentralWidget()
     setCentralWidget(centralWidget);
 }
 
+MapCanvas *MainWindow::createMapCanvas()
+{
+    MapCanvas *canvas = new MapCanvas(mapScene);
+    canvas->setDiagnostics(renderDiagnostics);
+    canvas->setRenderHint(QPainter::Antialiasing, true);
+    canvas->setDragMode(QGraphicsView::ScrollHandDrag);
+    canvas->setViewportUpdateMode(QGraphicsView::FullViewportUpdate);
+    canvas->setBackgroundBrush(QBrush(QColor(240, 240, 240)));
+    canvas->setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
+    canvas->setResizeAnchor(QGraphicsView::AnchorUnderMouse);
+
+    mapCanvases.append(canvas);
+    connect(canvas, &MapCanvas::extentChanged, this, [this, canvas]() {
+        synchronizeMapViews(canvas);
+    });
+    return canvas;
+}
+
+void MainWindow::onNewMapView()
+{
+    if (!mapScene || !mapView) return;
+
+    // Another view of the same scene: layers, stores, indexes and raster
+    // images are shared, only the per-view render caches are added
+    MapCanvas *canvas = createMapCanvas();
+    canvas->setWheelZoom(true);
+
+    QString title = QString("Map %1").arg(++mapViewCount);
+    QDockWidget *dock = new QDockWidget(title, this);
+    dock->setObjectName(title);
+    dock->setAttribute(Qt::WA_DeleteOnClose);
+
+    QWidget *viewWidget = new QWidget();
+    QVBoxLayout *viewLayout = new QVBoxLayout(viewWidget);
+    viewLayout->setContentsMargins(0, 0, 0, 0);
+    viewLayout->setSpacing(0);
+
+    QToolBar *viewToolBar = new QToolBar();
+    viewToolBar->setIconSize(QSize(16, 16));
+    QAction *syncAction = viewToolBar->addAction(QIcon(":/icons/pan.png"), "Synchronize Extent");
+    syncAction->setCheckable(true);
+    syncAction->setToolTip("Follow the main map view and move it along");
+    QAction *mainExtentAction = viewToolBar->addAction(QIcon(":/icons/zoom_to_layer.png"), "Zoom to Main View");
+    QAction *fullExtentAction = viewToolBar->addAction(QIcon(":/icons/zoom_full.png"), "Zoom Full");
+    viewLayout->addWidget(viewToolBar);
+    viewLayout->addWidget(canvas);
+    dock->setWidget(viewWidget);
+
+    connect(syncAction, &QAction::toggled, this, [this, canvas](bool checked) {
+        canvas->setExtentSync(checked);
+        if (checked) canvas->setView(mapView->transform(), qobject_cast<MapCanvas*>(mapView)->viewCenter());
+    });
+    connect(mainExtentAction, &QAction::triggered, this, [this, canvas]() {
+        canvas->setView(mapView->transform(), qobject_cast<MapCanvas*>(mapView)->viewCenter());
+        synchronizeMapViews(canvas);
+    });
+    connect(fullExtentAction, &QAction::triggered, this, [this, canvas]() {
+        QRectF bounds = layersSceneBounds();
+        if (bounds.isEmpty()) bounds = mapScene->itemsBoundingRect();
+        if (!bounds.isEmpty()) canvas->fitInView(bounds, Qt::KeepAspectRatio);
+    });
+
+    addDockWidget(Qt::RightDockWidgetArea, dock);
+    dock->show();
+    canvas->setView(mapView->transform(), qobject_cast<MapCanvas*>(mapView)->viewCenter());
+
+    if (messageLabel) {
+        messageLabel->setText(title + " opened; it shares all layers with the main map");
+    }
+}
+
+void MainWindow::synchronizeMapViews(MapCanvas *source)
+{
+    // The main view and the views with Synchronize Extent on move together
+    if (syncingMapViews) return;
+    if (source != mapView && !source->extentSync()) return;
+
+    syncingMapViews = true;
+    for (const QPointer<MapCanvas> &view : mapCanvases) {
+        MapCanvas *canvas = view.data();
+        if (!canvas || canvas == source || (canvas != mapView && !canvas->extentSync())) continue;
+        canvas->setView(source->transform(), source->viewCenter());
+    }
+    syncingMapViews = false;
+    mapCanvases.removeAll(QPointer<MapCanvas>());
+
+    if (source != mapView) {
+        currentScale = mapView->transform().m11();
+        updateMagnifier(qRound(currentScale * 100));
+        updateScale(currentScale);
+    }
+}
+
 void MainWindow::setupStatusBar()
 {
     // Get or create the main status bar
@@ -1560,27 +1935,16 @@ void MainWindow::updateExtentsDisplayLabel(QLabel* extentsDisplayLabel)
 
     } else if (!loadedLayers.isEmpty()) {
         // For vector layers
-        QRectF combinedBounds;
-        bool first = true;
-
-        for (const LayerInfo &layer : loadedLayers) {
-            if (layer.graphicsItem) {
-                QRectF bounds = layer.graphicsItem->boundingRect();
-                if (first) {
-                    combinedBounds = bounds;
-                    first = false;
-                } else {
-                    combinedBounds = combinedBounds.united(bounds);
-                }
-            }
-        }
+        // Cached layer extents in map units, no item or feature scan
+        QRectF combinedBounds = combinedLayerExtent();
 
         if (!combinedBounds.isEmpty()) {
             QString suffix = displayInDegrees ? "°" : "";
-            displayText += QString("TL(%1%4,%2%5) BR(%3%4,%2%5)")
+            displayText += QString("TL(%1%5,%2%5) BR(%3%5,%4%5)")
                     .arg(combinedBounds.left(), 0, 'f', 1)
-                    .arg(combinedBounds.top(), 0, 'f', 1)
+                    .arg(combinedBounds.bottom(), 0, 'f', 1)
                     .arg(combinedBounds.right(), 0, 'f', 1)
+                    .arg(combinedBounds.top(), 0, 'f', 1)
                     .arg(suffix);
         } else {
             displayText += "No bounds";
@@ -2112,9 +2476,11 @@ void MainWindow::createNewProjectDialog()
             if (loadedLayers[i].graphicsItem) {
                 mapScene->removeItem(loadedLayers[i].graphicsItem);
                 delete loadedLayers[i].graphicsItem;
+                loadedLayers[i].graphicsItem = nullptr;
             }
         }
         loadedLayers.clear();
+        layerExtents.clear();
 
         // Clear layers tree (remove only child items, keep groups)
         if (layersTree) {
@@ -2466,6 +2832,9 @@ void MainWindow::loadRasterFile(const QString &filePath)
     georeferencedImagesInfo.append(georefInfo);
     mapScene->addItem(pixmapItem);
 
+    // Layers loaded before it now go through its pixel grid
+    if (isMainGeoTIFF) applyMapToSceneTransform();
+
     // Create layer info
     LayerInfo layer;
     layer.name = layerName;
@@ -2585,9 +2954,9 @@ void MainWindow::fitAllGeoreferencedImages()
     }
 
     // Also include any vector layers
-    for (QGraphicsItem *item : currentVectorItems) {
-        if (item) {
-            sceneBounds = sceneBounds.united(item->boundingRect());
+    for (const LayerInfo &layer : loadedLayers) {
+        if (layer.featureStore && layer.graphicsItem) {
+            sceneBounds = sceneBounds.united(layer.graphicsItem->sceneBoundingRect());
         }
     }
 
@@ -2643,6 +3012,7 @@ void MainWindow::removeLayer(const QString &layerName)
 
             // Remove from scene
             if (layer.graphicsItem) {
+                layerExtents.remove(layer.graphicsItem);
                 mapScene->removeItem(layer.graphicsItem);
                 delete layer.graphicsItem;
                 layer.graphicsItem = nullptr;
@@ -2661,6 +3031,7 @@ void MainWindow::removeLayer(const QString &layerName)
             // Remove from list
             loadedLayers.removeAt(i);
             projectModified = true;  // Mark project as modified
+            refreshStylingLayers();
 
             // Update project info
             if (projectInfoLabel) {
@@ -2695,6 +3066,25 @@ void MainWindow::fitImageToView()
 // File Saving Methods
 bool MainWindow::saveLayerToFile(const LayerInfo &layer, const QString &savePath)
 {
+    // Vector layers are written from their features, so memory layers and
+    // format changes work too
+    QString driver = VectorWriter::driverForPath(savePath);
+    if (layer.featureStore && !driver.isEmpty()) {
+        VectorWriter::Options options;
+        options.driver = driver;
+        QString error;
+        if (!VectorWriter::write(*layer.featureStore, savePath, layer.name,
+                                 layer.crs.isEmpty() ? projectCrs() : layer.crs, options, nullptr, &error)) {
+            qDebug() << "Could not write" << layer.name << ":" << error;
+            return false;
+        }
+        if (messageLabel) {
+            messageLabel->setText("Saved layer to: " + savePath);
+        }
+        emit layerSaved(layer.name, savePath);
+        return true;
+    }
+
     if (layer.filePath.isEmpty()) {
         return false;
     }
@@ -2804,10 +3194,12 @@ void MainWindow::exportProject(const QString &directory)
     int exportedCount = 0;
     for (int i = 0; i < loadedLayers.size(); ++i) {
         const LayerInfo &layer = loadedLayers[i];
-        QString exportPath = QDir(layersExportDir).filePath(
-                    layer.name + "." + QFileInfo(layer.filePath).suffix());
+        // Memory layers have no file to copy and go to a GeoPackage
+        QString suffix = layer.filePath.isEmpty() && layer.featureStore
+                ? QString("gpkg") : QFileInfo(layer.filePath).suffix();
+        QString exportPath = QDir(layersExportDir).filePath(layer.name + "." + suffix);
 
-        if (QFile::copy(layer.filePath, exportPath)) {
+        if (saveLayerToFile(layer, exportPath)) {
             exportedCount++;
         }
     }
@@ -3094,40 +3486,126 @@ void MainWindow::onSaveLayerAs()
     onSaveLayer();  // Same functionality for now
 }
 
-void MainWindow::onExportToPdf()
+void MainWindow::onExportVectorAs()
 {
-    QString fileName = QFileDialog::getSaveFileName(this,
-                                                    "Export to PDF",
-                                                    QDir(getSaveLocation()).filePath(currentProjectName + "_export.pdf"),
-                                                    "PDF Files (*.pdf);;All Files (*)");
+    QList<int> vectorLayers;
+    for (int i = 0; i < loadedLayers.size(); ++i) {
+        if (loadedLayers[i].featureStore) vectorLayers.append(i);
+    }
+    if (vectorLayers.isEmpty()) {
+        QMessageBox::information(this, "Export Vector As", "Load a vector layer first.");
+        return;
+    }
 
-    if (!fileName.isEmpty()) {
-        // In a real QGIS app, this would export the map to PDF
-        QMessageBox::information(this, "Export PDF",
-                                 "Map would be exported to PDF: " + fileName);
+    QDialog dialog(this);
+    dialog.setWindowTitle("Export Vector As");
+    QFormLayout *form = new QFormLayout(&dialog);
 
-        if (messageLabel) {
-            messageLabel->setText("Exported to PDF: " + fileName);
+    // Start from the layer selected in the layers panel
+    QComboBox *layerCombo = new QComboBox();
+    QTreeWidgetItem *currentItem = layersTree->currentItem();
+    for (int index : vectorLayers) {
+        layerCombo->addItem(loadedLayers[index].name, index);
+        if (currentItem && loadedLayers[index].treeItem == currentItem) {
+            layerCombo->setCurrentIndex(layerCombo->count() - 1);
+        }
+    }
+    form->addRow("Layer:", layerCombo);
+
+    QComboBox *formatCombo = new QComboBox();
+    QVector<VectorWriter::Format> formats = VectorWriter::formats();
+    for (const VectorWriter::Format &format : formats) formatCombo->addItem(format.name);
+    form->addRow("Format:", formatCombo);
+
+    QLineEdit *fileEdit = new QLineEdit();
+    QPushButton *browseButton = new QPushButton("...");
+    QHBoxLayout *fileLayout = new QHBoxLayout();
+    fileLayout->addWidget(fileEdit);
+    fileLayout->addWidget(browseButton);
+    form->addRow("File name:", fileLayout);
+
+    auto suggestFileName = [this, layerCombo, formatCombo, fileEdit, formats]() {
+        const VectorWriter::Format &format = formats[formatCombo->currentIndex()];
+        QString base = fileEdit->text().isEmpty()
+                ? QDir(lastUsedDirectory).filePath(layerCombo->currentText())
+                : QDir(QFileInfo(fileEdit->text()).path()).filePath(QFileInfo(fileEdit->text()).completeBaseName());
+        fileEdit->setText(base + "." + format.extension);
+    };
+    suggestFileName();
+    connect(formatCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), &dialog, suggestFileName);
+    connect(browseButton, &QPushButton::clicked, &dialog, [this, formatCombo, fileEdit, formats]() {
+        const VectorWriter::Format &format = formats[formatCombo->currentIndex()];
+        QString fileName = QFileDialog::getSaveFileName(this, "Export Vector As", fileEdit->text(),
+                                                        QString("%1 (*.%2)").arg(format.name, format.extension));
+        if (!fileName.isEmpty()) fileEdit->setText(fileName);
+    });
+
+    QSpinBox *batchSpin = new QSpinBox();
+    batchSpin->setRange(1, 10000000);
+    batchSpin->setValue(100000);
+    batchSpin->setGroupSeparatorShown(true);
+    form->addRow("Features per transaction:", batchSpin);
+    QCheckBox *indexCheck = new QCheckBox("Create a spatial index");
+    indexCheck->setChecked(true);
+    form->addRow(indexCheck);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    QString fileName = fileEdit->text().trimmed();
+    if (fileName.isEmpty()) return;
+    const LayerInfo &layer = loadedLayers[layerCombo->currentData().toInt()];
+    FeatureStorePtr store = layer.featureStore;
+    QString layerName = layer.name;
+    QString crs = layer.crs.isEmpty() ? projectCrs() : layer.crs;
+
+    VectorWriter::Options options;
+    options.driver = formats[formatCombo->currentIndex()].driver;
+    options.batchSize = batchSpin->value();
+    options.spatialIndex = indexCheck->isChecked();
+
+    Geoprocessing::Feedback feedback;
+    QString error;
+    bool written = false;
+    QElapsedTimer timer;
+    timer.start();
+    runWithProgress("Exporting " + layerName, feedback, [&]() {
+        written = VectorWriter::write(*store, fileName, layerName, crs, options, &feedback, &error);
+    });
+
+    if (!written) {
+        if (feedback.isCanceled()) {
+            if (messageLabel) messageLabel->setText("Export canceled");
+        } else {
+            QMessageBox::warning(this, "Export Vector As", error.isEmpty() ? QString("Export failed.") : error);
         }
+        return;
+    }
+
+    lastUsedDirectory = QFileInfo(fileName).path();
+    emit layerSaved(layerName, fileName);
+    if (messageLabel) {
+        messageLabel->setText(QString("Exported %1 features of %2 to %3 in %4 ms")
+                              .arg(store->featureCount())
+                              .arg(layerName)
+                              .arg(fileName)
+                              .arg(timer.elapsed()));
     }
 }
 
-void MainWindow::onExportToImage()
+void MainWindow::onExportToPdf()
 {
-    //    QString fileName = QFileDialog->getSaveFileName(this,
-    //        "Export to Image",
-    //        QDir(getSaveLocation()).filePath(currentProjectName + "_export.png"),
-    //        "PNG Files (*.png);;JPEG Files (*.jpg *.jpeg);;All Files (*)");
-
-    //    if (!fileName.isEmpty()) {
-    //        // In a real QGIS app, this would export the map view to an image
-    //        QMessageBox::information(this, "Export Image",
-    //            "Map would be exported to image: " + fileName);
+    exportMap("Export to PDF", "pdf", "PDF Files (*.pdf);;All Files (*)");
+}
 
-    //        if (messageLabel) {
-    //            messageLabel->setText("Exported to image: " + fileName);
-    //        }
-    //    }
+void MainWindow::onExportToImage()
+{
+    exportMap("Export to Image", "png",
+              "PNG Files (*.png);;GeoTIFF Files (*.tif *.tiff);;All Files (*)");
 }
 
 void MainWindow::onSaveAllLayers()
@@ -3345,6 +3823,190 @@ void MainWindow::onShowPythonConsole()
 }
 
 void MainWindow::onShowLayerProperties()
+{
+    showLayerPropertiesDialog(0);
+}
+
+void MainWindow::onLayerLabeling()
+{
+    showLayerPropertiesDialog(2);
+}
+
+MainWindow::LayerInfo *MainWindow::stylingLayer()
+{
+    if (!stylingLayerCombo) return nullptr;
+
+    // The combo keeps the item pointer; make sure the layer still exists
+    QGraphicsItem *item = static_cast<QGraphicsItem*>(stylingLayerCombo->currentData().value<void*>());
+    for (int i = 0; i < loadedLayers.size(); ++i) {
+        if (item && loadedLayers[i].graphicsItem == item && loadedLayers[i].featureStore) {
+            return &loadedLayers[i];
+        }
+    }
+    return nullptr;
+}
+
+void MainWindow::refreshStylingLayers()
+{
+    if (!stylingLayerCombo) return;
+
+    QVariant current = stylingLayerCombo->currentData();
+    stylingLayerCombo->blockSignals(true);
+    stylingLayerCombo->clear();
+    for (const LayerInfo &layer : loadedLayers) {
+        if (!layer.featureStore || !qgraphicsitem_cast<VectorLayerItem*>(layer.graphicsItem)) continue;
+        stylingLayerCombo->addItem(layer.name,
+                                   QVariant::fromValue(static_cast<void*>(layer.graphicsItem)));
+    }
+    int index = stylingLayerCombo->findData(current);
+    stylingLayerCombo->setCurrentIndex(index >= 0 ? index : 0);
+    stylingLayerCombo->blockSignals(false);
+
+    onStylingLayerChanged(stylingLayerCombo->currentIndex());
+}
+
+void MainWindow::onStylingLayerChanged(int index)
+{
+    Q_UNUSED(index);
+    if (!rendererFieldCombo) return;
+
+    rendererFieldCombo->clear();
+    LayerInfo *layer = stylingLayer();
+    if (!layer) {
+        clusterPointsCheck->setEnabled(false);
+        updateRendererClasses();
+        return;
+    }
+
+    const FeatureStore &store = *layer->featureStore;
+    for (int f = 0; f < store.fieldCount(); ++f) {
+        rendererFieldCombo->addItem(store.field(f).name, f);
+    }
+
+    // Show what the layer is currently drawn with
+    VectorLayerItem *vectorItem = qgraphicsitem_cast<VectorLayerItem*>(layer->graphicsItem);
+    FeatureRendererPtr renderer = vectorItem->renderer();
+    if (renderer) {
+        rendererTypeCombo->setCurrentIndex(rendererTypeCombo->findData(renderer->type()));
+        rendererFieldCombo->setCurrentIndex(rendererFieldCombo->findData(renderer->field()));
+    } else {
+        rendererTypeCombo->setCurrentIndex(0);
+    }
+
+    // Clustering only applies to point layers
+    clusterPointsCheck->blockSignals(true);
+    clusterPointsCheck->setEnabled(store.dominantKind() == FeatureStore::PointGeometry);
+    clusterPointsCheck->setChecked(vectorItem->clustering());
+    clusterPointsCheck->blockSignals(false);
+    updateRendererClasses();
+}
+
+void MainWindow::updateRendererClasses()
+{
+    rendererClassesTree->clear();
+
+    LayerInfo *layer = stylingLayer();
+    if (!layer) return;
+    VectorLayerItem *vectorItem = qgraphicsitem_cast<VectorLayerItem*>(layer->graphicsItem);
+    FeatureRendererPtr renderer = vectorItem->renderer();
+    if (!renderer) return;
+
+    QLocale locale;
+    const QVector<FeatureRenderer::Category> &categories = renderer->categories();
+    for (int c = 0; c < categories.size(); ++c) {
+        QPixmap swatch(16, 16);
+        swatch.fill(categories[c].color);
+
+        QTreeWidgetItem *classItem = new QTreeWidgetItem(rendererClassesTree);
+        classItem->setIcon(0, QIcon(swatch));
+        classItem->setText(1, categories[c].label);
+        classItem->setText(2, locale.toString(categories[c].count));
+        classItem->setData(0, Qt::UserRole, c);
+    }
+    rendererClassesTree->resizeColumnToContents(0);
+}
+
+void MainWindow::onApplyRenderer()
+{
+    LayerInfo *layer = stylingLayer();
+    if (!layer) {
+        messageLabel->setText("No vector layer to style");
+        return;
+    }
+    VectorLayerItem *vectorItem = qgraphicsitem_cast<VectorLayerItem*>(layer->graphicsItem);
+
+    int type = rendererTypeCombo->currentData().toInt();
+    if (type == FeatureRenderer::SingleSymbol) {
+        vectorItem->setRenderer(FeatureRendererPtr());
+        updateRendererClasses();
+        messageLabel->setText("Single symbol renderer applied to " + layer->name);
+        return;
+    }
+
+    int field = rendererFieldCombo->currentData().toInt();
+    if (rendererFieldCombo->currentIndex() < 0) {
+        messageLabel->setText("Select a field to classify");
+        return;
+    }
+
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    QElapsedTimer timer;
+    timer.start();
+
+    // One pass over the features; later colour changes only touch the table
+    FeatureRendererPtr renderer(new FeatureRenderer());
+    bool ok;
+    if (type == FeatureRenderer::CategorizedSymbol) {
+        ok = renderer->classifyCategorized(*layer->featureStore, field);
+    } else {
+        ok = renderer->classifyGraduated(*layer->featureStore, field, rendererClassesSpin->value(),
+                                         FeatureRenderer::ClassificationMode(rendererModeCombo->currentData().toInt()));
+    }
+    qint64 elapsed = timer.elapsed();
+    QApplication::restoreOverrideCursor();
+
+    if (!ok) {
+        QMessageBox::warning(this, "Layer Styling",
+                             "Field " + rendererFieldCombo->currentText() + " cannot be classified this way.");
+        return;
+    }
+
+    vectorItem->setRenderer(renderer);
+    updateRendererClasses();
+    messageLabel->setText(QString("Classified %1 into %2 classes in %3 ms (%4 symbol table)")
+                          .arg(layer->name)
+                          .arg(renderer->categories().size())
+                          .arg(elapsed)
+                          .arg(QLocale().formattedDataSize(renderer->memoryUsage())));
+}
+
+void MainWindow::onRendererClassDoubleClicked(QTreeWidgetItem *item, int column)
+{
+    Q_UNUSED(column);
+    LayerInfo *layer = stylingLayer();
+    if (!item || !layer) return;
+
+    VectorLayerItem *vectorItem = qgraphicsitem_cast<VectorLayerItem*>(layer->graphicsItem);
+    FeatureRendererPtr renderer = vectorItem->renderer();
+    if (!renderer) return;
+
+    int category = item->data(0, Qt::UserRole).toInt();
+    if (category < 0 || category >= renderer->categories().size()) return;
+
+    QColor color = QColorDialog::getColor(renderer->categories()[category].color, this, "Class Colour");
+    if (!color.isValid()) return;
+
+    // Only the symbol table changes, the per-feature indices are kept;
+    // setting the renderer again renders with the new colours
+    renderer->setCategoryColor(category, color);
+    vectorItem->setRenderer(renderer);
+
+    QPixmap swatch(16, 16);
+    swatch.fill(color);
+    item->setIcon(0, QIcon(swatch));
+}
+
+void MainWindow::showLayerPropertiesDialog(int initialTab)
 {
     QTreeWidgetItem *currentItem = layersTree->currentItem();
     if (currentItem && currentItem->parent()) {
@@ -3365,7 +4027,23 @@ void MainWindow::onShowLayerProperties()
                 infoLayout->addRow("Name:", new QLabel(layerName));
                 infoLayout->addRow("Type:", new QLabel(loadedLayers[i].type));
                 infoLayout->addRow("File:", new QLabel(loadedLayers[i].filePath));
-                // Add more properties...
+
+                // In-memory footprint of the layer's feature store
+                if (loadedLayers[i].featureStore) {
+                    const FeatureStore &store = *loadedLayers[i].featureStore;
+                    QLocale locale;
+                    infoLayout->addRow("Features:", new QLabel(QString::number(store.featureCount())));
+                    infoLayout->addRow("Vertices:", new QLabel(QString::number(store.vertexCount())));
+                    infoLayout->addRow("Fields:", new QLabel(QString::number(store.fieldCount())));
+                    infoLayout->addRow("Geometry memory:",
+                                       new QLabel(locale.formattedDataSize(store.geometryBytes())));
+                    infoLayout->addRow("Attribute memory:",
+                                       new QLabel(locale.formattedDataSize(store.attributeBytes())));
+                    infoLayout->addRow("Total memory:",
+                                       new QLabel(QString("%1 (%2 reserved)")
+                                                  .arg(locale.formattedDataSize(store.memoryUsage()))
+                                                  .arg(locale.formattedDataSize(store.memoryReserved()))));
+                }
 
                 // Symbology tab
                 QWidget *symbologyTab = new QWidget();
@@ -3373,11 +4051,47 @@ void MainWindow::onShowLayerProperties()
 
                 // Labels tab
                 QWidget *labelsTab = new QWidget();
-                // Add labeling controls...
+                QFormLayout *labelsLayout = new QFormLayout(labelsTab);
+                VectorLayerItem *vectorItem = qgraphicsitem_cast<VectorLayerItem*>(loadedLayers[i].graphicsItem);
+                LabelSettings labelSettings = vectorItem ? vectorItem->labelSettings() : LabelSettings();
+
+                QCheckBox *showLabelsCheck = new QCheckBox("Label features of this layer");
+                showLabelsCheck->setChecked(labelSettings.enabled);
+                QComboBox *labelFieldCombo = new QComboBox();
+                QComboBox *priorityFieldCombo = new QComboBox();
+                priorityFieldCombo->addItem("None", -1);
+                if (loadedLayers[i].featureStore) {
+                    const FeatureStore &store = *loadedLayers[i].featureStore;
+                    for (int field = 0; field < store.fieldCount(); ++field) {
+                        labelFieldCombo->addItem(store.field(field).name, field);
+                        if (store.field(field).type != FeatureStore::StringField) {
+                            priorityFieldCombo->addItem(store.field(field).name, field);
+                        }
+                    }
+                }
+                labelFieldCombo->setCurrentIndex(qMax(0, labelFieldCombo->findData(labelSettings.field)));
+                priorityFieldCombo->setCurrentIndex(qMax(0, priorityFieldCombo->findData(labelSettings.priorityField)));
+
+                QFontComboBox *labelFontCombo = new QFontComboBox();
+                labelFontCombo->setCurrentFont(labelSettings.font);
+                QSpinBox *labelSizeSpin = new QSpinBox();
+                labelSizeSpin->setRange(6, 72);
+                labelSizeSpin->setValue(labelSettings.font.pointSize() > 0 ? labelSettings.font.pointSize() : 10);
+                QCheckBox *labelBufferCheck = new QCheckBox("Draw text buffer");
+                labelBufferCheck->setChecked(labelSettings.buffer);
+
+                labelsLayout->addRow(showLabelsCheck);
+                labelsLayout->addRow("Label field:", labelFieldCombo);
+                labelsLayout->addRow("Priority field:", priorityFieldCombo);
+                labelsLayout->addRow("Font:", labelFontCombo);
+                labelsLayout->addRow("Size:", labelSizeSpin);
+                labelsLayout->addRow(labelBufferCheck);
+                labelsTab->setEnabled(vectorItem != nullptr && labelFieldCombo->count() > 0);
 
                 tabs->addTab(infoTab, "Information");
                 tabs->addTab(symbologyTab, "Symbology");
                 tabs->addTab(labelsTab, "Labels");
+                tabs->setCurrentIndex(initialTab);
 
                 QVBoxLayout *mainLayout = new QVBoxLayout(dialog);
                 mainLayout->addWidget(tabs);
@@ -3388,7 +4102,20 @@ void MainWindow::onShowLayerProperties()
                 connect(buttons, &QDialogButtonBox::rejected, dialog, &QDialog::reject);
                 mainLayout->addWidget(buttons);
 
-                dialog->exec();
+                if (dialog->exec() == QDialog::Accepted && labelsTab->isEnabled()) {
+                    labelSettings.enabled = showLabelsCheck->isChecked();
+                    labelSettings.field = labelFieldCombo->currentData().toInt();
+                    labelSettings.priorityField = priorityFieldCombo->currentData().toInt();
+                    labelSettings.font = labelFontCombo->currentFont();
+                    labelSettings.font.setPointSize(labelSizeSpin->value());
+                    labelSettings.buffer = labelBufferCheck->isChecked();
+                    vectorItem->setLabelSettings(labelSettings);
+                    if (messageLabel) {
+                        messageLabel->setText(labelSettings.enabled
+                                              ? QString("Labeling %1 by %2").arg(layerName, labelFieldCombo->currentText())
+                                              : QString("Labels off for %1").arg(layerName));
+                    }
+                }
                 delete dialog;
                 break;
             }
@@ -3398,10 +4125,181 @@ void MainWindow::onShowLayerProperties()
 
 void MainWindow::onCreatePrintLayout()
 {
-    QMessageBox::information(this, "Print Layout",
-                             "Creating new print layout (Ctrl+P)");
+    if (!mapView || !mapScene) return;
+
+    QList<int> vectorLayers;
+    for (int i = 0; i < loadedLayers.size(); ++i) {
+        if (loadedLayers[i].featureStore && loadedLayers[i].featureStore->featureCount() > 0) {
+            vectorLayers.append(i);
+        }
+    }
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("Print Layout");
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    QLineEdit *titleEdit = new QLineEdit(currentProjectName);
+    form->addRow("Title:", titleEdit);
+
+    QComboBox *pageSizeCombo = new QComboBox();
+    pageSizeCombo->addItem("A4", int(QPageSize::A4));
+    pageSizeCombo->addItem("A3", int(QPageSize::A3));
+    pageSizeCombo->addItem("A2", int(QPageSize::A2));
+    pageSizeCombo->addItem("Letter", int(QPageSize::Letter));
+    pageSizeCombo->addItem("Tabloid", int(QPageSize::Tabloid));
+    form->addRow("Page size:", pageSizeCombo);
+
+    QComboBox *orientationCombo = new QComboBox();
+    orientationCombo->addItem("Landscape", int(QPageLayout::Landscape));
+    orientationCombo->addItem("Portrait", int(QPageLayout::Portrait));
+    form->addRow("Orientation:", orientationCombo);
+
+    QSpinBox *dpiSpin = new QSpinBox();
+    dpiSpin->setRange(72, 1200);
+    dpiSpin->setValue(300);
+    form->addRow("Resolution (dpi):", dpiSpin);
+
+    // Atlas: one page per feature of a coverage layer
+    QComboBox *coverageCombo = new QComboBox();
+    coverageCombo->addItem("None (current map view)", -1);
+    for (int index : vectorLayers) {
+        coverageCombo->addItem(loadedLayers[index].name, index);
+    }
+    form->addRow("Atlas coverage layer:", coverageCombo);
+
+    QComboBox *pageNameCombo = new QComboBox();
+    form->addRow("Page name field:", pageNameCombo);
+    auto fillPageNames = [&]() {
+        pageNameCombo->clear();
+        pageNameCombo->addItem("(feature id)", -1);
+        int index = coverageCombo->currentData().toInt();
+        pageNameCombo->setEnabled(index >= 0);
+        if (index < 0) return;
+        const FeatureStorePtr &store = loadedLayers[index].featureStore;
+        for (int field = 0; field < store->fieldCount(); ++field) {
+            pageNameCombo->addItem(store->field(field).name, field);
+        }
+    };
+    connect(coverageCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), &dialog, fillPageNames);
+    fillPageNames();
+
+    QCheckBox *legendCheck = new QCheckBox("Legend");
+    legendCheck->setChecked(true);
+    QCheckBox *scaleBarCheck = new QCheckBox("Scale bar");
+    scaleBarCheck->setChecked(true);
+    QCheckBox *northArrowCheck = new QCheckBox("North arrow");
+    northArrowCheck->setChecked(true);
+    QHBoxLayout *itemsLayout = new QHBoxLayout();
+    itemsLayout->addWidget(legendCheck);
+    itemsLayout->addWidget(scaleBarCheck);
+    itemsLayout->addWidget(northArrowCheck);
+    form->addRow("Items:", itemsLayout);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    QString fileName = QFileDialog::getSaveFileName(this, "Export Print Layout",
+                                                    QDir(getSaveLocation()).filePath(currentProjectName + "_layout.pdf"),
+                                                    "PDF Files (*.pdf);;All Files (*)");
+    if (fileName.isEmpty()) return;
+    if (QFileInfo(fileName).suffix().isEmpty()) fileName += ".pdf";
+
+    QTransform mapToScene = mapToSceneTransform();
+    PrintLayout::Options options;
+    options.pageSize = QPageSize(QPageSize::PageSizeId(pageSizeCombo->currentData().toInt()));
+    options.orientation = QPageLayout::Orientation(orientationCombo->currentData().toInt());
+    options.dpi = dpiSpin->value();
+    options.background = mapScene->backgroundBrush().style() == Qt::NoBrush
+            ? QColor(Qt::white) : mapScene->backgroundBrush().color();
+    options.sceneToMap = mapToScene.inverted();
+    options.geographic = CoordinateTransformer::isGeographic(projectCrs());
+
+    // Visible vector layers with their classes, top layer first
+    for (int i = loadedLayers.size() - 1; i >= 0; --i) {
+        VectorLayerItem *vectorItem = qgraphicsitem_cast<VectorLayerItem*>(loadedLayers[i].graphicsItem);
+        if (!vectorItem || !vectorItem->isVisible() || !vectorItem->featureStore()) continue;
+        PrintLayout::LegendEntry entry;
+        entry.label = loadedLayers[i].name;
+        entry.color = vectorItem->color();
+        entry.kind = vectorItem->featureStore()->dominantKind();
+        options.legend.append(entry);
+
+        FeatureRendererPtr renderer = vectorItem->renderer();
+        if (!renderer) continue;
+        for (const FeatureRenderer::Category &category : renderer->categories()) {
+            PrintLayout::LegendEntry classEntry = entry;
+            classEntry.label = category.label;
+            classEntry.color = category.color;
+            classEntry.indented = true;
+            options.legend.append(classEntry);
+        }
+    }
+
+    PrintLayout layout(options);
+    layout.setItems(PrintLayout::defaultItems(layout.pageSizeMm(), legendCheck->isChecked(),
+                                              scaleBarCheck->isChecked(), northArrowCheck->isChecked()));
+
+    QString title = titleEdit->text();
+    int coverageIndex = coverageCombo->currentData().toInt();
+    if (coverageIndex < 0) {
+        layout.addPage(mapView->mapToScene(mapView->viewport()->rect()).boundingRect(), title);
+    } else {
+        const LayerInfo &coverage = loadedLayers[coverageIndex];
+        const FeatureStore &store = *coverage.featureStore;
+        int nameField = pageNameCombo->currentData().toInt();
+        // Points and tiny features still get some surroundings
+        QRectF layerRect = mapToScene.mapRect(store.extent().toRectF());
+        double minimumSide = qMax(layerRect.width(), layerRect.height()) * 0.05;
+        for (qint64 f = 0; f < store.featureCount(); ++f) {
+            if (store.partBegin(f) == store.partEnd(f)) continue;
+            QRectF rect = mapToScene.mapRect(store.featureExtent(f).toRectF());
+            double side = qMax(minimumSide, qMax(rect.width(), rect.height()) * 1.1);
+            QPointF center = rect.center();
+            rect = QRectF(center.x() - side / 2.0, center.y() - side / 2.0, side, side);
+
+            QString pageName = nameField >= 0 ? store.attribute(nameField, f).toString()
+                                              : QString::number(store.featureId(f));
+            layout.addPage(rect, title.isEmpty() ? pageName : title + " - " + pageName);
+        }
+    }
+    if (layout.pageCount() == 0) {
+        QMessageBox::warning(this, "Print Layout", "The coverage layer has no features with geometry.");
+        return;
+    }
+
+    if (!layoutFrameCache) layoutFrameCache = new LayoutFrameCache();
+    layout.prepare(mapScene, layoutFrameCache);
+
+    Geoprocessing::Feedback feedback;
+    PrintLayout::Statistics stats;
+    QString error;
+    bool ok = false;
+    runWithProgress("Exporting print layout", feedback, [&]() {
+        ok = layout.exportPdf(fileName, &feedback, &stats, &error);
+    });
+
+    if (!ok) {
+        if (feedback.isCanceled()) {
+            if (messageLabel) messageLabel->setText("Print layout export canceled");
+        } else {
+            QMessageBox::warning(this, "Print Layout",
+                                 error.isEmpty() ? QString("Print layout export failed.") : error);
+        }
+        return;
+    }
+
     if (messageLabel) {
-        messageLabel->setText("Print Layout created");
+        messageLabel->setText(QString("Exported %1 pages in %2 ms on %3 threads: %4 map frames rendered, %5 reused: %6")
+                              .arg(stats.pages)
+                              .arg(stats.elapsedMs)
+                              .arg(stats.threads)
+                              .arg(stats.framesRendered)
+                              .arg(stats.framesCached)
+                              .arg(fileName));
     }
 }
 
@@ -3448,6 +4346,7 @@ void MainWindow::onLayerContextMenuRequested(const QPoint &pos)
         contextMenu.addSeparator();
         contextMenu.addAction("Save Layer", this, &MainWindow::onSaveLayer);
         contextMenu.addAction("Save Layer As...", this, &MainWindow::onSaveLayerAs);
+        contextMenu.addAction("Export Vector As...", this, &MainWindow::onExportVectorAs);
         contextMenu.addSeparator();
         contextMenu.addAction("Remove Layer", this, &MainWindow::onRemoveLayer);
         contextMenu.addSeparator();
@@ -3653,9 +4552,9 @@ void MainWindow::onOpenGeoTIFF()
             return;
         }
 
-        // Clear existing items
+        // Clear existing items; loaded layers keep theirs
         if (mapScene) {
-            mapScene->clear();
+            clearUnownedSceneItems();
             currentImageItem = nullptr;
             geoTIFFItem = nullptr;
         }
@@ -3672,6 +4571,10 @@ void MainWindow::onOpenGeoTIFF()
 
             geoTIFFItem = mapScene->addPixmap(geoTIFFPixmap);
             currentImageItem = geoTIFFItem;
+            isGeoTIFFLoaded = true;
+
+            // Layers loaded before it now go through its pixel grid
+            applyMapToSceneTransform();
 
             // Store the image path
             currentImagePath = fileName;
@@ -3685,8 +4588,6 @@ void MainWindow::onOpenGeoTIFF()
                 updateScale(currentScale);
             }
 
-            isGeoTIFFLoaded = true;
-
             // Update image info
             updateImageInfo();
 
@@ -3839,24 +4740,44 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *event)
 
     // Existing event filter code for map view...
     if (mapView && mapView->viewport() && obj == mapView->viewport()) {
+        if (handleSelectionToolEvent(event)) {
+            return true;
+        }
         if (event->type() == QEvent::MouseMove) {
             QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(event);
             QPointF scenePos = mapView->mapToScene(mouseEvent->pos());
             updateCoordinates(scenePos);
+            if (mouseEvent->buttons() == Qt::NoButton) {
+                scheduleHoverUpdate(mouseEvent->pos());
+            }
             return true;
         }
+        else if (event->type() == QEvent::Leave) {
+            clearHover();
+        }
         else if (event->type() == QEvent::Wheel) {
-            QWheelEvent *wheelEvent = static_cast<QWheelEvent*>(event);
-            QTimer::singleShot(1000, this, [this]() {
-                if (mapView) {
-                    currentScale = mapView->transform().m11();
-                    updateMagnifier(qRound(currentScale * 100));
-                    updateScale(currentScale);
-                }
-            });
+            // One update after the last step instead of one per step
+            if (!wheelScaleTimer) {
+                wheelScaleTimer = new QTimer(this);
+                wheelScaleTimer->setSingleShot(true);
+                wheelScaleTimer->setInterval(250);
+                connect(wheelScaleTimer, &QTimer::timeout, this, [this]() {
+                    if (mapView) {
+                        currentScale = mapView->transform().m11();
+                        updateMagnifier(qRound(currentScale * 100));
+                        updateScale(currentScale);
+                    }
+                });
+            }
+            wheelScaleTimer->start();
         }
         else if (event->type() == QEvent::MouseButtonPress) {
             QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(event);
+            if (identifyAction && identifyAction->isChecked() &&
+                    mouseEvent->button() == Qt::LeftButton) {
+                identifyFeatures(mouseEvent->pos());
+                return true;
+            }
             if (coordinatesToolBtn && coordinatesToolBtn->isChecked() &&
                     mouseEvent->button() == Qt::LeftButton) {
                 QPointF scenePos = mapView->mapToScene(mouseEvent->pos());
@@ -4010,27 +4931,15 @@ void MainWindow::updateExtentsDisplay()
 
     } else if (!loadedLayers.isEmpty()) {
         // For vector layers
-        QRectF combinedBounds;
-        bool first = true;
-
-        for (const LayerInfo &layer : loadedLayers) {
-            if (layer.graphicsItem) {
-                QRectF bounds = layer.graphicsItem->boundingRect();
-                if (first) {
-                    combinedBounds = bounds;
-                    first = false;
-                } else {
-                    combinedBounds = combinedBounds.united(bounds);
-                }
-            }
-        }
+        // Cached layer extents in map units, no item or feature scan
+        QRectF combinedBounds = combinedLayerExtent();
 
         if (!combinedBounds.isEmpty()) {
             displayText += QString("TL(%1, %2) BR(%3, %4)")
-                    .arg(combinedBounds.left(), 0, 'f', 1)
-                    .arg(combinedBounds.top(), 0, 'f', 1)
-                    .arg(combinedBounds.right(), 0, 'f', 1)
-                    .arg(combinedBounds.bottom(), 0, 'f', 1);
+                    .arg(formatCoordinate(combinedBounds.left(), displayInDegrees))
+                    .arg(formatCoordinate(combinedBounds.bottom(), displayInDegrees))
+                    .arg(formatCoordinate(combinedBounds.right(), displayInDegrees))
+                    .arg(formatCoordinate(combinedBounds.top(), displayInDegrees));
         } else {
             displayText += "No bounds";
         }
@@ -4082,27 +4991,15 @@ void MainWindow::updateMiniExtentsDisplay(QLabel* miniExtentsLabel)
 
     } else if (!loadedLayers.isEmpty()) {
         // For vector layers
-        QRectF combinedBounds;
-        bool first = true;
-
-        for (const LayerInfo &layer : loadedLayers) {
-            if (layer.graphicsItem) {
-                QRectF bounds = layer.graphicsItem->boundingRect();
-                if (first) {
-                    combinedBounds = bounds;
-                    first = false;
-                } else {
-                    combinedBounds = combinedBounds.united(bounds);
-                }
-            }
-        }
+        // Cached layer extents in map units, no item or feature scan
+        QRectF combinedBounds = combinedLayerExtent();
 
         if (!combinedBounds.isEmpty()) {
             displayText += QString("TL(%1,%2) BR(%3,%4)")
                     .arg(combinedBounds.left(), 0, 'f', 1)
-                    .arg(combinedBounds.top(), 0, 'f', 1)
+                    .arg(combinedBounds.bottom(), 0, 'f', 1)
                     .arg(combinedBounds.right(), 0, 'f', 1)
-                    .arg(combinedBounds.bottom(), 0, 'f', 1);
+                    .arg(combinedBounds.top(), 0, 'f', 1);
         } else {
             displayText += "No bounds";
         }
@@ -4571,6 +5468,8 @@ QPointF MainWindow::geographicToSceneCoords(double lon, double lat)
 
 QPointF MainWindow::sceneToGeographicCoords(const QPointF &scenePoint)
 {
+    ScopedRenderTiming timing(renderDiagnostics, RenderDiagnostics::GeographicTransform);
+
     // Check all georeferenced images
     for (const GeoreferenceInfo &georefInfo : georeferencedImagesInfo) {
         if (georefInfo.imageItem && georefInfo.hasTransform &&
@@ -4628,23 +5527,7 @@ void MainWindow::fitAllImages()
 {
     if (!mapView || !mapScene || loadedLayers.isEmpty()) return;
 
-    QRectF totalBounds;
-    bool first = true;
-
-    for (const LayerInfo &layer : loadedLayers) {
-        if (layer.graphicsItem) {
-            QRectF bounds = layer.graphicsItem->boundingRect();
-            QPointF pos = layer.graphicsItem->pos();
-            bounds.translate(pos);
-
-            if (first) {
-                totalBounds = bounds;
-                first = false;
-            } else {
-                totalBounds = totalBounds.united(bounds);
-            }
-        }
-    }
+    QRectF totalBounds = layersSceneBounds();
 
     if (!totalBounds.isEmpty()) {
         // Add some padding
@@ -4692,7 +5575,35 @@ void MainWindow::updatePropertiesDisplay(const LayerInfo &layer)
         }
 
         if (layer.properties.contains("feature_count")) {
-            info += QString("<b>Features:</b> %1<br>").arg(layer.properties["feature_count"].toInt());
+            info += QString("<b>Features:</b> %1<br>").arg(layer.properties["feature_count"].toLongLong());
+        }
+
+        // Driver metadata read at open time, from headers and index tables
+        if (layer.properties.contains("source_feature_count")) {
+            qint64 sourceCount = layer.properties["source_feature_count"].toLongLong();
+            if (!layer.properties.contains("feature_count") ||
+                    layer.properties["feature_count"].toLongLong() != sourceCount) {
+                info += QString("<b>Features in Source:</b> %1<br>").arg(sourceCount);
+            }
+        }
+        if (layer.properties.contains("source_extent")) {
+            QRectF extent = layer.properties["source_extent"].toRectF();
+            info += QString("<b>Source Extent:</b> %1, %2 : %3, %4<br>")
+                    .arg(extent.left(), 0, 'g', 10)
+                    .arg(extent.top(), 0, 'g', 10)
+                    .arg(extent.right(), 0, 'g', 10)
+                    .arg(extent.bottom(), 0, 'g', 10);
+        }
+
+        if (layer.featureStore) {
+            if (layer.properties.contains("load_method")) {
+                info += QString("<b>Loaded via:</b> %1 (%2 ms)<br>")
+                        .arg(layer.properties["load_method"].toString())
+                        .arg(layer.properties["load_time_ms"].toLongLong());
+            }
+            info += QString("<b>Vertices:</b> %1<br>").arg(layer.featureStore->vertexCount());
+            info += QString("<b>Memory:</b> %1<br>")
+                    .arg(QLocale().formattedDataSize(layer.featureStore->memoryUsage()));
         }
 
         info += QString("<b>Total Layers Loaded:</b> %1").arg(loadedLayers.size());
@@ -4719,6 +5630,16 @@ void MainWindow::clearAllImages()
     // Clear georeference info
     georeferencedImagesInfo.clear();
 
+    // Layer items first, so no LayerInfo points at an item clear() deleted
+    for (LayerInfo &layer : loadedLayers) {
+        if (layer.graphicsItem && mapScene) {
+            mapScene->removeItem(layer.graphicsItem);
+            delete layer.graphicsItem;
+        }
+        layer.graphicsItem = nullptr;
+        layer.vectorItems.clear();
+    }
+
     // Clear all graphics items from scene
     if (mapScene) {
         mapScene->clear();
@@ -4727,6 +5648,7 @@ void MainWindow::clearAllImages()
 
     // Clear loaded layers
     loadedLayers.clear();
+    layerExtents.clear();
     currentVectorItems.clear();
     layerVectorItems.clear();
     currentCrosshairItems.clear();
@@ -4765,29 +5687,35 @@ void MainWindow::clearAllImages()
         messageLabel->setText("All images cleared");
     }
 }
-void MainWindow::highlightAreaAroundPoint(double centerX, double centerY, double radius)
+QGraphicsItem *MainWindow::highlightAreaAroundPoint(double centerX, double centerY, double radius)
 {
+    // Screen-sized pens, so the highlight looks the same at any scale
+    QPen outlinePen(QColor(255, 255, 0, 150), 3);
+    outlinePen.setCosmetic(true);
+    QPen radialPen(QColor(255, 200, 0, 100), 2);
+    radialPen.setCosmetic(true);
+
     // Create a circular highlight
     QGraphicsEllipseItem *areaHighlight = mapScene->addEllipse(
                 centerX - radius, centerY - radius,
                 radius * 2, radius * 2,
-                QPen(QColor(255, 255, 0, 150), 3),
+                outlinePen,
                 QBrush(QColor(255, 255, 0, 30))
                 );
+    areaHighlight->setZValue(1e6);
 
-    // Create radial lines
+    // Radial lines belong to the circle, so removing it removes them too
     for (int i = 0; i < 8; i++) {
         double angle = i * M_PI / 4;
-        QGraphicsLineItem *radialLine = mapScene->addLine(
+        QGraphicsLineItem *radialLine = new QGraphicsLineItem(
                     centerX, centerY,
                     centerX + cos(angle) * radius,
                     centerY + sin(angle) * radius,
-                    QPen(QColor(255, 200, 0, 100), 2)
-                    );
-        currentCrosshairItems.append(radialLine);
+                    areaHighlight);
+        radialLine->setPen(radialPen);
     }
 
-    currentCrosshairItems.append(areaHighlight);
+    return areaHighlight;
 }
 
 void MainWindow::addSelectionRectangle(double x, double y, double width, double height)
@@ -4951,11 +5879,7 @@ void MainWindow::zoomToExtents()
     } else if (currentImageItem) {
         bounds = currentImageItem->boundingRect();
     } else if (!loadedLayers.isEmpty()) {
-        for (const LayerInfo &layer : loadedLayers) {
-            if (layer.graphicsItem) {
-                bounds = bounds.united(layer.graphicsItem->boundingRect());
-            }
-        }
+        bounds = layersSceneBounds();
     }
 
     if (!bounds.isEmpty()) {
@@ -5019,6 +5943,7 @@ void MainWindow::onCoordinatesToolToggled(bool enabled)
 void MainWindow::updateCoordinates(const QPointF &scenePoint)
 {
     if (!coordinateLabel) return;
+    ScopedRenderTiming timing(renderDiagnostics, RenderDiagnostics::CoordinateUpdate);
 
     // Try to convert scene coordinates to geographic coordinates
     QPointF geoCoords = sceneToGeographicCoords(scenePoint);
@@ -5040,6 +5965,52 @@ void MainWindow::updateCoordinates(const QPointF &scenePoint)
     coordinateLabel->setText(coordText);
 }
 
+void MainWindow::clearUnownedSceneItems()
+{
+    if (!mapScene) return;
+
+    // Items of loaded layers stay, since their LayerInfo points at them
+    QSet<QGraphicsItem*> owned;
+    for (const LayerInfo &layer : loadedLayers) {
+        if (layer.graphicsItem) owned.insert(layer.graphicsItem->topLevelItem());
+        for (QGraphicsItem *item : layer.vectorItems) {
+            if (item) owned.insert(item->topLevelItem());
+        }
+    }
+
+    QList<QGraphicsItem*> unowned;
+    for (QGraphicsItem *item : mapScene->items()) {
+        if (!item->parentItem() && !owned.contains(item)) unowned.append(item);
+    }
+    for (QGraphicsItem *item : unowned) {
+        mapScene->removeItem(item);
+        delete item;
+    }
+
+    // Forget the deleted items wherever they were listed
+    QSet<QGraphicsItem*> remaining;
+    for (QGraphicsItem *item : mapScene->items()) {
+        remaining.insert(item);
+    }
+    for (int i = currentCrosshairItems.size() - 1; i >= 0; --i) {
+        if (!remaining.contains(currentCrosshairItems[i])) currentCrosshairItems.removeAt(i);
+    }
+    for (int i = currentVectorItems.size() - 1; i >= 0; --i) {
+        if (!remaining.contains(currentVectorItems[i])) currentVectorItems.remove(i);
+    }
+    for (QVector<QGraphicsItem*> &items : layerVectorItems) {
+        for (int i = items.size() - 1; i >= 0; --i) {
+            if (!remaining.contains(items[i])) items.remove(i);
+        }
+    }
+    for (int i = georeferencedImages.size() - 1; i >= 0; --i) {
+        if (!remaining.contains(georeferencedImages[i])) georeferencedImages.removeAt(i);
+    }
+    for (int i = georeferencedImagesInfo.size() - 1; i >= 0; --i) {
+        if (!remaining.contains(georeferencedImagesInfo[i].imageItem)) georeferencedImagesInfo.removeAt(i);
+    }
+}
+
 void MainWindow::clearCurrentImage()
 {
     // Close GDAL dataset if open
@@ -5054,9 +6025,9 @@ void MainWindow::clearCurrentImage()
     geoTIFFImage = QImage();
     geoTIFFSize = QSize();
 
-    // Clear the scene
+    // Clear the scene; loaded layers keep their items
     if (mapScene) {
-        mapScene->clear();
+        clearUnownedSceneItems();
         currentImageItem = nullptr;
     }
 
@@ -5065,6 +6036,9 @@ void MainWindow::clearCurrentImage()
     currentScale = 1.0;
     rotationAngle = 0.0;
 
+    // Without the GeoTIFF the remaining layers fall back to the fixed scale
+    applyMapToSceneTransform();
+
     // Update status bar
     updateMagnifier(100);
     updateScale(1.0);
@@ -5202,13 +6176,6 @@ void MainWindow::drawVectorLayer(const QString &filePath)
     QColor multiLineColor(75, 0, 130, 200);   // Indigo
     QColor multiPolygonColor(238, 130, 238, 150); // Violet
 
-    // Determine scale factor based on coordinate system
-    double scaleFactor = 100.0;
-    if (isGeoTIFFLoaded && hasGeoTransform) {
-        // If we have a georeferenced image, use appropriate scaling
-        scaleFactor = 1000.0;
-    }
-
     // Process each layer
     for (int i = 0; i < layerCount; i++) {
         OGRLayer *layer = dataset->GetLayer(i);
@@ -5264,6 +6231,18 @@ void MainWindow::drawVectorLayer(const QString &filePath)
         layerInfo.properties["geometry_type"] = geomTypeStr;
         layerInfo.properties["layer_index"] = i;
 
+        // Driver metadata from headers and index tables only, never a scan
+        GIntBig sourceCount = layer->GetFeatureCount(FALSE);
+        if (sourceCount >= 0) {
+            layerInfo.properties["source_feature_count"] = qint64(sourceCount);
+        }
+        OGREnvelope sourceEnvelope;
+        if (layer->GetExtent(&sourceEnvelope, FALSE) == OGRERR_NONE) {
+            layerInfo.properties["source_extent"] = QRectF(sourceEnvelope.MinX, sourceEnvelope.MinY,
+                                                           sourceEnvelope.MaxX - sourceEnvelope.MinX,
+                                                           sourceEnvelope.MaxY - sourceEnvelope.MinY);
+        }
+
         // Add layer to tree
         QTreeWidgetItem *layerItem = new QTreeWidgetItem(
                     QStringList() << qLayerName << "Vector (" + geomTypeStr + ")");
@@ -5288,37 +6267,36 @@ void MainWindow::drawVectorLayer(const QString &filePath)
 
         vectorGroup->addChild(layerItem);
 
-        // Store items for this layer
-        QList<QGraphicsItem*> layerItems;
-
-        // Draw features
-        OGRFeature *feature;
-        int featureCount = 0;
-        int maxFeatures = 1000;  // Limit for performance
+        // Load all features into the layer's columnar store
+        FeatureStorePtr store = loadFeatureStore(dataset, layer, layerInfo);
+        qint64 featureCount = store->featureCount();
 
-        while ((feature = layer->GetNextFeature()) != nullptr && featureCount < maxFeatures) {
-            OGRGeometry *geometry = feature->GetGeometryRef();
-            if (geometry) {
-                drawGeometry(geometry, color, scaleFactor);
-                // Note: drawGeometry adds items to currentVectorItems
+        // Remember the layer CRS so the store can be reprojected later
+        OGRSpatialReference *layerSrs = layer->GetSpatialRef();
+        if (layerSrs) {
+            char *wkt = nullptr;
+            if (layerSrs->exportToWkt(&wkt) == OGRERR_NONE && wkt) {
+                layerInfo.crs = QString::fromUtf8(wkt);
             }
-            OGRFeature::DestroyFeature(feature);
-            featureCount++;
+            CPLFree(wkt);
         }
 
-        // Store layer items
-        layerVectorItems[qLayerName] = currentVectorItems;
-        currentVectorItems.clear();
+        // One scene item draws the whole layer from the store
+        VectorLayerItem *vectorItem = new VectorLayerItem(store, color);
+        vectorItem->setLayerName(layerInfo.name);
+        mapScene->addItem(vectorItem);
 
-        // Get feature count for the entire layer
-        layer->ResetReading();
-        int totalFeatures = layer->GetFeatureCount();
-        layerInfo.properties["feature_count"] = totalFeatures;
-        layerInfo.properties["features_drawn"] = qMin(featureCount, maxFeatures);
+        layerInfo.graphicsItem = vectorItem;
+        layerInfo.featureStore = store;
+        reprojectVectorLayer(layerInfo);
+        layerInfo.properties["feature_count"] = featureCount;
+        layerInfo.properties["features_drawn"] = featureCount;
+        layerInfo.properties["memory_bytes"] = qint64(store->memoryUsage());
 
         // Add layer to loaded layers
         loadedLayers.append(layerInfo);
         projectModified = true;
+        refreshStylingLayers();
 
         // Update project info
         if (projectInfoLabel) {
@@ -5342,161 +6320,1613 @@ void MainWindow::drawVectorLayer(const QString &filePath)
     fitAllImages();
 }
 
-void MainWindow::drawGeometry(OGRGeometry *geom, const QColor &color, double scaleFactor)
+FeatureStorePtr MainWindow::loadFeatureStore(GDALDataset *dataset, OGRLayer *layer, LayerInfo &layerInfo)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Arrow batches where the driver supports them, feature iterator otherwise
+    FeatureLoader::Method method = FeatureLoader::FeatureIteratorMethod;
+    FeatureStorePtr store = FeatureLoader::load(dataset, layer, FeatureLoader::AutomaticMethod, &method);
+
+    layerInfo.properties["load_method"] = FeatureLoader::methodName(method);
+    layerInfo.properties["load_time_ms"] = timer.elapsed();
+    return store;
+}
+
+void MainWindow::addMemoryVectorLayer(const QString &layerName, const FeatureStorePtr &store,
+                                      const QVariantMap &properties)
 {
-    if (!geom || !mapScene) return;
+    if (!store) return;
 
-    OGRwkbGeometryType type = wkbFlatten(geom->getGeometryType());
+    // Results are in the project CRS, like every other vector layer
+    QString name = layerName;
+    for (int n = 2; ; ++n) {
+        bool taken = false;
+        for (const LayerInfo &layer : loadedLayers) {
+            if (layer.name == name) taken = true;
+        }
+        if (!taken) break;
+        name = QString("%1 (%2)").arg(layerName).arg(n);
+    }
 
-    switch (type) {
-    case wkbPoint:
-        drawPoint((OGRPoint*)geom, color, scaleFactor);
+    QColor color;
+    QString geomTypeStr;
+    switch (store->dominantKind()) {
+    case FeatureStore::PointGeometry:
+        color = QColor(255, 0, 0, 200);
+        geomTypeStr = "Point";
         break;
-    case wkbLineString:
-        drawLine((OGRLineString*)geom, color, scaleFactor);
+    case FeatureStore::LineGeometry:
+        color = QColor(0, 0, 255, 200);
+        geomTypeStr = "Line";
         break;
-    case wkbPolygon:
-        drawPolygon((OGRPolygon*)geom, color, scaleFactor);
+    case FeatureStore::PolygonGeometry:
+        color = QColor(0, 255, 0, 150);
+        geomTypeStr = "Polygon";
         break;
-    case wkbMultiPoint:
-    case wkbMultiLineString:
-    case wkbMultiPolygon:
-        // Handle multi-geometries recursively
-        if (OGRGeometryCollection *collection = dynamic_cast<OGRGeometryCollection*>(geom)) {
-            for (int i = 0; i < collection->getNumGeometries(); i++) {
-                drawGeometry(collection->getGeometryRef(i), color, scaleFactor);
+    default:
+        color = QColor(128, 128, 128, 200);
+        geomTypeStr = "Unknown";
+    }
+
+    LayerInfo layerInfo;
+    layerInfo.name = name;
+    layerInfo.type = "vector";
+    layerInfo.properties = properties;
+    layerInfo.properties["geometry_type"] = geomTypeStr;
+    layerInfo.properties["feature_count"] = store->featureCount();
+    layerInfo.properties["features_drawn"] = store->featureCount();
+    layerInfo.properties["memory_bytes"] = qint64(store->memoryUsage());
+    layerInfo.crs = projectCrs();
+
+    QTreeWidgetItem *layerItem = new QTreeWidgetItem(
+                QStringList() << name << "Memory (" + geomTypeStr + ")");
+    layerItem->setCheckState(0, Qt::Checked);
+    layerItem->setIcon(0, QIcon(":/icons/vector_layer.png"));
+    layerInfo.treeItem = layerItem;
+
+    QTreeWidgetItem *vectorGroup = nullptr;
+    for (int j = 0; j < layersTree->topLevelItemCount(); ++j) {
+        if (layersTree->topLevelItem(j)->text(0) == "Vector Layers") {
+            vectorGroup = layersTree->topLevelItem(j);
+            break;
+        }
+    }
+    if (!vectorGroup) {
+        vectorGroup = new QTreeWidgetItem(layersTree, QStringList() << "Vector Layers");
+        vectorGroup->setIcon(0, QIcon(":/icons/folder.png"));
+        vectorGroup->setExpanded(true);
+    }
+    vectorGroup->addChild(layerItem);
+
+    VectorLayerItem *vectorItem = new VectorLayerItem(store, color);
+    vectorItem->setLayerName(name);
+    mapScene->addItem(vectorItem);
+    layerInfo.graphicsItem = vectorItem;
+    layerInfo.featureStore = store;
+    reprojectVectorLayer(layerInfo);
+
+    loadedLayers.append(layerInfo);
+    projectModified = true;
+    refreshStylingLayers();
+
+    if (projectInfoLabel) {
+        projectInfoLabel->setText(QString("Project: %1\nLayers: %2")
+                                  .arg(currentProjectName)
+                                  .arg(loadedLayers.size()));
+    }
+    updatePropertiesDisplay(layerInfo);
+}
+
+void MainWindow::onProcessingAlgorithm(QTreeWidgetItem *item, int column)
+{
+    Q_UNUSED(column);
+    if (!item || !item->parent()) return;
+
+    QString algorithm = item->text(0);
+    if (algorithm == "Buffer" || algorithm == "Clip" || algorithm == "Intersection" ||
+            algorithm == "Line Intersections" || algorithm == "Sum Line Lengths") {
+        runGeoprocessing(algorithm);
+    } else if (algorithm == "Dissolve") {
+        runDissolve();
+    } else if (algorithm == "Check & Fix Geometries") {
+        runCheckGeometries();
+    } else if (algorithm == "Spatial Join") {
+        runSpatialJoin();
+    } else if (algorithm == "Random Points" || algorithm == "Regular Points") {
+        runPointGenerator(algorithm);
+    } else if (algorithm == "Heatmap (Kernel Density)") {
+        runHeatmap();
+    } else if (messageLabel) {
+        messageLabel->setText(algorithm + " is not available yet");
+    }
+}
+
+void MainWindow::runWithProgress(const QString &title, Geoprocessing::Feedback &feedback,
+                                 const std::function<void()> &task)
+{
+    // Run on the thread pool; the dialog polls progress and can cancel
+    QFuture<void> future = QtConcurrent::run(task);
+
+    // Shown at once: the modal dialog is what keeps the window from being
+    // used (and the layers changed) while the task reads them
+    QProgressDialog progress(title + "...", "Cancel", 0, 1000, this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(0);
+    progress.show();
+    QFutureWatcher<void> watcher;
+    QTimer pollTimer;
+    QEventLoop loop;
+    connect(&pollTimer, &QTimer::timeout, &progress, [&progress, &feedback]() {
+        progress.setValue(int(feedback.progress() * 999));
+    });
+    connect(&progress, &QProgressDialog::canceled, &progress, [&feedback]() {
+        feedback.cancel();
+    });
+    connect(&watcher, &QFutureWatcher<void>::finished, &loop, &QEventLoop::quit);
+    watcher.setFuture(future);
+    pollTimer.start(100);
+    if (!future.isFinished()) loop.exec();
+    pollTimer.stop();
+    progress.reset();
+}
+
+void MainWindow::runGeoprocessing(const QString &algorithm)
+{
+    QList<int> vectorLayers;
+    for (int i = 0; i < loadedLayers.size(); ++i) {
+        if (loadedLayers[i].featureStore) vectorLayers.append(i);
+    }
+    // Line Intersections may use the same layer twice
+    bool overlayNeeded = algorithm != "Buffer";
+    int layersNeeded = (overlayNeeded && algorithm != "Line Intersections") ? 2 : 1;
+    if (vectorLayers.size() < layersNeeded) {
+        QMessageBox::information(this, algorithm,
+                                 layersNeeded > 1 ? "Load an input and an overlay vector layer first."
+                                                  : "Load a vector layer first.");
+        return;
+    }
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(algorithm);
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    QComboBox *inputCombo = new QComboBox();
+    QComboBox *overlayCombo = new QComboBox();
+    for (int index : vectorLayers) {
+        inputCombo->addItem(loadedLayers[index].name, index);
+        overlayCombo->addItem(loadedLayers[index].name, index);
+    }
+    if (algorithm != "Line Intersections") {
+        overlayCombo->setCurrentIndex(qMin(1, overlayCombo->count() - 1));
+    }
+    form->addRow(algorithm == "Sum Line Lengths" ? "Polygon layer:" : "Input layer:", inputCombo);
+
+    QDoubleSpinBox *distanceSpin = new QDoubleSpinBox();
+    distanceSpin->setRange(-1e9, 1e9);
+    distanceSpin->setDecimals(6);
+    distanceSpin->setValue(CoordinateTransformer::isGeographic(projectCrs()) ? 0.01 : 100.0);
+    QSpinBox *segmentsSpin = new QSpinBox();
+    segmentsSpin->setRange(1, 64);
+    segmentsSpin->setValue(8);
+    if (algorithm == "Buffer") {
+        form->addRow("Distance (map units):", distanceSpin);
+        form->addRow("Segments per quarter circle:", segmentsSpin);
+    } else if (algorithm == "Clip") {
+        form->addRow("Clip layer:", overlayCombo);
+    } else if (algorithm == "Line Intersections") {
+        form->addRow("Intersect layer:", overlayCombo);
+    } else if (algorithm == "Sum Line Lengths") {
+        form->addRow("Lines layer:", overlayCombo);
+    } else {
+        form->addRow("Overlay layer:", overlayCombo);
+    }
+
+    QLineEdit *outputEdit = new QLineEdit(algorithm);
+    form->addRow("Output layer:", outputEdit);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    FeatureStorePtr input = loadedLayers[inputCombo->currentData().toInt()].featureStore;
+    FeatureStorePtr overlay = loadedLayers[overlayCombo->currentData().toInt()].featureStore;
+    double distance = distanceSpin->value();
+    int segments = segmentsSpin->value();
+
+    Geoprocessing::Feedback feedback;
+    Geoprocessing::Statistics stats;
+    QString error;
+    FeatureStorePtr result;
+    runWithProgress(algorithm, feedback, [&]() {
+        if (algorithm == "Buffer") {
+            result = Geoprocessing::buffer(*input, distance, segments, &feedback, &stats, &error);
+        } else if (algorithm == "Clip") {
+            result = Geoprocessing::clip(*input, *overlay, &feedback, &stats, &error);
+        } else if (algorithm == "Line Intersections") {
+            result = Geoprocessing::lineIntersections(*input, *overlay, &feedback, &stats, &error);
+        } else if (algorithm == "Sum Line Lengths") {
+            result = Geoprocessing::sumLineLengths(*input, *overlay, &feedback, &stats, &error);
+        } else {
+            result = Geoprocessing::intersection(*input, *overlay, &feedback, &stats, &error);
+        }
+    });
+
+    if (!result) {
+        if (feedback.isCanceled()) {
+            if (messageLabel) messageLabel->setText(algorithm + " canceled");
+        } else {
+            QMessageBox::warning(this, algorithm, error.isEmpty() ? algorithm + " failed." : error);
+        }
+        return;
+    }
+
+    QVariantMap properties;
+    properties["algorithm"] = algorithm;
+    properties["processing_time_ms"] = stats.elapsedMs;
+    properties["processing_threads"] = stats.threads;
+    properties["index_candidates"] = stats.candidates;
+    addMemoryVectorLayer(outputEdit->text().trimmed().isEmpty() ? algorithm : outputEdit->text().trimmed(),
+                         result, properties);
+
+    if (messageLabel) {
+        messageLabel->setText(QString("%1: %2 features -> %3 features in %4 ms on %5 threads "
+                                      "(%6 index candidates)")
+                              .arg(algorithm)
+                              .arg(stats.inputFeatures)
+                              .arg(stats.outputFeatures)
+                              .arg(stats.elapsedMs)
+                              .arg(stats.threads)
+                              .arg(stats.candidates));
+    }
+}
+
+void MainWindow::runDissolve()
+{
+    QList<int> vectorLayers;
+    for (int i = 0; i < loadedLayers.size(); ++i) {
+        if (loadedLayers[i].featureStore) vectorLayers.append(i);
+    }
+    if (vectorLayers.isEmpty()) {
+        QMessageBox::information(this, "Dissolve", "Load a vector layer first.");
+        return;
+    }
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("Dissolve");
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    QComboBox *inputCombo = new QComboBox();
+    for (int index : vectorLayers) inputCombo->addItem(loadedLayers[index].name, index);
+    form->addRow("Input layer:", inputCombo);
+
+    // Dissolve field follows the chosen layer
+    QComboBox *fieldCombo = new QComboBox();
+    auto fillFields = [this, inputCombo, fieldCombo]() {
+        fieldCombo->clear();
+        fieldCombo->addItem("(dissolve all)", -1);
+        const FeatureStore &store = *loadedLayers[inputCombo->currentData().toInt()].featureStore;
+        for (int f = 0; f < store.fieldCount(); ++f) fieldCombo->addItem(store.field(f).name, f);
+    };
+    fillFields();
+    connect(inputCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), &dialog, fillFields);
+    form->addRow("Dissolve field:", fieldCombo);
+
+    QLineEdit *outputEdit = new QLineEdit("Dissolved");
+    form->addRow("Output layer:", outputEdit);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    FeatureStorePtr input = loadedLayers[inputCombo->currentData().toInt()].featureStore;
+    int field = fieldCombo->currentData().toInt();
+
+    Geoprocessing::Feedback feedback;
+    Geoprocessing::Statistics stats;
+    QVector<Geoprocessing::GroupTiming> timings;
+    QString error;
+    FeatureStorePtr result;
+    runWithProgress("Dissolve", feedback, [&]() {
+        result = Geoprocessing::dissolve(*input, field, &feedback, &stats, &timings, &error);
+    });
+
+    if (!result) {
+        if (feedback.isCanceled()) {
+            if (messageLabel) messageLabel->setText("Dissolve canceled");
+        } else {
+            QMessageBox::warning(this, "Dissolve", error.isEmpty() ? QString("Dissolve failed.") : error);
+        }
+        return;
+    }
+
+    QVariantMap properties;
+    properties["algorithm"] = "Dissolve";
+    properties["processing_time_ms"] = stats.elapsedMs;
+    properties["processing_threads"] = stats.threads;
+    addMemoryVectorLayer(outputEdit->text().trimmed().isEmpty() ? QString("Dissolved") : outputEdit->text().trimmed(),
+                         result, properties);
+
+    if (messageLabel) {
+        messageLabel->setText(QString("Dissolve: %1 features -> %2 groups in %3 ms on %4 threads")
+                              .arg(stats.inputFeatures)
+                              .arg(stats.outputFeatures)
+                              .arg(stats.elapsedMs)
+                              .arg(stats.threads));
+    }
+
+    // Per-group union time, slowest first
+    std::sort(timings.begin(), timings.end(),
+              [](const Geoprocessing::GroupTiming &a, const Geoprocessing::GroupTiming &b) {
+        return a.elapsedMs > b.elapsedMs;
+    });
+
+    QDialog *report = new QDialog(this);
+    report->setAttribute(Qt::WA_DeleteOnClose);
+    report->setWindowTitle("Dissolve - Group Timing");
+    report->resize(420, 400);
+    QVBoxLayout *reportLayout = new QVBoxLayout(report);
+    reportLayout->addWidget(new QLabel(QString("%1 groups, %2 ms wall time, %3 threads")
+                                       .arg(timings.size()).arg(stats.elapsedMs).arg(stats.threads)));
+    QTableWidget *table = new QTableWidget(timings.size(), 3);
+    table->setHorizontalHeaderLabels(QStringList() << "Group" << "Features" << "Union time (ms)");
+    table->verticalHeader()->setVisible(false);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    for (int row = 0; row < timings.size(); ++row) {
+        table->setItem(row, 0, new QTableWidgetItem(timings[row].key));
+        QTableWidgetItem *featuresItem = new QTableWidgetItem();
+        featuresItem->setData(Qt::DisplayRole, timings[row].features);
+        table->setItem(row, 1, featuresItem);
+        QTableWidgetItem *timeItem = new QTableWidgetItem();
+        timeItem->setData(Qt::DisplayRole, timings[row].elapsedMs);
+        table->setItem(row, 2, timeItem);
+    }
+    table->horizontalHeader()->setStretchLastSection(true);
+    table->setSortingEnabled(true);
+    reportLayout->addWidget(table);
+    QDialogButtonBox *closeButtons = new QDialogButtonBox(QDialogButtonBox::Close);
+    connect(closeButtons, &QDialogButtonBox::rejected, report, &QDialog::close);
+    reportLayout->addWidget(closeButtons);
+    report->show();
+}
+
+void MainWindow::runCheckGeometries()
+{
+    QList<int> vectorLayers;
+    for (int i = 0; i < loadedLayers.size(); ++i) {
+        if (loadedLayers[i].featureStore) vectorLayers.append(i);
+    }
+    if (vectorLayers.isEmpty()) {
+        QMessageBox::information(this, "Check & Fix Geometries", "Load a vector layer first.");
+        return;
+    }
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("Check & Fix Geometries");
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    QComboBox *layerCombo = new QComboBox();
+    for (int index : vectorLayers) {
+        layerCombo->addItem(loadedLayers[index].name, index);
+    }
+    form->addRow("Input layer:", layerCombo);
+
+    QCheckBox *invalidOnlyCheck = new QCheckBox("Only output the repaired features");
+    form->addRow(invalidOnlyCheck);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    const LayerInfo &layer = loadedLayers[layerCombo->currentData().toInt()];
+    QString layerName = layer.name;
+    FeatureStorePtr input = layer.featureStore;
+    GeometryChecker::Options options;
+    options.invalidOnly = invalidOnlyCheck->isChecked();
+
+    Geoprocessing::Feedback feedback;
+    GeometryChecker::Statistics stats;
+    GeometryChecker::Result result;
+    QString error;
+    bool ok = false;
+    runWithProgress("Check & Fix Geometries", feedback, [&]() {
+        ok = GeometryChecker::check(*input, options, result, &feedback, &stats, &error);
+    });
+
+    if (!ok) {
+        if (feedback.isCanceled()) {
+            if (messageLabel) messageLabel->setText("Geometry check canceled");
+        } else {
+            QMessageBox::warning(this, "Check & Fix Geometries",
+                                 error.isEmpty() ? QString("Geometry check failed.") : error);
+        }
+        return;
+    }
+
+    QVariantMap properties;
+    properties["algorithm"] = "Check & Fix Geometries";
+    properties["processing_time_ms"] = stats.elapsedMs;
+    properties["processing_threads"] = stats.threads;
+    properties["invalid_features"] = stats.invalid;
+    addMemoryVectorLayer(layerName + " (fixed)", result.repaired, properties);
+    // Nothing to report on a clean layer
+    if (stats.invalid > 0) {
+        addMemoryVectorLayer(layerName + " (errors)", result.errors, properties);
+    }
+
+    if (messageLabel) {
+        messageLabel->setText(QString("Checked %1 features in %2 ms on %3 threads: %4 invalid, %5 repaired, %6 not repairable")
+                              .arg(stats.checked)
+                              .arg(stats.elapsedMs)
+                              .arg(stats.threads)
+                              .arg(stats.invalid)
+                              .arg(stats.repaired)
+                              .arg(stats.failed));
+    }
+}
+
+void MainWindow::runSpatialJoin()
+{
+    QList<int> vectorLayers;
+    for (int i = 0; i < loadedLayers.size(); ++i) {
+        if (loadedLayers[i].featureStore) vectorLayers.append(i);
+    }
+    if (vectorLayers.size() < 2) {
+        QMessageBox::information(this, "Spatial Join", "Load a target and a join vector layer first.");
+        return;
+    }
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("Spatial Join");
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    QComboBox *targetCombo = new QComboBox();
+    QComboBox *joinCombo = new QComboBox();
+    for (int index : vectorLayers) {
+        targetCombo->addItem(loadedLayers[index].name, index);
+        joinCombo->addItem(loadedLayers[index].name, index);
+    }
+    joinCombo->setCurrentIndex(1);
+    form->addRow("Join to features in:", targetCombo);
+    form->addRow("By comparing to:", joinCombo);
+
+    QComboBox *predicateCombo = new QComboBox();
+    predicateCombo->addItem("Intersects", SpatialJoin::Intersects);
+    predicateCombo->addItem("Are within", SpatialJoin::Within);
+    predicateCombo->addItem("Contain", SpatialJoin::Contains);
+    predicateCombo->addItem("Nearest", SpatialJoin::Nearest);
+    form->addRow("Where the features:", predicateCombo);
+
+    QCheckBox *attributesCheck = new QCheckBox("Copy attributes of the first match");
+    attributesCheck->setChecked(true);
+    form->addRow(attributesCheck);
+
+    // Numeric join fields can be summarised over all matches
+    QComboBox *summaryCombo = new QComboBox();
+    auto fillSummaryFields = [this, joinCombo, summaryCombo]() {
+        summaryCombo->clear();
+        summaryCombo->addItem("(count only)", -1);
+        const FeatureStore &store = *loadedLayers[joinCombo->currentData().toInt()].featureStore;
+        for (int f = 0; f < store.fieldCount(); ++f) {
+            if (store.field(f).type != FeatureStore::StringField) summaryCombo->addItem(store.field(f).name, f);
+        }
+    };
+    fillSummaryFields();
+    connect(joinCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), &dialog, fillSummaryFields);
+    form->addRow("Summarise (sum, mean):", summaryCombo);
+
+    QLineEdit *outputEdit = new QLineEdit("Joined");
+    form->addRow("Output layer:", outputEdit);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    FeatureStorePtr target = loadedLayers[targetCombo->currentData().toInt()].featureStore;
+    FeatureStorePtr joinLayer = loadedLayers[joinCombo->currentData().toInt()].featureStore;
+    SpatialJoin::Options options;
+    options.predicate = SpatialJoin::Predicate(predicateCombo->currentData().toInt());
+    options.joinAttributes = attributesCheck->isChecked();
+    options.summaryField = summaryCombo->currentData().toInt();
+
+    Geoprocessing::Feedback feedback;
+    Geoprocessing::Statistics stats;
+    QString error;
+    FeatureStorePtr result;
+    runWithProgress("Spatial Join", feedback, [&]() {
+        result = SpatialJoin::join(*target, *joinLayer, options, &feedback, &stats, &error);
+    });
+
+    if (!result) {
+        if (feedback.isCanceled()) {
+            if (messageLabel) messageLabel->setText("Spatial join canceled");
+        } else {
+            QMessageBox::warning(this, "Spatial Join", error.isEmpty() ? QString("Spatial join failed.") : error);
+        }
+        return;
+    }
+
+    QVariantMap properties;
+    properties["algorithm"] = "Spatial Join (" + SpatialJoin::predicateName(options.predicate) + ")";
+    properties["processing_time_ms"] = stats.elapsedMs;
+    properties["processing_threads"] = stats.threads;
+    properties["index_candidates"] = stats.candidates;
+    addMemoryVectorLayer(outputEdit->text().trimmed().isEmpty() ? QString("Joined") : outputEdit->text().trimmed(),
+                         result, properties);
+
+    if (messageLabel) {
+        messageLabel->setText(QString("Spatial join (%1): %2 features in %3 ms on %4 threads, %5 index candidates")
+                              .arg(SpatialJoin::predicateName(options.predicate))
+                              .arg(stats.outputFeatures)
+                              .arg(stats.elapsedMs)
+                              .arg(stats.threads)
+                              .arg(stats.candidates));
+    }
+}
+
+void MainWindow::runPointGenerator(const QString &algorithm)
+{
+    bool random = algorithm == "Random Points";
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(algorithm);
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    // Extent from the view or a layer, optionally restricted to polygons
+    QComboBox *extentCombo = new QComboBox();
+    extentCombo->addItem("Current map view", -1);
+    QComboBox *maskCombo = new QComboBox();
+    maskCombo->addItem("(none)", -1);
+    for (int i = 0; i < loadedLayers.size(); ++i) {
+        if (!loadedLayers[i].featureStore) continue;
+        extentCombo->addItem("Extent of " + loadedLayers[i].name, i);
+        if (loadedLayers[i].featureStore->dominantKind() == FeatureStore::PolygonGeometry) {
+            maskCombo->addItem(loadedLayers[i].name, i);
+        }
+    }
+    form->addRow("Extent:", extentCombo);
+    form->addRow("Inside polygons of:", maskCombo);
+
+    QSpinBox *countSpin = new QSpinBox();
+    countSpin->setRange(1, 2000000000);
+    countSpin->setValue(10000);
+    countSpin->setGroupSeparatorShown(true);
+    QSpinBox *seedSpin = new QSpinBox();
+    seedSpin->setRange(0, 2147483647);
+    seedSpin->setValue(1);
+    QDoubleSpinBox *spacingSpin = new QDoubleSpinBox();
+    spacingSpin->setRange(1e-9, 1e9);
+    spacingSpin->setDecimals(6);
+    spacingSpin->setValue(CoordinateTransformer::isGeographic(projectCrs()) ? 0.01 : 100.0);
+    if (random) {
+        form->addRow("Number of points:", countSpin);
+        form->addRow("Seed:", seedSpin);
+    } else {
+        form->addRow("Spacing (map units):", spacingSpin);
+    }
+
+    // Straight into a memory layer, or written to a GeoPackage
+    QLineEdit *outputEdit = new QLineEdit(algorithm);
+    form->addRow("Output layer:", outputEdit);
+    QLineEdit *fileEdit = new QLineEdit();
+    fileEdit->setPlaceholderText("Memory layer (leave empty)");
+    QPushButton *browseButton = new QPushButton("...");
+    QHBoxLayout *fileLayout = new QHBoxLayout();
+    fileLayout->addWidget(fileEdit);
+    fileLayout->addWidget(browseButton);
+    form->addRow("GeoPackage:", fileLayout);
+    connect(browseButton, &QPushButton::clicked, &dialog, [this, fileEdit]() {
+        QString fileName = QFileDialog::getSaveFileName(this, "Save Points", lastUsedDirectory,
+                                                        "GeoPackage (*.gpkg)");
+        if (!fileName.isEmpty()) fileEdit->setText(fileName);
+    });
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    FeatureStore::Extent extent = FeatureStore::Extent::null();
+    int extentLayer = extentCombo->currentData().toInt();
+    if (extentLayer >= 0) {
+        extent = loadedLayers[extentLayer].featureStore->extent();
+    } else if (mapView) {
+        QRectF sceneRect = mapView->mapToScene(mapView->viewport()->rect()).boundingRect();
+        extent = FeatureStore::Extent::fromRectF(mapToSceneTransform().inverted().mapRect(sceneRect));
+    }
+    int maskLayer = maskCombo->currentData().toInt();
+    FeatureStorePtr mask = maskLayer >= 0 ? loadedLayers[maskLayer].featureStore : FeatureStorePtr();
+    if (mask) {
+        // Nothing outside the mask can be kept anyway
+        const FeatureStore::Extent &maskExtent = mask->extent();
+        extent.minX = qMax(extent.minX, maskExtent.minX);
+        extent.minY = qMax(extent.minY, maskExtent.minY);
+        extent.maxX = qMin(extent.maxX, maskExtent.maxX);
+        extent.maxY = qMin(extent.maxY, maskExtent.maxY);
+    }
+
+    qint64 count = countSpin->value();
+    quint32 seed = quint32(seedSpin->value());
+    double spacing = spacingSpin->value();
+    QString fileName = fileEdit->text().trimmed();
+    QString layerName = outputEdit->text().trimmed().isEmpty() ? algorithm : outputEdit->text().trimmed();
+    QString crs = projectCrs();
+
+    Geoprocessing::Feedback feedback;
+    PointGenerator::Statistics stats;
+    QString error;
+    FeatureStorePtr result;
+    bool written = false;
+    runWithProgress(algorithm, feedback, [&]() {
+        if (random) {
+            result = PointGenerator::randomPoints(extent, mask.data(), count, seed, &feedback, &stats, &error);
+        } else {
+            result = PointGenerator::regularPoints(extent, mask.data(), spacing, &feedback, &stats, &error);
+        }
+        if (result && !fileName.isEmpty()) {
+            written = VectorWriter::write(*result, fileName, layerName, crs, VectorWriter::Options(),
+                                          &feedback, &error);
+        }
+    });
+
+    if (!result || (!fileName.isEmpty() && !written)) {
+        if (feedback.isCanceled()) {
+            if (messageLabel) messageLabel->setText(algorithm + " canceled");
+        } else {
+            QMessageBox::warning(this, algorithm, error.isEmpty() ? algorithm + " failed." : error);
+        }
+        return;
+    }
+
+    if (fileName.isEmpty()) {
+        QVariantMap properties;
+        properties["algorithm"] = algorithm;
+        properties["processing_time_ms"] = stats.elapsedMs;
+        addMemoryVectorLayer(layerName, result, properties);
+    } else {
+        lastUsedDirectory = QFileInfo(fileName).path();
+    }
+
+    if (messageLabel) {
+        messageLabel->setText(QString("%1: %2 points from %3 tiles in %4 ms%5")
+                              .arg(algorithm)
+                              .arg(stats.points)
+                              .arg(stats.tiles)
+                              .arg(stats.elapsedMs)
+                              .arg(fileName.isEmpty() ? QString() : ", written to " + fileName));
+    }
+}
+
+void MainWindow::runHeatmap()
+{
+    QList<int> pointLayers;
+    for (int i = 0; i < loadedLayers.size(); ++i) {
+        if (loadedLayers[i].featureStore &&
+                loadedLayers[i].featureStore->dominantKind() == FeatureStore::PointGeometry) {
+            pointLayers.append(i);
+        }
+    }
+    if (pointLayers.isEmpty()) {
+        QMessageBox::information(this, "Heatmap", "Load a point layer first.");
+        return;
+    }
+
+    QDialog dialog(this);
+    dialog.setWindowTitle("Heatmap (Kernel Density)");
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    QComboBox *layerCombo = new QComboBox();
+    for (int index : pointLayers) layerCombo->addItem(loadedLayers[index].name, index);
+    form->addRow("Point layer:", layerCombo);
+
+    QComboBox *weightCombo = new QComboBox();
+    QDoubleSpinBox *radiusSpin = new QDoubleSpinBox();
+    radiusSpin->setRange(1e-9, 1e9);
+    radiusSpin->setDecimals(6);
+    QDoubleSpinBox *cellSpin = new QDoubleSpinBox();
+    cellSpin->setRange(1e-9, 1e9);
+    cellSpin->setDecimals(6);
+
+    // Defaults from the layer: about a thousand cells and fifty radii across
+    auto updateLayerDefaults = [this, layerCombo, weightCombo, radiusSpin, cellSpin]() {
+        const FeatureStore &store = *loadedLayers[layerCombo->currentData().toInt()].featureStore;
+        weightCombo->clear();
+        weightCombo->addItem("(none)", -1);
+        for (int f = 0; f < store.fieldCount(); ++f) {
+            if (store.field(f).type != FeatureStore::StringField) weightCombo->addItem(store.field(f).name, f);
+        }
+        const FeatureStore::Extent &extent = store.extent();
+        double side = qMax(extent.maxX - extent.minX, extent.maxY - extent.minY);
+        if (side <= 0.0) side = CoordinateTransformer::isGeographic(projectCrs()) ? 1.0 : 1000.0;
+        radiusSpin->setValue(side / 50.0);
+        cellSpin->setValue(side / 1000.0);
+    };
+    updateLayerDefaults();
+    connect(layerCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), &dialog, updateLayerDefaults);
+    form->addRow("Weight from field:", weightCombo);
+    form->addRow("Radius (map units):", radiusSpin);
+    form->addRow("Cell size (map units):", cellSpin);
+
+    QComboBox *kernelCombo = new QComboBox();
+    kernelCombo->addItem("Quartic", Heatmap::Quartic);
+    kernelCombo->addItem("Triangular", Heatmap::Triangular);
+    kernelCombo->addItem("Uniform", Heatmap::Uniform);
+    kernelCombo->addItem("Gaussian (separable)", Heatmap::Gaussian);
+    form->addRow("Kernel shape:", kernelCombo);
+
+    QLineEdit *outputEdit = new QLineEdit("Heatmap");
+    form->addRow("Output layer:", outputEdit);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    FeatureStorePtr points = loadedLayers[layerCombo->currentData().toInt()].featureStore;
+    Heatmap::Options options;
+    options.cellSize = cellSpin->value();
+    options.radius = radiusSpin->value();
+    options.kernel = Heatmap::Kernel(kernelCombo->currentData().toInt());
+    options.weightField = weightCombo->currentData().toInt();
+
+    Geoprocessing::Feedback feedback;
+    Heatmap::Statistics stats;
+    Heatmap::Raster raster;
+    QImage image;
+    QString error;
+    bool ok = false;
+    runWithProgress("Heatmap", feedback, [&]() {
+        ok = Heatmap::estimate(*points, options, raster, &feedback, &stats, &error);
+        if (ok) image = Heatmap::render(raster);
+    });
+
+    if (!ok) {
+        if (feedback.isCanceled()) {
+            if (messageLabel) messageLabel->setText("Heatmap canceled");
+        } else {
+            QMessageBox::warning(this, "Heatmap", error.isEmpty() ? QString("Heatmap failed.") : error);
+        }
+        return;
+    }
+
+    QString layerName = outputEdit->text().trimmed().isEmpty() ? QString("Heatmap") : outputEdit->text().trimmed();
+    QString name = layerName;
+    for (int n = 2; ; ++n) {
+        bool taken = false;
+        for (const LayerInfo &layer : loadedLayers) {
+            if (layer.name == name) taken = true;
+        }
+        if (!taken) break;
+        name = QString("%1 (%2)").arg(layerName).arg(n);
+    }
+
+    // Cells to map units, then into the scene like the vector layers
+    QGraphicsPixmapItem *pixmapItem = new QGraphicsPixmapItem(QPixmap::fromImage(image));
+    QTransform pixelToMap(raster.cellSize, 0.0, 0.0, -raster.cellSize, raster.originX, raster.originY);
+    pixmapItem->setTransform(pixelToMap * mapToSceneTransform());
+    mapScene->addItem(pixmapItem);
+
+    LayerInfo layer;
+    layer.name = name;
+    layer.type = "raster";
+    layer.graphicsItem = pixmapItem;
+    layer.crs = projectCrs();
+    layer.itemToMap = pixelToMap;
+    layer.placedInMap = true;
+    layer.properties["algorithm"] = "Heatmap (" + Heatmap::kernelName(options.kernel) + ")";
+    layer.properties["processing_time_ms"] = stats.elapsedMs;
+    layer.properties["processing_threads"] = stats.threads;
+    layer.properties["has_geotransform"] = true;
+    layer.properties["width"] = raster.columns;
+    layer.properties["height"] = raster.rows;
+    layer.properties["top_left_x"] = raster.originX;
+    layer.properties["top_left_y"] = raster.originY;
+    layer.properties["pixel_width"] = raster.cellSize;
+    layer.properties["pixel_height"] = -raster.cellSize;
+    layer.properties["radius"] = options.radius;
+    layer.properties["maximum_density"] = raster.maximum;
+
+    QTreeWidgetItem *layerItem = new QTreeWidgetItem(QStringList() << name << "Heatmap");
+    layerItem->setCheckState(0, Qt::Checked);
+    layerItem->setIcon(0, QIcon(":/icons/raster_layer.png"));
+    layer.treeItem = layerItem;
+
+    QTreeWidgetItem *rasterGroup = nullptr;
+    for (int i = 0; i < layersTree->topLevelItemCount(); ++i) {
+        if (layersTree->topLevelItem(i)->text(0) == "Raster Layers") {
+            rasterGroup = layersTree->topLevelItem(i);
+            break;
+        }
+    }
+    if (!rasterGroup) {
+        rasterGroup = new QTreeWidgetItem(layersTree, QStringList() << "Raster Layers");
+        rasterGroup->setIcon(0, QIcon(":/icons/folder.png"));
+        rasterGroup->setExpanded(true);
+    }
+    rasterGroup->addChild(layerItem);
+
+    layerExtents[pixmapItem] = QRectF(raster.originX, raster.originY - raster.rows * raster.cellSize,
+                                      raster.columns * raster.cellSize, raster.rows * raster.cellSize);
+    loadedLayers.append(layer);
+    projectModified = true;
+    if (projectInfoLabel) {
+        projectInfoLabel->setText(QString("Project: %1\nLayers: %2")
+                                  .arg(currentProjectName)
+                                  .arg(loadedLayers.size()));
+    }
+    updatePropertiesDisplay(layer);
+
+    if (messageLabel) {
+        messageLabel->setText(QString("Heatmap: %1 points into %2 x %3 cells (%4 non-empty) in %5 ms on %6 threads")
+                              .arg(stats.points)
+                              .arg(raster.columns)
+                              .arg(raster.rows)
+                              .arg(stats.bins)
+                              .arg(stats.elapsedMs)
+                              .arg(stats.threads));
+    }
+}
+
+QString MainWindow::projectCrs() const
+{
+    QString crs = appSettings ? appSettings->value("currentCRS").toString() : QString();
+    return crs.isEmpty() ? QString("EPSG:4326") : crs;
+}
+
+QTransform MainWindow::mapToSceneTransform()
+{
+    QString crs = projectCrs();
+
+    // Over a georeferenced GeoTIFF in the project CRS, go through its pixel grid
+    if (isGeoTIFFLoaded && hasGeoTransform && gdalDataset && geoTIFFItem) {
+        QString rasterCrs = QString::fromUtf8(gdalDataset->GetProjectionRef());
+        if (!rasterCrs.isEmpty() && CoordinateTransformer::isSameCrs(rasterCrs, crs)) {
+            QTransform pixelToMap(gdalGeoTransform[1], gdalGeoTransform[4],
+                                  gdalGeoTransform[2], gdalGeoTransform[5],
+                                  gdalGeoTransform[0], gdalGeoTransform[3]);
+            bool invertible = false;
+            QTransform mapToPixel = pixelToMap.inverted(&invertible);
+            if (invertible) {
+                return mapToPixel * geoTIFFItem->sceneTransform();
             }
         }
-        break;
-    default:
-        qDebug() << "Unhandled geometry type:" << type;
-        break;
     }
+
+    // Otherwise a fixed scale with y pointing up
+    double scaleFactor = CoordinateTransformer::isGeographic(crs) ? 100.0 : 1.0;
+    return QTransform::fromScale(scaleFactor, -scaleFactor);
+}
+
+void MainWindow::reprojectVectorLayer(LayerInfo &layerInfo)
+{
+    if (!layerInfo.featureStore) return;
+
+    // Every reprojection starts from the features as loaded, so errors and
+    // vertices that failed in one CRS never carry over into the next
+    if (!layerInfo.sourceStore) {
+        layerInfo.sourceStore = layerInfo.featureStore;
+        layerInfo.sourceCrs = layerInfo.crs;
+    }
+
+    // Layers without a CRS are assumed to be in the project CRS already
+    QString targetCrs = projectCrs();
+    if (layerInfo.sourceCrs.isEmpty()) {
+        layerInfo.featureStore = layerInfo.sourceStore;
+    } else if (CoordinateTransformer::isSameCrs(layerInfo.sourceCrs, targetCrs)) {
+        layerInfo.featureStore = layerInfo.sourceStore;
+        layerInfo.crs = targetCrs;
+        layerInfo.properties.remove("transform_time_ms");
+        layerInfo.properties.remove("transform_failures");
+    } else {
+        QElapsedTimer timer;
+        timer.start();
+
+        // Into a new store: renders on the thread pool may still read the old one
+        qint64 failed = 0;
+        QString error;
+        FeatureStorePtr reprojected = CoordinateTransformer::reprojectStore(
+                    layerInfo.sourceStore, layerInfo.sourceCrs, targetCrs, &failed, &error);
+        if (reprojected) {
+            layerInfo.featureStore = reprojected;
+            layerInfo.crs = targetCrs;
+            layerInfo.properties["transform_time_ms"] = timer.elapsed();
+            layerInfo.properties["transform_failures"] = failed;
+            if (failed > 0) {
+                qDebug() << layerInfo.name << ":" << failed << "vertices could not be reprojected";
+            }
+        } else {
+            qDebug() << "Reprojection failed for" << layerInfo.name << ":" << error;
+        }
+    }
+
+    VectorLayerItem *vectorItem = dynamic_cast<VectorLayerItem*>(layerInfo.graphicsItem);
+    if (vectorItem) {
+        vectorItem->setFeatureStore(layerInfo.featureStore);
+        layerInfo.itemToMap = QTransform();
+        layerInfo.placedInMap = true;
+        vectorItem->setTransform(mapToSceneTransform());
+    }
+    updateLayerMetadata(layerInfo);
+}
+
+void MainWindow::applyMapToSceneTransform()
+{
+    // The scene follows the main GeoTIFF's pixel grid while one is loaded,
+    // so items placed in map units move whenever it comes or goes
+    QTransform mapToScene = mapToSceneTransform();
+    for (LayerInfo &layer : loadedLayers) {
+        if (layer.placedInMap && layer.graphicsItem) {
+            layer.graphicsItem->setTransform(layer.itemToMap * mapToScene);
+        }
+    }
+}
+
+void MainWindow::updateLayerMetadata(LayerInfo &layerInfo)
+{
+    if (!layerInfo.featureStore) return;
+
+    // The store keeps its count and extent current, so this is O(1)
+    const FeatureStore &store = *layerInfo.featureStore;
+    layerInfo.properties["feature_count"] = store.featureCount();
+    if (!layerInfo.graphicsItem) return;
+    if (store.extent().isNull()) {
+        layerExtents.remove(layerInfo.graphicsItem);
+    } else {
+        layerExtents[layerInfo.graphicsItem] = store.extent().toRectF();
+    }
+}
+
+QRectF MainWindow::combinedLayerExtent() const
+{
+    // United by hand: QRectF::united() drops zero-size extents of single points
+    bool any = false;
+    double minX = 0.0, minY = 0.0, maxX = 0.0, maxY = 0.0;
+    for (const QRectF &extent : layerExtents) {
+        if (!any) {
+            minX = extent.left();
+            minY = extent.top();
+            maxX = extent.right();
+            maxY = extent.bottom();
+            any = true;
+        } else {
+            minX = qMin(minX, extent.left());
+            minY = qMin(minY, extent.top());
+            maxX = qMax(maxX, extent.right());
+            maxY = qMax(maxY, extent.bottom());
+        }
+    }
+    return any ? QRectF(minX, minY, maxX - minX, maxY - minY) : QRectF();
+}
+
+QRectF MainWindow::layersSceneBounds()
+{
+    // Registered layers map their cached extent; images use their item
+    QTransform mapToScene = mapToSceneTransform();
+    QRectF bounds;
+    for (const LayerInfo &layer : loadedLayers) {
+        QRectF layerBounds;
+        QHash<const QGraphicsItem*, QRectF>::const_iterator extent = layerExtents.constFind(layer.graphicsItem);
+        if (extent != layerExtents.constEnd()) {
+            layerBounds = mapToScene.mapRect(extent.value());
+        } else if (layer.graphicsItem) {
+            layerBounds = layer.graphicsItem->sceneBoundingRect();
+        }
+        if (!layerBounds.isEmpty()) bounds = bounds.isEmpty() ? layerBounds : bounds.united(layerBounds);
+    }
+    return bounds;
 }
 
-void MainWindow::drawPoint(OGRPoint *point, const QColor &color, double scaleFactor)
+void MainWindow::onBenchmarkVectorLoading()
 {
-    if (!point || !mapScene) return;
+    QString fileName = QFileDialog::getOpenFileName(this,
+                                                    "Benchmark Vector Loading",
+                                                    lastUsedDirectory,
+                                                    "Vector Files (*.gpkg *.parquet *.arrow *.fgb *.shp *.geojson);;"
+                                                    "All Files (*)");
+    if (fileName.isEmpty()) return;
 
-    double x = point->getX();
-    double y = point->getY();
+    GDALDataset *dataset = (GDALDataset*)GDALOpenEx(
+                fileName.toUtf8().constData(),
+                GDAL_OF_VECTOR | GDAL_OF_READONLY,
+                nullptr, nullptr, nullptr);
+    if (!dataset || dataset->GetLayerCount() == 0) {
+        QMessageBox::critical(this, "Benchmark", "Could not open vector file:\n" + fileName);
+        if (dataset) GDALClose(dataset);
+        return;
+    }
 
-    // Scale coordinates
-    x = x * scaleFactor;
-    y = y * -scaleFactor; // Invert Y for proper display
+    OGRLayer *layer = dataset->GetLayer(0);
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+
+    // An untimed pass of each path warms the file cache and the driver and
+    // gives the counts to compare
+    FeatureStorePtr iteratorStore = FeatureLoader::loadWithFeatureIterator(layer);
+    qint64 featureCount = iteratorStore->featureCount();
+    qint64 vertexCount = iteratorStore->vertexCount();
+    iteratorStore.clear();
+
+    bool fastArrow = FeatureLoader::hasFastArrowStream(dataset, layer);
+    FeatureStorePtr arrowStore = FeatureLoader::loadWithArrowStream(layer);
+    bool arrowOk = !arrowStore.isNull();
+    bool countsMatch = arrowOk && arrowStore->featureCount() == featureCount &&
+            arrowStore->vertexCount() == vertexCount;
+    arrowStore.clear();
+
+    // Timed runs take turns going first; each path reports its median
+    const int runs = 5;
+    QVector<qint64> iteratorTimes;
+    QVector<qint64> arrowTimes;
+    QElapsedTimer timer;
+    for (int run = 0; run < runs; ++run) {
+        for (int turn = 0; turn < 2; ++turn) {
+            bool arrowTurn = (run + turn) % 2 == 1;
+            if (arrowTurn && !arrowOk) continue;
+            timer.start();
+            FeatureStorePtr store = arrowTurn ? FeatureLoader::loadWithArrowStream(layer)
+                                              : FeatureLoader::loadWithFeatureIterator(layer);
+            (arrowTurn ? arrowTimes : iteratorTimes).append(timer.elapsed());
+        }
+    }
+    std::sort(iteratorTimes.begin(), iteratorTimes.end());
+    std::sort(arrowTimes.begin(), arrowTimes.end());
+    qint64 iteratorMs = iteratorTimes[runs / 2];
+    qint64 arrowMs = arrowOk ? arrowTimes[runs / 2] : 0;
+
+    QApplication::restoreOverrideCursor();
+    GDALClose(dataset);
 
-    // Create a circle for the point
-    double pointSize = 6.0;
-    QGraphicsEllipseItem *item = mapScene->addEllipse(x - pointSize/2, y - pointSize/2,
-                                                      pointSize, pointSize);
-    item->setPen(QPen(color, 1));
-    item->setBrush(QBrush(color));
+    QString report = QString("<b>%1</b> (%2 features, %3 vertices)<br>"
+                             "Median of %4 runs after a warm-up, alternating which path goes first<br><br>")
+            .arg(QFileInfo(fileName).fileName())
+            .arg(featureCount)
+            .arg(vertexCount)
+            .arg(runs);
+    report += QString("Feature iterator: %1 ms (%2 features/s)<br>")
+            .arg(iteratorMs)
+            .arg(iteratorMs > 0 ? featureCount * 1000 / iteratorMs : featureCount);
+    if (arrowOk) {
+        report += QString("Arrow stream%1: %2 ms (%3 features/s)<br>")
+                .arg(fastArrow ? "" : " (generic driver implementation)")
+                .arg(arrowMs)
+                .arg(arrowMs > 0 ? featureCount * 1000 / arrowMs : featureCount);
+        report += QString("<br>Speed-up: %1x<br>")
+                .arg(arrowMs > 0 ? double(iteratorMs) / arrowMs : 0.0, 0, 'f', 2);
+        report += countsMatch ? "Both paths produced identical feature and vertex counts."
+                              : "<font color='red'>Feature or vertex counts differ between paths!</font>";
+    } else {
+        report += "Arrow stream: not available for this driver / GDAL version";
+    }
 
-    // Store in current vector items
-    currentVectorItems.append(item);
+    qDebug() << "Vector load benchmark" << fileName << "iterator ms:" << iteratorMs
+             << "arrow ms:" << (arrowOk ? arrowMs : -1);
 
-    // Optional: Add tooltip with coordinates
-    item->setToolTip(QString("Point: %1, %2").arg(x/scaleFactor).arg(-y/scaleFactor));
+    QMessageBox::information(this, "Vector Loading Benchmark", report);
 }
 
-void MainWindow::drawLine(OGRLineString *line, const QColor &color, double scaleFactor)
+void MainWindow::identifyFeatures(const QPoint &viewPos)
 {
-    if (!line || !mapScene) return;
+    if (!mapView) return;
 
-    int pointCount = line->getNumPoints();
-    if (pointCount < 2) return;
+    // Search tolerance of a few screen pixels
+    QPointF scenePos = mapView->mapToScene(viewPos);
+    QPointF toleranceScenePos = mapView->mapToScene(viewPos + QPoint(3, 0));
 
-    QPainterPath path;
+    QTreeWidget *resultsTree = new QTreeWidget();
+    resultsTree->setHeaderLabels(QStringList() << "Feature" << "Value");
+    int totalHits = 0;
 
-    OGRPoint point;
-    line->getPoint(0, &point);
-    double x = point.getX() * scaleFactor;
-    double y = point.getY() * -scaleFactor;
+    for (const LayerInfo &layer : loadedLayers) {
+        if (!layer.featureStore || !layer.graphicsItem || !layer.graphicsItem->isVisible()) {
+            continue;
+        }
+
+        QPointF mapPos = layer.graphicsItem->mapFromScene(scenePos);
+        double tolerance = QLineF(mapPos, layer.graphicsItem->mapFromScene(toleranceScenePos)).length();
 
-    path.moveTo(x, y);
+        const FeatureStore &store = *layer.featureStore;
+        QVector<qint64> hits = store.featuresAt(mapPos.x(), mapPos.y(), tolerance);
+        if (hits.isEmpty()) continue;
+
+        QTreeWidgetItem *layerItem = new QTreeWidgetItem(resultsTree, QStringList() << layer.name);
+        layerItem->setIcon(0, QIcon(":/icons/vector_layer.png"));
+        layerItem->setExpanded(true);
+
+        for (int i = 0; i < hits.size() && i < 100; ++i) {
+            qint64 feature = hits[i];
+            QTreeWidgetItem *featureItem = new QTreeWidgetItem(
+                        layerItem, QStringList() << QString("FID %1").arg(store.featureId(feature)));
+            for (int field = 0; field < store.fieldCount(); ++field) {
+                QVariant value = store.attribute(field, feature);
+                new QTreeWidgetItem(featureItem, QStringList()
+                                    << store.field(field).name
+                                    << (value.isNull() ? QString("NULL") : value.toString()));
+            }
+            featureItem->setExpanded(hits.size() == 1);
+        }
+        totalHits += hits.size();
+    }
 
-    for (int i = 1; i < pointCount; i++) {
-        line->getPoint(i, &point);
-        x = point.getX() * scaleFactor;
-        y = point.getY() * -scaleFactor;
-        path.lineTo(x, y);
+    if (totalHits == 0) {
+        delete resultsTree;
+        if (messageLabel) {
+            messageLabel->setText("Identify: no features found");
+        }
+        return;
     }
 
-    QGraphicsPathItem *item = mapScene->addPath(path);
-    item->setPen(QPen(color, 2));
+    QDialog *dialog = new QDialog(this);
+    dialog->setWindowTitle("Identify Results");
+    dialog->resize(400, 450);
+
+    QVBoxLayout *layout = new QVBoxLayout(dialog);
+    layout->addWidget(resultsTree);
+    resultsTree->header()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
+
+    if (messageLabel) {
+        messageLabel->setText(QString("Identify: %1 feature(s) found").arg(totalHits));
+    }
+
+    dialog->exec();
+    delete dialog;
+}
+
+QPointF MainWindow::getVectorItemCoordinates(QGraphicsItem *item, const QPointF &scenePos)
+{
+    // Vector items work in map units of the project CRS
+    return item ? item->mapFromScene(scenePos) : QPointF();
+}
+
+void MainWindow::highlightVectorItem(QGraphicsItem *item, bool highlight)
+{
+    VectorLayerItem *vectorItem = qgraphicsitem_cast<VectorLayerItem*>(item);
+    if (vectorItem) {
+        vectorItem->setHoveredFeature(highlight ? hoveredFeature : -1);
+    }
+}
+
+void MainWindow::trackVectorItemHover(QGraphicsItem *item, const QPointF &scenePos)
+{
+    VectorLayerItem *vectorItem = qgraphicsitem_cast<VectorLayerItem*>(item);
+    if (!vectorItem || !vectorItem->featureStore() || !mapView) return;
+
+    // Three screen pixels of tolerance, in map units
+    QPointF mapPos = getVectorItemCoordinates(item, scenePos);
+    QPointF toleranceScenePos = mapView->mapToScene(hoverViewPos + QPoint(3, 0));
+    double tolerance = QLineF(mapPos, getVectorItemCoordinates(item, toleranceScenePos)).length();
+
+    const FeatureStore &store = *vectorItem->featureStore();
+    QVector<qint64> hits = store.featuresAt(mapPos.x(), mapPos.y(), tolerance);
+    if (hits.isEmpty()) return;
+
+    // The last feature is drawn on top
+    qint64 feature = hits.last();
+    if (item == hoveredItem && feature == hoveredFeature) return;
+
+    clearHover();
+    hoveredItem = item;
+    hoveredFeature = feature;
+    highlightVectorItem(item, true);
+
+    // Tooltip text is only built for the feature under the mouse
+    QString layerName;
+    for (const LayerInfo &layer : loadedLayers) {
+        if (layer.graphicsItem == item) {
+            layerName = layer.name;
+            break;
+        }
+    }
+
+    QString tooltip = QString("<b>%1</b><br>FID: %2").arg(layerName.toHtmlEscaped()).arg(store.featureId(feature));
+    int shownFields = qMin(store.fieldCount(), 8);
+    for (int field = 0; field < shownFields; ++field) {
+        QVariant value = store.attribute(field, feature);
+        tooltip += QString("<br>%1: %2")
+                .arg(store.field(field).name.toHtmlEscaped())
+                .arg(value.isNull() ? QString("NULL") : value.toString().left(80).toHtmlEscaped());
+    }
+    if (store.fieldCount() > shownFields) {
+        tooltip += QString("<br><i>%1 more field(s)</i>").arg(store.fieldCount() - shownFields);
+    }
+
+    QToolTip::showText(mapView->viewport()->mapToGlobal(hoverViewPos), tooltip, mapView->viewport());
+}
+
+void MainWindow::scheduleHoverUpdate(const QPoint &viewPos)
+{
+    hoverViewPos = viewPos;
+
+    if (!hoverTimer) {
+        // One lookup per display frame, however fast the mouse events arrive
+        double refreshRate = 60.0;
+        if (QScreen *screen = QGuiApplication::primaryScreen()) {
+            refreshRate = qMax(30.0, screen->refreshRate());
+        }
+        hoverTimer = new QTimer(this);
+        hoverTimer->setSingleShot(true);
+        hoverTimer->setInterval(qMax(1, int(1000.0 / refreshRate)));
+        connect(hoverTimer, &QTimer::timeout, this, &MainWindow::updateHover);
+    }
+
+    if (!hoverTimer->isActive()) {
+        hoverTimer->start();
+    }
+}
+
+void MainWindow::updateHover()
+{
+    if (!mapView) return;
+    QPointF scenePos = mapView->mapToScene(hoverViewPos);
+
+    // Topmost layer first
+    for (int i = loadedLayers.size() - 1; i >= 0; --i) {
+        QGraphicsItem *item = loadedLayers[i].graphicsItem;
+        if (!loadedLayers[i].featureStore || !item || !item->isVisible()) continue;
+        if (!item->sceneBoundingRect().contains(scenePos)) continue;
+
+        trackVectorItemHover(item, scenePos);
+        if (hoveredItem == item) return;
+    }
+
+    clearHover();
+}
+
+void MainWindow::clearHover()
+{
+    if (hoveredItem) {
+        // The item may have been removed since it was hovered
+        for (const LayerInfo &layer : loadedLayers) {
+            if (layer.graphicsItem == hoveredItem) {
+                highlightVectorItem(hoveredItem, false);
+                break;
+            }
+        }
+        QToolTip::hideText();
+    }
+    hoveredItem = nullptr;
+    hoveredFeature = -1;
+}
+
+void MainWindow::selectFeatures(const QPolygonF &scenePolygon, FeatureSelection::Mode mode,
+                                bool rectangle)
+{
+    if (scenePolygon.size() < 3) return;
+
+    GeosContext geos;
+
+    for (LayerInfo &layer : loadedLayers) {
+        VectorLayerItem *vectorItem = dynamic_cast<VectorLayerItem*>(layer.graphicsItem);
+        if (!layer.featureStore || !vectorItem || !vectorItem->isVisible()) continue;
+
+        const FeatureStore &store = *layer.featureStore;
+        if (!layer.selection) {
+            layer.selection = FeatureSelectionPtr(new FeatureSelection(store.featureCount()));
+            vectorItem->setSelection(layer.selection);
+        }
+
+        // Selection shape in the layer's map units
+        QPolygonF mapPolygon = vectorItem->mapFromScene(scenePolygon);
+        QRectF bounds = mapPolygon.boundingRect();
+        bool axisAligned = rectangle && vectorItem->sceneTransform().type() <= QTransform::TxScale;
+
+        // Spatial index first, exact test only for what it returns
+        QVector<qint64> candidates = store.featuresIn(FeatureStore::Extent::fromRectF(bounds));
+
+        GEOSGeometry *shape = GeosUtils::fromPolygon(geos.handle(), mapPolygon);
+        if (!shape) continue;
+        const GEOSPreparedGeometry *prepared = GEOSPrepare_r(geos.handle(), shape);
+
+        QVector<qint64> hits;
+        for (qint64 f : candidates) {
+            // Features entirely inside a rectangle need no exact test
+            const FeatureStore::Extent &extent = store.featureExtent(f);
+            if (axisAligned && extent.minX >= bounds.left() && extent.maxX <= bounds.right() &&
+                    extent.minY >= bounds.top() && extent.maxY <= bounds.bottom()) {
+                hits.append(f);
+                continue;
+            }
+
+            GEOSGeometry *geometry = GeosUtils::fromFeature(geos.handle(), store, f);
+            if (!geometry) continue;
+            if (GEOSPreparedIntersects_r(geos.handle(), prepared, geometry) == 1) {
+                hits.append(f);
+            }
+            GEOSGeom_destroy_r(geos.handle(), geometry);
+        }
 
-    // Store in current vector items
-    currentVectorItems.append(item);
+        GEOSPreparedGeom_destroy_r(geos.handle(), prepared);
+        GEOSGeom_destroy_r(geos.handle(), shape);
+
+        layer.selection->apply(hits, mode);
+        layer.properties["selected_count"] = layer.selection->selectedCount();
+        vectorItem->update();
+    }
+
+    updateSelectionStatus();
+}
 
-    // Optional: Add tooltip
-    item->setToolTip(QString("Line with %1 points").arg(pointCount));
+void MainWindow::selectFeaturesInRectangle(const QRectF &sceneRect, FeatureSelection::Mode mode)
+{
+    selectFeatures(QPolygonF(sceneRect.normalized()), mode, true);
 }
 
-void MainWindow::drawPolygon(OGRPolygon *polygon, const QColor &color, double scaleFactor)
+void MainWindow::selectFeaturesInRadius(const QPointF &sceneCenter, double sceneRadius,
+                                        FeatureSelection::Mode mode)
 {
-    if (!polygon || !mapScene) return;
+    if (sceneRadius <= 0.0) return;
+
+    // Circle as a 64-sided polygon
+    QPolygonF circle;
+    for (int i = 0; i < 64; ++i) {
+        double angle = i * 2.0 * M_PI / 64;
+        circle << QPointF(sceneCenter.x() + cos(angle) * sceneRadius,
+                          sceneCenter.y() + sin(angle) * sceneRadius);
+    }
+    selectFeatures(circle, mode);
+}
 
-    // Outer ring
-    OGRLinearRing *ring = polygon->getExteriorRing();
-    if (!ring || ring->getNumPoints() < 3) return;
+void MainWindow::updateSelectionStatus()
+{
+    qint64 selected = 0;
+    int layers = 0;
+    for (const LayerInfo &layer : loadedLayers) {
+        if (layer.selection && !layer.selection->isEmpty()) {
+            selected += layer.selection->selectedCount();
+            layers++;
+        }
+    }
 
-    QPainterPath path;
+    if (messageLabel) {
+        messageLabel->setText(QString("%1 feature(s) selected in %2 layer(s)").arg(selected).arg(layers));
+    }
+}
 
-    OGRPoint point;
-    ring->getPoint(0, &point);
-    double x = point.getX() * scaleFactor;
-    double y = point.getY() * -scaleFactor;
+void MainWindow::clearSelectionRubberBand()
+{
+    if (selectionRubberBand) {
+        mapScene->removeItem(selectionRubberBand);
+        delete selectionRubberBand;
+        selectionRubberBand = nullptr;
+    }
+    selectionDragging = false;
+    selectionPolygon.clear();
+}
 
-    path.moveTo(x, y);
+bool MainWindow::handleSelectionToolEvent(QEvent *event)
+{
+    bool rectangleTool = selectRectangleAction && selectRectangleAction->isChecked();
+    bool polygonTool = selectPolygonAction && selectPolygonAction->isChecked();
+    bool radiusTool = selectRadiusAction && selectRadiusAction->isChecked();
+    if (!mapScene || !(rectangleTool || polygonTool || radiusTool)) return false;
 
-    for (int i = 1; i < ring->getNumPoints(); i++) {
-        ring->getPoint(i, &point);
-        x = point.getX() * scaleFactor;
-        y = point.getY() * -scaleFactor;
-        path.lineTo(x, y);
+    QEvent::Type type = event->type();
+    if (type != QEvent::MouseButtonPress && type != QEvent::MouseMove &&
+            type != QEvent::MouseButtonRelease && type != QEvent::MouseButtonDblClick) {
+        return false;
     }
-    path.closeSubpath();
 
-    // Draw interior rings (holes) if any
-    int interiorRingCount = polygon->getNumInteriorRings();
-    for (int r = 0; r < interiorRingCount; r++) {
-        OGRLinearRing *interiorRing = polygon->getInteriorRing(r);
-        if (interiorRing && interiorRing->getNumPoints() >= 3) {
-            OGRPoint interiorPoint;
-            interiorRing->getPoint(0, &interiorPoint);
-            double ix = interiorPoint.getX() * scaleFactor;
-            double iy = interiorPoint.getY() * -scaleFactor;
+    QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(event);
+    QPointF scenePos = mapView->mapToScene(mouseEvent->pos());
 
-            path.moveTo(ix, iy);
+    FeatureSelection::Mode mode = FeatureSelection::ReplaceSelection;
+    if (mouseEvent->modifiers() & Qt::ShiftModifier) {
+        mode = FeatureSelection::AddToSelection;
+    } else if (mouseEvent->modifiers() & Qt::ControlModifier) {
+        mode = FeatureSelection::RemoveFromSelection;
+    }
+
+    QPen rubberPen(QColor(255, 200, 0), 2, Qt::DashLine);
+    rubberPen.setCosmetic(true);
+    QBrush rubberBrush(QColor(255, 255, 0, 40));
 
-            for (int i = 1; i < interiorRing->getNumPoints(); i++) {
-                interiorRing->getPoint(i, &interiorPoint);
-                ix = interiorPoint.getX() * scaleFactor;
-                iy = interiorPoint.getY() * -scaleFactor;
-                path.lineTo(ix, iy);
+    if (rectangleTool || radiusTool) {
+        if (type == QEvent::MouseButtonPress && mouseEvent->button() == Qt::LeftButton) {
+            clearSelectionRubberBand();
+            selectionDragging = true;
+            selectionStartPos = scenePos;
+            if (rectangleTool) {
+                selectionRubberBand = mapScene->addRect(QRectF(scenePos, scenePos), rubberPen, rubberBrush);
+                selectionRubberBand->setZValue(1e6);
+            } else {
+                selectionRubberBand = highlightAreaAroundPoint(scenePos.x(), scenePos.y(), 0.0);
+            }
+            return true;
+        }
+        if (type == QEvent::MouseMove && selectionDragging) {
+            if (rectangleTool) {
+                static_cast<QGraphicsRectItem*>(selectionRubberBand)->setRect(
+                            QRectF(selectionStartPos, scenePos).normalized());
+            } else {
+                // The area highlight with its radial lines, drawn again at the new radius
+                double radius = QLineF(selectionStartPos, scenePos).length();
+                mapScene->removeItem(selectionRubberBand);
+                delete selectionRubberBand;
+                selectionRubberBand = highlightAreaAroundPoint(selectionStartPos.x(), selectionStartPos.y(),
+                                                               radius);
+            }
+            return false; // Coordinates display still follows the mouse
+        }
+        if (type == QEvent::MouseButtonRelease && selectionDragging &&
+                mouseEvent->button() == Qt::LeftButton) {
+            QPointF startPos = selectionStartPos;
+            clearSelectionRubberBand();
+
+            // A click without dragging picks what is under the cursor
+            double pickRadius = QLineF(mapView->mapToScene(QPoint(0, 0)),
+                                       mapView->mapToScene(QPoint(3, 0))).length();
+            double dragLength = QLineF(startPos, scenePos).length();
+
+            if (rectangleTool) {
+                QRectF rect = QRectF(startPos, scenePos).normalized();
+                if (dragLength < pickRadius) {
+                    rect = QRectF(startPos.x() - pickRadius, startPos.y() - pickRadius,
+                                  pickRadius * 2, pickRadius * 2);
+                }
+                selectFeaturesInRectangle(rect, mode);
+            } else {
+                selectFeaturesInRadius(startPos, qMax(dragLength, pickRadius), mode);
             }
-            path.closeSubpath();
+            return true;
+        }
+        return false;
+    }
+
+    // Polygon tool: left click adds a vertex, right click or double click closes
+    if (type == QEvent::MouseButtonPress && mouseEvent->button() == Qt::LeftButton) {
+        if (selectionPolygon.isEmpty()) {
+            clearSelectionRubberBand();
+            QGraphicsPolygonItem *polygonItem = mapScene->addPolygon(QPolygonF(), rubberPen, rubberBrush);
+            polygonItem->setZValue(1e6);
+            selectionRubberBand = polygonItem;
+        }
+        selectionPolygon << scenePos;
+        static_cast<QGraphicsPolygonItem*>(selectionRubberBand)->setPolygon(selectionPolygon);
+        return true;
+    }
+    if (type == QEvent::MouseMove && selectionRubberBand && !selectionPolygon.isEmpty()) {
+        QPolygonF preview = selectionPolygon;
+        preview << scenePos;
+        static_cast<QGraphicsPolygonItem*>(selectionRubberBand)->setPolygon(preview);
+        return false;
+    }
+    if ((type == QEvent::MouseButtonDblClick && mouseEvent->button() == Qt::LeftButton) ||
+            (type == QEvent::MouseButtonPress && mouseEvent->button() == Qt::RightButton)) {
+        QPolygonF polygon = selectionPolygon;
+        clearSelectionRubberBand();
+        if (polygon.size() >= 3) {
+            selectFeatures(polygon, mode);
         }
+        return true;
     }
+    return false;
+}
 
-    QGraphicsPathItem *item = mapScene->addPath(path);
-    QPen pen(color, 1);
-    item->setPen(pen);
+void MainWindow::onSelectionToolToggled(bool checked)
+{
+    clearSelectionRubberBand();
+    if (!checked) return;
 
-    // Fill polygon with semi-transparent color
-    QColor fillColor = color;
-    fillColor.setAlpha(100); // 40% opacity
-    item->setBrush(QBrush(fillColor));
+    // Only one map tool at a time
+    QAction *tool = qobject_cast<QAction*>(sender());
+    QList<QAction*> tools = {selectRectangleAction, selectPolygonAction, selectRadiusAction};
+    for (QAction *other : tools) {
+        if (other != tool) other->setChecked(false);
+    }
+    if (identifyAction) identifyAction->setChecked(false);
+    if (coordinatesToolBtn) coordinatesToolBtn->setChecked(false);
 
-    // Store in current vector items
-    currentVectorItems.append(item);
+    if (messageLabel && tool) {
+        messageLabel->setText(tool->text() + " - Shift adds, Ctrl removes");
+    }
+}
 
-    // Optional: Add tooltip
-    item->setToolTip(QString("Polygon with %1 rings").arg(interiorRingCount + 1));
+void MainWindow::onDeselectAll()
+{
+    for (LayerInfo &layer : loadedLayers) {
+        if (!layer.selection) continue;
+        layer.selection->clear();
+        layer.properties["selected_count"] = 0;
+        if (layer.graphicsItem) layer.graphicsItem->update();
+    }
+    updateSelectionStatus();
+}
+
+void MainWindow::onZoomToSelection()
+{
+    QRectF sceneRect;
+    for (const LayerInfo &layer : loadedLayers) {
+        if (!layer.selection || layer.selection->isEmpty() || !layer.graphicsItem) continue;
+
+        const FeatureStore &store = *layer.featureStore;
+        FeatureStore::Extent extent = FeatureStore::Extent::null();
+        for (qint64 f : layer.selection->selectedFeatures()) {
+            const FeatureStore::Extent &featureExtent = store.featureExtent(f);
+            if (featureExtent.isNull()) continue;
+            extent.minX = qMin(extent.minX, featureExtent.minX);
+            extent.minY = qMin(extent.minY, featureExtent.minY);
+            extent.maxX = qMax(extent.maxX, featureExtent.maxX);
+            extent.maxY = qMax(extent.maxY, featureExtent.maxY);
+        }
+        if (extent.isNull()) continue;
+
+        QRectF layerRect = layer.graphicsItem->mapRectToScene(extent.toRectF());
+        sceneRect = sceneRect.isNull() ? layerRect : sceneRect.united(layerRect);
+    }
+
+    if (sceneRect.isNull() || !mapView) {
+        if (messageLabel) messageLabel->setText("No features selected");
+        return;
+    }
+
+    // Single points get some room around them
+    double margin = qMax(sceneRect.width(), sceneRect.height()) * 0.1;
+    if (margin <= 0.0) margin = 10.0;
+    mapView->fitInView(sceneRect.adjusted(-margin, -margin, margin, margin), Qt::KeepAspectRatio);
+    currentScale = mapView->transform().m11();
+    updateScale(currentScale);
+}
+
+void MainWindow::onShowRenderStatistics()
+{
+    VectorLayerItem::RenderCounters counters = VectorLayerItem::renderCounters();
+
+    QMessageBox box(this);
+    box.setWindowTitle("Render Statistics");
+    box.setIcon(QMessageBox::Information);
+    box.setText(QString("Background layer renders: %1 started, %2 completed, %3 canceled")
+                .arg(counters.started).arg(counters.completed).arg(counters.canceled));
+    box.setInformativeText(QString("Features drawn: %1\n"
+                                   "Features skipped by canceled renders: %2\n"
+                                   "Time in completed renders: %3 ms\n"
+                                   "Time in canceled renders before they stopped: %4 ms")
+                           .arg(counters.featuresDrawn)
+                           .arg(counters.featuresSkipped)
+                           .arg(counters.completedMs)
+                           .arg(counters.canceledMs));
+    QPushButton *resetButton = box.addButton("Reset", QMessageBox::ResetRole);
+    box.addButton(QMessageBox::Close);
+    box.exec();
+
+    if (box.clickedButton() == resetButton) {
+        VectorLayerItem::resetRenderCounters();
+    }
 }
 
 void MainWindow::clearVectorItems(const QString &layerName)
 {
+    clearHover();
+
+    // Store-backed layers own a single scene item
+    for (LayerInfo &layer : loadedLayers) {
+        if (!layer.featureStore) continue;
+        if (!layerName.isEmpty() && layer.name != layerName) continue;
+
+        if (layer.graphicsItem && mapScene) {
+            layerExtents.remove(layer.graphicsItem);
+            mapScene->removeItem(layer.graphicsItem);
+            delete layer.graphicsItem;
+        }
+        layer.graphicsItem = nullptr;
+        layer.featureStore.clear();
+        layer.sourceStore.clear();
+    }
+
     if (layerName.isEmpty()) {
         // Clear all vector items
         for (QGraphicsItem *item : currentVectorItems) {
@@ -5599,29 +8029,111 @@ void MainWindow::setupProjectionSystem()
 
 void MainWindow::onExportMap()
 {
-    QString fileName = QFileDialog::getSaveFileName(this,
-                                                    "Export Map",
-                                                    QDir(getSaveLocation()).filePath(currentProjectName + "_export.pdf"),
-                                                    "PDF Files (*.pdf);;PNG Files (*.png);;JPEG Files (*.jpg);;All Files (*)");
+    exportMap("Export Map", "pdf",
+              "PDF Files (*.pdf);;PNG Files (*.png);;GeoTIFF Files (*.tif *.tiff);;All Files (*)");
+}
 
-    if (!fileName.isEmpty()) {
-        // Create a high-resolution render of the map view
-        if (mapView && mapScene) {
-            QImage image(mapView->viewport()->size(), QImage::Format_ARGB32);
-            image.fill(Qt::white);
+void MainWindow::exportMap(const QString &title, const QString &defaultSuffix, const QString &filter)
+{
+    if (!mapView || !mapScene) return;
 
-            QPainter painter(&image);
-            mapView->render(&painter);
-            painter.end();
+    QString fileName = QFileDialog::getSaveFileName(this, title,
+                                                    QDir(getSaveLocation()).filePath(currentProjectName + "_export." + defaultSuffix),
+                                                    filter);
+    if (fileName.isEmpty()) return;
+    if (QFileInfo(fileName).suffix().isEmpty()) fileName += "." + defaultSuffix;
 
-            if (image.save(fileName)) {
-                if (messageLabel) {
-                    messageLabel->setText("Map exported to: " + fileName);
-                }
-                QMessageBox::information(this, "Export Successful",
-                                         QString("Map exported to:\n%1").arg(fileName));
-            }
+    MapExporter::Format format;
+    if (!MapExporter::formatForPath(fileName, &format)) {
+        QMessageBox::warning(this, title, "Maps can be exported as PDF, PNG or GeoTIFF.");
+        return;
+    }
+
+    QRectF viewRect = mapView->mapToScene(mapView->viewport()->rect()).boundingRect();
+    QRectF allRect = layersSceneBounds();
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(title);
+    QFormLayout *form = new QFormLayout(&dialog);
+
+    QComboBox *extentCombo = new QComboBox();
+    extentCombo->addItem("Current map view");
+    if (!allRect.isEmpty()) extentCombo->addItem("All layers");
+    form->addRow("Extent:", extentCombo);
+
+    QSpinBox *widthSpin = new QSpinBox();
+    widthSpin->setRange(16, 100000);
+    widthSpin->setSuffix(" px");
+    widthSpin->setValue(mapView->viewport()->width() * 300 / 96);
+    form->addRow("Width:", widthSpin);
+
+    QLabel *heightLabel = new QLabel();
+    form->addRow("Height:", heightLabel);
+
+    QSpinBox *dpiSpin = new QSpinBox();
+    dpiSpin->setRange(24, 2400);
+    dpiSpin->setValue(300);
+    form->addRow("Resolution (dpi):", dpiSpin);
+
+    // Height follows the aspect ratio of the chosen extent
+    auto extentRect = [&]() { return extentCombo->currentIndex() == 1 ? allRect : viewRect; };
+    auto outputHeight = [&]() {
+        QRectF rect = extentRect();
+        return rect.width() > 0.0 ? qMax(1, qRound(widthSpin->value() * rect.height() / rect.width())) : 1;
+    };
+    auto updateHeight = [&]() { heightLabel->setText(QString("%1 px").arg(outputHeight())); };
+    connect(widthSpin, QOverload<int>::of(&QSpinBox::valueChanged), &dialog, updateHeight);
+    connect(extentCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), &dialog, updateHeight);
+    updateHeight();
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    form->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    MapExporter::Options options;
+    options.sceneRect = extentRect();
+    options.size = QSize(widthSpin->value(), outputHeight());
+    options.dpi = dpiSpin->value();
+    options.background = mapScene->backgroundBrush().style() == Qt::NoBrush
+            ? QColor(Qt::white) : mapScene->backgroundBrush().color();
+    options.sceneToMap = mapToSceneTransform().inverted();
+    options.crs = projectCrs();
+
+    // The snapshot of the scene is taken here; label placement, rendering
+    // and writing run behind the progress dialog
+    MapExporter exporter(options);
+    exporter.prepare(mapScene);
+
+    Geoprocessing::Feedback feedback;
+    MapExporter::Statistics stats;
+    QString error;
+    bool ok = false;
+    runWithProgress(title, feedback, [&]() {
+        ok = exporter.write(fileName, format, &feedback, &stats, &error);
+    });
+
+    if (!ok) {
+        if (feedback.isCanceled()) {
+            if (messageLabel) messageLabel->setText("Export canceled");
+        } else {
+            QMessageBox::warning(this, title, error.isEmpty() ? QString("Export failed.") : error);
         }
+        return;
+    }
+
+    if (messageLabel) {
+        QString parts = format == MapExporter::Pdf
+                ? QString("%1 pages").arg(stats.pages)
+                : QString("%1 tiles on %2 threads").arg(stats.tiles).arg(stats.threads);
+        messageLabel->setText(QString("Exported %1 x %2 px map in %3 ms (%4): %5")
+                              .arg(options.size.width())
+                              .arg(options.size.height())
+                              .arg(stats.elapsedMs)
+                              .arg(parts)
+                              .arg(fileName));
     }
 }
 void MainWindow::onOpenAttributeTable()
@@ -5642,31 +8154,35 @@ void MainWindow::onOpenAttributeTable()
         searchEdit->setPlaceholderText("Filter attributes...");
         layout->addWidget(searchEdit);
 
-        // Create table widget
-        QTableWidget *table = new QTableWidget();
+        // Attribute columns come straight from the layer's feature store
+        FeatureStorePtr store;
+        for (const LayerInfo &layer : loadedLayers) {
+            if (layer.name == layerName && layer.featureStore) {
+                store = layer.featureStore;
+                break;
+            }
+        }
+
+        AttributeTableModel *model = new AttributeTableModel(store, dialog);
+        QSortFilterProxyModel *proxy = new QSortFilterProxyModel(dialog);
+        proxy->setSourceModel(model);
+        proxy->setFilterKeyColumn(-1);
+        proxy->setFilterCaseSensitivity(Qt::CaseInsensitive);
+        connect(searchEdit, &QLineEdit::textChanged, proxy, &QSortFilterProxyModel::setFilterFixedString);
+
+        QTableView *table = new QTableView();
+        table->setModel(proxy);
         table->setAlternatingRowColors(true);
         table->setSortingEnabled(true);
         table->setSelectionBehavior(QAbstractItemView::SelectRows);
-
-        // For vector layers, you could load actual attributes from GDAL
-        // For now, create sample data
-        table->setColumnCount(5);
-        table->setHorizontalHeaderLabels({"ID", "Name", "Type", "Area", "Length"});
-        table->setRowCount(50);
-
-        for (int row = 0; row < 50; ++row) {
-            for (int col = 0; col < 5; ++col) {
-                QTableWidgetItem *item = new QTableWidgetItem(
-                            QString("Data %1-%2").arg(row+1).arg(col+1));
-                table->setItem(row, col, item);
-            }
-        }
+        table->verticalHeader()->setDefaultSectionSize(22);
 
         layout->addWidget(table);
 
         // Add statistics
         QLabel *statsLabel = new QLabel(
-                    QString("Showing %1 features").arg(table->rowCount()));
+                    store ? QString("Showing %1 features").arg(store->featureCount())
+                          : QString("Layer has no attribute table"));
         layout->addWidget(statsLabel);
 
         dialog->exec();
@@ -6214,6 +8730,19 @@ void MainWindow::onCRSChanged(const QString &crs)
         appSettings->setValue("currentCRS", crs);
         appSettings->setValue("currentCRSDisplay", displayName);
     }
+
+    // Bring vector layers into the new CRS
+    bool reprojected = false;
+    for (LayerInfo &layer : loadedLayers) {
+        if (layer.featureStore) {
+            reprojectVectorLayer(layer);
+            reprojected = true;
+        }
+    }
+    applyMapToSceneTransform();
+    if (reprojected) {
+        fitAllImages();
+    }
     qDebug() << "CRS changed to:" << crs << "(" << displayName << ")";
 
     animateCRSChange();
@@ -6444,7 +8973,9 @@ bool MainWindow::storeImageInDatabase(const QString &filePath,
             if (dataset) {
                 OGRLayer *layer = dataset->GetLayer(0);
                 if (layer) {
-                    metadata["feature_count"] = (int)layer->GetFeatureCount();
+                    // Only the header count; -1 would mean a full scan was needed
+                    GIntBig featureCount = layer->GetFeatureCount(FALSE);
+                    if (featureCount >= 0) metadata["feature_count"] = qint64(featureCount);
                     metadata["geometry_type"] = OGRGeometryTypeToName(layer->GetGeomType());
                 }
                 GDALClose(dataset);
@@ -6647,19 +9178,12 @@ bool MainWindow::loadImageFromDatabase(int fileId)
         return false;
     }
 
-    // Save to temporary file
-    QString tempDir = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
-    QString tempFilePath = QDir(tempDir).filePath(fileName);
-
-    QFile tempFile(tempFilePath);
-    if (!tempFile.open(QIODevice::WriteOnly)) {
-        QMessageBox::critical(this, "Error", "Cannot create temporary file");
+    // GDAL reads the fetched blob in place; no temporary file is written
+    MemoryFile memoryFile(fileData, fileName);
+    if (!memoryFile.isValid()) {
+        QMessageBox::critical(this, "Error", "Cannot open the file data in memory");
         return false;
     }
-    tempFile.write(fileData);
-    tempFile.close();
-
-    qDebug() << "Saved to temp file:" << tempFilePath;
 
     // Clear current content
     clearCurrentImage();
@@ -6674,7 +9198,7 @@ bool MainWindow::loadImageFromDatabase(int fileId)
     // 1. GEOTIFF
     if (fileType == "geotiff" || suffix == "tif" || suffix == "tiff") {
         qDebug() << "Loading GeoTIFF...";
-        GDALDataset *dataset = (GDALDataset*)GDALOpen(tempFilePath.toUtf8().constData(), GA_ReadOnly);
+        GDALDataset *dataset = (GDALDataset*)GDALOpen(memoryFile.path().toUtf8().constData(), GA_ReadOnly);
         if (dataset) {
             hasGeoTransform = (dataset->GetGeoTransform(gdalGeoTransform) == CE_None);
             const char *wkt = dataset->GetProjectionRef();
@@ -6742,7 +9266,6 @@ bool MainWindow::loadImageFromDatabase(int fileId)
                 }
             }
         }
-        QFile::remove(tempFilePath);
     }
 
     // 2. VECTOR GIS files (Shapefile, GeoJSON, KML, GPKG)
@@ -6750,39 +9273,21 @@ bool MainWindow::loadImageFromDatabase(int fileId)
              fileType == "gml" || fileType == "gpkg" || suffix == "shp" ||
              suffix == "geojson" || suffix == "kml" || suffix == "gml" || suffix == "gpkg") {
         qDebug() << "Loading vector GIS file...";
-        drawVectorLayer(tempFilePath);
-        if (!currentVectorItems.isEmpty()) {
-            QTreeWidgetItem *layerItem = new QTreeWidgetItem(
-                        QStringList() << displayName << "Vector (DB)");
-            layerItem->setCheckState(0, Qt::Checked);
-            layerItem->setIcon(0, QIcon(":/icons/vector_layer.png"));
-
-            QTreeWidgetItem *vectorGroup = nullptr;
-            for (int i = 0; i < layersTree->topLevelItemCount(); ++i) {
-                if (layersTree->topLevelItem(i)->text(0) == "Vector Layers") {
-                    vectorGroup = layersTree->topLevelItem(i);
-                    break;
-                }
-            }
-            if (!vectorGroup) {
-                vectorGroup = new QTreeWidgetItem(layersTree, QStringList() << "Vector Layers");
-                vectorGroup->setIcon(0, QIcon(":/icons/folder.png"));
-                vectorGroup->setExpanded(true);
-            }
-            vectorGroup->addChild(layerItem);
-
-            LayerInfo layer;
-            layer.name = displayName;
+        // The features are copied into the layers' stores, so the memory
+        // file is not needed once drawVectorLayer returns
+        int firstLayer = loadedLayers.size();
+        drawVectorLayer(memoryFile.path());
+        for (int i = firstLayer; i < loadedLayers.size(); ++i) {
+            LayerInfo &layer = loadedLayers[i];
             layer.filePath = QString("database://%1/%2").arg(fileId).arg(fileName);
             layer.type = "vector_db";
-            layer.treeItem = layerItem;
             layer.properties["db_id"] = fileId;
             layer.properties["format"] = suffix;
-            loadedLayers.append(layer);
-            projectModified = true;
+            if (layer.treeItem) {
+                layer.treeItem->setText(1, layer.treeItem->text(1) + " [DB]");
+            }
             success = true;
         }
-        QFile::remove(tempFilePath);
     }
 
     // 3. OTHER VECTOR formats (SVG, AI, EPS, PDF, DXF, DWG, CDR, etc.)
@@ -6860,14 +9365,13 @@ bool MainWindow::loadImageFromDatabase(int fileId)
         loadedLayers.append(layer);
         projectModified = true;
         success = true;
-        QFile::remove(tempFilePath);
     }
 
     // 4. RASTER IMAGES (JPEG, PNG, GIF, BMP, WEBP, HEIC, PSD, XCF, EXR, HDR, etc.)
     else {
         qDebug() << "Loading raster image...";
         QPixmap pixmap;
-        if (pixmap.load(tempFilePath)) {
+        if (pixmap.loadFromData(fileData)) {
             if (mapScene) {
                 QGraphicsPixmapItem *item = mapScene->addPixmap(pixmap);
                 currentImageItem = item;
@@ -6913,7 +9417,6 @@ bool MainWindow::loadImageFromDatabase(int fileId)
                 success = true;
             }
         }
-        QFile::remove(tempFilePath);
     }
 
     if (success) {
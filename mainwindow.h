@@ -30,6 +30,7 @@
 #include <QAction>
 #include <QSlider>
 #include <QDockWidget>
+#include <QPointer>
 #include <QStackedWidget>
 #include <QWheelEvent>
 #include <QKeyEvent>
@@ -62,7 +63,9 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QDebug>
+#include <QTimer>
 #include <cmath>
+#include <functional>
 #include <cstdlib>
 #include <ctime>
 #include <QTableWidget>
@@ -80,8 +83,15 @@
 #include "gdal_priv.h"
 #include "ogrsf_frmts.h"
 
+#include "featureselection.h"
+#include "featurestore.h"
+#include "geoprocessing.h"
+
 // Forward declaration
 class QGraphicsSvgItem;
+class LayoutFrameCache;
+class MapCanvas;
+class RenderDiagnostics;
 
 class MainWindow : public QMainWindow
 {
@@ -97,7 +107,7 @@ public:
     void setupStatusBarShortcuts();
     void onToggleCoordExtentDisplay(bool showCoordinates, QStackedWidget* stackWidget);
     void flashMarker();
-    void highlightAreaAroundPoint(double centerX, double centerY, double radius);
+    QGraphicsItem *highlightAreaAroundPoint(double centerX, double centerY, double radius);
     void addSelectionRectangle(double x, double y, double width, double height);
 
 protected:
@@ -116,8 +126,15 @@ private:
         QGraphicsItem* graphicsItem;
         QVariantMap properties;
         QList<QGraphicsItem*> vectorItems; // For vector layers with multiple items
-
-        LayerInfo() : treeItem(nullptr), graphicsItem(nullptr) {}
+        FeatureStorePtr featureStore; // Columnar features for vector layers
+        QString crs; // CRS the feature store coordinates are currently in
+        FeatureStorePtr sourceStore; // Features as loaded; reprojection starts from these
+        QString sourceCrs; // CRS of the source store
+        FeatureSelectionPtr selection; // Selected features, one bit each
+        QTransform itemToMap; // Item to map units, for items placed in map units
+        bool placedInMap; // The item transform is itemToMap * mapToSceneTransform()
+
+        LayerInfo() : treeItem(nullptr), graphicsItem(nullptr), placedInMap(false) {}
     };
 
     struct GeoreferenceInfo {
@@ -151,12 +168,27 @@ private:
     void trackVectorItemHover(QGraphicsItem *item, const QPointF &scenePos);
     QPointF getVectorItemCoordinates(QGraphicsItem *item, const QPointF &scenePos);
     void highlightVectorItem(QGraphicsItem *item, bool highlight);
+    void scheduleHoverUpdate(const QPoint &viewPos);
+    void updateHover();
+    void clearHover();
+
+    // Hover state; lookups are coalesced to one per display frame
+    QTimer *hoverTimer = nullptr;
+    QPoint hoverViewPos;
+    QGraphicsItem *hoveredItem = nullptr;
+    qint64 hoveredFeature = -1;
+
+    // Scale display after wheel zooming, restarted by every wheel step
+    QTimer *wheelScaleTimer = nullptr;
 
     void setupUI();
     void setupMenuBar();
     void setupToolBars();
     void setupDockWidgets();
+    void setupDiagnosticsDock();
     void setupCentralWidget();
+    MapCanvas *createMapCanvas();
+    void synchronizeMapViews(MapCanvas *source);
     void setupStatusBar();
     void setupConnections();
 
@@ -170,7 +202,7 @@ private:
     // Extents and coordinates display
     QLabel *extentsLabel;
     bool displayInDegrees;
-    QMap<QString, QRectF> layerExtents;
+    QHash<const QGraphicsItem*, QRectF> layerExtents; // Per layer item, map units of the project CRS
 
     QToolButton *coordinateModeBtn;
     QToolButton *coordinatesToolBtn;
@@ -218,14 +250,43 @@ private:
 
     // Vector operations
     void drawVectorLayer(const QString &filePath);
-    void drawGeometry(OGRGeometry *geom, const QColor &color, double scaleFactor = 100.0);
-    void drawPoint(OGRPoint *point, const QColor &color, double scaleFactor = 100.0);
-    void drawLine(OGRLineString *line, const QColor &color, double scaleFactor = 100.0);
-    void drawPolygon(OGRPolygon *polygon, const QColor &color, double scaleFactor = 100.0);
+    FeatureStorePtr loadFeatureStore(GDALDataset *dataset, OGRLayer *layer, LayerInfo &layerInfo);
+    void reprojectVectorLayer(LayerInfo &layerInfo);
+    QString projectCrs() const;
+    QTransform mapToSceneTransform();
+    void applyMapToSceneTransform();
+    void updateLayerMetadata(LayerInfo &layerInfo);
+    QRectF combinedLayerExtent() const;
+    QRectF layersSceneBounds();
+    void identifyFeatures(const QPoint &viewPos);
+
+    // Feature selection
+    void selectFeatures(const QPolygonF &scenePolygon, FeatureSelection::Mode mode,
+                        bool rectangle = false);
+    void selectFeaturesInRectangle(const QRectF &sceneRect, FeatureSelection::Mode mode);
+    void selectFeaturesInRadius(const QPointF &sceneCenter, double sceneRadius,
+                                FeatureSelection::Mode mode);
+    bool handleSelectionToolEvent(QEvent *event);
+    void clearSelectionRubberBand();
+    void updateSelectionStatus();
+
+    void showLayerPropertiesDialog(int initialTab);
+    void addMemoryVectorLayer(const QString &layerName, const FeatureStorePtr &store,
+                              const QVariantMap &properties = QVariantMap());
+    void runGeoprocessing(const QString &algorithm);
+    void runPointGenerator(const QString &algorithm);
+    void runDissolve();
+    void runCheckGeometries();
+    void runSpatialJoin();
+    void runHeatmap();
+    void exportMap(const QString &title, const QString &defaultSuffix, const QString &filter);
+    void runWithProgress(const QString &title, Geoprocessing::Feedback &feedback,
+                         const std::function<void()> &task);
     void addVectorLayerToTree(const QString &layerName, const QString &filePath, OGRwkbGeometryType geomType);
     void clearVectorItems(const QString &layerName = QString());
 
     // Image handling
+    void clearUnownedSceneItems();
     void clearCurrentImage();
     void fitImageToView();
     void updateImageInfo();
@@ -256,6 +317,37 @@ private:
     QDockWidget *layerStylingDock;
     QDockWidget *imagePropertiesDock;
 
+    // Render diagnostics: frame timings of the map canvas
+    RenderDiagnostics *renderDiagnostics = nullptr;
+    QDockWidget *diagnosticsDock = nullptr;
+    QAction *renderDiagnosticsAction = nullptr;
+    QCheckBox *diagnosticsOverlayCheck = nullptr;
+    QLabel *diagnosticsSummaryLabel = nullptr;
+    QTableWidget *diagnosticsLayerTable = nullptr;
+    QTimer *diagnosticsRefreshTimer = nullptr;
+
+    // Map frames of print layout exports, reused while nothing changed
+    LayoutFrameCache *layoutFrameCache = nullptr;
+
+    // The main view first, then the views opened in docks; all show mapScene
+    QList<QPointer<MapCanvas>> mapCanvases;
+    bool syncingMapViews = false;
+    int mapViewCount = 1;
+    void updateDiagnosticsRecording();
+    void refreshDiagnostics();
+
+    // Layer styling panel
+    QComboBox *stylingLayerCombo = nullptr;
+    QComboBox *rendererTypeCombo = nullptr;
+    QComboBox *rendererFieldCombo = nullptr;
+    QComboBox *rendererModeCombo = nullptr;
+    QSpinBox *rendererClassesSpin = nullptr;
+    QTreeWidget *rendererClassesTree = nullptr;
+    QCheckBox *clusterPointsCheck = nullptr;
+    void refreshStylingLayers();
+    void updateRendererClasses();
+    LayerInfo *stylingLayer();
+
     // Central widget components
     QTabWidget *mapViewsTabWidget;
     QGraphicsView *mapView;
@@ -370,6 +462,16 @@ private:
     QAction *zoomInAction;
     QAction *zoomOutAction;
     QAction *identifyAction;
+    QAction *selectRectangleAction = nullptr;
+    QAction *selectPolygonAction = nullptr;
+    QAction *selectRadiusAction = nullptr;
+    QAction *deselectAllAction = nullptr;
+
+    // Selection tool state, in scene coordinates
+    bool selectionDragging = false;
+    QPointF selectionStartPos;
+    QPolygonF selectionPolygon;
+    QGraphicsItem *selectionRubberBand = nullptr;
     QAction *measureAction;
     QAction *bookmarkAction;
 
@@ -455,6 +557,11 @@ private slots:
     void onShowProcessingToolbox();
     void onShowPythonConsole();
     void onShowLayerProperties();
+    void onLayerLabeling();
+    void onStylingLayerChanged(int index);
+    void onApplyRenderer();
+    void onRendererClassDoubleClicked(QTreeWidgetItem *item, int column);
+    void onProcessingAlgorithm(QTreeWidgetItem *item, int column);
     void onCreatePrintLayout();
     void onShowBookmarks();
     void addMarkerActions();
@@ -488,6 +595,7 @@ private slots:
     void onImportProject();
     void onSaveLayer();
     void onSaveLayerAs();
+    void onExportVectorAs();
     void onExportToPdf();
     void onExportToImage();
     void onSaveAllLayers();
@@ -503,6 +611,16 @@ private slots:
 
     // GDAL slots
     void onOpenGeoTIFF();
+    void onBenchmarkVectorLoading();
+
+    // Selection slots
+    void onSelectionToolToggled(bool checked);
+    void onDeselectAll();
+    void onZoomToSelection();
+
+    void onShowRenderStatistics();
+    void onExportDiagnosticsCsv();
+    void onNewMapView();
 
 signals:
     void projectLoaded(const QString &projectPath);
@@ -0,0 +1,154 @@
+#include "mapcanvas.h"
+
+#include <QFontMetrics>
+#include <QPainter>
+#include <QStringList>
+#include <QWheelEvent>
+#include <algorithm>
+#include <cmath>
+
+#include "renderdiagnostics.h"
+
+namespace {
+// Slowest layers listed in the overlay
+const int kOverlayLayers = 5;
+// Zoom per wheel notch
+const double kWheelZoomFactor = 1.2;
+}
+
+MapCanvas::MapCanvas(QGraphicsScene *scene, QWidget *parent)
+    : QGraphicsView(scene, parent)
+    , frameDiagnostics(nullptr)
+    , showOverlay(false)
+    , syncExtent(false)
+    , zoomOnWheel(false)
+    , settingView(false)
+{
+}
+
+QPointF MapCanvas::viewCenter() const
+{
+    return mapToScene(viewport()->rect().center());
+}
+
+void MapCanvas::setView(const QTransform &transform, const QPointF &center)
+{
+    settingView = true;
+    setTransform(QTransform(transform.m11(), transform.m12(), transform.m21(), transform.m22(), 0.0, 0.0));
+    centerOn(center);
+    settingView = false;
+    lastTransform = this->transform();
+    lastCenter = viewCenter();
+}
+
+void MapCanvas::checkExtent()
+{
+    if (settingView) return;
+    QTransform current = transform();
+    QPointF center = viewCenter();
+    if (current == lastTransform && center == lastCenter) return;
+    lastTransform = current;
+    lastCenter = center;
+    emit extentChanged();
+}
+
+void MapCanvas::scrollContentsBy(int dx, int dy)
+{
+    QGraphicsView::scrollContentsBy(dx, dy);
+    checkExtent();
+}
+
+void MapCanvas::resizeEvent(QResizeEvent *event)
+{
+    QGraphicsView::resizeEvent(event);
+    checkExtent();
+}
+
+void MapCanvas::wheelEvent(QWheelEvent *event)
+{
+    if (!zoomOnWheel || event->angleDelta().y() == 0) {
+        QGraphicsView::wheelEvent(event);
+        return;
+    }
+    double factor = std::pow(kWheelZoomFactor, event->angleDelta().y() / 120.0);
+    ViewportAnchor anchor = transformationAnchor();
+    setTransformationAnchor(AnchorUnderMouse);
+    scale(factor, factor);
+    setTransformationAnchor(anchor);
+    event->accept();
+}
+
+void MapCanvas::setDiagnostics(RenderDiagnostics *diagnostics)
+{
+    frameDiagnostics = diagnostics;
+}
+
+void MapCanvas::setOverlayVisible(bool visible)
+{
+    showOverlay = visible;
+    viewport()->update();
+}
+
+void MapCanvas::paintEvent(QPaintEvent *event)
+{
+    // Zooming does not always scroll; the new scale is seen here at the latest
+    checkExtent();
+    if (!frameDiagnostics || !frameDiagnostics->isEnabled()) {
+        QGraphicsView::paintEvent(event);
+        return;
+    }
+
+    frameDiagnostics->beginFrame();
+    QGraphicsView::paintEvent(event);
+    frameDiagnostics->endFrame();
+}
+
+void MapCanvas::drawForeground(QPainter *painter, const QRectF &rect)
+{
+    QGraphicsView::drawForeground(painter, rect);
+    if (!showOverlay || !frameDiagnostics || frameDiagnostics->history().isEmpty()) return;
+
+    // The frame before this one; this one is still being drawn
+    const RenderDiagnostics::Frame &frame = frameDiagnostics->history().last();
+    QStringList lines;
+    lines << QString("Frame %1: %2 ms").arg(frame.number).arg(frame.totalMs, 0, 'f', 2);
+    lines << QString("Cache %1 hit / %2 miss").arg(frame.cacheHits).arg(frame.cacheMisses);
+    lines << QString("Features %1 drawn / %2 culled").arg(frame.drawn).arg(frame.culled);
+    lines << QString("Coordinates %1 ms (transform %2 ms)")
+             .arg(frame.coordinateUpdateMs, 0, 'f', 2)
+             .arg(frame.geographicTransformMs, 0, 'f', 2);
+
+    QVector<RenderDiagnostics::LayerSample> layers = frame.layers;
+    std::sort(layers.begin(), layers.end(),
+              [](const RenderDiagnostics::LayerSample &a, const RenderDiagnostics::LayerSample &b) {
+        return a.paintMs + a.renderMs > b.paintMs + b.renderMs;
+    });
+    for (int i = 0; i < layers.size() && i < kOverlayLayers; ++i) {
+        lines << QString("  %1: %2 ms%3")
+                 .arg(layers[i].layer)
+                 .arg(layers[i].paintMs, 0, 'f', 2)
+                 .arg(layers[i].cacheHit ? QString(" (cached)")
+                                         : QString(", render %1 ms").arg(layers[i].renderMs, 0, 'f', 2));
+    }
+
+    // Pinned to the top left of the viewport
+    painter->save();
+    painter->resetTransform();
+    QFont font = painter->font();
+    font.setPointSize(8);
+    painter->setFont(font);
+    QFontMetrics metrics(font);
+    int width = 0;
+    for (const QString &line : lines) {
+        width = qMax(width, metrics.boundingRect(line).width());
+    }
+    QRect box(8, 8, width + 12, lines.size() * metrics.height() + 8);
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(QColor(0, 0, 0, 160));
+    painter->drawRect(box);
+    painter->setPen(Qt::white);
+    for (int i = 0; i < lines.size(); ++i) {
+        painter->drawText(box.left() + 6, box.top() + 4 + metrics.ascent() + i * metrics.height(), lines[i]);
+    }
+    painter->restore();
+}
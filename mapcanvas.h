@@ -0,0 +1,65 @@
+#ifndef MAPCANVAS_H
+#define MAPCANVAS_H
+
+#include <QGraphicsView>
+#include <QTransform>
+
+class RenderDiagnostics;
+
+// The map view. Every paint is one frame for the render diagnostics, and
+// the optional overlay draws the last recorded frame over the map.
+//
+// Any number of canvases can show the same scene; layers keep one render
+// cache per canvas and share everything else. extentChanged() lets other
+// canvases follow this one.
+class MapCanvas : public QGraphicsView
+{
+    Q_OBJECT
+
+public:
+    explicit MapCanvas(QGraphicsScene *scene, QWidget *parent = nullptr);
+
+    RenderDiagnostics *diagnostics() const { return frameDiagnostics; }
+    void setDiagnostics(RenderDiagnostics *diagnostics);
+
+    bool overlayVisible() const { return showOverlay; }
+    void setOverlayVisible(bool visible);
+
+    // Moves together with the main view (set by the owner)
+    bool extentSync() const { return syncExtent; }
+    void setExtentSync(bool enabled) { syncExtent = enabled; }
+
+    // Zoom around the mouse on the wheel instead of scrolling
+    bool wheelZoom() const { return zoomOnWheel; }
+    void setWheelZoom(bool enabled) { zoomOnWheel = enabled; }
+
+    // Scene point in the middle of the viewport
+    QPointF viewCenter() const;
+    // Shows the same scale and rotation as transform around center,
+    // without emitting extentChanged()
+    void setView(const QTransform &transform, const QPointF &center);
+
+signals:
+    // Panned, zoomed or resized
+    void extentChanged();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void drawForeground(QPainter *painter, const QRectF &rect) override;
+    void scrollContentsBy(int dx, int dy) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+
+private:
+    void checkExtent();
+
+    RenderDiagnostics *frameDiagnostics;
+    bool showOverlay;
+    bool syncExtent;
+    bool zoomOnWheel;
+    bool settingView;
+    QTransform lastTransform;
+    QPointF lastCenter;
+};
+
+#endif // MAPCANVAS_H
@@ -0,0 +1,472 @@
+#include "mapexporter.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QGraphicsPixmapItem>
+#include <QGraphicsScene>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QPicture>
+#include <QStyleOptionGraphicsItem>
+#include <QThread>
+#include <QtConcurrent/QtConcurrentMap>
+#include <cmath>
+
+#include "cpl_string.h"
+#include "gdal_priv.h"
+
+#include "coordinatetransformer.h"
+
+namespace {
+// Logical pixels per inch; symbols are sized for this and scaled with the dpi
+const double kLogicalDpi = 96.0;
+// Tiles per thread rendered before they are written
+const int kTilesPerThread = 2;
+
+int progressCallback(double, const char *, void *data)
+{
+    Geoprocessing::Feedback *feedback = static_cast<Geoprocessing::Feedback*>(data);
+    return feedback && feedback->isCanceled() ? FALSE : TRUE;
+}
+}
+
+// One scene item, independent of the output area
+struct MapExporter::Item {
+    enum Kind {
+        Vector,
+        Image,
+        Picture
+    };
+
+    Kind kind = Picture;
+    QTransform itemToScene;            // deviceTransform() of an identity view
+    bool untransformed = false;        // Ignores the view scale, only moves with anchor
+    QPointF anchor;                    // Scene origin of the untransformed ancestor
+    QRectF bounds;                     // Item coordinates
+    qreal opacity = 1.0;
+    QByteArray content;                // Changes whenever the item draws differently
+    const VectorLayerItem *vector = nullptr;
+    VectorLayerItem::RenderJob job;    // Fitted to each output by exportJobAt()
+    QImage image;
+    QPointF offset;
+    bool smooth = false;
+    QByteArray picture;                // QPicture data; replayed from a copy per tile
+};
+
+struct MapExporter::Snapshot {
+    QVector<Item> items;
+};
+
+// A snapshot item placed in this output
+struct MapExporter::Layer {
+    const Item *item = nullptr;
+    QTransform itemToLogical;          // Item to output logical pixels
+    QRectF logicalBounds;
+    VectorLayerItem::RenderJob job;    // Vector items at the output scale
+};
+
+struct MapExporter::Tile {
+    QRect rect;                        // Output pixels
+    QImage image;
+};
+
+MapExporter::MapExporter(const Options &exportOptions)
+    : options(exportOptions)
+    , ratio(qMax(0.01, exportOptions.dpi / kLogicalDpi))
+{
+    if (options.sceneRect.width() > 0.0 && options.sceneRect.height() > 0.0) {
+        double scaleX = options.size.width() / ratio / options.sceneRect.width();
+        double scaleY = options.size.height() / ratio / options.sceneRect.height();
+        sceneToLogical = QTransform::fromTranslate(-options.sceneRect.left(), -options.sceneRect.top()) *
+                QTransform::fromScale(scaleX, scaleY);
+    }
+}
+
+MapExporter::~MapExporter()
+{
+}
+
+bool MapExporter::formatForPath(const QString &filePath, Format *format)
+{
+    QString suffix = QFileInfo(filePath).suffix().toLower();
+    if (suffix == "png") *format = Png;
+    else if (suffix == "tif" || suffix == "tiff") *format = GeoTiff;
+    else if (suffix == "pdf") *format = Pdf;
+    else return false;
+    return true;
+}
+
+MapExporter::SnapshotPtr MapExporter::takeSnapshot(QGraphicsScene *scene)
+{
+    QSharedPointer<Snapshot> snapshot(new Snapshot());
+    if (!scene) return snapshot;
+
+    for (QGraphicsItem *item : scene->items(Qt::AscendingOrder)) {
+        if (!item->isVisible() || item->effectiveOpacity() <= 0.0) continue;
+
+        Item entry;
+        entry.itemToScene = item->deviceTransform(QTransform());
+        // As in deviceTransform(): below the topmost item that ignores the
+        // view scale, only the view position of its origin changes
+        for (QGraphicsItem *ancestor = item; ancestor; ancestor = ancestor->parentItem()) {
+            if (!(ancestor->flags() & QGraphicsItem::ItemIgnoresTransformations)) continue;
+            entry.untransformed = true;
+            QGraphicsItem *parent = ancestor->parentItem();
+            entry.anchor = parent ? parent->sceneTransform().map(ancestor->pos()) : ancestor->pos();
+        }
+        entry.bounds = item->boundingRect();
+        entry.opacity = item->effectiveOpacity();
+
+        if (VectorLayerItem *vectorItem = qgraphicsitem_cast<VectorLayerItem*>(item)) {
+            entry.kind = Item::Vector;
+            entry.vector = vectorItem;
+            entry.job = vectorItem->exportJob();
+            entry.content = QByteArray::number(vectorItem->contentRevision());
+        } else if (QGraphicsPixmapItem *pixmapItem = qgraphicsitem_cast<QGraphicsPixmapItem*>(item)) {
+            // Pixmaps are GUI-thread only; the image is shared, not copied
+            entry.kind = Item::Image;
+            entry.image = pixmapItem->pixmap().toImage();
+            entry.content = QByteArray::number(pixmapItem->pixmap().cacheKey());
+            entry.offset = pixmapItem->offset();
+            entry.smooth = pixmapItem->transformationMode() == Qt::SmoothTransformation;
+        } else {
+            entry.kind = Item::Picture;
+            QPicture picture;
+            QPainter painter(&picture);
+            QStyleOptionGraphicsItem option;
+            option.exposedRect = item->boundingRect();
+            option.rect = item->boundingRect().toAlignedRect();
+            item->paint(&painter, &option, nullptr);
+            painter.end();
+            entry.picture = QByteArray(picture.data(), int(picture.size()));
+            entry.content = QCryptographicHash::hash(entry.picture, QCryptographicHash::Sha1);
+        }
+        snapshot->items.append(entry);
+    }
+    return snapshot;
+}
+
+void MapExporter::prepare(QGraphicsScene *scene)
+{
+    prepare(takeSnapshot(scene));
+}
+
+void MapExporter::prepare(const SnapshotPtr &sceneSnapshot)
+{
+    snapshot = sceneSnapshot;
+    layers.clear();
+    key.clear();
+    if (!snapshot) return;
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QByteArray header;
+    QDataStream headerStream(&header, QIODevice::WriteOnly);
+    headerStream << options.sceneRect << options.size << options.dpi << options.background;
+    hash.addData(header);
+    QRectF outputRect(0.0, 0.0, options.size.width() / ratio, options.size.height() / ratio);
+
+    for (const Item &item : snapshot->items) {
+        Layer layer;
+        layer.item = &item;
+        if (item.untransformed) {
+            QPointF shift = sceneToLogical.map(item.anchor) - item.anchor;
+            layer.itemToLogical = item.itemToScene * QTransform::fromTranslate(shift.x(), shift.y());
+        } else {
+            layer.itemToLogical = item.itemToScene * sceneToLogical;
+        }
+        layer.logicalBounds = layer.itemToLogical.mapRect(item.bounds);
+        // Items outside the output neither draw nor change the snapshot key
+        if (!layer.logicalBounds.intersects(outputRect)) continue;
+        if (item.kind == Item::Vector) {
+            layer.job = VectorLayerItem::exportJobAt(item.job, layer.itemToLogical);
+        }
+        layers.append(layer);
+
+        QByteArray entry;
+        QDataStream stream(&entry, QIODevice::WriteOnly);
+        stream << int(item.kind) << layer.itemToLogical << item.opacity << item.content;
+        hash.addData(entry);
+    }
+    key = hash.result();
+}
+
+QImage MapExporter::render()
+{
+    placeLabels();
+    Tile tile;
+    tile.rect = QRect(QPoint(0, 0), options.size);
+    renderTile(tile);
+    return tile.image;
+}
+
+bool MapExporter::write(const QString &filePath, Format format,
+                        Geoprocessing::Feedback *feedback, Statistics *statistics, QString *error)
+{
+    if (options.size.isEmpty() || options.sceneRect.isEmpty()) {
+        if (error) *error = "Nothing to export";
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    placeLabels();
+    if (feedback && feedback->isCanceled()) {
+        if (error) *error = "Canceled";
+        return false;
+    }
+
+    Statistics stats;
+    bool ok = format == Pdf ? writePdf(filePath, feedback, stats, error)
+                            : writeRaster(filePath, format, feedback, stats, error);
+
+    stats.elapsedMs = timer.elapsed();
+    if (statistics) *statistics = stats;
+    return ok;
+}
+
+void MapExporter::placeLabels()
+{
+    QVector<Layer*> pending;
+    for (Layer &layer : layers) {
+        if (layer.item->kind == Item::Vector && layer.job.labelRequest.store && !layer.job.labels) {
+            pending.append(&layer);
+        }
+    }
+    QtConcurrent::blockingMap(pending, [](Layer *layer) {
+        layer->job.labels = LabelEngine::placeRequest(layer->job.labelRequest, layer->job.mapToDevice);
+    });
+}
+
+void MapExporter::drawLayers(QPainter *painter, const QRectF &outputRect) const
+{
+    QRectF logicalRect(outputRect.left() / ratio, outputRect.top() / ratio,
+                       outputRect.width() / ratio, outputRect.height() / ratio);
+    QTransform toArea = QTransform::fromTranslate(-logicalRect.left(), -logicalRect.top());
+
+    for (const Layer &layer : layers) {
+        if (!layer.logicalBounds.intersects(logicalRect)) continue;
+
+        const Item &item = *layer.item;
+        painter->save();
+        painter->setOpacity(item.opacity);
+        painter->setTransform(layer.itemToLogical * toArea, true);
+
+        switch (item.kind) {
+        case Item::Vector:
+            item.vector->drawExport(painter, layer.job,
+                                    layer.itemToLogical.inverted().mapRect(logicalRect));
+            break;
+        case Item::Image:
+            painter->setRenderHint(QPainter::SmoothPixmapTransform, item.smooth);
+            painter->drawImage(item.offset, item.image);
+            break;
+        case Item::Picture: {
+            // Playback moves the picture's read position, so every tile uses its own copy
+            QPicture picture;
+            picture.setData(item.picture.constData(), uint(item.picture.size()));
+            painter->drawPicture(0, 0, picture);
+            break;
+        }
+        }
+        painter->restore();
+    }
+}
+
+void MapExporter::renderTile(Tile &tile) const
+{
+    tile.image = QImage(tile.rect.size(), QImage::Format_ARGB32_Premultiplied);
+    tile.image.setDevicePixelRatio(ratio);
+    tile.image.fill(options.background);
+
+    QPainter painter(&tile.image);
+    painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing |
+                           QPainter::SmoothPixmapTransform);
+    drawLayers(&painter, QRectF(tile.rect));
+    painter.end();
+}
+
+bool MapExporter::writeRaster(const QString &filePath, Format format, Geoprocessing::Feedback *feedback,
+                              Statistics &stats, QString *error)
+{
+    GDALDriver *tiffDriver = GetGDALDriverManager()->GetDriverByName("GTiff");
+    GDALDriver *pngDriver = format == Png ? GetGDALDriverManager()->GetDriverByName("PNG") : nullptr;
+    if (!tiffDriver || (format == Png && !pngDriver)) {
+        if (error) *error = "GDAL driver not available for " + QFileInfo(filePath).suffix();
+        return false;
+    }
+
+    // PNG cannot be written in pieces; tiles go to a GeoTIFF that is
+    // then copied scanline by scanline
+    QString tiffPath = format == Png ? filePath + ".tiles.tif" : filePath;
+    char **creationOptions = nullptr;
+    creationOptions = CSLSetNameValue(creationOptions, "TILED", "YES");
+    creationOptions = CSLSetNameValue(creationOptions, "COMPRESS", format == Png ? "LZW" : "DEFLATE");
+    creationOptions = CSLSetNameValue(creationOptions, "BIGTIFF", "IF_SAFER");
+    creationOptions = CSLSetNameValue(creationOptions, "PHOTOMETRIC", "RGB");
+    creationOptions = CSLSetNameValue(creationOptions, "ALPHA", "YES");
+    GDALDataset *dataset = tiffDriver->Create(tiffPath.toUtf8().constData(),
+                                              options.size.width(), options.size.height(), 4,
+                                              GDT_Byte, creationOptions);
+    CSLDestroy(creationOptions);
+    if (!dataset) {
+        if (error) *error = "Could not create " + tiffPath + ": " + QString::fromUtf8(CPLGetLastErrorMsg());
+        return false;
+    }
+
+    // Output pixel -> scene -> map
+    QTransform pixelToScene = QTransform::fromScale(options.sceneRect.width() / options.size.width(),
+                                                    options.sceneRect.height() / options.size.height()) *
+            QTransform::fromTranslate(options.sceneRect.left(), options.sceneRect.top());
+    QTransform pixelToMap = pixelToScene * options.sceneToMap;
+    double geoTransform[6] = { pixelToMap.dx(), pixelToMap.m11(), pixelToMap.m21(),
+                               pixelToMap.dy(), pixelToMap.m12(), pixelToMap.m22() };
+    dataset->SetGeoTransform(geoTransform);
+    if (!options.crs.isEmpty()) {
+        OGRSpatialReference *srs = CoordinateTransformer::createSpatialReference(options.crs);
+        char *wkt = nullptr;
+        if (srs && srs->exportToWkt(&wkt) == OGRERR_NONE && wkt) dataset->SetProjection(wkt);
+        CPLFree(wkt);
+        if (srs) srs->Release();
+    }
+
+    QVector<Tile> tiles;
+    int tileSize = qMax(64, options.tileSize);
+    for (int y = 0; y < options.size.height(); y += tileSize) {
+        for (int x = 0; x < options.size.width(); x += tileSize) {
+            Tile tile;
+            tile.rect = QRect(x, y, qMin(tileSize, options.size.width() - x),
+                              qMin(tileSize, options.size.height() - y));
+            tiles.append(tile);
+        }
+    }
+
+    int threads = qMax(1, QThread::idealThreadCount());
+    int batchSize = threads * kTilesPerThread;
+    stats.tiles = tiles.size();
+    stats.threads = qMin(threads, tiles.size());
+    if (feedback) feedback->setTotal(tiles.size());
+
+    // Byte order of a QImage::Format_ARGB32 pixel in memory
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+    int bandMap[4] = { 3, 2, 1, 4 };
+#else
+    int bandMap[4] = { 4, 1, 2, 3 };
+#endif
+
+    bool ok = true;
+    for (int batchBegin = 0; batchBegin < tiles.size() && ok; batchBegin += batchSize) {
+        if (feedback && feedback->isCanceled()) {
+            if (error) *error = "Canceled";
+            ok = false;
+            break;
+        }
+
+        QVector<Tile> batch = tiles.mid(batchBegin, batchSize);
+        QtConcurrent::blockingMap(batch, [this](Tile &tile) {
+            renderTile(tile);
+            // GDAL wants straight alpha
+            tile.image = tile.image.convertToFormat(QImage::Format_ARGB32);
+        });
+
+        // Written in order and dropped, so one batch of tiles is ever held
+        for (Tile &tile : batch) {
+            CPLErr result = dataset->RasterIO(GF_Write, tile.rect.x(), tile.rect.y(),
+                                              tile.rect.width(), tile.rect.height(),
+                                              tile.image.bits(), tile.rect.width(), tile.rect.height(),
+                                              GDT_Byte, 4, bandMap,
+                                              4, tile.image.bytesPerLine(), 1, nullptr);
+            tile.image = QImage();
+            if (result != CE_None) {
+                if (error) *error = "Could not write tile: " + QString::fromUtf8(CPLGetLastErrorMsg());
+                ok = false;
+                break;
+            }
+            if (feedback) feedback->addProgress(1);
+        }
+    }
+    GDALClose(dataset);
+
+    if (ok && format == Png) {
+        GDALDataset *source = static_cast<GDALDataset*>(GDALOpen(tiffPath.toUtf8().constData(), GA_ReadOnly));
+        char **copyOptions = nullptr;
+        if (!options.crs.isEmpty()) copyOptions = CSLSetNameValue(copyOptions, "WORLDFILE", "YES");
+        GDALDataset *png = source ? pngDriver->CreateCopy(filePath.toUtf8().constData(), source, FALSE,
+                                                          copyOptions, progressCallback, feedback)
+                                  : nullptr;
+        CSLDestroy(copyOptions);
+        if (!png) {
+            if (error) {
+                *error = feedback && feedback->isCanceled()
+                        ? QString("Canceled")
+                        : "Could not write " + filePath + ": " + QString::fromUtf8(CPLGetLastErrorMsg());
+            }
+            ok = false;
+        } else {
+            GDALClose(png);
+        }
+        if (source) GDALClose(source);
+    }
+
+    if (format == Png) tiffDriver->Delete(tiffPath.toUtf8().constData());
+    else if (!ok) tiffDriver->Delete(tiffPath.toUtf8().constData());
+    return ok;
+}
+
+bool MapExporter::writePdf(const QString &filePath, Geoprocessing::Feedback *feedback,
+                           Statistics &stats, QString *error)
+{
+    // Drawn in logical pixels, so symbols keep the size they have in the
+    // raster exports; vectors and embedded images keep their own resolution
+    QPdfWriter writer(filePath);
+    writer.setResolution(int(kLogicalDpi));
+    writer.setCreator("Qgis_demo");
+    QPageLayout::Orientation orientation = options.size.width() > options.size.height()
+            ? QPageLayout::Landscape : QPageLayout::Portrait;
+    writer.setPageLayout(QPageLayout(options.pageSize, orientation, QMarginsF(10, 10, 10, 10),
+                                     QPageLayout::Millimeter));
+
+    // Output pixels covered by one page
+    double pageWidth = writer.width() * ratio;
+    double pageHeight = writer.height() * ratio;
+    int columns = qMax(1, int(std::ceil(options.size.width() / pageWidth)));
+    int rows = qMax(1, int(std::ceil(options.size.height() / pageHeight)));
+    stats.pages = columns * rows;
+    stats.threads = 1;
+    if (feedback) feedback->setTotal(stats.pages);
+
+    QPainter painter;
+    if (!painter.begin(&writer)) {
+        if (error) *error = "Could not write " + filePath;
+        return false;
+    }
+    painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing |
+                           QPainter::SmoothPixmapTransform);
+
+    bool ok = true;
+    for (int row = 0; row < rows && ok; ++row) {
+        for (int column = 0; column < columns; ++column) {
+            if (feedback && feedback->isCanceled()) {
+                if (error) *error = "Canceled";
+                ok = false;
+                break;
+            }
+            if (row > 0 || column > 0) writer.newPage();
+
+            QRectF outputRect(column * pageWidth, row * pageHeight,
+                              qMin(pageWidth, options.size.width() - column * pageWidth),
+                              qMin(pageHeight, options.size.height() - row * pageHeight));
+            QRectF pageRect(0.0, 0.0, outputRect.width() / ratio, outputRect.height() / ratio);
+            painter.save();
+            painter.setClipRect(pageRect);
+            painter.fillRect(pageRect, options.background);
+            drawLayers(&painter, outputRect);
+            painter.restore();
+            if (feedback) feedback->addProgress(1);
+        }
+    }
+    painter.end();
+    return ok;
+}
@@ -0,0 +1,120 @@
+#ifndef MAPEXPORTER_H
+#define MAPEXPORTER_H
+
+#include <QByteArray>
+#include <QColor>
+#include <QImage>
+#include <QPageLayout>
+#include <QPageSize>
+#include <QRectF>
+#include <QSharedPointer>
+#include <QSize>
+#include <QString>
+#include <QTransform>
+#include <QVector>
+
+#include "geoprocessing.h"
+#include "vectorlayeritem.h"
+
+class QGraphicsScene;
+class QPainter;
+
+// Poster-size map exports without a full-size bitmap.
+//
+// takeSnapshot() runs on the GUI thread and captures the visible scene
+// items in stacking order: vector layers keep their export job (style,
+// clusters and label request), pixmap items their image and every other
+// item a recorded QPicture. prepare() fits a snapshot to the output area,
+// which only places the items, so several exporters can share one
+// snapshot. write() can then run on any thread; it places the labels for
+// the output scale before drawing.
+//
+// Raster outputs are cut into tiles that render in parallel a batch at a
+// time and are written as they finish: a tiled, compressed GeoTIFF with
+// the geotransform and CRS, or a PNG copied line by line from such a
+// temporary GeoTIFF. PDF pages are drawn straight into QPdfWriter, so
+// vector layers stay vectors; an output larger than one page is split
+// over several pages.
+class MapExporter
+{
+public:
+    enum Format {
+        Png,
+        GeoTiff,
+        Pdf
+    };
+
+    struct Options {
+        QRectF sceneRect;            // Area to export, scene coordinates
+        QSize size;                  // Output pixels
+        double dpi = 300.0;          // Symbols and labels scale with dpi / 96
+        int tileSize = 2048;
+        QColor background = Qt::white;
+        QTransform sceneToMap;       // GeoTIFF and PNG world file
+        QString crs;
+        QPageSize pageSize = QPageSize(QPageSize::A4);   // PDF
+    };
+
+    struct Statistics {
+        int tiles = 0;
+        int pages = 0;
+        int threads = 0;
+        qint64 elapsedMs = 0;
+    };
+
+    // Scene items captured once, shareable between exporters
+    struct Snapshot;
+    typedef QSharedPointer<const Snapshot> SnapshotPtr;
+
+    explicit MapExporter(const Options &options);
+    ~MapExporter();
+
+    // GUI thread: the items must outlive every exporter using the snapshot
+    static SnapshotPtr takeSnapshot(QGraphicsScene *scene);
+
+    // GUI thread: takeSnapshot() and prepare() in one
+    void prepare(QGraphicsScene *scene);
+    // Any thread: places the snapshot items in the output, no drawing
+    void prepare(const SnapshotPtr &sceneSnapshot);
+
+    bool write(const QString &filePath, Format format,
+               Geoprocessing::Feedback *feedback = nullptr,
+               Statistics *statistics = nullptr, QString *error = nullptr);
+
+    // The whole output in one image, labels placed and rendered on the
+    // calling thread
+    QImage render();
+
+    // Changes whenever the output would: extent, size, dpi, the placement
+    // of an item or the content of a layer. Valid after prepare().
+    QByteArray snapshotKey() const { return key; }
+
+    static bool formatForPath(const QString &filePath, Format *format);
+
+private:
+    struct Item;
+    struct Layer;
+    struct Tile;
+
+    bool writeRaster(const QString &filePath, Format format, Geoprocessing::Feedback *feedback,
+                     Statistics &stats, QString *error);
+    bool writePdf(const QString &filePath, Geoprocessing::Feedback *feedback,
+                  Statistics &stats, QString *error);
+    // Label placements of the vector layers, done once before any drawing
+    void placeLabels();
+    void renderTile(Tile &tile) const;
+    // Draws the layers over outputRect (output pixels) with the painter
+    // in logical pixels of the output
+    void drawLayers(QPainter *painter, const QRectF &outputRect) const;
+
+    Options options;
+    double ratio;                 // Output pixels per logical pixel
+    QTransform sceneToLogical;
+    SnapshotPtr snapshot;
+    QVector<Layer> layers;
+    QByteArray key;
+
+    Q_DISABLE_COPY(MapExporter)
+};
+
+#endif // MAPEXPORTER_H
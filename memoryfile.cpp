@@ -0,0 +1,39 @@
+#include "memoryfile.h"
+
+#include <QFileInfo>
+#include <QUuid>
+
+#include "cpl_vsi.h"
+
+MemoryFile::MemoryFile(const QByteArray &data, const QString &fileName)
+    : bytes(data)
+{
+    if (bytes.isEmpty()) return;
+
+    // A unique directory keeps the original name, so drivers still see the extension
+    QString name = QFileInfo(fileName).fileName();
+    if (name.isEmpty()) name = "data";
+    QString path = QString("/vsimem/%1/%2")
+            .arg(QString::fromLatin1(QUuid::createUuid().toRfc4122().toHex()), name);
+
+    // constData() does not detach; GDAL only reads through the pointer
+    GByte *buffer = reinterpret_cast<GByte*>(const_cast<char*>(bytes.constData()));
+    VSILFILE *file = VSIFileFromMemBuffer(path.toUtf8().constData(), buffer,
+                                          vsi_l_offset(bytes.size()), FALSE);
+    if (!file) return;
+    VSIFCloseL(file);
+    filePath = path;
+}
+
+MemoryFile::~MemoryFile()
+{
+    if (!filePath.isEmpty()) VSIUnlink(filePath.toUtf8().constData());
+}
+
+QString MemoryFile::path() const
+{
+    if (QFileInfo(filePath).suffix().compare("zip", Qt::CaseInsensitive) == 0) {
+        return "/vsizip/" + filePath;
+    }
+    return filePath;
+}
@@ -0,0 +1,31 @@
+#ifndef MEMORYFILE_H
+#define MEMORYFILE_H
+
+#include <QByteArray>
+#include <QString>
+
+// Exposes a QByteArray to GDAL as a read-only /vsimem/ file.
+//
+// The file wraps the array's buffer directly: nothing is copied and
+// nothing touches the disk. The array is held (implicitly shared) for
+// the lifetime of the object, and the file is unlinked when it goes
+// away, so datasets opened from path() must be closed before that.
+// Zip archives are opened through /vsizip/ on top of the buffer.
+class MemoryFile
+{
+public:
+    MemoryFile(const QByteArray &data, const QString &fileName);
+    ~MemoryFile();
+
+    bool isValid() const { return !filePath.isEmpty(); }
+    // Path to hand to GDALOpen / GDALOpenEx
+    QString path() const;
+
+private:
+    QByteArray bytes;
+    QString filePath;
+
+    Q_DISABLE_COPY(MemoryFile)
+};
+
+#endif // MEMORYFILE_H
@@ -0,0 +1,175 @@
+#include "pointclusterindex.h"
+
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace {
+// Interleaves the bits of x (even) and y (odd)
+quint64 mortonCode(quint32 x, quint32 y)
+{
+    quint64 code = 0;
+    for (int bit = 0; bit < 32; ++bit) {
+        code |= quint64((x >> bit) & 1u) << (2 * bit);
+        code |= quint64((y >> bit) & 1u) << (2 * bit + 1);
+    }
+    return code;
+}
+
+bool keyLess(const PointClusterIndex::Cluster &cluster, quint64 key)
+{
+    return cluster.key < key;
+}
+}
+
+PointClusterIndex::PointClusterIndex()
+    : originX(0.0)
+    , originY(0.0)
+    , side(1.0)
+    , numPoints(0)
+    , buildMs(0)
+{
+}
+
+PointClusterIndexPtr PointClusterIndex::build(const FeatureStorePtr &store)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    PointClusterIndex *index = new PointClusterIndex();
+    PointClusterIndexPtr result(index);
+    if (!store || !store->isFinished() || store->extent().isNull()) return result;
+
+    const FeatureStore::Extent &extent = store->extent();
+    index->originX = extent.minX;
+    index->originY = extent.minY;
+    index->side = qMax(extent.maxX - extent.minX, extent.maxY - extent.minY);
+    if (index->side <= 0.0) index->side = 1.0;
+
+    // One cluster per point at the finest level, in Morton order
+    const quint32 cells = 1u << kMaxLevel;
+    const double scale = cells / index->side;
+    const double *xs = store->xData();
+    const double *ys = store->yData();
+    std::vector<Cluster> current;
+    current.reserve(size_t(store->featureCount()));
+    for (qint64 f = 0; f < store->featureCount(); ++f) {
+        if (store->geometryKind(f) != FeatureStore::PointGeometry) continue;
+        for (quint32 part = store->partBegin(f); part < store->partEnd(f); ++part) {
+            quint32 v = store->vertexBegin(store->ringBegin(part));
+            quint32 cx = quint32(qBound(0.0, (xs[v] - index->originX) * scale, double(cells - 1)));
+            quint32 cy = quint32(qBound(0.0, (ys[v] - index->originY) * scale, double(cells - 1)));
+            Cluster point = { mortonCode(cx, cy), xs[v], ys[v], 1 };
+            current.push_back(point);
+        }
+    }
+    index->numPoints = qint64(current.size());
+    std::sort(current.begin(), current.end(), [](const Cluster &a, const Cluster &b) {
+        return a.key < b.key;
+    });
+
+    // Merge bottom-up; x and y hold coordinate sums until the end. A level
+    // is kept once it at least halves the point count, so the finest
+    // levels where every point is alone never stay in memory.
+    std::vector<std::vector<Cluster> > kept(kMaxLevel + 1);
+    int finest = -1;
+    for (int level = kMaxLevel; level >= 0; --level) {
+        std::vector<Cluster> merged;
+        size_t begin = 0;
+        while (begin < current.size()) {
+            quint64 key = level == kMaxLevel ? current[begin].key : current[begin].key >> 2;
+            Cluster cluster = { key, 0.0, 0.0, 0 };
+            size_t end = begin;
+            while (end < current.size() &&
+                   (level == kMaxLevel ? current[end].key : current[end].key >> 2) == key) {
+                cluster.x += current[end].x;
+                cluster.y += current[end].y;
+                cluster.count += current[end].count;
+                ++end;
+            }
+            merged.push_back(cluster);
+            begin = end;
+        }
+
+        if (merged.size() * 2 <= size_t(index->numPoints)) {
+            if (finest < 0) finest = level;
+            kept[level] = merged;
+        }
+        current = std::move(merged);
+    }
+
+    index->levels.resize(size_t(finest + 1));
+    for (int level = 0; level <= finest; ++level) {
+        index->levels[level].swap(kept[level]);
+        for (Cluster &cluster : index->levels[level]) {
+            cluster.x /= cluster.count;
+            cluster.y /= cluster.count;
+        }
+    }
+    index->buildMs = timer.elapsed();
+    return result;
+}
+
+double PointClusterIndex::cellSize(int level) const
+{
+    return std::ldexp(side, -level);
+}
+
+int PointClusterIndex::levelFor(double minimumCellSize) const
+{
+    if (levels.empty() || !(minimumCellSize > 0.0)) return -1;
+    int level = qMax(0, int(std::floor(std::log2(side / minimumCellSize))));
+    return level < levelCount() ? level : -1;
+}
+
+void PointClusterIndex::clustersIn(int level, const FeatureStore::Extent &extent,
+                                   QVector<const Cluster*> &results) const
+{
+    if (level < 0 || level >= levelCount() || levels[level].empty()) return;
+    collect(level, 0, 0, 0, 0, extent, results);
+}
+
+void PointClusterIndex::collect(int level, int depth, quint64 code, quint32 nodeX, quint32 nodeY,
+                                const FeatureStore::Extent &extent,
+                                QVector<const Cluster*> &results) const
+{
+    double size = cellSize(depth);
+    FeatureStore::Extent node = { originX + nodeX * size, originY + nodeY * size,
+                                  originX + (nodeX + 1) * size, originY + (nodeY + 1) * size };
+    if (!node.intersects(extent)) return;
+
+    // The clusters under this node are one run of the level
+    const std::vector<Cluster> &clusters = levels[level];
+    int shift = 2 * (level - depth);
+    std::vector<Cluster>::const_iterator first =
+            std::lower_bound(clusters.begin(), clusters.end(), code << shift, keyLess);
+    std::vector<Cluster>::const_iterator last =
+            std::lower_bound(first, clusters.end(), (code + 1) << shift, keyLess);
+    if (first == last) return;
+
+    bool inside = node.minX >= extent.minX && node.maxX <= extent.maxX &&
+            node.minY >= extent.minY && node.maxY <= extent.maxY;
+    if (inside || depth == level) {
+        for (std::vector<Cluster>::const_iterator it = first; it != last; ++it) {
+            results.append(&*it);
+        }
+        return;
+    }
+
+    for (quint32 by = 0; by < 2; ++by) {
+        for (quint32 bx = 0; bx < 2; ++bx) {
+            collect(level, depth + 1, (code << 2) | (by << 1) | bx,
+                    nodeX * 2 + bx, nodeY * 2 + by, extent, results);
+        }
+    }
+}
+
+size_t PointClusterIndex::memoryUsage() const
+{
+    size_t bytes = 0;
+    for (const std::vector<Cluster> &clusters : levels) {
+        bytes += clusters.capacity() * sizeof(Cluster);
+    }
+    return bytes;
+}
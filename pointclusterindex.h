@@ -0,0 +1,64 @@
+#ifndef POINTCLUSTERINDEX_H
+#define POINTCLUSTERINDEX_H
+
+#include <QSharedPointer>
+#include <QVector>
+#include <vector>
+
+#include "featurestore.h"
+
+// Precomputed point clusters for every zoom level of a point layer.
+//
+// The layer extent is a square quadtree: level 0 is one cell and every
+// level halves the cell size. Points are sorted once by their Morton key
+// at the finest level, so the points of any cell at any level form one
+// contiguous run. Level L + 1 is aggregated into level L by a linear scan
+// over its clusters. Levels are kept down to where clustering stops
+// merging points; at finer zoom the points are drawn as they are.
+// Drawing only picks a level and walks the quadtree for the visible cells.
+class PointClusterIndex
+{
+public:
+    struct Cluster {
+        quint64 key;      // Morton code of the cell at its level
+        double x;         // Mean position of the points
+        double y;
+        quint32 count;
+    };
+
+    static QSharedPointer<const PointClusterIndex> build(const FeatureStorePtr &store);
+
+    int levelCount() const { return int(levels.size()); }
+    double cellSize(int level) const;
+    qint64 pointCount() const { return numPoints; }
+    qint64 elapsedMs() const { return buildMs; }
+
+    // Finest level whose cells are at least minimumCellSize wide, or -1
+    // when even the finest kept level is coarser than needed
+    int levelFor(double minimumCellSize) const;
+
+    // Clusters of the level whose cells touch the extent
+    void clustersIn(int level, const FeatureStore::Extent &extent,
+                    QVector<const Cluster*> &results) const;
+
+    size_t memoryUsage() const;
+
+private:
+    static const int kMaxLevel = 20;
+
+    PointClusterIndex();
+
+    void collect(int level, int depth, quint64 code, quint32 nodeX, quint32 nodeY,
+                 const FeatureStore::Extent &extent, QVector<const Cluster*> &results) const;
+
+    double originX;
+    double originY;
+    double side;
+    qint64 numPoints;
+    qint64 buildMs;
+    std::vector<std::vector<Cluster> > levels;   // Sorted by key
+};
+
+typedef QSharedPointer<const PointClusterIndex> PointClusterIndexPtr;
+
+#endif // POINTCLUSTERINDEX_H
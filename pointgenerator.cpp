@@ -0,0 +1,330 @@
+#include "pointgenerator.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPair>
+#include <QRandomGenerator>
+#include <QScopedPointer>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "geosutils.h"
+
+namespace {
+// Fixed tile count, enough to balance dense and empty tiles over the pool.
+// It must not depend on the thread count: random tiles are seeded by index.
+const int kTileCount = 256;
+// Progress and cancellation are checked every this many points
+const qint64 kProgressStep = 4096;
+}
+
+struct PointGenerator::Tile {
+    int index = 0;
+    FeatureStore::Extent extent;
+    qint64 quota = 0;        // Random: points to place
+    double maskArea = 0.0;   // Random with a mask: mask area inside the tile
+    qint64 firstRow = 0;     // Regular: grid rows of this tile
+    qint64 lastRow = 0;
+    qint64 tested = 0;
+    std::vector<double> xs;
+    std::vector<double> ys;
+};
+
+// Point-in-polygon test against a mask layer, one per worker thread
+class PointGenerator::Mask
+{
+public:
+    explicit Mask(const FeatureStore *store) : store(store) {}
+
+    ~Mask()
+    {
+        GEOSContextHandle_t context = geos.handle();
+        for (const Entry &entry : polygons) {
+            if (entry.prepared) GEOSPreparedGeom_destroy_r(context, entry.prepared);
+            if (entry.geometry) GEOSGeom_destroy_r(context, entry.geometry);
+        }
+    }
+
+    bool contains(double x, double y)
+    {
+        // Reuses the candidate buffer; search() appends
+        candidates.clear();
+        store->spatialIndex().search(x, y, x, y, candidates);
+
+        GEOSContextHandle_t context = geos.handle();
+        for (qint64 candidate : candidates) {
+            QHash<qint64, Entry>::iterator it = polygons.find(candidate);
+            if (it == polygons.end()) {
+                Entry entry;
+                entry.geometry = store->geometryKind(candidate) == FeatureStore::PolygonGeometry
+                        ? GeosUtils::fromFeature(context, *store, candidate) : nullptr;
+                entry.prepared = entry.geometry ? GEOSPrepare_r(context, entry.geometry) : nullptr;
+                it = polygons.insert(candidate, entry);
+            }
+            if (!it.value().prepared) continue;
+
+#if GEOS_VERSION_MAJOR > 3 || (GEOS_VERSION_MAJOR == 3 && GEOS_VERSION_MINOR >= 12)
+            if (GEOSPreparedContainsXY_r(context, it.value().prepared, x, y) == 1) return true;
+#else
+            GEOSGeometry *geometry = GEOSGeom_createPointFromXY_r(context, x, y);
+            bool inside = GEOSPreparedContains_r(context, it.value().prepared, geometry) == 1;
+            GEOSGeom_destroy_r(context, geometry);
+            if (inside) return true;
+#endif
+        }
+        return false;
+    }
+
+    // Polygon area inside the rectangle
+    double area(const FeatureStore::Extent &extent)
+    {
+        GEOSContextHandle_t context = geos.handle();
+        double total = 0.0;
+        for (qint64 candidate : store->featuresIn(extent)) {
+            if (store->geometryKind(candidate) != FeatureStore::PolygonGeometry) continue;
+            GEOSGeometry *geometry = GeosUtils::fromFeature(context, *store, candidate);
+            if (!geometry) continue;
+            GEOSGeometry *clipped = GEOSClipByRect_r(context, geometry, extent.minX, extent.minY,
+                                                     extent.maxX, extent.maxY);
+            double clippedArea = 0.0;
+            if (clipped && GEOSArea_r(context, clipped, &clippedArea) == 1) total += clippedArea;
+            if (clipped) GEOSGeom_destroy_r(context, clipped);
+            GEOSGeom_destroy_r(context, geometry);
+        }
+        return total;
+    }
+
+private:
+    struct Entry {
+        GEOSGeometry *geometry;
+        const GEOSPreparedGeometry *prepared;
+    };
+
+    const FeatureStore *store;
+    GeosContext geos;
+    QHash<qint64, Entry> polygons;
+    QVector<qint64> candidates;
+};
+
+QVector<PointGenerator::Tile> PointGenerator::makeTiles(const FeatureStore::Extent &extent, int tileCount)
+{
+    double width = extent.maxX - extent.minX;
+    double height = extent.maxY - extent.minY;
+
+    // Roughly square tiles
+    int tilesX = 1;
+    int tilesY = 1;
+    if (width > 0.0 && height > 0.0) {
+        tilesX = qMax(1, int(std::lround(std::sqrt(tileCount * width / height))));
+        tilesY = qMax(1, (tileCount + tilesX - 1) / tilesX);
+    }
+
+    QVector<Tile> tiles;
+    for (int ty = 0; ty < tilesY; ++ty) {
+        for (int tx = 0; tx < tilesX; ++tx) {
+            Tile tile;
+            tile.index = tiles.size();
+            tile.extent.minX = extent.minX + width * tx / tilesX;
+            tile.extent.maxX = extent.minX + width * (tx + 1) / tilesX;
+            tile.extent.minY = extent.minY + height * ty / tilesY;
+            tile.extent.maxY = extent.minY + height * (ty + 1) / tilesY;
+            tiles.append(tile);
+        }
+    }
+    return tiles;
+}
+
+FeatureStorePtr PointGenerator::collect(const QVector<Tile> &tiles, Statistics &stats)
+{
+    // Tiles are appended in index order, so the layer does not depend on scheduling
+    FeatureStorePtr store(new FeatureStore());
+    int idField = store->addField("id", FeatureStore::IntegerField);
+
+    qint64 id = 0;
+    for (const Tile &tile : tiles) {
+        stats.tested += tile.tested;
+        for (size_t i = 0; i < tile.xs.size(); ++i) {
+            store->beginFeature(id);
+            store->beginPart(FeatureStore::PointGeometry);
+            store->beginRing();
+            store->addVertex(tile.xs[i], tile.ys[i]);
+            store->setInteger(idField, id);
+            store->endFeature();
+            ++id;
+        }
+    }
+    store->finish();
+
+    stats.points = store->featureCount();
+    stats.tiles = tiles.size();
+    return store;
+}
+
+FeatureStorePtr PointGenerator::randomPoints(const FeatureStore::Extent &extent, const FeatureStore *mask,
+                                             qint64 count, quint32 seed,
+                                             Geoprocessing::Feedback *feedback,
+                                             Statistics *statistics, QString *error)
+{
+    if (extent.isNull() || count <= 0) {
+        if (error) *error = "An extent and a positive point count are needed";
+        return FeatureStorePtr();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<Tile> tiles = makeTiles(extent, kTileCount);
+
+    // Weight the tiles by their area, or by the mask area they cover
+    if (mask) {
+        QtConcurrent::blockingMap(tiles, [mask](Tile &tile) {
+            Mask tileMask(mask);
+            tile.maskArea = tileMask.area(tile.extent);
+        });
+    } else {
+        for (Tile &tile : tiles) {
+            tile.maskArea = (tile.extent.maxX - tile.extent.minX) * (tile.extent.maxY - tile.extent.minY);
+        }
+    }
+    double totalArea = 0.0;
+    for (const Tile &tile : tiles) totalArea += tile.maskArea;
+    if (totalArea <= 0.0) {
+        if (error) *error = "The mask polygons do not overlap the extent";
+        return FeatureStorePtr();
+    }
+
+    // Largest remainder split of the count
+    qint64 assigned = 0;
+    QVector<QPair<double, int> > remainders;
+    for (Tile &tile : tiles) {
+        double share = count * tile.maskArea / totalArea;
+        tile.quota = qint64(std::floor(share));
+        assigned += tile.quota;
+        remainders.append(qMakePair(share - tile.quota, tile.index));
+    }
+    std::sort(remainders.begin(), remainders.end(), [](const QPair<double, int> &a, const QPair<double, int> &b) {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    });
+    for (int i = 0; assigned < count && i < remainders.size(); ++i, ++assigned) {
+        tiles[remainders[i].second].quota++;
+    }
+
+    if (feedback) feedback->setTotal(count);
+
+    QtConcurrent::blockingMap(tiles, [mask, seed, feedback](Tile &tile) {
+        quint32 seeds[2] = { seed, quint32(tile.index) };
+        QRandomGenerator generator(seeds, 2);
+        QScopedPointer<Mask> tileMask(mask ? new Mask(mask) : nullptr);
+
+        double width = tile.extent.maxX - tile.extent.minX;
+        double height = tile.extent.maxY - tile.extent.minY;
+        tile.xs.reserve(size_t(tile.quota));
+        tile.ys.reserve(size_t(tile.quota));
+
+        // Rejection sampling; the cap only matters for slivers of mask area
+        qint64 attempts = 0;
+        qint64 maxAttempts = tile.quota * 1000 + 1000;
+        while (qint64(tile.xs.size()) < tile.quota && attempts < maxAttempts) {
+            if (feedback && attempts % kProgressStep == 0 && feedback->isCanceled()) break;
+            ++attempts;
+
+            double x = tile.extent.minX + generator.generateDouble() * width;
+            double y = tile.extent.minY + generator.generateDouble() * height;
+            if (tileMask) {
+                ++tile.tested;
+                if (!tileMask->contains(x, y)) continue;
+            }
+            tile.xs.push_back(x);
+            tile.ys.push_back(y);
+            if (feedback && tile.xs.size() % kProgressStep == 0) feedback->addProgress(kProgressStep);
+        }
+    });
+
+    if (feedback && feedback->isCanceled()) {
+        if (error) *error = "Canceled";
+        return FeatureStorePtr();
+    }
+
+    Statistics stats;
+    FeatureStorePtr store = collect(tiles, stats);
+    stats.elapsedMs = timer.elapsed();
+    if (statistics) *statistics = stats;
+    return store;
+}
+
+FeatureStorePtr PointGenerator::regularPoints(const FeatureStore::Extent &extent, const FeatureStore *mask,
+                                              double spacing,
+                                              Geoprocessing::Feedback *feedback,
+                                              Statistics *statistics, QString *error)
+{
+    if (extent.isNull() || spacing <= 0.0) {
+        if (error) *error = "An extent and a positive spacing are needed";
+        return FeatureStorePtr();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    qint64 columns = qint64(std::floor((extent.maxX - extent.minX) / spacing));
+    qint64 rows = qint64(std::floor((extent.maxY - extent.minY) / spacing));
+    if (columns <= 0 || rows <= 0) {
+        if (error) *error = "The spacing is larger than the extent";
+        return FeatureStorePtr();
+    }
+
+    // Bands of whole grid rows, so no point falls on a tile edge twice
+    qint64 bands = qMin<qint64>(rows, kTileCount);
+    QVector<Tile> tiles;
+    for (qint64 band = 0; band < bands; ++band) {
+        Tile tile;
+        tile.index = tiles.size();
+        tile.firstRow = rows * band / bands;
+        tile.lastRow = rows * (band + 1) / bands;
+        tile.extent.minX = extent.minX;
+        tile.extent.maxX = extent.minX + columns * spacing;
+        tile.extent.minY = extent.minY + tile.firstRow * spacing;
+        tile.extent.maxY = extent.minY + tile.lastRow * spacing;
+        tiles.append(tile);
+    }
+
+    if (feedback) feedback->setTotal(rows);
+
+    QtConcurrent::blockingMap(tiles, [&extent, mask, spacing, columns, feedback](Tile &tile) {
+        QScopedPointer<Mask> tileMask(mask ? new Mask(mask) : nullptr);
+        // Bands outside every mask polygon are skipped as a whole
+        if (mask && mask->featuresIn(tile.extent).isEmpty()) {
+            if (feedback) feedback->addProgress(tile.lastRow - tile.firstRow);
+            return;
+        }
+
+        for (qint64 row = tile.firstRow; row < tile.lastRow; ++row) {
+            if (feedback && feedback->isCanceled()) return;
+
+            double y = extent.minY + (row + 0.5) * spacing;
+            for (qint64 column = 0; column < columns; ++column) {
+                double x = extent.minX + (column + 0.5) * spacing;
+                if (tileMask) {
+                    ++tile.tested;
+                    if (!tileMask->contains(x, y)) continue;
+                }
+                tile.xs.push_back(x);
+                tile.ys.push_back(y);
+            }
+            if (feedback) feedback->addProgress(1);
+        }
+    });
+
+    if (feedback && feedback->isCanceled()) {
+        if (error) *error = "Canceled";
+        return FeatureStorePtr();
+    }
+
+    Statistics stats;
+    FeatureStorePtr store = collect(tiles, stats);
+    stats.elapsedMs = timer.elapsed();
+    if (statistics) *statistics = stats;
+    return store;
+}
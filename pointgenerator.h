@@ -0,0 +1,47 @@
+#ifndef POINTGENERATOR_H
+#define POINTGENERATOR_H
+
+#include <QString>
+
+#include "featurestore.h"
+#include "geoprocessing.h"
+
+// Random and regular point layers for sampling and research designs.
+//
+// The extent is cut into a fixed number of tiles that are filled in
+// parallel. Random points draw from one generator per tile seeded with
+// (seed, tile), so a given seed gives the same layer on any machine, no
+// matter how many threads there are or how the tiles were scheduled. With a
+// mask layer only points inside its polygons are kept: candidates go
+// through the mask's spatial index and then prepared polygons. Random
+// counts are shared between tiles by the mask area each tile covers, so
+// the points stay uniform over the polygons.
+class PointGenerator
+{
+public:
+    struct Statistics {
+        qint64 points = 0;
+        qint64 tested = 0;      // Candidate points tested against the mask
+        int tiles = 0;
+        qint64 elapsedMs = 0;
+    };
+
+    static FeatureStorePtr randomPoints(const FeatureStore::Extent &extent, const FeatureStore *mask,
+                                        qint64 count, quint32 seed,
+                                        Geoprocessing::Feedback *feedback = nullptr,
+                                        Statistics *statistics = nullptr, QString *error = nullptr);
+    // Points on a square grid of the given spacing, half a cell in from the extent edges
+    static FeatureStorePtr regularPoints(const FeatureStore::Extent &extent, const FeatureStore *mask,
+                                         double spacing,
+                                         Geoprocessing::Feedback *feedback = nullptr,
+                                         Statistics *statistics = nullptr, QString *error = nullptr);
+
+private:
+    struct Tile;
+    class Mask;
+
+    static QVector<Tile> makeTiles(const FeatureStore::Extent &extent, int tileCount);
+    static FeatureStorePtr collect(const QVector<Tile> &tiles, Statistics &stats);
+};
+
+#endif // POINTGENERATOR_H
@@ -0,0 +1,512 @@
+#include "printlayout.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QGraphicsScene>
+#include <QImageReader>
+#include <QImageWriter>
+#include <QMutexLocker>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QPolygonF>
+#include <QSaveFile>
+#include <QThread>
+#include <QtConcurrent/QtConcurrentMap>
+#include <cmath>
+
+namespace {
+const double kMillimetresPerInch = 25.4;
+// Metres per degree along the equator
+const double kMetresPerDegree = 111320.0;
+const double kPageMargin = 10.0;
+const double kTitleHeight = 12.0;
+const double kLegendLineHeight = 5.0;
+// PNG text entry holding the snapshot key of a frame file
+const char *const kFrameKeyText = "SnapshotKey";
+// PNG quality of frame files: light, fast compression
+const int kFrameFileQuality = 80;
+
+QRectF toDevice(const QRectF &rect, double dotsPerMm)
+{
+    return QRectF(rect.left() * dotsPerMm, rect.top() * dotsPerMm,
+                  rect.width() * dotsPerMm, rect.height() * dotsPerMm);
+}
+
+// Largest 1, 2 or 5 times a power of ten not above value
+double niceLength(double value)
+{
+    if (value <= 0.0) return 0.0;
+    double magnitude = std::pow(10.0, std::floor(std::log10(value)));
+    double step = value / magnitude;
+    if (step >= 5.0) return 5.0 * magnitude;
+    if (step >= 2.0) return 2.0 * magnitude;
+    return magnitude;
+}
+
+QString distanceText(double metres)
+{
+    if (metres >= 1000.0) return QString::number(metres / 1000.0, 'g', 6) + " km";
+    return QString::number(metres, 'g', 6) + " m";
+}
+}
+
+LayoutFrameCache::LayoutFrameCache(int maxMegabytes)
+    : entries(qMax(1, maxMegabytes) * 1024)
+{
+}
+
+QImage LayoutFrameCache::find(const QByteArray &slot, const QByteArray &key)
+{
+    {
+        QMutexLocker locker(&mutex);
+        Entry *entry = entries.object(slot);
+        if (entry && entry->key == key) return entry->image;
+    }
+
+    // Frames dropped from memory are read back from their file
+    if (!directory.isValid()) return QImage();
+    QImageReader reader(filePath(slot), "png");
+    if (reader.text(kFrameKeyText) != QString::fromLatin1(key.toHex())) return QImage();
+    QImage image = reader.read();
+    if (!image.isNull()) keep(slot, key, image);
+    return image;
+}
+
+void LayoutFrameCache::insert(const QByteArray &slot, const QByteArray &key, const QImage &image)
+{
+    keep(slot, key, image);
+    if (!directory.isValid()) return;
+
+    // Written aside and renamed, so a reader never sees half a file
+    QSaveFile file(filePath(slot));
+    if (!file.open(QIODevice::WriteOnly)) return;
+    QImageWriter writer(&file, "png");
+    writer.setQuality(kFrameFileQuality);
+    writer.setText(kFrameKeyText, QString::fromLatin1(key.toHex()));
+    if (writer.write(image)) file.commit();
+    else file.cancelWriting();
+}
+
+void LayoutFrameCache::clear()
+{
+    QMutexLocker locker(&mutex);
+    entries.clear();
+    if (!directory.isValid()) return;
+    QDir files(directory.path());
+    for (const QString &name : files.entryList(QDir::Files)) files.remove(name);
+}
+
+void LayoutFrameCache::keep(const QByteArray &slot, const QByteArray &key, const QImage &image)
+{
+    Entry *entry = new Entry;
+    entry->key = key;
+    entry->image = image;
+    QMutexLocker locker(&mutex);
+    entries.insert(slot, entry, qMax(1, int(qint64(image.bytesPerLine()) * image.height() / 1024)));
+}
+
+QString LayoutFrameCache::filePath(const QByteArray &slot) const
+{
+    return directory.filePath(QString::fromLatin1(
+            QCryptographicHash::hash(slot, QCryptographicHash::Sha1).toHex()) + ".png");
+}
+
+struct PrintLayout::Frame {
+    int page = 0;
+    QRectF rect;                             // Millimetres on the page
+    QRectF sceneRect;
+    QSize size;                              // Output pixels
+    QByteArray slot;
+    QSharedPointer<MapExporter> exporter;    // Only while its page is exported
+    QImage image;                            // Held only while its page is drawn
+};
+
+PrintLayout::PrintLayout(const Options &layoutOptions)
+    : options(layoutOptions)
+    , cache(nullptr)
+{
+}
+
+PrintLayout::~PrintLayout()
+{
+}
+
+QVector<PrintLayout::Item> PrintLayout::defaultItems(const QSizeF &pageMm, bool legend, bool scaleBar,
+                                                     bool northArrow)
+{
+    QVector<Item> layoutItems;
+    double width = pageMm.width() - 2.0 * kPageMargin;
+    double height = pageMm.height() - 2.0 * kPageMargin;
+
+    Item title;
+    title.kind = TitleItem;
+    title.rect = QRectF(kPageMargin, kPageMargin, width, kTitleHeight);
+    layoutItems.append(title);
+
+    Item map;
+    map.kind = MapItem;
+    map.rect = QRectF(kPageMargin, kPageMargin + kTitleHeight + 2.0,
+                      width, height - kTitleHeight - 2.0);
+    layoutItems.append(map);
+
+    // The rest sits on the map, inset from its border
+    if (legend) {
+        Item item;
+        item.kind = LegendItem;
+        double legendHeight = qMin(80.0, map.rect.height() / 2.0);
+        item.rect = QRectF(map.rect.right() - 55.0, map.rect.bottom() - legendHeight - 3.0,
+                           52.0, legendHeight);
+        layoutItems.append(item);
+    }
+    if (scaleBar) {
+        Item item;
+        item.kind = ScaleBarItem;
+        item.rect = QRectF(map.rect.left() + 3.0, map.rect.bottom() - 15.0,
+                           qMin(80.0, map.rect.width() / 3.0), 12.0);
+        layoutItems.append(item);
+    }
+    if (northArrow) {
+        Item item;
+        item.kind = NorthArrowItem;
+        item.rect = QRectF(map.rect.right() - 15.0, map.rect.top() + 3.0, 12.0, 18.0);
+        layoutItems.append(item);
+    }
+    return layoutItems;
+}
+
+QSizeF PrintLayout::pageSizeMm() const
+{
+    QSizeF size = options.pageSize.size(QPageSize::Millimeter);
+    bool landscape = options.orientation == QPageLayout::Landscape;
+    if (landscape != (size.width() > size.height())) size.transpose();
+    return size;
+}
+
+void PrintLayout::addPage(const QRectF &sceneRect, const QString &title)
+{
+    Page page;
+    page.sceneRect = sceneRect;
+    page.title = title;
+    pages.append(page);
+}
+
+QRectF PrintLayout::frameSceneRect(const QRectF &sceneRect, const QRectF &frameMm) const
+{
+    if (sceneRect.isEmpty() || frameMm.isEmpty()) return sceneRect;
+
+    // Widen the short side so the extent fills the frame undistorted
+    double frameAspect = frameMm.width() / frameMm.height();
+    QRectF rect = sceneRect;
+    if (rect.width() / rect.height() < frameAspect) rect.setWidth(rect.height() * frameAspect);
+    else rect.setHeight(rect.width() / frameAspect);
+    rect.moveCenter(sceneRect.center());
+    return rect;
+}
+
+MapExporter::Options PrintLayout::frameOptions(const Frame &frame) const
+{
+    MapExporter::Options exportOptions;
+    exportOptions.sceneRect = frame.sceneRect;
+    exportOptions.size = frame.size;
+    exportOptions.dpi = options.dpi;
+    exportOptions.background = options.background;
+    return exportOptions;
+}
+
+void PrintLayout::prepare(QGraphicsScene *scene, LayoutFrameCache *frameCache)
+{
+    cache = frameCache;
+    frames.clear();
+    // One snapshot for the frames of every page; fitting it to a frame is cheap
+    snapshot = MapExporter::takeSnapshot(scene);
+
+    for (int page = 0; page < pages.size(); ++page) {
+        for (const Item &item : items) {
+            if (item.kind != MapItem || item.rect.isEmpty()) continue;
+
+            Frame frame;
+            frame.page = page;
+            frame.rect = item.rect;
+            frame.sceneRect = frameSceneRect(pages[page].sceneRect, item.rect);
+            frame.size = QSize(qMax(1, qRound(item.rect.width() / kMillimetresPerInch * options.dpi)),
+                               qMax(1, qRound(item.rect.height() / kMillimetresPerInch * options.dpi)));
+
+            // Same extent, size and dpi: the same slot in the cache
+            QDataStream stream(&frame.slot, QIODevice::WriteOnly);
+            stream << frame.sceneRect << frame.size << options.dpi;
+            stream.setDevice(nullptr);
+            frames.append(frame);
+        }
+    }
+}
+
+bool PrintLayout::exportPdf(const QString &filePath, Geoprocessing::Feedback *feedback,
+                            Statistics *statistics, QString *error)
+{
+    if (pages.isEmpty()) {
+        if (error) *error = "The layout has no pages";
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QPdfWriter writer(filePath);
+    writer.setResolution(qRound(options.dpi));
+    writer.setCreator("Qgis_demo");
+    writer.setPageLayout(QPageLayout(options.pageSize, options.orientation, QMarginsF(0, 0, 0, 0)));
+
+    QPainter painter;
+    if (!painter.begin(&writer)) {
+        if (error) *error = "Could not write " + filePath;
+        return false;
+    }
+    painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing |
+                           QPainter::SmoothPixmapTransform);
+    double dotsPerMm = options.dpi / kMillimetresPerInch;
+
+    int threads = qMax(1, QThread::idealThreadCount());
+    Statistics stats;
+    stats.pages = pages.size();
+    stats.frames = frames.size();
+    stats.threads = qMin(threads, frames.size());
+    if (feedback) feedback->setTotal(pages.size());
+
+    // One page per thread at a time; the frames of a batch are all the
+    // full-resolution images held at once
+    bool ok = true;
+    int frameBegin = 0;
+    for (int pageBegin = 0; pageBegin < pages.size(); pageBegin += threads) {
+        if (feedback && feedback->isCanceled()) {
+            if (error) *error = "Canceled";
+            ok = false;
+            break;
+        }
+        int pageEnd = qMin(pages.size(), pageBegin + threads);
+        int frameEnd = frameBegin;
+        while (frameEnd < frames.size() && frames[frameEnd].page < pageEnd) ++frameEnd;
+
+        // Fitting the snapshot only places its items and gives the key;
+        // labels and drawing are left to the frames the cache misses
+        QVector<Frame*> batch;
+        for (int f = frameBegin; f < frameEnd; ++f) batch.append(&frames[f]);
+        QtConcurrent::blockingMap(batch, [this](Frame *frame) {
+            frame->exporter.reset(new MapExporter(frameOptions(*frame)));
+            frame->exporter->prepare(snapshot);
+            if (cache) frame->image = cache->find(frame->slot, frame->exporter->snapshotKey());
+        });
+
+        QVector<Frame*> pending;
+        for (Frame *frame : batch) {
+            if (frame->image.isNull()) pending.append(frame);
+            else ++stats.framesCached;
+        }
+        QtConcurrent::blockingMap(pending, [this](Frame *frame) {
+            frame->image = frame->exporter->render();
+            if (cache) cache->insert(frame->slot, frame->exporter->snapshotKey(), frame->image);
+        });
+        stats.framesRendered += pending.size();
+
+        // PDF pages can only be written in order, on one thread
+        for (int page = pageBegin; page < pageEnd; ++page) {
+            if (page > 0) writer.newPage();
+            drawPage(&painter, page, dotsPerMm);
+            if (feedback) feedback->addProgress(1);
+        }
+        for (int f = frameBegin; f < frameEnd; ++f) {
+            frames[f].image = QImage();
+            frames[f].exporter.reset();
+        }
+        frameBegin = frameEnd;
+    }
+    painter.end();
+
+    stats.elapsedMs = timer.elapsed();
+    if (statistics) *statistics = stats;
+    return ok;
+}
+
+void PrintLayout::drawPage(QPainter *painter, int page, double dotsPerMm) const
+{
+    QSizeF pageMm = pageSizeMm();
+    painter->fillRect(toDevice(QRectF(QPointF(0.0, 0.0), pageMm), dotsPerMm), options.background);
+
+    const Frame *pageFrame = nullptr;
+    int frame = 0;
+    while (frame < frames.size() && frames[frame].page < page) ++frame;
+
+    for (const Item &item : items) {
+        QRectF rect = toDevice(item.rect, dotsPerMm);
+        painter->save();
+        switch (item.kind) {
+        case MapItem:
+            if (frame < frames.size() && frames[frame].page == page) {
+                const Frame &mapFrame = frames[frame++];
+                if (!pageFrame) pageFrame = &mapFrame;
+                painter->drawImage(rect, mapFrame.image);
+                painter->setPen(QPen(Qt::black, 0.3 * dotsPerMm));
+                painter->setBrush(Qt::NoBrush);
+                painter->drawRect(rect);
+            }
+            break;
+        case TitleItem: {
+            QFont font = painter->font();
+            font.setPointSizeF(16.0);
+            font.setBold(true);
+            painter->setFont(font);
+            painter->setPen(Qt::black);
+            painter->drawText(rect, Qt::AlignLeft | Qt::AlignVCenter | Qt::TextSingleLine,
+                              item.text.isEmpty() ? pages[page].title : item.text);
+            break;
+        }
+        case LegendItem:
+            drawLegend(painter, rect, dotsPerMm);
+            break;
+        case ScaleBarItem:
+            drawScaleBar(painter, rect, pageFrame, dotsPerMm);
+            break;
+        case NorthArrowItem:
+            drawNorthArrow(painter, rect);
+            break;
+        }
+        painter->restore();
+    }
+}
+
+void PrintLayout::drawLegend(QPainter *painter, const QRectF &rect, double dotsPerMm) const
+{
+    if (options.legend.isEmpty()) return;
+
+    painter->setPen(QPen(Qt::black, 0.2 * dotsPerMm));
+    painter->setBrush(QColor(255, 255, 255, 230));
+    painter->drawRect(rect);
+    painter->setClipRect(rect);
+
+    double padding = 2.0 * dotsPerMm;
+    double lineHeight = kLegendLineHeight * dotsPerMm;
+    QFont font = painter->font();
+    font.setPointSizeF(9.0);
+    font.setBold(true);
+    painter->setFont(font);
+    painter->setPen(Qt::black);
+    double y = rect.top() + padding;
+    painter->drawText(QRectF(rect.left() + padding, y, rect.width() - 2.0 * padding, lineHeight),
+                      Qt::AlignLeft | Qt::AlignVCenter, "Legend");
+    y += lineHeight;
+
+    font.setBold(false);
+    font.setPointSizeF(7.5);
+    painter->setFont(font);
+    for (const LegendEntry &entry : options.legend) {
+        if (y + lineHeight > rect.bottom() - padding) {
+            painter->setPen(Qt::black);
+            painter->drawText(QRectF(rect.left() + padding, y, rect.width() - 2.0 * padding, lineHeight),
+                              Qt::AlignLeft | Qt::AlignVCenter, QString::fromUtf8("…"));
+            break;
+        }
+
+        double x = rect.left() + padding + (entry.indented ? 3.0 * dotsPerMm : 0.0);
+        QRectF symbol(x, y + lineHeight * 0.2, 6.0 * dotsPerMm, lineHeight * 0.6);
+        switch (entry.kind) {
+        case FeatureStore::PointGeometry: {
+            double radius = symbol.height() / 2.0;
+            painter->setPen(QPen(entry.color.darker(150), 0.15 * dotsPerMm));
+            painter->setBrush(entry.color);
+            painter->drawEllipse(symbol.center(), radius, radius);
+            break;
+        }
+        case FeatureStore::LineGeometry:
+            painter->setPen(QPen(entry.color, 0.5 * dotsPerMm));
+            painter->drawLine(QPointF(symbol.left(), symbol.center().y()),
+                              QPointF(symbol.right(), symbol.center().y()));
+            break;
+        default:
+            painter->setPen(QPen(entry.color.darker(150), 0.15 * dotsPerMm));
+            painter->setBrush(entry.color);
+            painter->drawRect(symbol);
+            break;
+        }
+
+        double textLeft = symbol.right() + 2.0 * dotsPerMm;
+        painter->setPen(Qt::black);
+        painter->drawText(QRectF(textLeft, y, rect.right() - padding - textLeft, lineHeight),
+                          Qt::AlignLeft | Qt::AlignVCenter | Qt::TextSingleLine, entry.label);
+        y += lineHeight;
+    }
+}
+
+void PrintLayout::drawScaleBar(QPainter *painter, const QRectF &rect, const Frame *frame,
+                               double dotsPerMm) const
+{
+    if (!frame || frame->rect.isEmpty()) return;
+
+    // Ground metres per millimetre of the frame, taken across its centre
+    QRectF mapRect = options.sceneToMap.mapRect(frame->sceneRect);
+    double metresPerMm = mapRect.width() / frame->rect.width();
+    if (options.geographic) {
+        double latitude = qBound(-89.0, mapRect.center().y(), 89.0);
+        metresPerMm *= kMetresPerDegree * std::cos(latitude * M_PI / 180.0);
+    }
+    if (metresPerMm <= 0.0) return;
+
+    double rectMm = rect.width() / dotsPerMm;
+    double metres = niceLength(rectMm * 0.8 * metresPerMm);
+    double barWidth = metres / metresPerMm * dotsPerMm;
+    if (barWidth <= 0.0) return;
+
+    QFont font = painter->font();
+    font.setPointSizeF(7.0);
+    painter->setFont(font);
+    double textHeight = rect.height() * 0.45;
+    double barHeight = rect.height() * 0.2;
+    double barTop = rect.top() + textHeight;
+    double left = rect.left() + rect.width() * 0.05;
+
+    // Four segments in alternating colours
+    const int segments = 4;
+    double segmentWidth = barWidth / segments;
+    painter->setPen(QPen(Qt::black, 0.15 * dotsPerMm));
+    for (int i = 0; i < segments; ++i) {
+        painter->setBrush(i % 2 == 0 ? Qt::black : Qt::white);
+        painter->drawRect(QRectF(left + i * segmentWidth, barTop, segmentWidth, barHeight));
+    }
+
+    painter->setPen(Qt::black);
+    QRectF zeroRect(left - segmentWidth / 2.0, rect.top(), segmentWidth, textHeight);
+    painter->drawText(zeroRect, Qt::AlignHCenter | Qt::AlignBottom, "0");
+    QRectF endRect(left + barWidth - segmentWidth, rect.top(), 2.0 * segmentWidth, textHeight);
+    painter->drawText(endRect, Qt::AlignHCenter | Qt::AlignBottom, distanceText(metres));
+
+    QRectF scaleRect(left, barTop + barHeight, rect.right() - left, rect.bottom() - barTop - barHeight);
+    painter->drawText(scaleRect, Qt::AlignLeft | Qt::AlignVCenter,
+                      QString("1:%L1").arg(qRound64(metresPerMm * 1000.0)));
+}
+
+void PrintLayout::drawNorthArrow(QPainter *painter, const QRectF &rect) const
+{
+    // The map is never rotated, so north is straight up
+    double letterHeight = rect.height() * 0.3;
+    QRectF arrow(rect.left(), rect.top() + letterHeight, rect.width(), rect.height() - letterHeight);
+    QPointF tip(arrow.center().x(), arrow.top());
+    QPointF notch(arrow.center().x(), arrow.top() + arrow.height() * 0.7);
+
+    QPolygonF leftHalf;
+    leftHalf << tip << QPointF(arrow.left(), arrow.bottom()) << notch;
+    QPolygonF rightHalf;
+    rightHalf << tip << notch << QPointF(arrow.right(), arrow.bottom());
+
+    painter->setPen(QPen(Qt::black, rect.width() * 0.03));
+    painter->setBrush(Qt::white);
+    painter->drawPolygon(leftHalf);
+    painter->setBrush(Qt::black);
+    painter->drawPolygon(rightHalf);
+
+    QFont font = painter->font();
+    font.setPointSizeF(10.0);
+    font.setBold(true);
+    painter->setFont(font);
+    painter->drawText(QRectF(rect.left(), rect.top(), rect.width(), letterHeight),
+                      Qt::AlignCenter, "N");
+}
@@ -0,0 +1,159 @@
+#ifndef PRINTLAYOUT_H
+#define PRINTLAYOUT_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QColor>
+#include <QImage>
+#include <QMutex>
+#include <QPageLayout>
+#include <QPageSize>
+#include <QRectF>
+#include <QSharedPointer>
+#include <QSizeF>
+#include <QString>
+#include <QTemporaryDir>
+#include <QTransform>
+#include <QVector>
+
+#include "featurestore.h"
+#include "geoprocessing.h"
+#include "mapexporter.h"
+
+class QGraphicsScene;
+class QPainter;
+
+// Rendered map frames of print layouts, kept between exports. Every frame
+// has one slot (its page extent, frame size and dpi) holding the image of
+// the last export together with the snapshot key it was rendered from, so
+// a frame renders again only when its extent or one of its layers
+// changed, and a changed frame replaces its own entry. The most recently
+// used frames stay in memory within a fixed budget; every frame is also
+// written to a temporary directory, one PNG per slot tagged with its key,
+// so an atlas larger than the budget reads its older frames back instead
+// of rendering them again. Thread safe.
+class LayoutFrameCache
+{
+public:
+    explicit LayoutFrameCache(int maxMegabytes = 1024);
+
+    QImage find(const QByteArray &slot, const QByteArray &key);
+    void insert(const QByteArray &slot, const QByteArray &key, const QImage &image);
+    void clear();
+
+private:
+    struct Entry {
+        QByteArray key;
+        QImage image;
+    };
+
+    void keep(const QByteArray &slot, const QByteArray &key, const QImage &image);
+    QString filePath(const QByteArray &slot) const;
+
+    QMutex mutex;
+    QCache<QByteArray, Entry> entries;   // Cost in kilobytes
+    QTemporaryDir directory;             // Removed with the cache
+
+    Q_DISABLE_COPY(LayoutFrameCache)
+};
+
+// Print layout with map frames, title, legend, scale bar and north arrow.
+//
+// The same items are placed on every page; each page shows its own
+// extent in the map frames, so a list of pages is an atlas. prepare()
+// takes one MapExporter snapshot of the scene for the whole layout on the
+// GUI thread. exportPdf() then fits it to the frames of several pages in
+// parallel, which only gives their keys, and places the labels and
+// renders at the output dpi just the frames the frame cache does not
+// hold, before drawing the pages into the PDF in order. The decorations
+// are drawn as vectors.
+class PrintLayout
+{
+public:
+    enum ItemKind {
+        MapItem,
+        TitleItem,
+        LegendItem,
+        ScaleBarItem,
+        NorthArrowItem
+    };
+
+    struct Item {
+        ItemKind kind = MapItem;
+        QRectF rect;               // Millimetres from the top left of the page
+        QString text;              // Title; the page title when empty
+    };
+
+    struct Page {
+        QRectF sceneRect;          // Widened to the aspect of the map frames
+        QString title;
+    };
+
+    struct LegendEntry {
+        QString label;
+        QColor color;
+        FeatureStore::GeometryKind kind = FeatureStore::PolygonGeometry;
+        bool indented = false;     // A class of the layer above
+    };
+
+    struct Options {
+        QPageSize pageSize = QPageSize(QPageSize::A4);
+        QPageLayout::Orientation orientation = QPageLayout::Landscape;
+        double dpi = 300.0;
+        QColor background = Qt::white;
+        QTransform sceneToMap;     // For the scale bar
+        bool geographic = false;   // Map units are degrees
+        QVector<LegendEntry> legend;
+    };
+
+    struct Statistics {
+        int pages = 0;
+        int frames = 0;
+        int framesRendered = 0;
+        int framesCached = 0;
+        int threads = 0;
+        qint64 elapsedMs = 0;
+    };
+
+    explicit PrintLayout(const Options &options);
+    ~PrintLayout();
+
+    // Title band above a map frame filling the page, with the legend,
+    // scale bar and north arrow over the map
+    static QVector<Item> defaultItems(const QSizeF &pageMm, bool legend, bool scaleBar,
+                                      bool northArrow);
+
+    QSizeF pageSizeMm() const;
+    void setItems(const QVector<Item> &layoutItems) { items = layoutItems; }
+    void addPage(const QRectF &sceneRect, const QString &title);
+    int pageCount() const { return pages.size(); }
+
+    // GUI thread: snapshot of the scene for every map frame; the scene
+    // items must outlive exportPdf(). The cache may be null.
+    void prepare(QGraphicsScene *scene, LayoutFrameCache *cache);
+
+    bool exportPdf(const QString &filePath, Geoprocessing::Feedback *feedback = nullptr,
+                   Statistics *statistics = nullptr, QString *error = nullptr);
+
+private:
+    struct Frame;
+
+    QRectF frameSceneRect(const QRectF &sceneRect, const QRectF &frameMm) const;
+    MapExporter::Options frameOptions(const Frame &frame) const;
+    void drawPage(QPainter *painter, int page, double dotsPerMm) const;
+    void drawLegend(QPainter *painter, const QRectF &rect, double dotsPerMm) const;
+    void drawScaleBar(QPainter *painter, const QRectF &rect, const Frame *frame,
+                      double dotsPerMm) const;
+    void drawNorthArrow(QPainter *painter, const QRectF &rect) const;
+
+    Options options;
+    QVector<Item> items;
+    QVector<Page> pages;
+    QVector<Frame> frames;         // Page by page, in item order
+    MapExporter::SnapshotPtr snapshot;
+    LayoutFrameCache *cache;
+
+    Q_DISABLE_COPY(PrintLayout)
+};
+
+#endif // PRINTLAYOUT_H
@@ -0,0 +1,141 @@
+#include "renderdiagnostics.h"
+
+#include <QFile>
+#include <QTextStream>
+
+namespace {
+// About ten seconds at 60 frames per second
+const int kDefaultHistorySize = 600;
+
+QString csvText(const QString &text)
+{
+    if (!text.contains(',') && !text.contains('"') && !text.contains('\n')) return text;
+    QString quoted = text;
+    quoted.replace("\"", "\"\"");
+    return "\"" + quoted + "\"";
+}
+}
+
+RenderDiagnostics::RenderDiagnostics(QObject *parent)
+    : QObject(parent)
+    , enabled(false)
+    , frameOpen(false)
+    , maxFrames(kDefaultHistorySize)
+    , frameCount(0)
+    , pendingCoordinateNs(0)
+    , pendingTransformNs(0)
+{
+    clock.start();
+}
+
+void RenderDiagnostics::setEnabled(bool enable)
+{
+    enabled = enable;
+    frameOpen = false;
+}
+
+void RenderDiagnostics::setHistorySize(int count)
+{
+    maxFrames = qMax(1, count);
+    if (frames.size() > maxFrames) frames.remove(0, frames.size() - maxFrames);
+}
+
+void RenderDiagnostics::beginFrame()
+{
+    if (!enabled) return;
+    current = Frame();
+    current.number = ++frameCount;
+    current.timestampMs = clock.elapsed();
+    frameOpen = true;
+    frameTimer.start();
+}
+
+void RenderDiagnostics::endFrame()
+{
+    if (!enabled || !frameOpen) return;
+    frameOpen = false;
+    current.totalMs = frameTimer.nsecsElapsed() / 1.0e6;
+
+    // Readouts since the last frame are booked to this one
+    current.coordinateUpdateMs = pendingCoordinateNs / 1.0e6;
+    current.geographicTransformMs = pendingTransformNs / 1.0e6;
+    pendingCoordinateNs = 0;
+    pendingTransformNs = 0;
+
+    if (frames.size() >= maxFrames) frames.remove(0, frames.size() - maxFrames + 1);
+    frames.append(current);
+    emit frameRecorded();
+}
+
+void RenderDiagnostics::addLayerSample(const LayerSample &sample)
+{
+    if (!enabled || !frameOpen) return;
+    current.layers.append(sample);
+    if (sample.cacheHit) ++current.cacheHits;
+    else ++current.cacheMisses;
+    current.drawn += sample.drawn;
+    current.culled += sample.culled;
+}
+
+void RenderDiagnostics::addTime(Timing timing, qint64 nanoseconds)
+{
+    if (!enabled) return;
+    if (timing == CoordinateUpdate) pendingCoordinateNs += nanoseconds;
+    else pendingTransformNs += nanoseconds;
+}
+
+void RenderDiagnostics::clear()
+{
+    frames.clear();
+    pendingCoordinateNs = 0;
+    pendingTransformNs = 0;
+}
+
+bool RenderDiagnostics::exportCsv(const QString &filePath, QString *error) const
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
+        if (error) *error = "Could not write " + filePath + ": " + file.errorString();
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "frame,timestamp_ms,total_ms,coordinate_update_ms,geographic_transform_ms,"
+           "cache_hits,cache_misses,features_drawn,features_culled,"
+           "layer,layer_paint_ms,layer_render_ms,layer_drawn,layer_culled,layer_cache_hit\n";
+
+    for (const Frame &frame : frames) {
+        QString frameColumns = QString("%1,%2,%3,%4,%5,%6,%7,%8,%9")
+                .arg(frame.number)
+                .arg(frame.timestampMs)
+                .arg(frame.totalMs, 0, 'f', 3)
+                .arg(frame.coordinateUpdateMs, 0, 'f', 3)
+                .arg(frame.geographicTransformMs, 0, 'f', 3)
+                .arg(frame.cacheHits)
+                .arg(frame.cacheMisses)
+                .arg(frame.drawn)
+                .arg(frame.culled);
+
+        // Frames without layer samples still get a row
+        if (frame.layers.isEmpty()) {
+            out << frameColumns << ",,,,,,\n";
+            continue;
+        }
+        for (const LayerSample &layer : frame.layers) {
+            out << frameColumns << ','
+                << csvText(layer.layer) << ','
+                << QString::number(layer.paintMs, 'f', 3) << ','
+                << QString::number(layer.renderMs, 'f', 3) << ','
+                << layer.drawn << ','
+                << layer.culled << ','
+                << (layer.cacheHit ? 1 : 0) << '\n';
+        }
+    }
+
+    out.flush();
+    if (file.error() != QFileDevice::NoError) {
+        if (error) *error = "Could not write " + filePath + ": " + file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,109 @@
+#ifndef RENDERDIAGNOSTICS_H
+#define RENDERDIAGNOSTICS_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+// Frame timings of the map canvas.
+//
+// The canvas brackets every paint with beginFrame() and endFrame(); layer
+// items add one sample per paint in between. Coordinate readouts report
+// their time whenever they run and are booked to the next frame. Finished
+// frames go into a rolling history that can be written out as CSV. All
+// calls come from the GUI thread; when disabled every call returns at once.
+class RenderDiagnostics : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Timing {
+        CoordinateUpdate,       // MainWindow::updateCoordinates
+        GeographicTransform     // MainWindow::sceneToGeographicCoords
+    };
+
+    struct LayerSample {
+        QString layer;
+        double paintMs = 0.0;    // GUI thread, compositing included
+        double renderMs = 0.0;   // Background render that finished since the last frame
+        qint64 drawn = 0;        // Features drawn by that render
+        qint64 culled = 0;       // Features it skipped by extent
+        bool cacheHit = false;   // Composited without asking for a new render
+    };
+
+    struct Frame {
+        qint64 number = 0;
+        qint64 timestampMs = 0;  // Since the diagnostics were created
+        double totalMs = 0.0;
+        double coordinateUpdateMs = 0.0;
+        double geographicTransformMs = 0.0;
+        int cacheHits = 0;
+        int cacheMisses = 0;
+        qint64 drawn = 0;
+        qint64 culled = 0;
+        QVector<LayerSample> layers;
+    };
+
+    explicit RenderDiagnostics(QObject *parent = nullptr);
+
+    bool isEnabled() const { return enabled; }
+    void setEnabled(bool enable);
+
+    // Frames kept before the oldest are dropped
+    int historySize() const { return maxFrames; }
+    void setHistorySize(int count);
+
+    void beginFrame();
+    void endFrame();
+    bool inFrame() const { return frameOpen; }
+
+    void addLayerSample(const LayerSample &sample);
+    void addTime(Timing timing, qint64 nanoseconds);
+
+    const QVector<Frame> &history() const { return frames; }
+    void clear();
+
+    // One row per layer sample, frame columns repeated on every row
+    bool exportCsv(const QString &filePath, QString *error = nullptr) const;
+
+signals:
+    void frameRecorded();
+
+private:
+    bool enabled;
+    bool frameOpen;
+    int maxFrames;
+    qint64 frameCount;
+    QElapsedTimer clock;
+    QElapsedTimer frameTimer;
+    Frame current;
+    qint64 pendingCoordinateNs;
+    qint64 pendingTransformNs;
+    QVector<Frame> frames;
+};
+
+// Adds the time until it goes out of scope to one of the timings
+class ScopedRenderTiming
+{
+public:
+    ScopedRenderTiming(RenderDiagnostics *diagnostics, RenderDiagnostics::Timing timing)
+        : diagnostics(diagnostics && diagnostics->isEnabled() ? diagnostics : nullptr)
+        , timing(timing)
+    {
+        if (this->diagnostics) timer.start();
+    }
+    ~ScopedRenderTiming()
+    {
+        if (diagnostics) diagnostics->addTime(timing, timer.nsecsElapsed());
+    }
+
+private:
+    RenderDiagnostics *diagnostics;
+    RenderDiagnostics::Timing timing;
+    QElapsedTimer timer;
+
+    Q_DISABLE_COPY(ScopedRenderTiming)
+};
+
+#endif // RENDERDIAGNOSTICS_H
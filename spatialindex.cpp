@@ -0,0 +1,230 @@
+#include "spatialindex.h"
+
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Position of (x, y) on a 16 bit Hilbert curve
+quint32 hilbertValue(quint32 x, quint32 y)
+{
+    quint32 a = x ^ y;
+    quint32 b = 0xFFFF ^ a;
+    quint32 c = 0xFFFF ^ (x | y);
+    quint32 d = x & (y ^ 0xFFFF);
+
+    quint32 A = a | (b >> 1);
+    quint32 B = (a >> 1) ^ a;
+    quint32 C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+    quint32 D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+
+    a = A; b = B; c = C; d = D;
+    A = (a & (a >> 2)) ^ (b & (b >> 2));
+    B = (a & (b >> 2)) ^ (b & ((a ^ b) >> 2));
+    C ^= (a & (c >> 2)) ^ (b & (d >> 2));
+    D ^= (b & (c >> 2)) ^ ((a ^ b) & (d >> 2));
+
+    a = A; b = B; c = C; d = D;
+    A = (a & (a >> 4)) ^ (b & (b >> 4));
+    B = (a & (b >> 4)) ^ (b & ((a ^ b) >> 4));
+    C ^= (a & (c >> 4)) ^ (b & (d >> 4));
+    D ^= (b & (c >> 4)) ^ ((a ^ b) & (d >> 4));
+
+    a = A; b = B; c = C; d = D;
+    C ^= (a & (c >> 8)) ^ (b & (d >> 8));
+    D ^= (b & (c >> 8)) ^ ((a ^ b) & (d >> 8));
+
+    a = C ^ (C >> 1);
+    b = D ^ (D >> 1);
+
+    quint32 i0 = x ^ y;
+    quint32 i1 = b | (0xFFFF ^ (i0 | a));
+
+    i0 = (i0 | (i0 << 8)) & 0x00FF00FF;
+    i0 = (i0 | (i0 << 4)) & 0x0F0F0F0F;
+    i0 = (i0 | (i0 << 2)) & 0x33333333;
+    i0 = (i0 | (i0 << 1)) & 0x55555555;
+
+    i1 = (i1 | (i1 << 8)) & 0x00FF00FF;
+    i1 = (i1 | (i1 << 4)) & 0x0F0F0F0F;
+    i1 = (i1 | (i1 << 2)) & 0x33333333;
+    i1 = (i1 | (i1 << 1)) & 0x55555555;
+
+    return (i1 << 1) | i0;
+}
+
+}
+
+SpatialIndex::SpatialIndex()
+    : numItems(0)
+    , finished(false)
+{
+}
+
+void SpatialIndex::clear()
+{
+    numItems = 0;
+    finished = false;
+    std::vector<double>().swap(boxes);
+    std::vector<qint64>().swap(indices);
+    levelBounds.clear();
+}
+
+void SpatialIndex::reserve(qint64 count)
+{
+    boxes.reserve(size_t(count) * 4);
+    indices.reserve(size_t(count));
+}
+
+void SpatialIndex::add(qint64 item, double minX, double minY, double maxX, double maxY)
+{
+    boxes.push_back(minX);
+    boxes.push_back(minY);
+    boxes.push_back(maxX);
+    boxes.push_back(maxY);
+    indices.push_back(item);
+    ++numItems;
+}
+
+void SpatialIndex::finish()
+{
+    levelBounds.clear();
+    finished = true;
+    if (numItems == 0) return;
+
+    size_t count = size_t(numItems);
+
+    // Node count of every level up to the single root
+    size_t levelCount = count;
+    size_t numNodes = count;
+    levelBounds.push_back(numNodes);
+    do {
+        levelCount = (levelCount + kNodeSize - 1) / kNodeSize;
+        numNodes += levelCount;
+        levelBounds.push_back(numNodes);
+    } while (levelCount != 1);
+
+    double minX = std::numeric_limits<double>::max();
+    double minY = std::numeric_limits<double>::max();
+    double maxX = -std::numeric_limits<double>::max();
+    double maxY = -std::numeric_limits<double>::max();
+    for (size_t i = 0; i < count; ++i) {
+        minX = qMin(minX, boxes[i * 4]);
+        minY = qMin(minY, boxes[i * 4 + 1]);
+        maxX = qMax(maxX, boxes[i * 4 + 2]);
+        maxY = qMax(maxY, boxes[i * 4 + 3]);
+    }
+
+    // Sort the leaves along the Hilbert curve so siblings are close together
+    if (count > size_t(kNodeSize)) {
+        double width = maxX - minX;
+        double height = maxY - minY;
+        const double hilbertMax = 65535.0;
+
+        std::vector<quint32> hilbert(count);
+        for (size_t i = 0; i < count; ++i) {
+            double cx = (boxes[i * 4] + boxes[i * 4 + 2]) / 2.0;
+            double cy = (boxes[i * 4 + 1] + boxes[i * 4 + 3]) / 2.0;
+            quint32 hx = width > 0.0 ? quint32(std::floor(hilbertMax * (cx - minX) / width)) : 0;
+            quint32 hy = height > 0.0 ? quint32(std::floor(hilbertMax * (cy - minY) / height)) : 0;
+            hilbert[i] = hilbertValue(hx, hy);
+        }
+
+        std::vector<quint32> order(count);
+        for (size_t i = 0; i < count; ++i) order[i] = quint32(i);
+        std::sort(order.begin(), order.end(), [&hilbert](quint32 a, quint32 b) {
+            return hilbert[a] < hilbert[b];
+        });
+
+        std::vector<double> sortedBoxes(numNodes * 4);
+        std::vector<qint64> sortedIndices(numNodes);
+        for (size_t i = 0; i < count; ++i) {
+            size_t from = order[i];
+            std::copy(boxes.begin() + from * 4, boxes.begin() + from * 4 + 4,
+                      sortedBoxes.begin() + i * 4);
+            sortedIndices[i] = indices[from];
+        }
+        boxes.swap(sortedBoxes);
+        indices.swap(sortedIndices);
+    } else {
+        boxes.resize(numNodes * 4);
+        indices.resize(numNodes);
+    }
+
+    // Pack each level into parent nodes
+    size_t position = 0;
+    size_t writePosition = count;
+    for (size_t level = 0; level + 1 < levelBounds.size(); ++level) {
+        size_t end = levelBounds[level];
+        while (position < end) {
+            size_t firstChild = position;
+            double nodeMinX = std::numeric_limits<double>::max();
+            double nodeMinY = std::numeric_limits<double>::max();
+            double nodeMaxX = -std::numeric_limits<double>::max();
+            double nodeMaxY = -std::numeric_limits<double>::max();
+
+            for (int j = 0; j < kNodeSize && position < end; ++j, ++position) {
+                nodeMinX = qMin(nodeMinX, boxes[position * 4]);
+                nodeMinY = qMin(nodeMinY, boxes[position * 4 + 1]);
+                nodeMaxX = qMax(nodeMaxX, boxes[position * 4 + 2]);
+                nodeMaxY = qMax(nodeMaxY, boxes[position * 4 + 3]);
+            }
+
+            boxes[writePosition * 4] = nodeMinX;
+            boxes[writePosition * 4 + 1] = nodeMinY;
+            boxes[writePosition * 4 + 2] = nodeMaxX;
+            boxes[writePosition * 4 + 3] = nodeMaxY;
+            indices[writePosition] = qint64(firstChild);
+            ++writePosition;
+        }
+    }
+}
+
+void SpatialIndex::search(double minX, double minY, double maxX, double maxY,
+                          QVector<qint64> &results) const
+{
+    if (!finished || numItems == 0) return;
+
+    // Pairs of (first node, level) still to visit
+    std::vector<size_t> stack;
+    size_t nodeIndex = levelBounds.back() - 1;
+    size_t level = levelBounds.size() - 1;
+
+    while (true) {
+        size_t end = qMin(nodeIndex + kNodeSize, levelBounds[level]);
+
+        for (size_t position = nodeIndex; position < end; ++position) {
+            const double *box = &boxes[position * 4];
+            if (maxX < box[0] || maxY < box[1] || minX > box[2] || minY > box[3]) continue;
+
+            if (level == 0) {
+                results.append(indices[position]);
+            } else {
+                stack.push_back(size_t(indices[position]));
+                stack.push_back(level - 1);
+            }
+        }
+
+        if (stack.empty()) break;
+        level = stack.back();
+        stack.pop_back();
+        nodeIndex = stack.back();
+        stack.pop_back();
+    }
+}
+
+QVector<qint64> SpatialIndex::search(double minX, double minY, double maxX, double maxY) const
+{
+    QVector<qint64> results;
+    search(minX, minY, maxX, maxY, results);
+    return results;
+}
+
+size_t SpatialIndex::memoryUsage() const
+{
+    return boxes.capacity() * sizeof(double) +
+            indices.capacity() * sizeof(qint64) +
+            levelBounds.capacity() * sizeof(size_t);
+}
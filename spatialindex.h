@@ -0,0 +1,48 @@
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <QVector>
+#include <vector>
+#include <cstddef>
+
+// Static packed R-tree over item bounding boxes.
+//
+// Items are added once, sorted along a Hilbert curve by finish() and
+// packed bottom-up into nodes of kNodeSize children. The whole tree is
+// two flat arrays (boxes and indices), so it is cheap to build and to
+// throw away when the coordinates change.
+class SpatialIndex
+{
+public:
+    SpatialIndex();
+
+    void clear();
+    void reserve(qint64 count);
+    void add(qint64 item, double minX, double minY, double maxX, double maxY);
+    void finish();
+
+    bool isEmpty() const { return numItems == 0; }
+    qint64 itemCount() const { return numItems; }
+
+    // Items whose box intersects the query box, in index order
+    void search(double minX, double minY, double maxX, double maxY,
+                QVector<qint64> &results) const;
+    QVector<qint64> search(double minX, double minY, double maxX, double maxY) const;
+
+    size_t memoryUsage() const;
+
+private:
+    static const int kNodeSize = 16;
+
+    qint64 numItems;
+    bool finished;
+
+    // Four doubles per node, leaves first, root last
+    std::vector<double> boxes;
+    // Leaves: item id; parents: position of the first child
+    std::vector<qint64> indices;
+    // End position of each tree level
+    std::vector<size_t> levelBounds;
+};
+
+#endif // SPATIALINDEX_H
@@ -0,0 +1,365 @@
+#include "spatialjoin.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentMap>
+#include <cmath>
+#include <vector>
+
+#include "geosutils.h"
+
+namespace {
+const qint64 kMinimumChunkSize = 32;
+const qint64 kMaximumChunkSize = 2048;
+const int kChunksPerThread = 4;
+
+FeatureStore::Extent expanded(const FeatureStore::Extent &extent, double margin)
+{
+    FeatureStore::Extent result = {extent.minX - margin, extent.minY - margin,
+                                   extent.maxX + margin, extent.maxY + margin};
+    return result;
+}
+
+// GEOS geometries of the indexed side, built once per chunk on first use
+class GeometryCache
+{
+public:
+    GeometryCache(GEOSContextHandle_t context, const FeatureStore &store)
+        : context(context), store(store) {}
+
+    ~GeometryCache()
+    {
+        for (GEOSGeometry *geometry : geometries) {
+            if (geometry) GEOSGeom_destroy_r(context, geometry);
+        }
+    }
+
+    const GEOSGeometry *geometry(qint64 feature)
+    {
+        QHash<qint64, GEOSGeometry*>::const_iterator it = geometries.constFind(feature);
+        if (it != geometries.constEnd()) return it.value();
+        GEOSGeometry *created = GeosUtils::fromFeature(context, store, feature);
+        geometries.insert(feature, created);
+        return created;
+    }
+
+private:
+    GEOSContextHandle_t context;
+    const FeatureStore &store;
+    QHash<qint64, GEOSGeometry*> geometries;
+
+    Q_DISABLE_COPY(GeometryCache)
+};
+}
+
+struct SpatialJoin::Match {
+    qint64 first = -1;       // Lowest matching join feature
+    qint64 count = 0;
+    double sum = 0.0;
+    qint64 values = 0;       // Non-null summary values
+    double distance = 0.0;   // Nearest only
+
+    void add(qint64 joinFeature, const FeatureStore &joinLayer, int summaryField)
+    {
+        first = first < 0 ? joinFeature : qMin(first, joinFeature);
+        ++count;
+        if (summaryField >= 0 && !joinLayer.isNull(summaryField, joinFeature)) {
+            sum += joinLayer.realValue(summaryField, joinFeature);
+            ++values;
+        }
+    }
+
+    void merge(const Match &other)
+    {
+        if (other.first >= 0) first = first < 0 ? other.first : qMin(first, other.first);
+        count += other.count;
+        sum += other.sum;
+        values += other.values;
+    }
+};
+
+struct SpatialJoin::Chunk {
+    qint64 begin = 0;
+    qint64 end = 0;
+    qint64 candidates = 0;
+    QHash<qint64, Match> partial;   // Join-driven chunks: per target aggregates
+};
+
+struct SpatialJoin::Context {
+    const FeatureStore *target;
+    const FeatureStore *joinLayer;
+    Options options;
+    Geoprocessing::Feedback *feedback;
+    std::vector<Match> *matches;   // Per target; target chunks write their own range
+    double searchRadius;           // Nearest: first search margin
+    double maxRadius;              // Nearest: margin covering both layers
+};
+
+QString SpatialJoin::predicateName(Predicate predicate)
+{
+    switch (predicate) {
+    case Intersects: return "Intersects";
+    case Within: return "Within";
+    case Contains: return "Contains";
+    case Nearest: return "Nearest";
+    }
+    return QString();
+}
+
+FeatureStorePtr SpatialJoin::join(const FeatureStore &target, const FeatureStore &joinLayer,
+                                  const Options &options, Geoprocessing::Feedback *feedback,
+                                  Geoprocessing::Statistics *statistics, QString *error)
+{
+    if (options.summaryField >= joinLayer.fieldCount() ||
+            (options.summaryField >= 0 &&
+             joinLayer.field(options.summaryField).type == FeatureStore::StringField)) {
+        if (error) *error = "The summary field must be a numeric join field";
+        return FeatureStorePtr();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    std::vector<Match> matches(size_t(target.featureCount()));
+
+    Context context;
+    context.target = &target;
+    context.joinLayer = &joinLayer;
+    context.options = options;
+    context.feedback = feedback;
+    context.matches = &matches;
+
+    // Nearest starts with about one join feature's spacing and doubles
+    const FeatureStore::Extent &joinExtent = joinLayer.extent();
+    const FeatureStore::Extent &targetExtent = target.extent();
+    double joinDiagonal = std::hypot(joinExtent.maxX - joinExtent.minX, joinExtent.maxY - joinExtent.minY);
+    context.searchRadius = joinLayer.featureCount() > 0 && joinDiagonal > 0.0
+            ? joinDiagonal / std::sqrt(double(joinLayer.featureCount())) : 1.0;
+    context.maxRadius = (qMax(joinExtent.maxX, targetExtent.maxX) - qMin(joinExtent.minX, targetExtent.minX)) +
+            (qMax(joinExtent.maxY, targetExtent.maxY) - qMin(joinExtent.minY, targetExtent.minY));
+
+    // Chunks over the larger side, index lookups into the smaller one
+    bool targetDriven = options.predicate == Nearest || joinLayer.featureCount() <= target.featureCount();
+    qint64 count = targetDriven ? target.featureCount() : joinLayer.featureCount();
+
+    int threads = qMax(1, QThread::idealThreadCount());
+    qint64 chunkSize = qBound(kMinimumChunkSize, count / (qint64(threads) * kChunksPerThread),
+                              kMaximumChunkSize);
+    QVector<Chunk> chunks;
+    for (qint64 begin = 0; begin < count; begin += chunkSize) {
+        Chunk chunk;
+        chunk.begin = begin;
+        chunk.end = qMin(count, begin + chunkSize);
+        chunks.append(chunk);
+    }
+
+    if (feedback) feedback->setTotal(count);
+    QtConcurrent::blockingMap(chunks, [&context, targetDriven](Chunk &chunk) {
+        if (targetDriven) {
+            joinTargetChunk(context, chunk);
+        } else {
+            joinSourceChunk(context, chunk);
+        }
+    });
+
+    if (feedback && feedback->isCanceled()) {
+        if (error) *error = "Canceled";
+        return FeatureStorePtr();
+    }
+
+    Geoprocessing::Statistics stats;
+    for (const Chunk &chunk : chunks) {
+        stats.candidates += chunk.candidates;
+        for (QHash<qint64, Match>::const_iterator it = chunk.partial.constBegin();
+             it != chunk.partial.constEnd(); ++it) {
+            matches[size_t(it.key())].merge(it.value());
+        }
+    }
+
+    // Target fields, then the join fields, then the statistics
+    FeatureStorePtr output(new FeatureStore());
+    for (int field = 0; field < target.fieldCount(); ++field) {
+        output->addField(target.field(field).name, target.field(field).type);
+    }
+    int joinFirstField = output->fieldCount();
+    if (options.joinAttributes) {
+        for (int field = 0; field < joinLayer.fieldCount(); ++field) {
+            QString name = joinLayer.field(field).name;
+            while (output->fieldIndex(name) >= 0) name += "_2";
+            output->addField(name, joinLayer.field(field).type);
+        }
+    }
+    int countField = output->addField("JOIN_COUNT", FeatureStore::IntegerField);
+    int sumField = -1;
+    int meanField = -1;
+    if (options.summaryField >= 0) {
+        QString name = joinLayer.field(options.summaryField).name;
+        sumField = output->addField(name + "_SUM", FeatureStore::RealField);
+        meanField = output->addField(name + "_MEAN", FeatureStore::RealField);
+    }
+    int distanceField = options.predicate == Nearest
+            ? output->addField("JOIN_DIST", FeatureStore::RealField) : -1;
+
+    for (qint64 t = 0; t < target.featureCount(); ++t) {
+        const Match &match = matches[size_t(t)];
+        output->beginFeature(target.featureId(t));
+        output->copyGeometry(target, t);
+        Geoprocessing::copyAttributes(target, t, *output, 0);
+        if (options.joinAttributes && match.first >= 0) {
+            Geoprocessing::copyAttributes(joinLayer, match.first, *output, joinFirstField);
+        }
+        output->setInteger(countField, match.count);
+        if (sumField >= 0 && match.values > 0) {
+            output->setReal(sumField, match.sum);
+            output->setReal(meanField, match.sum / match.values);
+        }
+        if (distanceField >= 0 && match.first >= 0) {
+            output->setReal(distanceField, match.distance);
+        }
+        output->endFeature();
+    }
+    output->finish();
+
+    stats.inputFeatures = target.featureCount();
+    stats.outputFeatures = output->featureCount();
+    stats.threads = int(qMin<qint64>(threads, chunks.size()));
+    stats.elapsedMs = timer.elapsed();
+    if (statistics) *statistics = stats;
+    return output;
+}
+
+void SpatialJoin::joinTargetChunk(const Context &context, Chunk &chunk)
+{
+    GeosContext geos;
+    GEOSContextHandle_t handle = geos.handle();
+    const FeatureStore &target = *context.target;
+    const FeatureStore &joinLayer = *context.joinLayer;
+    Predicate predicate = context.options.predicate;
+    GeometryCache joinGeometries(handle, joinLayer);
+
+    qint64 t = chunk.begin;
+    for (; t < chunk.end; ++t) {
+        if (context.feedback && context.feedback->isCanceled()) break;
+        if (target.geometryKind(t) == FeatureStore::NoGeometry) continue;
+
+        Match &match = (*context.matches)[size_t(t)];
+        const FeatureStore::Extent &extent = target.featureExtent(t);
+
+        if (predicate == Nearest) {
+            // Grow the search box until it holds a join feature
+            double radius = context.searchRadius;
+            QVector<qint64> candidates = joinLayer.featuresIn(expanded(extent, radius));
+            while (candidates.isEmpty() && radius < context.maxRadius) {
+                radius *= 2.0;
+                candidates = joinLayer.featuresIn(expanded(extent, radius));
+            }
+            if (candidates.isEmpty()) continue;
+
+            GEOSGeometry *geometry = GeosUtils::fromFeature(handle, target, t);
+            if (!geometry) continue;
+
+            qint64 best = -1;
+            double bestDistance = 0.0;
+            auto visit = [&](const QVector<qint64> &features) {
+                for (qint64 j : features) {
+                    const GEOSGeometry *joinGeometry = joinGeometries.geometry(j);
+                    double distance;
+                    if (!joinGeometry || GEOSDistance_r(handle, geometry, joinGeometry, &distance) != 1) continue;
+                    if (best < 0 || distance < bestDistance || (distance == bestDistance && j < best)) {
+                        best = j;
+                        bestDistance = distance;
+                    }
+                }
+            };
+            visit(candidates);
+            chunk.candidates += candidates.size();
+
+            // A closer feature can lie outside the box but within the best distance
+            if (best >= 0 && bestDistance > radius) {
+                QVector<qint64> wider = joinLayer.featuresIn(expanded(extent, bestDistance));
+                chunk.candidates += wider.size();
+                visit(wider);
+            }
+            GEOSGeom_destroy_r(handle, geometry);
+
+            if (best >= 0) {
+                match.add(best, joinLayer, context.options.summaryField);
+                match.distance = bestDistance;
+            }
+            continue;
+        }
+
+        QVector<qint64> candidates = joinLayer.featuresIn(extent);
+        chunk.candidates += candidates.size();
+        if (candidates.isEmpty()) continue;
+
+        GEOSGeometry *geometry = GeosUtils::fromFeature(handle, target, t);
+        if (!geometry) continue;
+        const GEOSPreparedGeometry *prepared = GEOSPrepare_r(handle, geometry);
+
+        for (qint64 j : candidates) {
+            const GEOSGeometry *joinGeometry = joinGeometries.geometry(j);
+            if (!joinGeometry || !prepared) continue;
+
+            char hit = 0;
+            switch (predicate) {
+            case Intersects: hit = GEOSPreparedIntersects_r(handle, prepared, joinGeometry); break;
+            case Within: hit = GEOSPreparedWithin_r(handle, prepared, joinGeometry); break;
+            case Contains: hit = GEOSPreparedContains_r(handle, prepared, joinGeometry); break;
+            default: break;
+            }
+            if (hit == 1) match.add(j, joinLayer, context.options.summaryField);
+        }
+
+        if (prepared) GEOSPreparedGeom_destroy_r(handle, prepared);
+        GEOSGeom_destroy_r(handle, geometry);
+    }
+
+    if (context.feedback) context.feedback->addProgress(t - chunk.begin);
+}
+
+void SpatialJoin::joinSourceChunk(const Context &context, Chunk &chunk)
+{
+    GeosContext geos;
+    GEOSContextHandle_t handle = geos.handle();
+    const FeatureStore &target = *context.target;
+    const FeatureStore &joinLayer = *context.joinLayer;
+    Predicate predicate = context.options.predicate;
+    GeometryCache targetGeometries(handle, target);
+
+    qint64 j = chunk.begin;
+    for (; j < chunk.end; ++j) {
+        if (context.feedback && context.feedback->isCanceled()) break;
+        if (joinLayer.geometryKind(j) == FeatureStore::NoGeometry) continue;
+
+        QVector<qint64> candidates = target.featuresIn(joinLayer.featureExtent(j));
+        chunk.candidates += candidates.size();
+        if (candidates.isEmpty()) continue;
+
+        GEOSGeometry *geometry = GeosUtils::fromFeature(handle, joinLayer, j);
+        if (!geometry) continue;
+        const GEOSPreparedGeometry *prepared = GEOSPrepare_r(handle, geometry);
+
+        for (qint64 t : candidates) {
+            const GEOSGeometry *targetGeometry = targetGeometries.geometry(t);
+            if (!targetGeometry || !prepared) continue;
+
+            // The join feature is prepared here, so within and contains swap
+            char hit = 0;
+            switch (predicate) {
+            case Intersects: hit = GEOSPreparedIntersects_r(handle, prepared, targetGeometry); break;
+            case Within: hit = GEOSPreparedContains_r(handle, prepared, targetGeometry); break;
+            case Contains: hit = GEOSPreparedWithin_r(handle, prepared, targetGeometry); break;
+            default: break;
+            }
+            if (hit == 1) chunk.partial[t].add(j, joinLayer, context.options.summaryField);
+        }
+
+        if (prepared) GEOSPreparedGeom_destroy_r(handle, prepared);
+        GEOSGeom_destroy_r(handle, geometry);
+    }
+
+    if (context.feedback) context.feedback->addProgress(j - chunk.begin);
+}
@@ -0,0 +1,54 @@
+#ifndef SPATIALJOIN_H
+#define SPATIALJOIN_H
+
+#include <QString>
+
+#include "featurestore.h"
+#include "geoprocessing.h"
+
+// Attaches attributes of a join layer to the features of a target layer.
+//
+// Index nested loop: the larger layer is cut into chunks that run in
+// parallel, and every feature of a chunk looks up its candidates in the
+// packed R-tree of the smaller layer before the predicate is tested on
+// prepared geometry. When the join layer is the larger one, chunks keep
+// partial per-target aggregates that are merged afterwards, so matched
+// pairs are never materialised. Nearest always walks the targets.
+//
+// The output has every target feature (matched or not) with its own
+// attributes, the attributes of the first matching join feature, the
+// match count and, for a numeric summary field, its sum and mean.
+class SpatialJoin
+{
+public:
+    enum Predicate {
+        Intersects,
+        Within,      // Target within the join feature
+        Contains,    // Target contains the join feature
+        Nearest
+    };
+
+    struct Options {
+        Predicate predicate = Intersects;
+        bool joinAttributes = true;   // Copy the first match's attributes
+        int summaryField = -1;        // Numeric join field for sum and mean
+    };
+
+    static FeatureStorePtr join(const FeatureStore &target, const FeatureStore &joinLayer,
+                                const Options &options,
+                                Geoprocessing::Feedback *feedback = nullptr,
+                                Geoprocessing::Statistics *statistics = nullptr,
+                                QString *error = nullptr);
+
+    static QString predicateName(Predicate predicate);
+
+private:
+    struct Match;
+    struct Chunk;
+    struct Context;
+
+    static void joinTargetChunk(const Context &context, Chunk &chunk);
+    static void joinSourceChunk(const Context &context, Chunk &chunk);
+};
+
+#endif // SPATIALJOIN_H
@@ -0,0 +1,844 @@
+#include "vectorlayeritem.h"
+
+#include <QElapsedTimer>
+#include <QPainterPath>
+#include <QWidget>
+#include <QPolygonF>
+#include <QtAlgorithms>
+#include <QtConcurrent/QtConcurrentRun>
+#include <cmath>
+
+#include "renderdiagnostics.h"
+
+namespace {
+const double kPointRadiusPixels = 3.0;
+const QColor kSelectionColor(255, 255, 0);
+const QColor kHoverColor(0, 200, 255);
+// Point layers this large start out clustered
+const qint64 kAutoClusterPoints = 100000;
+// Clusters are merged from cells at least this many pixels wide
+const double kClusterCellPixels = 48.0;
+// The render cache reaches this fraction of the viewport past each side,
+// so short pans are composited without rendering again
+const double kCacheMargin = 0.25;
+// Features drawn between two checks for a canceled render
+const qint64 kCancelCheckInterval = 1024;
+
+// Shared by the renders of all layers
+QAtomicInteger<qint64> rendersStarted(0);
+QAtomicInteger<qint64> rendersCompleted(0);
+QAtomicInteger<qint64> rendersCanceled(0);
+QAtomicInteger<qint64> featuresDrawn(0);
+QAtomicInteger<qint64> featuresSkipped(0);
+QAtomicInteger<qint64> completedMs(0);
+QAtomicInteger<qint64> canceledMs(0);
+
+RenderDiagnostics *diagnostics = nullptr;
+
+// GUI thread only; unique across layers so a revision also tells them apart
+quint64 generationCounter = 0;
+
+quint64 nextGeneration()
+{
+    return ++generationCounter;
+}
+
+// Same scale and rotation; the translation may differ
+bool sameLinearPart(const QTransform &a, const QTransform &b)
+{
+    return qFuzzyCompare(a.m11(), b.m11()) && qFuzzyCompare(a.m22(), b.m22()) &&
+            qFuzzyCompare(1.0 + a.m12(), 1.0 + b.m12()) &&
+            qFuzzyCompare(1.0 + a.m21(), 1.0 + b.m21());
+}
+
+QString clusterCountText(quint32 count)
+{
+    if (count < 1000) return QString::number(count);
+    if (count < 10000) return QString::number(count / 1000.0, 'f', 1) + "k";
+    if (count < 1000000) return QString::number(count / 1000) + "k";
+    return QString::number(count / 1000000.0, 'f', 1) + "M";
+}
+}
+
+VectorLayerItem::VectorLayerItem(const FeatureStorePtr &store, const QColor &color,
+                                 QGraphicsItem *parent)
+    : QGraphicsItem(parent)
+    , store(store)
+    , hovered(-1)
+    , labels(nullptr)
+    , clusterPoints(store && store->dominantKind() == FeatureStore::PointGeometry &&
+                    store->featureCount() >= kAutoClusterPoints)
+    , clustersStale(false)
+    , clusterWatcher(nullptr)
+    , layerColor(color)
+    , renderGeneration(nextGeneration())
+    , lastRenderReported(true)
+{
+    // Needed so paint() gets the exposed rectangle for culling
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
+    updateGeometry();
+}
+
+VectorLayerItem::~VectorLayerItem()
+{
+    // A running render still calls the item's draw functions
+    for (ViewCache *cache : viewCaches) {
+        releaseViewCache(cache);
+    }
+    delete labels;
+    if (clusterWatcher) {
+        clusterWatcher->waitForFinished();
+        delete clusterWatcher;
+    }
+}
+
+QRectF VectorLayerItem::boundingRect() const
+{
+    return bounds;
+}
+
+void VectorLayerItem::setColor(const QColor &color)
+{
+    layerColor = color;
+    invalidateCache();
+}
+
+void VectorLayerItem::setFeatureStore(const FeatureStorePtr &featureStore)
+{
+    if (featureStore == store) return;
+
+    // Running renders, label placements and cluster builds keep the old
+    // store until they finish; the new generation drops their results
+    store = featureStore;
+    if (labels) labels->setStore(store);
+    updateGeometry();
+}
+
+void VectorLayerItem::setRenderer(const FeatureRendererPtr &renderer)
+{
+    featureRenderer = renderer;
+    invalidateCache();
+}
+
+void VectorLayerItem::invalidateCache()
+{
+    // The old images stay on screen until the new ones are ready
+    for (ViewCache *cache : viewCaches) {
+        cache->valid = false;
+    }
+    renderGeneration = nextGeneration();
+    update();
+}
+
+void VectorLayerItem::setSelection(const FeatureSelectionPtr &selection)
+{
+    selectedFeatures = selection;
+    update();
+}
+
+void VectorLayerItem::setHoveredFeature(qint64 feature)
+{
+    if (feature == hovered) return;
+    hovered = feature;
+    update();
+}
+
+LabelSettings VectorLayerItem::labelSettings() const
+{
+    return labels ? labels->settings() : LabelSettings();
+}
+
+void VectorLayerItem::setLabelSettings(const LabelSettings &settings)
+{
+    if (!labels) {
+        labels = new LabelEngine(store);
+        // Repaint once a background placement is ready
+        QObject::connect(labels, &LabelEngine::placementReady, [this]() { invalidateCache(); });
+    }
+    labels->setSettings(settings);
+    invalidateCache();
+}
+
+void VectorLayerItem::setClustering(bool enabled)
+{
+    clusterPoints = enabled;
+    invalidateCache();
+}
+
+void VectorLayerItem::startClusterBuild()
+{
+    if (!clusterWatcher) {
+        clusterWatcher = new QFutureWatcher<PointClusterIndexPtr>();
+        QObject::connect(clusterWatcher, &QFutureWatcher<PointClusterIndexPtr>::finished, [this]() {
+            // The store was replaced while building; start over
+            if (clustersStale) {
+                clustersStale = false;
+                startClusterBuild();
+                return;
+            }
+            clusters = clusterWatcher->result();
+            invalidateCache();
+        });
+    }
+    if (clusterWatcher->isRunning()) {
+        clustersStale = true;
+        return;
+    }
+    clusterWatcher->setFuture(QtConcurrent::run(&PointClusterIndex::build, store));
+}
+
+void VectorLayerItem::updateGeometry()
+{
+    prepareGeometryChange();
+    if (labels) labels->invalidate();
+    clusters.reset();
+    if (clusterWatcher && clusterWatcher->isRunning()) clustersStale = true;
+    for (ViewCache *cache : viewCaches) {
+        cache->valid = false;
+        cache->image = QImage();
+    }
+    renderGeneration = nextGeneration();
+
+    bounds = QRectF();
+    if (!store || !store->isFinished() || store->extent().isNull()) return;
+
+    // Leave room for point symbols and line widths on the layer border
+    bounds = store->extent().toRectF();
+    double padding = qMax(bounds.width(), bounds.height()) * 0.01;
+    if (padding <= 0.0) padding = 1.0;
+    bounds.adjust(-padding, -padding, padding, padding);
+}
+
+VectorLayerItem::RenderCounters VectorLayerItem::renderCounters()
+{
+    RenderCounters counters;
+    counters.started = rendersStarted.loadAcquire();
+    counters.completed = rendersCompleted.loadAcquire();
+    counters.canceled = rendersCanceled.loadAcquire();
+    counters.featuresDrawn = featuresDrawn.loadAcquire();
+    counters.featuresSkipped = featuresSkipped.loadAcquire();
+    counters.completedMs = completedMs.loadAcquire();
+    counters.canceledMs = canceledMs.loadAcquire();
+    return counters;
+}
+
+void VectorLayerItem::resetRenderCounters()
+{
+    rendersStarted.fetchAndStoreOrdered(0);
+    rendersCompleted.fetchAndStoreOrdered(0);
+    rendersCanceled.fetchAndStoreOrdered(0);
+    featuresDrawn.fetchAndStoreOrdered(0);
+    featuresSkipped.fetchAndStoreOrdered(0);
+    completedMs.fetchAndStoreOrdered(0);
+    canceledMs.fetchAndStoreOrdered(0);
+}
+
+void VectorLayerItem::setDiagnostics(RenderDiagnostics *renderDiagnostics)
+{
+    diagnostics = renderDiagnostics;
+}
+
+double VectorLayerItem::mapUnitsPerPixel(const QPainter *painter)
+{
+    const QTransform &transform = painter->worldTransform();
+    double scale = std::sqrt(std::fabs(transform.determinant()));
+    return scale > 0.0 ? 1.0 / scale : 1.0;
+}
+
+void VectorLayerItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
+                            QWidget *widget)
+{
+    if (!store || !store->isFinished()) return;
+
+    bool sampled = diagnostics && diagnostics->isEnabled() && diagnostics->inFrame();
+    QElapsedTimer timer;
+    if (sampled) timer.start();
+
+    double pixelSize = mapUnitsPerPixel(painter);
+
+    // Only features touching the exposed area are drawn
+    QRectF exposed = option->exposedRect;
+    double margin = kPointRadiusPixels * pixelSize;
+    exposed.adjust(-margin, -margin, margin, margin);
+    FeatureStore::Extent visible = FeatureStore::Extent::fromRectF(exposed);
+
+    // Views composite the cached image; exports and prints (no widget)
+    // render straight into their device at its own resolution
+    bool clustered;
+    bool cacheHit = false;
+    RenderResult direct;
+    if (widget) {
+        cacheHit = drawCached(painter, widget, pixelSize);
+        clustered = viewCache(widget)->clustered;
+    } else {
+        RenderJob job = renderJob(painter->worldTransform(), pixelSize, true);
+        job.hints = painter->renderHints();
+        drawLayer(painter, job, visible, direct);
+        clustered = direct.clustered;
+    }
+
+    qint64 count = store->featureCount();
+    if (!clustered && selectedFeatures && !selectedFeatures->isEmpty()) {
+        if (widget) {
+            drawCachedSelection(painter, widget, pixelSize);
+        } else {
+            drawSelection(painter, visible, pixelSize);
+        }
+    }
+
+    if (!clustered && hovered >= 0 && hovered < count && store->featureExtent(hovered).intersects(visible)) {
+        QPen hoverPen(kHoverColor, 3);
+        hoverPen.setCosmetic(true);
+        QColor hoverFill = kHoverColor;
+        hoverFill.setAlpha(80);
+
+        painter->setPen(hoverPen);
+        if (store->geometryKind(hovered) == FeatureStore::LineGeometry) {
+            painter->setBrush(Qt::NoBrush);
+        } else {
+            painter->setBrush(QBrush(hoverFill));
+        }
+        drawFeature(painter, *store, hovered, pixelSize);
+    }
+
+    if (sampled) {
+        RenderDiagnostics::LayerSample sample;
+        sample.layer = name;
+        sample.paintMs = timer.nsecsElapsed() / 1.0e6;
+        sample.cacheHit = cacheHit;
+        sample.drawn = direct.drawn;
+        sample.culled = direct.culled;
+        // A background render that finished since the last frame
+        if (!lastRenderReported) {
+            sample.renderMs = lastRender.elapsedMs;
+            sample.drawn += lastRender.drawn;
+            sample.culled += lastRender.culled;
+            lastRenderReported = true;
+        }
+        diagnostics->addLayerSample(sample);
+    }
+}
+
+VectorLayerItem::RenderJob VectorLayerItem::exportJob()
+{
+    if (!store || !store->isFinished()) return RenderJob();
+    return renderJob(QTransform(), 1.0, true);
+}
+
+VectorLayerItem::RenderJob VectorLayerItem::exportJobAt(const RenderJob &base,
+                                                        const QTransform &mapToDevice)
+{
+    RenderJob job = base;
+    if (!job.store) return job;
+
+    double scale = std::sqrt(std::fabs(mapToDevice.determinant()));
+    job.mapToDevice = mapToDevice;
+    job.pixelSize = scale > 0.0 ? 1.0 / scale : 1.0;
+    if (job.clusters) {
+        job.clusterLevel = job.clusters->levelFor(kClusterCellPixels * job.pixelSize);
+        if (job.clusterLevel < 0) job.clusters.clear();
+    }
+    // Clustered points are drawn without labels, as in the views
+    if (job.clusters) job.labelRequest = LabelEngine::Request();
+    return job;
+}
+
+void VectorLayerItem::drawExport(QPainter *painter, const RenderJob &job, const QRectF &area) const
+{
+    if (!job.store) return;
+    QRectF visible = area;
+    double margin = kPointRadiusPixels * job.pixelSize;
+    visible.adjust(-margin, -margin, margin, margin);
+    RenderResult result;
+    drawLayer(painter, job, FeatureStore::Extent::fromRectF(visible), result);
+}
+
+VectorLayerItem::RenderJob VectorLayerItem::renderJob(const QTransform &mapToDevice, double pixelSize,
+                                                      bool exporting)
+{
+    RenderJob job;
+    job.store = store;
+    job.mapToDevice = mapToDevice;
+    job.pixelSize = pixelSize;
+    job.color = layerColor;
+    job.renderer = featureRenderer;
+    if (featureRenderer) {
+        const QVector<FeatureRenderer::Category> &categories = featureRenderer->categories();
+        job.symbolColors.reserve(categories.size());
+        for (const FeatureRenderer::Category &category : categories) {
+            job.symbolColors.append(category.color);
+        }
+    }
+    job.generation = renderGeneration;
+
+    // Cluster levels and view label placements are built by GUI-thread
+    // watchers; the job only takes what is ready now. Exports take a label
+    // request instead of whatever the views placed last, and leave the
+    // cluster level and the labels to exportJobAt() for their output scale.
+    if (clusterPoints && store->dominantKind() == FeatureStore::PointGeometry) {
+        if (!clusters) {
+            if (!clusterWatcher || !clusterWatcher->isRunning()) startClusterBuild();
+        } else if (exporting) {
+            job.clusters = clusters;
+        } else {
+            job.clusterLevel = clusters->levelFor(kClusterCellPixels * pixelSize);
+            if (job.clusterLevel >= 0) job.clusters = clusters;
+        }
+    }
+    if ((exporting || !job.clusters) && labels && labels->settings().enabled) {
+        if (exporting) job.labelRequest = labels->request();
+        else job.labels = labels->placement(job.mapToDevice);
+        job.labelSettings = labels->settings();
+    }
+    return job;
+}
+
+bool VectorLayerItem::drawCached(QPainter *painter, QWidget *widget, double pixelSize)
+{
+    ViewCache *cache = viewCache(widget);
+    QTransform mapToDevice = painter->worldTransform();
+    QRect layerRect = mapToDevice.mapRect(bounds).toAlignedRect();
+    QRect viewport = widget->rect();
+    QRect needed = layerRect & viewport;
+    if (needed.isEmpty()) return true;
+
+    // Panning only moves the image; any other change renders it again
+    QPointF offset(mapToDevice.dx() - cache->transform.dx(), mapToDevice.dy() - cache->transform.dy());
+    bool sameScale = cache->valid && sameLinearPart(mapToDevice, cache->transform);
+    bool hit = sameScale && QRectF(cache->rect).translated(offset).contains(QRectF(needed));
+    if (!hit) {
+        int marginX = int(viewport.width() * kCacheMargin);
+        int marginY = int(viewport.height() * kCacheMargin);
+        RenderJob job = renderJob(mapToDevice, pixelSize, false);
+        job.hints = painter->renderHints();
+        job.target = viewport.adjusted(-marginX, -marginY, marginX, marginY) & layerRect;
+        job.ratio = widget->devicePixelRatioF();
+        startRender(cache, job);
+    }
+    if (cache->image.isNull()) return hit;
+
+    // The last image, moved (and while zooming, scaled) to the current view
+    painter->save();
+    painter->setWorldTransform(cache->transform.inverted() * mapToDevice);
+    if (!sameScale) painter->setRenderHint(QPainter::SmoothPixmapTransform, true);
+    painter->drawImage(QPointF(cache->rect.topLeft()), cache->image);
+    painter->restore();
+    return hit;
+}
+
+void VectorLayerItem::drawCachedSelection(QPainter *painter, QWidget *widget, double pixelSize)
+{
+    ViewCache *cache = viewCache(widget);
+    QTransform mapToDevice = painter->worldTransform();
+    QRect layerRect = mapToDevice.mapRect(bounds).toAlignedRect();
+    QRect viewport = widget->rect();
+    QRect needed = layerRect & viewport;
+    if (needed.isEmpty()) return;
+
+    // Redrawn only for a changed selection, store or scale, or a pan past
+    // its margin; hover and other repaints just composite it
+    QPointF offset(mapToDevice.dx() - cache->selectionTransform.dx(),
+                   mapToDevice.dy() - cache->selectionTransform.dy());
+    bool current = !cache->selectionImage.isNull() &&
+            cache->selection == selectedFeatures.data() &&
+            cache->selectionRevision == selectedFeatures->revision() &&
+            cache->selectionGeneration == renderGeneration &&
+            sameLinearPart(mapToDevice, cache->selectionTransform) &&
+            QRectF(cache->selectionRect).translated(offset).contains(QRectF(needed));
+    if (!current) {
+        int marginX = int(viewport.width() * kCacheMargin);
+        int marginY = int(viewport.height() * kCacheMargin);
+        QRect target = viewport.adjusted(-marginX, -marginY, marginX, marginY) & layerRect;
+        qreal ratio = widget->devicePixelRatioF();
+
+        QImage image(target.size() * ratio, QImage::Format_ARGB32_Premultiplied);
+        image.setDevicePixelRatio(ratio);
+        image.fill(Qt::transparent);
+        QPainter imagePainter(&image);
+        imagePainter.setRenderHints(painter->renderHints());
+        imagePainter.setWorldTransform(mapToDevice * QTransform::fromTranslate(-target.left(), -target.top()));
+        QRectF area = mapToDevice.inverted().mapRect(QRectF(target));
+        double margin = kPointRadiusPixels * pixelSize;
+        area.adjust(-margin, -margin, margin, margin);
+        drawSelection(&imagePainter, FeatureStore::Extent::fromRectF(area), pixelSize);
+        imagePainter.end();
+
+        cache->selectionImage = image;
+        cache->selectionTransform = mapToDevice;
+        cache->selectionRect = target;
+        cache->selection = selectedFeatures.data();
+        cache->selectionRevision = selectedFeatures->revision();
+        cache->selectionGeneration = renderGeneration;
+    }
+
+    painter->save();
+    painter->setWorldTransform(cache->selectionTransform.inverted() * mapToDevice);
+    painter->drawImage(QPointF(cache->selectionRect.topLeft()), cache->selectionImage);
+    painter->restore();
+}
+
+VectorLayerItem::ViewCache *VectorLayerItem::viewCache(QWidget *widget)
+{
+    ViewCache *cache = viewCaches.value(widget);
+    if (cache) return cache;
+
+    cache = new ViewCache;
+    cache->watcher = new QFutureWatcher<RenderResult>();
+    QObject::connect(cache->watcher, &QFutureWatcher<RenderResult>::finished, [this, cache]() {
+        RenderResult result = cache->watcher->result();
+        lastRender = result;
+        lastRender.image = QImage();
+        lastRenderReported = false;
+        // Results from before an invalidation or cut short are dropped
+        if (!result.canceled && result.generation == renderGeneration) {
+            cache->image = result.image;
+            cache->transform = result.mapToDevice;
+            cache->rect = result.rect;
+            cache->clustered = result.clustered;
+            cache->valid = true;
+        }
+        // The next paint starts a new render if the view moved on
+        update();
+    });
+    // A closed view takes its image along
+    cache->viewDestroyed = QObject::connect(widget, &QObject::destroyed, [this, widget]() {
+        ViewCache *closed = viewCaches.take(widget);
+        if (closed) releaseViewCache(closed);
+    });
+    viewCaches.insert(widget, cache);
+    return cache;
+}
+
+void VectorLayerItem::releaseViewCache(ViewCache *cache)
+{
+    QObject::disconnect(cache->viewDestroyed);
+    // A running render still calls the item's draw functions
+    if (cache->watcher->isRunning()) cache->runningJob.feedback->cancel();
+    cache->watcher->waitForFinished();
+    delete cache->watcher;
+    delete cache;
+}
+
+void VectorLayerItem::startRender(ViewCache *cache, const RenderJob &job)
+{
+    // One render at a time per layer and view. When the view moved on, the
+    // running one is stopped and the repaint after it starts the latest view.
+    if (cache->watcher->isRunning()) {
+        if (cache->runningJob.generation != job.generation || cache->runningJob.target != job.target ||
+                cache->runningJob.mapToDevice != job.mapToDevice) {
+            cache->runningJob.feedback->cancel();
+        }
+        return;
+    }
+    cache->runningJob = job;
+    cache->runningJob.feedback.reset(new Geoprocessing::Feedback());
+    rendersStarted.fetchAndAddRelaxed(1);
+    cache->watcher->setFuture(QtConcurrent::run(this, &VectorLayerItem::renderImage, cache->runningJob));
+}
+
+VectorLayerItem::RenderResult VectorLayerItem::renderImage(const RenderJob &job) const
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    RenderResult result;
+    result.mapToDevice = job.mapToDevice;
+    result.rect = job.target;
+    result.generation = job.generation;
+    if (job.target.isEmpty()) return result;
+
+    result.image = QImage(job.target.size() * job.ratio, QImage::Format_ARGB32_Premultiplied);
+    result.image.setDevicePixelRatio(job.ratio);
+    result.image.fill(Qt::transparent);
+
+    // Features are drawn into the image exactly as they would be into the view
+    QPainter painter(&result.image);
+    painter.setRenderHints(job.hints);
+    painter.setWorldTransform(job.mapToDevice * QTransform::fromTranslate(-job.target.left(), -job.target.top()));
+    QRectF area = job.mapToDevice.inverted().mapRect(QRectF(job.target));
+    double margin = kPointRadiusPixels * job.pixelSize;
+    area.adjust(-margin, -margin, margin, margin);
+    drawLayer(&painter, job, FeatureStore::Extent::fromRectF(area), result);
+
+    featuresDrawn.fetchAndAddRelaxed(result.drawn);
+    if (result.canceled) {
+        rendersCanceled.fetchAndAddRelaxed(1);
+        featuresSkipped.fetchAndAddRelaxed(result.skipped);
+        canceledMs.fetchAndAddRelaxed(timer.elapsed());
+    } else {
+        rendersCompleted.fetchAndAddRelaxed(1);
+        completedMs.fetchAndAddRelaxed(timer.elapsed());
+    }
+    result.elapsedMs = timer.nsecsElapsed() / 1.0e6;
+    return result;
+}
+
+void VectorLayerItem::drawLayer(QPainter *painter, const RenderJob &job,
+                                const FeatureStore::Extent &visible, RenderResult &result) const
+{
+    // Zoomed out, a clustered point layer draws its clusters instead
+    if (job.clusters) {
+        drawClusters(painter, job, visible);
+        result.clustered = true;
+        return;
+    }
+
+    const FeatureStore &store = *job.store;
+    FeatureStore::GeometryKind lastKind = FeatureStore::NoGeometry;
+    quint16 lastSymbol = FeatureRenderer::NoSymbol;
+    bool symbolSet = false;
+    qint64 count = store.featureCount();
+    bool classified = job.renderer && job.renderer->type() != FeatureRenderer::SingleSymbol;
+
+    // Zoomed in, the R-tree hands over just the visible features (in
+    // feature order, so the drawing order stays the same); a view over the
+    // whole layer walks all of them without a query
+    const FeatureStore::Extent &layerExtent = store.extent();
+    bool allVisible = visible.minX <= layerExtent.minX && visible.maxX >= layerExtent.maxX &&
+            visible.minY <= layerExtent.minY && visible.maxY >= layerExtent.maxY;
+    QVector<qint64> hits;
+    if (!allVisible) hits = store.featuresIn(visible);
+    qint64 candidates = allVisible ? count : hits.size();
+    result.culled = count - candidates;
+
+    for (qint64 i = 0; i < candidates; ++i) {
+        if (job.feedback && i % kCancelCheckInterval == 0 && job.feedback->isCanceled()) {
+            result.canceled = true;
+            result.skipped = candidates - i;
+            return;
+        }
+        qint64 f = allVisible ? i : hits[int(i)];
+        // Features whose vertices all failed to reproject have no extent
+        if (allVisible && store.featureExtent(f).isNull()) {
+            ++result.culled;
+            continue;
+        }
+
+        // Switch pen and brush only when the geometry kind or symbol changes
+        FeatureStore::GeometryKind kind = store.geometryKind(f);
+        quint16 symbol = classified ? job.renderer->symbolIndex(f) : FeatureRenderer::NoSymbol;
+        if (!symbolSet || kind != lastKind || symbol != lastSymbol) {
+            QColor color = classified && symbol < job.symbolColors.size() ? job.symbolColors[symbol] : job.color;
+            applySymbol(painter, kind, color, classified ? 200 : 100);
+            lastKind = kind;
+            lastSymbol = symbol;
+            symbolSet = true;
+        }
+
+        drawFeature(painter, store, f, job.pixelSize);
+        ++result.drawn;
+    }
+
+    if (job.labels) {
+        drawLabels(painter, job, visible);
+    }
+}
+
+void VectorLayerItem::drawClusters(QPainter *painter, const RenderJob &job,
+                                   const FeatureStore::Extent &visible) const
+{
+    // Cluster symbols reach past their centre by up to a cell
+    double margin = kClusterCellPixels * job.pixelSize;
+    FeatureStore::Extent area = { visible.minX - margin, visible.minY - margin,
+                                  visible.maxX + margin, visible.maxY + margin };
+    QVector<const PointClusterIndex::Cluster*> visibleClusters;
+    job.clusters->clustersIn(job.clusterLevel, area, visibleClusters);
+
+    // Symbols and counts are sized in pixels, so draw in device space
+    QTransform mapToDevice = painter->worldTransform();
+    painter->save();
+    painter->resetTransform();
+    painter->setRenderHint(QPainter::Antialiasing, true);
+    QFont font = painter->font();
+    font.setBold(true);
+    font.setPointSize(8);
+    painter->setFont(font);
+
+    QColor fillColor = job.color;
+    fillColor.setAlpha(200);
+    QPen outlinePen(Qt::white, 1.5);
+
+    for (const PointClusterIndex::Cluster *cluster : visibleClusters) {
+        QPointF center = mapToDevice.map(QPointF(cluster->x, cluster->y));
+        if (cluster->count == 1) {
+            painter->setPen(QPen(job.color, 1));
+            painter->setBrush(QBrush(job.color));
+            painter->drawEllipse(center, kPointRadiusPixels, kPointRadiusPixels);
+            continue;
+        }
+
+        // Grows with the order of magnitude of the count
+        double radius = 2.0 * kPointRadiusPixels + 3.0 * std::log10(double(cluster->count));
+        painter->setPen(outlinePen);
+        painter->setBrush(QBrush(fillColor));
+        painter->drawEllipse(center, radius, radius);
+        painter->drawText(QRectF(center.x() - 2.0 * radius, center.y() - radius, 4.0 * radius, 2.0 * radius),
+                          Qt::AlignCenter, clusterCountText(cluster->count));
+    }
+
+    painter->restore();
+}
+
+void VectorLayerItem::drawLabels(QPainter *painter, const RenderJob &job,
+                                 const FeatureStore::Extent &visible) const
+{
+    const LabelPlacementPtr &placement = job.labels;
+    if (placement->labels.isEmpty()) return;
+
+    QTransform mapToDevice = painter->worldTransform();
+    const LabelSettings &settings = job.labelSettings;
+
+    // Labels hanging over the edge of the exposed area still get drawn
+    const double labelMargin = 300.0 * job.pixelSize;
+    FeatureStore::Extent area = visible;
+    area.minX -= labelMargin;
+    area.minY -= labelMargin;
+    area.maxX += labelMargin;
+    area.maxY += labelMargin;
+
+    painter->save();
+    painter->resetTransform();
+    painter->setFont(settings.font);
+    painter->setRenderHint(QPainter::Antialiasing, true);
+
+    QPen bufferPen(settings.bufferColor, 3);
+    bufferPen.setJoinStyle(Qt::RoundJoin);
+
+    for (const PlacedLabel &label : placement->labels) {
+        if (!area.contains(label.anchor.x(), label.anchor.y())) continue;
+
+        QPointF device = mapToDevice.map(label.anchor);
+        QPointF baseline(device.x() + label.rect.left(),
+                         device.y() + label.rect.top() + placement->ascent);
+
+        if (settings.buffer) {
+            QPainterPath path;
+            path.addText(baseline, settings.font, label.text);
+            painter->strokePath(path, bufferPen);
+            painter->fillPath(path, settings.color);
+        } else {
+            painter->setPen(settings.color);
+            painter->drawText(baseline, label.text);
+        }
+    }
+
+    painter->restore();
+}
+
+void VectorLayerItem::drawSelection(QPainter *painter, const FeatureStore::Extent &visible,
+                                    double pixelSize) const
+{
+    QColor fillColor = kSelectionColor;
+    fillColor.setAlpha(120);
+
+    QPen selectionPen(kSelectionColor, 2);
+    selectionPen.setCosmetic(true);
+    painter->setPen(selectionPen);
+
+    qint64 count = store->featureCount();
+    int words = selectedFeatures->wordCount();
+
+    // Walk the bitset a word at a time; empty words cost one comparison
+    for (int w = 0; w < words; ++w) {
+        quint64 bits = selectedFeatures->word(w);
+        while (bits) {
+            qint64 f = qint64(w) * 64 + qCountTrailingZeroBits(bits);
+            bits &= bits - 1;
+            if (f >= count || !store->featureExtent(f).intersects(visible)) continue;
+
+            FeatureStore::GeometryKind kind = store->geometryKind(f);
+            if (kind == FeatureStore::LineGeometry) {
+                painter->setBrush(Qt::NoBrush);
+            } else {
+                painter->setBrush(QBrush(fillColor));
+            }
+            drawFeature(painter, *store, f, pixelSize);
+        }
+    }
+}
+
+void VectorLayerItem::applySymbol(QPainter *painter, FeatureStore::GeometryKind kind,
+                                  const QColor &color, int fillAlpha) const
+{
+    QPen pen(color, kind == FeatureStore::LineGeometry ? 2 : 1);
+    pen.setCosmetic(true);
+    painter->setPen(pen);
+
+    switch (kind) {
+    case FeatureStore::PointGeometry:
+        painter->setBrush(QBrush(color));
+        break;
+    case FeatureStore::PolygonGeometry: {
+        QColor fillColor = color;
+        fillColor.setAlpha(fillAlpha);
+        painter->setBrush(QBrush(fillColor));
+        break;
+    }
+    default:
+        painter->setBrush(Qt::NoBrush);
+        break;
+    }
+}
+
+void VectorLayerItem::drawFeature(QPainter *painter, const FeatureStore &store, qint64 feature,
+                                  double pixelSize) const
+{
+    const double *xs = store.xData();
+    const double *ys = store.yData();
+    FeatureStore::GeometryKind kind = store.geometryKind(feature);
+
+    // Lines and polygons smaller than a pixel collapse to a single dot
+    const FeatureStore::Extent &extent = store.featureExtent(feature);
+    if (kind != FeatureStore::PointGeometry &&
+            extent.maxX - extent.minX < pixelSize &&
+            extent.maxY - extent.minY < pixelSize) {
+        painter->drawPoint(QPointF(extent.minX, extent.minY));
+        return;
+    }
+
+    double radius = kPointRadiusPixels * pixelSize;
+
+    switch (kind) {
+    case FeatureStore::PointGeometry:
+        for (quint32 part = store.partBegin(feature); part < store.partEnd(feature); ++part) {
+            quint32 v = store.vertexBegin(store.ringBegin(part));
+            painter->drawEllipse(QPointF(xs[v], ys[v]), radius, radius);
+        }
+        break;
+    case FeatureStore::LineGeometry:
+        for (quint32 part = store.partBegin(feature); part < store.partEnd(feature); ++part) {
+            quint32 ring = store.ringBegin(part);
+            quint32 first = store.vertexBegin(ring);
+            int pointCount = int(store.vertexEnd(ring) - first);
+            if (pointCount < 2) continue;
+
+            QPolygonF polyline(pointCount);
+            for (int i = 0; i < pointCount; ++i) {
+                polyline[i] = QPointF(xs[first + i], ys[first + i]);
+            }
+            painter->drawPolyline(polyline);
+        }
+        break;
+    case FeatureStore::PolygonGeometry: {
+        // All parts and holes go into one odd-even filled path
+        QPainterPath path;
+        for (quint32 part = store.partBegin(feature); part < store.partEnd(feature); ++part) {
+            for (quint32 ring = store.ringBegin(part); ring < store.ringEnd(part); ++ring) {
+                quint32 first = store.vertexBegin(ring);
+                quint32 last = store.vertexEnd(ring);
+                if (last - first < 3) continue;
+
+                path.moveTo(xs[first], ys[first]);
+                for (quint32 v = first + 1; v < last; ++v) {
+                    path.lineTo(xs[v], ys[v]);
+                }
+                path.closeSubpath();
+            }
+        }
+        painter->drawPath(path);
+        break;
+    }
+    default:
+        break;
+    }
+}
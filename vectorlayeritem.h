@@ -0,0 +1,222 @@
+#ifndef VECTORLAYERITEM_H
+#define VECTORLAYERITEM_H
+
+#include <QGraphicsItem>
+#include <QColor>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QImage>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+
+#include "featurerenderer.h"
+#include "featureselection.h"
+#include "featurestore.h"
+#include "geoprocessing.h"
+#include "labelengine.h"
+#include "pointclusterindex.h"
+
+class RenderDiagnostics;
+
+// Scene item drawing a whole vector layer straight from its FeatureStore.
+// The item works in layer (map) coordinates; its transform maps them into
+// the scene. Pens and point symbols are sized in screen pixels.
+//
+// On screen the layer is rendered once into an off-screen image covering
+// the viewport plus a margin, and later paints only composite that image
+// as long as the scale is unchanged and the panned view stays inside it.
+// Data and style changes invalidate the image. The selection goes into a
+// second image per view, drawn again only when the selection, the data
+// or the scale changes or a pan leaves it, and the hover highlight is
+// drawn live on top; neither invalidates the layer image.
+//
+// The image is rendered on the thread pool from a job prepared on the GUI
+// thread: a copy of the colours and symbol table, the cluster level and
+// label placement ready at that time, and references to the store and
+// the per-feature symbol indices, neither of which changes once shared (a
+// reprojection swaps in a new store). So every visible
+// layer renders on its own core. Until the new image is ready the
+// previous one is drawn scaled and moved to the current view. A render
+// whose view has changed again is canceled between features, so rapid
+// zooming only renders the scale the user stops at.
+//
+// Several views can show the same scene; each keeps its own image and
+// render, while the store, indexes and style are shared.
+class VectorLayerItem : public QGraphicsItem
+{
+public:
+    enum { Type = UserType + 1 };
+
+    VectorLayerItem(const FeatureStorePtr &store, const QColor &color,
+                    QGraphicsItem *parent = nullptr);
+    ~VectorLayerItem();
+
+    int type() const override { return Type; }
+    QRectF boundingRect() const override;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
+               QWidget *widget = nullptr) override;
+
+    FeatureStorePtr featureStore() const { return store; }
+    // Draws another store with the same features, e.g. a reprojected copy
+    void setFeatureStore(const FeatureStorePtr &featureStore);
+
+    // Name reported in the render diagnostics
+    QString layerName() const { return name; }
+    void setLayerName(const QString &layerName) { name = layerName; }
+
+    QColor color() const { return layerColor; }
+    void setColor(const QColor &color);
+
+    // Classified colours; without a renderer every feature uses color().
+    // Renders copy the symbol colours, so after recolouring a renderer on
+    // the GUI thread set it again to render with the new ones.
+    FeatureRendererPtr renderer() const { return featureRenderer; }
+    void setRenderer(const FeatureRendererPtr &renderer);
+
+    // Selected features are drawn again on top in the highlight colour
+    FeatureSelectionPtr selection() const { return selectedFeatures; }
+    void setSelection(const FeatureSelectionPtr &selection);
+
+    // Feature under the mouse, or -1
+    qint64 hoveredFeature() const { return hovered; }
+    void setHoveredFeature(qint64 feature);
+
+    // Labels are placed in the background and drawn in screen space
+    LabelSettings labelSettings() const;
+    void setLabelSettings(const LabelSettings &settings);
+
+    // Point layers drawn as clusters with counts while zoomed out. The
+    // cluster levels are built once in the background on first paint;
+    // zooming only switches between them.
+    bool clustering() const { return clusterPoints; }
+    void setClustering(bool enabled);
+    PointClusterIndexPtr clusterIndex() const { return clusters; }
+
+    // Changes with every data or style change, unique across all layers
+    quint64 contentRevision() const { return renderGeneration; }
+
+    // Map-unit size of one screen pixel for the given painter
+    static double mapUnitsPerPixel(const QPainter *painter);
+
+    // Background renders of all layers since start or the last reset
+    struct RenderCounters {
+        qint64 started = 0;
+        qint64 completed = 0;
+        qint64 canceled = 0;
+        qint64 featuresDrawn = 0;
+        qint64 featuresSkipped = 0;   // Left unvisited by canceled renders
+        qint64 completedMs = 0;
+        qint64 canceledMs = 0;        // Time spent before the cancel
+    };
+    static RenderCounters renderCounters();
+    static void resetRenderCounters();
+
+    // Receives one sample per paint of every layer while it is enabled
+    static void setDiagnostics(RenderDiagnostics *diagnostics);
+
+    // Everything a render reads, copied on the GUI thread
+    struct RenderJob {
+        FeatureStorePtr store;
+        QTransform mapToDevice;
+        QRect target;                      // Device pixels to render
+        qreal ratio = 1.0;                 // Device pixel ratio of the view
+        QPainter::RenderHints hints;
+        double pixelSize = 1.0;
+        QColor color;
+        FeatureRendererPtr renderer;       // Symbol indices only
+        QVector<QColor> symbolColors;
+        PointClusterIndexPtr clusters;     // Set when drawing clusters
+        int clusterLevel = -1;
+        LabelPlacementPtr labels;
+        LabelSettings labelSettings;
+        LabelEngine::Request labelRequest; // Exports: placed by the exporter into labels
+        quint64 generation = 0;
+        QSharedPointer<Geoprocessing::Feedback> feedback;   // Background renders only
+    };
+
+    // Exports draw from worker threads: exportJob() takes the style,
+    // clusters and label request on the GUI thread, so the same job always
+    // gives the same output. exportJobAt() fits a copy to one output scale
+    // on any thread, the exporter places the labels on its worker, and
+    // drawExport() then draws the features in area (layer coordinates)
+    // with the painter's current transform
+    RenderJob exportJob();
+    static RenderJob exportJobAt(const RenderJob &base, const QTransform &mapToDevice);
+    void drawExport(QPainter *painter, const RenderJob &job, const QRectF &area) const;
+
+private:
+    struct RenderResult {
+        QImage image;
+        QTransform mapToDevice;
+        QRect rect;
+        bool clustered = false;
+        bool canceled = false;
+        qint64 drawn = 0;
+        qint64 culled = 0;
+        qint64 skipped = 0;
+        double elapsedMs = 0.0;
+        quint64 generation = 0;
+    };
+
+    // Off-screen render of the layer for one view transform
+    struct ViewCache {
+        QImage image;
+        QTransform transform;            // Map to device when it was rendered
+        QRect rect;                      // Device pixels the image covers
+        bool valid = false;
+        bool clustered = false;          // The image holds clusters, not features
+        RenderJob runningJob;
+        QFutureWatcher<RenderResult> *watcher = nullptr;
+        QMetaObject::Connection viewDestroyed;
+
+        // Selection overlay and what it was drawn from
+        QImage selectionImage;
+        QTransform selectionTransform;
+        QRect selectionRect;
+        const FeatureSelection *selection = nullptr;
+        quint64 selectionRevision = 0;
+        quint64 selectionGeneration = 0;
+    };
+
+    void updateGeometry();
+    void invalidateCache();
+    RenderJob renderJob(const QTransform &mapToDevice, double pixelSize, bool exporting);
+    RenderResult renderImage(const RenderJob &job) const;
+    ViewCache *viewCache(QWidget *widget);
+    void releaseViewCache(ViewCache *cache);
+    void startRender(ViewCache *cache, const RenderJob &job);
+    void drawLayer(QPainter *painter, const RenderJob &job, const FeatureStore::Extent &visible,
+                   RenderResult &result) const;
+    bool drawCached(QPainter *painter, QWidget *widget, double pixelSize);
+    void drawCachedSelection(QPainter *painter, QWidget *widget, double pixelSize);
+    void applySymbol(QPainter *painter, FeatureStore::GeometryKind kind,
+                     const QColor &color, int fillAlpha) const;
+    void drawFeature(QPainter *painter, const FeatureStore &store, qint64 feature,
+                     double pixelSize) const;
+    void drawSelection(QPainter *painter, const FeatureStore::Extent &visible,
+                       double pixelSize) const;
+    void drawLabels(QPainter *painter, const RenderJob &job, const FeatureStore::Extent &visible) const;
+    void drawClusters(QPainter *painter, const RenderJob &job, const FeatureStore::Extent &visible) const;
+    void startClusterBuild();
+
+    FeatureStorePtr store;
+    QString name;
+    FeatureRendererPtr featureRenderer;
+    FeatureSelectionPtr selectedFeatures;
+    qint64 hovered;
+    LabelEngine *labels;
+    bool clusterPoints;
+    bool clustersStale;
+    PointClusterIndexPtr clusters;
+    QFutureWatcher<PointClusterIndexPtr> *clusterWatcher;
+    QColor layerColor;
+    QRectF bounds;
+
+    // One per view (its viewport widget) that has painted the layer
+    QHash<QWidget*, ViewCache*> viewCaches;
+    quint64 renderGeneration;    // Renewed by every invalidation
+    RenderResult lastRender;     // Not yet reported to the diagnostics
+    bool lastRenderReported;
+};
+
+#endif // VECTORLAYERITEM_H
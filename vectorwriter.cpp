@@ -0,0 +1,199 @@
+#include "vectorwriter.h"
+
+#include <QFileInfo>
+
+#include "cpl_string.h"
+#include "gdal_priv.h"
+#include "ogrsf_frmts.h"
+
+#include "coordinatetransformer.h"
+
+namespace {
+OGRwkbGeometryType layerGeometryType(const FeatureStore &store, bool multi)
+{
+    switch (store.dominantKind()) {
+    case FeatureStore::PointGeometry:
+        return multi ? wkbMultiPoint : wkbPoint;
+    case FeatureStore::LineGeometry:
+        return multi ? wkbMultiLineString : wkbLineString;
+    case FeatureStore::PolygonGeometry:
+        return multi ? wkbMultiPolygon : wkbPolygon;
+    default:
+        return wkbUnknown;
+    }
+}
+
+// Per-driver layer options; GeoPackage indexes are deferred to the end
+char **layerCreationOptions(const QString &driver, bool spatialIndex)
+{
+    char **options = nullptr;
+    if (driver == "GPKG") {
+        options = CSLSetNameValue(options, "SPATIAL_INDEX", "NO");
+    } else if (driver == "FlatGeobuf") {
+        options = CSLSetNameValue(options, "SPATIAL_INDEX", spatialIndex ? "YES" : "NO");
+    } else if (driver == "CSV") {
+        options = CSLSetNameValue(options, "GEOMETRY", "AS_WKT");
+    } else if (driver == "ESRI Shapefile") {
+        options = CSLSetNameValue(options, "ENCODING", "UTF-8");
+    }
+    return options;
+}
+
+// Builds the index of a finished layer where the driver does not do it on close
+bool createSpatialIndex(GDALDataset *dataset, OGRLayer *layer, const QString &driver)
+{
+    QString sql;
+    if (driver == "GPKG") {
+        sql = QString("SELECT CreateSpatialIndex('%1', '%2')")
+                .arg(QString::fromUtf8(layer->GetName()), QString::fromUtf8(layer->GetGeometryColumn()));
+    } else if (driver == "ESRI Shapefile") {
+        sql = QString("CREATE SPATIAL INDEX ON \"%1\"").arg(QString::fromUtf8(layer->GetName()));
+    } else {
+        return true;
+    }
+
+    CPLErrorReset();
+    OGRLayer *result = dataset->ExecuteSQL(sql.toUtf8().constData(), nullptr, nullptr);
+    if (result) dataset->ReleaseResultSet(result);
+    return CPLGetLastErrorType() < CE_Failure;
+}
+}
+
+bool VectorWriter::write(const FeatureStore &store, const QString &filePath,
+                         const QString &layerName, const QString &crs,
+                         const Options &options,
+                         Geoprocessing::Feedback *feedback, QString *error)
+{
+    GDALDriver *driver = GetGDALDriverManager()->GetDriverByName(options.driver.toUtf8().constData());
+    if (!driver) {
+        if (error) *error = "OGR driver not available: " + options.driver;
+        return false;
+    }
+
+    // Replace an existing file rather than appending to it
+    if (QFileInfo::exists(filePath)) {
+        driver->Delete(filePath.toUtf8().constData());
+    }
+
+    GDALDataset *dataset = driver->Create(filePath.toUtf8().constData(), 0, 0, 0, GDT_Unknown, nullptr);
+    if (!dataset) {
+        if (error) *error = "Could not create " + filePath + ": " + QString::fromUtf8(CPLGetLastErrorMsg());
+        return false;
+    }
+
+    // Multi types only when some feature actually has several parts
+    bool multi = store.hasMultipartFeatures();
+    OGRwkbGeometryType geometryType = layerGeometryType(store, multi);
+
+    OGRSpatialReference *srs = CoordinateTransformer::createSpatialReference(crs);
+    char **creationOptions = layerCreationOptions(options.driver, options.spatialIndex);
+    OGRLayer *layer = dataset->CreateLayer(layerName.toUtf8().constData(), srs, geometryType, creationOptions);
+    CSLDestroy(creationOptions);
+    if (srs) srs->Release();
+    if (!layer) {
+        if (error) *error = "Could not create layer " + layerName + ": " + QString::fromUtf8(CPLGetLastErrorMsg());
+        GDALClose(dataset);
+        return false;
+    }
+
+    for (int field = 0; field < store.fieldCount(); ++field) {
+        OGRFieldType type = OFTString;
+        if (store.field(field).type == FeatureStore::IntegerField) type = OFTInteger64;
+        else if (store.field(field).type == FeatureStore::RealField) type = OFTReal;
+        OGRFieldDefn definition(store.field(field).name.toUtf8().constData(), type);
+        layer->CreateField(&definition);
+    }
+
+    qint64 count = store.featureCount();
+    if (feedback) feedback->setTotal(count);
+    int batchSize = qMax(1, options.batchSize);
+
+    bool ok = true;
+    bool inTransaction = false;
+    // One feature object for the whole layer; only its contents change
+    OGRFeature *feature = OGRFeature::CreateFeature(layer->GetLayerDefn());
+    for (qint64 f = 0; f < count && ok; ++f) {
+        if (!inTransaction) {
+            inTransaction = dataset->StartTransaction() == OGRERR_NONE;
+        }
+
+        OGRGeometry *geometry = store.createGeometry(f);
+        if (geometry && multi) {
+            geometry = OGRGeometryFactory::forceTo(geometry, geometryType);
+        }
+        feature->SetFID(OGRNullFID);
+        feature->SetGeometryDirectly(geometry);
+
+        for (int field = 0; field < store.fieldCount(); ++field) {
+            if (store.isNull(field, f)) {
+                feature->SetFieldNull(field);
+                continue;
+            }
+            switch (store.field(field).type) {
+            case FeatureStore::IntegerField:
+                feature->SetField(field, GIntBig(store.integerValue(field, f)));
+                break;
+            case FeatureStore::RealField:
+                feature->SetField(field, store.realValue(field, f));
+                break;
+            case FeatureStore::StringField:
+                feature->SetField(field, store.stringValue(field, f).toUtf8().constData());
+                break;
+            }
+        }
+
+        if (layer->CreateFeature(feature) != OGRERR_NONE) {
+            if (error) *error = "Could not write feature: " + QString::fromUtf8(CPLGetLastErrorMsg());
+            ok = false;
+        }
+
+        if ((f + 1) % batchSize == 0 || f + 1 == count) {
+            if (inTransaction && dataset->CommitTransaction() != OGRERR_NONE) {
+                if (error) *error = "Could not commit: " + QString::fromUtf8(CPLGetLastErrorMsg());
+                ok = false;
+            }
+            inTransaction = false;
+            if (feedback) {
+                feedback->addProgress((f % batchSize) + 1);
+                if (feedback->isCanceled()) {
+                    if (error) *error = "Canceled";
+                    ok = false;
+                }
+            }
+        }
+    }
+    OGRFeature::DestroyFeature(feature);
+
+    if (inTransaction) {
+        dataset->RollbackTransaction();
+    }
+
+    if (ok && options.spatialIndex && !createSpatialIndex(dataset, layer, options.driver)) {
+        if (error) *error = "Could not create the spatial index: " + QString::fromUtf8(CPLGetLastErrorMsg());
+        ok = false;
+    }
+
+    GDALClose(dataset);
+    return ok;
+}
+
+QVector<VectorWriter::Format> VectorWriter::formats()
+{
+    QVector<Format> list;
+    list.append({"GeoPackage", "GPKG", "gpkg"});
+    list.append({"FlatGeobuf", "FlatGeobuf", "fgb"});
+    list.append({"GeoJSON Sequence", "GeoJSONSeq", "geojsonl"});
+    list.append({"ESRI Shapefile", "ESRI Shapefile", "shp"});
+    list.append({"CSV (geometry as WKT)", "CSV", "csv"});
+    return list;
+}
+
+QString VectorWriter::driverForPath(const QString &filePath)
+{
+    QString suffix = QFileInfo(filePath).suffix().toLower();
+    if (suffix == "geojsons") suffix = "geojsonl";
+    for (const Format &format : formats()) {
+        if (format.extension == suffix) return format.driver;
+    }
+    return QString();
+}
@@ -0,0 +1,43 @@
+#ifndef VECTORWRITER_H
+#define VECTORWRITER_H
+
+#include <QString>
+#include <QVector>
+
+#include "featurestore.h"
+#include "geoprocessing.h"
+
+// Writes a FeatureStore to an OGR data source (GeoPackage by default).
+//
+// Features are streamed straight from the columnar store through one
+// reused OGRFeature and committed in transactions of batchSize features;
+// one transaction per feature is what makes naive GeoPackage writes slow.
+// Spatial indexes are built once after the last batch instead of being
+// updated on every insert.
+class VectorWriter
+{
+public:
+    struct Options {
+        QString driver = "GPKG";
+        int batchSize = 100000;
+        bool spatialIndex = true;
+    };
+
+    // Export formats offered to the user
+    struct Format {
+        QString name;
+        QString driver;
+        QString extension;
+    };
+
+    static bool write(const FeatureStore &store, const QString &filePath,
+                      const QString &layerName, const QString &crs,
+                      const Options &options = Options(),
+                      Geoprocessing::Feedback *feedback = nullptr, QString *error = nullptr);
+
+    static QVector<Format> formats();
+    // Driver for a file name extension, empty when it is not an export format
+    static QString driverForPath(const QString &filePath);
+};
+
+#endif // VECTORWRITER_H